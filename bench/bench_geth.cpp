@@ -0,0 +1,240 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <getopt.h>
+
+#include "dcss.h"
+#include "geth_mock.h"
+#include "tx_manager.h"
+
+// Drive the Ethereum paths (node startup, the transactions, then concurrent
+// calls) against geth, by default against the in-process stand-in.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void usage()
+{
+    std::cerr << "usage: bench_geth\n";
+    std::cerr << "\t-g\tgeth RPC server address "
+                 "(default mock:100,1, see GethMockConf::parse)\n";
+    std::cerr << "\t-n\tnumber of nodes to start\n";
+    std::cerr << "\t-a\tnumber of accounts sending the transactions\n";
+    std::cerr << "\t-t\tnumber of transactions\n";
+    std::cerr << "\t-w\tseconds to wait for the transactions\n";
+    std::cerr << "\t-G\tconnections to geth (size[,timeout_ms])\n";
+    std::cerr << "\t-c\tnumber of concurrent callers\n";
+    exit(1);
+}
+
+double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/** Start `n_nodes` nodes, with their accounts. */
+void bench_startup(const dcss::Conf& conf)
+{
+    dcss::Network network(conf);
+    const auto start = Clock::now();
+
+    network.initialize_nodes(1, {});
+    network.provision_accounts();
+    std::cout << conf.n_nodes << " nodes started in " << seconds_since(start)
+              << "s (" << conf.accounts.size() << " accounts)\n";
+}
+
+/** Send `n_txs` transactions from `n_accounts` accounts, wait for them (at
+ * most `wait`): the ones still waiting are reported as stuck.
+ */
+void bench_txs(
+    const dcss::Conf& conf,
+    uint32_t n_accounts,
+    uint32_t n_txs,
+    std::chrono::seconds wait)
+{
+    std::vector<std::string> accounts;
+    for (uint32_t i = 0; i < n_accounts; ++i) {
+        accounts.push_back(conf.geth.personal_newAccount("bench"));
+        conf.geth.personal_unlockAccount(accounts.back(), "bench", 0);
+    }
+
+    std::vector<std::future<dcss::TxReceipt>> receipts;
+    const auto start = Clock::now();
+    for (uint32_t i = 0; i < n_txs; ++i) {
+        Json::Value tx;
+        tx["from"] = accounts[i % accounts.size()];
+        tx["to"] = accounts[(i + 1) % accounts.size()];
+        tx["data"] = "0x";
+        receipts.push_back(conf.txs.submit(tx));
+    }
+    const auto deadline = start + wait;
+    uint32_t n_failed = 0;
+    uint32_t n_stuck = 0;
+    for (auto& receipt : receipts) {
+        if (receipt.wait_until(deadline) != std::future_status::ready) {
+            ++n_stuck;
+            continue;
+        }
+        try {
+            n_failed += receipt.get().success ? 0 : 1;
+        } catch (const std::exception&) {
+            ++n_failed;
+        }
+    }
+    const double elapsed = seconds_since(start);
+
+    const dcss::TxStats stats = conf.txs.stats();
+    std::cout << n_txs << " transactions in " << elapsed << "s ("
+              << n_txs / elapsed << " tx/s, " << n_failed << " failed, "
+              << n_stuck << " stuck)\n"
+              << "calls per transaction: "
+              << static_cast<double>(stats.n_calls) / n_txs
+              << ", requests per transaction: "
+              << static_cast<double>(stats.n_requests) / n_txs << '\n';
+}
+
+/** Call geth from `n_callers` threads together, `n_calls` times each. */
+void bench_calls(const dcss::Conf& conf, uint32_t n_callers, uint32_t n_calls)
+{
+    const dcss::GethPoolStats before = conf.geth_pool->stats();
+    std::vector<std::thread> callers;
+    std::vector<uint32_t> n_failed(n_callers, 0);
+    const auto start = Clock::now();
+
+    for (uint32_t i = 0; i < n_callers; ++i) {
+        callers.emplace_back([&conf, &n_failed, i, n_calls] {
+            for (uint32_t j = 0; j < n_calls; ++j) {
+                try {
+                    conf.geth.eth_blockNumber();
+                } catch (const jsonrpc::JsonRpcException&) {
+                    ++n_failed[i];
+                }
+            }
+        });
+    }
+    for (std::thread& caller : callers) {
+        caller.join();
+    }
+    const double elapsed = seconds_since(start);
+
+    const dcss::GethPoolStats stats = conf.geth_pool->stats();
+    uint32_t total_failed = 0;
+    for (const uint32_t n : n_failed) {
+        total_failed += n;
+    }
+    std::cout << n_callers << " callers: " << n_callers * n_calls
+              << " calls in " << elapsed << "s ("
+              << n_callers * n_calls / elapsed << " calls/s, "
+              << total_failed << " failed)\n"
+              << "connections: " << stats.n_opened << " opened, "
+              << stats.n_waits - before.n_waits << " waits for one\n";
+}
+
+} // namespace
+
+// NOLINTNEXTLINE(cert-err58-cpp)
+INITIALIZE_EASYLOGGINGPP
+
+int main(int argc, char** argv)
+{
+    int c;
+    std::string geth_addr = "mock:100,1";
+    uint32_t n_nodes = 1000;
+    uint32_t n_accounts = 10;
+    uint32_t n_txs = 1000;
+    uint32_t wait = 60;
+    uint32_t n_callers = 32;
+    dcss::GethPoolConf pool_conf;
+
+    try {
+        while ((c = getopt(argc, argv, "g:n:a:t:w:G:c:")) != -1) {
+            switch (c) {
+            case 'g':
+                geth_addr = optarg;
+                break;
+            case 'n':
+                n_nodes = dcss::stou32(optarg);
+                break;
+            case 'a':
+                n_accounts = dcss::stou32(optarg);
+                break;
+            case 't':
+                n_txs = dcss::stou32(optarg);
+                break;
+            case 'w':
+                wait = dcss::stou32(optarg);
+                break;
+            case 'G':
+                pool_conf = dcss::GethPoolConf::parse(optarg);
+                break;
+            case 'c':
+                n_callers = dcss::stou32(optarg);
+                break;
+            default:
+                usage();
+            }
+        }
+    } catch (const dcss::DomainError& exn) {
+        std::cerr << exn.what() << '\n';
+        usage();
+    }
+    if (n_nodes == 0 || n_accounts == 0 || n_txs == 0 || n_callers == 0) {
+        usage();
+    }
+
+    try {
+        const dcss::Conf conf(64, 20, 3, n_nodes, geth_addr, {}, pool_conf);
+
+        bench_startup(conf);
+        bench_txs(conf, n_accounts, n_txs, std::chrono::seconds(wait));
+        bench_calls(conf, n_callers, n_txs / n_callers + 1);
+
+        if (conf.geth_mock) {
+            const dcss::GethMockStats stats = conf.geth_mock->stats();
+            std::cout << "geth mock: " << stats.n_requests << " requests, "
+                      << stats.n_calls << " calls, " << stats.n_failures
+                      << " failures injected\n";
+        }
+    } catch (const std::exception& exn) {
+        std::cerr << exn.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
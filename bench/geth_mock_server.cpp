@@ -0,0 +1,141 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <getopt.h>
+
+#include <jsonrpccpp/server.h>
+#include <jsonrpccpp/server/connectors/httpserver.h>
+
+#include "exceptions.h"
+#include "geth_mock.h"
+#include "utils.h"
+
+// Serve the geth stand-in over HTTP, for the runs of `dcss` in other
+// processes (`-g localhost:PORT`).
+
+namespace {
+
+/** Answer the HTTP requests with the stand-in. */
+class Handler : public jsonrpc::IClientConnectionHandler {
+  public:
+    explicit Handler(dcss::GethMock& mock) : m_mock(mock) {}
+
+    void HandleRequest(const std::string& request, std::string& retValue)
+        override
+    {
+        retValue = m_mock.handle(request);
+    }
+
+  private:
+    dcss::GethMock& m_mock;
+};
+
+volatile std::sig_atomic_t g_stopping = 0;
+
+void stop(int /* signum */)
+{
+    g_stopping = 1;
+}
+
+void usage()
+{
+    std::cerr << "usage: geth_mock\n";
+    std::cerr << "\t-p\tport (default 8545)\n";
+    std::cerr << "\t-t\tnumber of threads serving the requests\n";
+    std::cerr << "\t-m\tbehavior (BLOCK_MS[,LATENCY_MS[,FAILURE_PCT"
+                 "[,REVERT_PCT]]])\n";
+    std::cerr << "\t-S\trandom seed (of the failures and reverts)\n";
+    exit(1);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int c;
+    uint32_t port = 8545;
+    uint32_t n_threads = 8;
+    dcss::GethMockConf conf;
+
+    try {
+        while ((c = getopt(argc, argv, "p:t:m:S:")) != -1) {
+            switch (c) {
+            case 'p':
+                port = dcss::stou32(optarg);
+                break;
+            case 't':
+                n_threads = dcss::stou32(optarg);
+                break;
+            case 'm':
+                conf = dcss::GethMockConf::parse(optarg);
+                break;
+            case 'S':
+                conf.seed = dcss::stou32(optarg);
+                break;
+            default:
+                usage();
+            }
+        }
+    } catch (const dcss::DomainError& exn) {
+        std::cerr << exn.what() << '\n';
+        usage();
+    }
+
+    dcss::GethMock mock(conf);
+    Handler handler(mock);
+    jsonrpc::HttpServer server(
+        static_cast<int>(port), "", "", static_cast<int>(n_threads));
+
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+    server.SetHandler(&handler);
+    if (!server.StartListening()) {
+        std::cerr << "cannot listen on port " << port << '\n';
+        return EXIT_FAILURE;
+    }
+    while (g_stopping == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    server.StopListening();
+
+    const dcss::GethMockStats stats = mock.stats();
+    std::cout << stats.n_requests << " requests, " << stats.n_calls
+              << " calls, " << stats.n_transactions << " transactions, "
+              << stats.n_failures << " failures injected, " << stats.n_reverts
+              << " reverts\n";
+    return EXIT_SUCCESS;
+}
@@ -214,9 +214,28 @@ contract DCSS is owned, TokenERC20 {
 
   mapping (address => bool) public frozenAccount;
 
+  // Unidirectional payment channel: the buyer escrows a deposit, then pays
+  // the seller off-chain by signing vouchers for the cumulative bytes put
+  // and got. Only the opening and the closing are transactions.
+  struct Channel {
+    address buyer;
+    address seller;
+    uint256 deposit;
+    uint256 putPrice;
+    uint256 getPrice;
+    uint256 expiration;
+  }
+
+  // The channels are never deleted (only emptied), so that an ID (and the
+  // vouchers signed for it) cannot be reused.
+  mapping (bytes32 => Channel) public channels;
+
   /* This generates a public event on the blockchain that will notify clients */
   event FrozenFunds(address target, bool frozen);
 
+  event ChannelOpened(bytes32 indexed id, address indexed buyer, address indexed seller, uint256 deposit);
+  event ChannelClosed(bytes32 indexed id, uint256 payment, uint256 refund);
+
   /* Initializes contract with initial supply tokens to the creator of the contract */
   function DCSS(
     uint256 initialSupply,
@@ -299,6 +318,24 @@ contract DCSS is owned, TokenERC20 {
     return transferFrom(from, msg.sender, thirdPartyCost);
   }
 
+  /// @notice Buy storage from several sellers at once (e.g. the holders of
+  /// the replicas or fragments of a file): `nBytes[i]` bytes from
+  /// `sellers[i]`, the third party being paid once
+  function buyStorageBatch(address from, address[] sellers, uint256[] nBytes) public returns (bool success) {
+    require(sellers.length == nBytes.length);
+    uint256 thirdPartyCost = 0;
+    for (uint i = 0; i < sellers.length; i++) {
+      uint256 totalCost = nBytes[i] * storagePriceOf[sellers[i]][buyPriceIndex];
+      uint256 sellerThirdPartyCost = totalCost * 3 / 100;
+      thirdPartyCost += sellerThirdPartyCost;
+      transferFrom(from, sellers[i], totalCost - sellerThirdPartyCost);
+    }
+    if (thirdPartyCost == 0) {
+      return true;
+    }
+    return transferFrom(from, msg.sender, thirdPartyCost);
+  }
+
   function buyerPutBytes(address from, address to, uint256 nBytes) public returns (bool success) {
     uint256 totalCost = nBytes * storagePriceOf[to][putPriceIndex];
     uint256 thirdPartyCost = totalCost * 3 / 100;
@@ -314,5 +351,68 @@ contract DCSS is owned, TokenERC20 {
     transferFrom(from, to, renterCost);
     return transferFrom(from, msg.sender, thirdPartyCost);
   }
-}
 
+  /// @notice Open the channel `id` to `seller`, escrowing `deposit` tokens
+  /// for `duration` blocks (the storage prices of the seller, `putPrice` and
+  /// `getPrice`, are frozen)
+  function openChannel(bytes32 id, address seller, uint256 deposit, uint256 putPrice, uint256 getPrice, uint256 duration) public {
+    require(channels[id].buyer == 0x0);
+    require(deposit > 0);
+    // The buyer caps its payments at the prices it expects.
+    require(putPrice == storagePriceOf[seller][putPriceIndex]);
+    require(getPrice == storagePriceOf[seller][getPriceIndex]);
+    _transfer(msg.sender, this, deposit);
+    channels[id] = Channel(msg.sender, seller, deposit, putPrice, getPrice,
+                           block.number + duration);
+    ChannelOpened(id, msg.sender, seller, deposit);
+  }
+
+  /// @notice Close the channel `id` with the last voucher of its buyer: the
+  /// seller is paid for `putBytes` and `getBytes` (up to the deposit), the
+  /// buyer gets the rest back
+  function settleChannel(bytes32 id, uint256 putBytes, uint256 getBytes, uint8 v, bytes32 r, bytes32 s) public {
+    Channel storage channel = channels[id];
+    require(msg.sender == channel.seller);
+    require(channel.deposit > 0);
+    // Signed with eth_sign: 116 bytes are the contract, the ID and the bytes.
+    bytes32 voucher = keccak256("\x19Ethereum Signed Message:\n116", this, id, putBytes, getBytes);
+    require(ecrecover(voucher, v, r, s) == channel.buyer);
+    // Up to the deposit, without overflowing.
+    uint256 payment = channel.deposit;
+    if (channel.putPrice == 0 || putBytes <= payment / channel.putPrice) {
+      uint256 left = payment - putBytes * channel.putPrice;
+      if (channel.getPrice == 0 || getBytes <= left / channel.getPrice) {
+        payment -= left - getBytes * channel.getPrice;
+      }
+    }
+    _closeChannel(id, payment);
+  }
+
+  /// @notice Get the deposit of the channel `id` back, if the seller didn't
+  /// settle it before its expiration
+  function disputeChannel(bytes32 id) public {
+    Channel storage channel = channels[id];
+    require(msg.sender == channel.buyer);
+    require(channel.deposit > 0);
+    require(block.number >= channel.expiration);
+    _closeChannel(id, 0);
+  }
+
+  function _closeChannel(bytes32 id, uint256 payment) internal {
+    Channel storage channel = channels[id];
+    require(payment <= channel.deposit);
+    uint256 refund = channel.deposit - payment;
+    uint256 thirdPartyCost = payment * 3 / 100;
+    channel.deposit = 0;
+    if (payment > thirdPartyCost) {
+      _transfer(this, channel.seller, payment - thirdPartyCost);
+    }
+    if (thirdPartyCost > 0) {
+      _transfer(this, owner, thirdPartyCost);
+    }
+    if (refund > 0) {
+      _transfer(this, channel.buyer, refund);
+    }
+    ChannelClosed(id, payment, refund);
+  }
+}
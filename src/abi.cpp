@@ -0,0 +1,79 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+
+#include "abi.h"
+
+namespace dcss {
+namespace abi {
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+void write_hex(char* out, uint64_t v, size_t n_digits)
+{
+    for (size_t i = n_digits; i > 0; --i) {
+        out[i - 1] = HEX_DIGITS[v & 0xf];
+        v >>= 4;
+    }
+}
+
+void Uint256::encode(char* out, const value_type& v)
+{
+    write_hex(out, v, 64);
+}
+
+void Uint8::encode(char* out, const value_type& v)
+{
+    write_hex(out, v, 64);
+}
+
+// Check the length of an hex string (0x and `n_digits` digits).
+static void check_hex(const std::string& v, size_t n_digits, const char* what)
+{
+    if (v.size() != 2 + n_digits || v[0] != '0' || v[1] != 'x') {
+        throw DomainError(std::string("invalid ") + what + ": " + v);
+    }
+}
+
+void Address::encode(char* out, const value_type& v)
+{
+    check_hex(v, 40, "address");
+    std::fill_n(out, 24, '0');
+    std::copy_n(v.data() + 2, 40, out + 24);
+}
+
+void Bytes32::encode(char* out, const value_type& v)
+{
+    check_hex(v, 64, "bytes32");
+    std::copy_n(v.data() + 2, 64, out);
+}
+
+} // namespace abi
+} // namespace dcss
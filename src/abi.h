@@ -0,0 +1,207 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_ABI_H__
+#define __DCSS_ABI_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "exceptions.h"
+#include "keccak.h"
+
+namespace dcss {
+
+/** Encoding of the contract calls, according to the Ethereum Contract ABI.
+ *
+ * See https://github.com/ethereum/wiki/wiki/Ethereum-Contract-ABI
+ *
+ * A function is declared with the types of its arguments, e.g.
+ *
+ *     constexpr abi::Function<abi::Address, abi::Uint256> TRANSFER(
+ *         "transfer(address,uint256)");
+ *
+ * Its selector is computed, and its signature checked against the types, at
+ * compile time. Its arguments are encoded in a single buffer, allocated
+ * once.
+ */
+namespace abi {
+
+/** Write the `n_digits` lowest hex digits of `v` to `out` (zero-padded). */
+void write_hex(char* out, uint64_t v, size_t n_digits);
+
+// The argument types: each one encodes a `value_type` in `size` hex digits,
+// in the head (static types) or in the tail (dynamic types) of the
+// arguments.
+
+/** uint256 (only up to 64 bits here). */
+struct Uint256 {
+    using value_type = uint64_t;
+
+    static constexpr const char* name()
+    {
+        return "uint256";
+    }
+    static constexpr bool is_dynamic()
+    {
+        return false;
+    }
+    static size_t size(const value_type& /*v*/)
+    {
+        return 64;
+    }
+    static void encode(char* out, const value_type& v);
+};
+
+/** uint8, encoded (padded) as an uint256. */
+struct Uint8 {
+    using value_type = uint8_t;
+
+    static constexpr const char* name()
+    {
+        return "uint8";
+    }
+    static constexpr bool is_dynamic()
+    {
+        return false;
+    }
+    static size_t size(const value_type& /*v*/)
+    {
+        return 64;
+    }
+    static void encode(char* out, const value_type& v);
+};
+
+/** address, given as an hex string (0x and 40 digits). */
+struct Address {
+    using value_type = std::string;
+
+    static constexpr const char* name()
+    {
+        return "address";
+    }
+    static constexpr bool is_dynamic()
+    {
+        return false;
+    }
+    static size_t size(const value_type& /*v*/)
+    {
+        return 64;
+    }
+    /** @throw DomainError if `v` is not an address */
+    static void encode(char* out, const value_type& v);
+};
+
+/** bytes32, given as an hex string (0x and 64 digits). */
+struct Bytes32 {
+    using value_type = std::string;
+
+    static constexpr const char* name()
+    {
+        return "bytes32";
+    }
+    static constexpr bool is_dynamic()
+    {
+        return false;
+    }
+    static size_t size(const value_type& /*v*/)
+    {
+        return 64;
+    }
+    /** @throw DomainError if `v` is not 32 bytes long */
+    static void encode(char* out, const value_type& v);
+};
+
+/** T[], a dynamic array of a static type: its length, then its items. */
+template <typename T>
+struct Array {
+    using value_type = std::vector<typename T::value_type>;
+
+    static constexpr const char* name()
+    {
+        return T::name();
+    }
+    static constexpr bool is_dynamic()
+    {
+        return true;
+    }
+    static size_t size(const value_type& v)
+    {
+        return 64 * (1 + v.size());
+    }
+    static void encode(char* out, const value_type& v);
+};
+
+/** A function of a contract, taking arguments of types `Args`. */
+template <typename... Args>
+class Function {
+  public:
+    /** @throw LogicError (a compilation error, if `constexpr`) if the
+     * argument types of `signature` are not `Args`
+     */
+    constexpr explicit Function(const char* signature);
+
+    constexpr const char* signature() const
+    {
+        return m_signature;
+    }
+
+    /** Return the first 4 bytes of the Keccak-256 of the signature. */
+    constexpr uint32_t selector() const
+    {
+        return m_selector;
+    }
+
+    /** Return the call data: 0x, the selector, then the arguments. */
+    std::string encode(const typename Args::value_type&... args) const;
+
+    /** Return the number of hex digits written by `encode_to`. */
+    size_t size(const typename Args::value_type&... args) const;
+
+    /** Write the call data (without the 0x) to `out`, which must hold
+     * `size(args...)` digits.
+     */
+    void
+    encode_to(char* out, const typename Args::value_type&... args) const;
+
+  private:
+    static constexpr bool matches(const char* signature);
+
+    const char* m_signature;
+    uint32_t m_selector;
+};
+
+} // namespace abi
+} // namespace dcss
+
+#include "abi.tpp"
+
+#endif
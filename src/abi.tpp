@@ -0,0 +1,198 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string>
+
+namespace dcss {
+namespace abi {
+
+namespace detail {
+
+/** Returned by `skip` when the signature doesn't match. */
+constexpr size_t NO_MATCH = static_cast<size_t>(-1);
+
+/** Return the position following `expected` in `signature`, if it is found
+ * at `pos`, or else NO_MATCH.
+ */
+constexpr size_t skip(const char* signature, size_t pos, const char* expected)
+{
+    if (pos == NO_MATCH) {
+        return NO_MATCH;
+    }
+    for (size_t i = 0; expected[i] != '\0'; ++i, ++pos) {
+        if (signature[pos] != expected[i]) {
+            return NO_MATCH;
+        }
+    }
+    return pos;
+}
+
+/** What follows the name of a type in a signature (`[]` for arrays). */
+template <typename T>
+struct TypeSuffix {
+    static constexpr const char* value()
+    {
+        return "";
+    }
+};
+
+template <typename T>
+struct TypeSuffix<Array<T>> {
+    static constexpr const char* value()
+    {
+        return "[]";
+    }
+};
+
+/** Encode the arguments one at a time: the static ones in the head, the
+ * dynamic ones in the tail (their offset, in bytes, in the head).
+ */
+template <typename... Ts>
+struct ArgsEncoder;
+
+template <>
+struct ArgsEncoder<> {
+    static size_t size()
+    {
+        return 0;
+    }
+    static void encode(char* /*base*/, char* /*head*/, size_t /*tail*/) {}
+};
+
+template <typename T, typename... Ts>
+struct ArgsEncoder<T, Ts...> {
+    static size_t
+    size(const typename T::value_type& v, const typename Ts::value_type&... vs)
+    {
+        // A dynamic argument takes its offset in the head, then its tail.
+        const size_t head = T::is_dynamic() ? 64 : 0;
+        return head + T::size(v) + ArgsEncoder<Ts...>::size(vs...);
+    }
+
+    /** @param tail position of the next dynamic argument, from `base` */
+    static void encode(
+        char* base,
+        char* head,
+        size_t tail,
+        const typename T::value_type& v,
+        const typename Ts::value_type&... vs)
+    {
+        if (T::is_dynamic()) {
+            Uint256::encode(head, tail / 2);
+            T::encode(base + tail, v);
+            tail += T::size(v);
+        } else {
+            T::encode(head, v);
+        }
+        ArgsEncoder<Ts...>::encode(base, head + 64, tail, vs...);
+    }
+};
+
+} // namespace detail
+
+template <typename T>
+void Array<T>::encode(char* out, const value_type& v)
+{
+    static_assert(!T::is_dynamic(), "arrays of dynamic types unsupported");
+
+    Uint256::encode(out, v.size());
+    for (size_t i = 0; i < v.size(); ++i) {
+        T::encode(out + 64 * (1 + i), v[i]);
+    }
+}
+
+template <typename... Args>
+constexpr Function<Args...>::Function(const char* signature)
+    : m_signature(signature), m_selector(0)
+{
+    if (!matches(signature)) {
+        throw LogicError(
+            std::string("argument types don't match ") + signature);
+    }
+
+    const keccak::Digest digest = keccak::keccak256(signature);
+    for (size_t i = 0; i < 4; ++i) {
+        m_selector = (m_selector << 8) | digest.bytes[i];
+    }
+}
+
+template <typename... Args>
+constexpr bool Function<Args...>::matches(const char* signature)
+{
+    const char* names[] = {Args::name()..., nullptr};
+    const char* suffixes[] = {detail::TypeSuffix<Args>::value()..., nullptr};
+
+    size_t pos = 0;
+    while (signature[pos] != '(') {
+        if (signature[pos] == '\0') {
+            return false;
+        }
+        ++pos;
+    }
+    ++pos;
+    for (size_t i = 0; i < sizeof...(Args); ++i) {
+        if (i != 0) {
+            pos = detail::skip(signature, pos, ",");
+        }
+        pos = detail::skip(signature, pos, names[i]);
+        pos = detail::skip(signature, pos, suffixes[i]);
+    }
+    pos = detail::skip(signature, pos, ")");
+    return pos != detail::NO_MATCH && signature[pos] == '\0';
+}
+
+template <typename... Args>
+std::string
+Function<Args...>::encode(const typename Args::value_type&... args) const
+{
+    std::string data(2 + size(args...), '0');
+
+    data[1] = 'x';
+    encode_to(&data[2], args...);
+    return data;
+}
+
+template <typename... Args>
+size_t Function<Args...>::size(const typename Args::value_type&... args) const
+{
+    return 8 + detail::ArgsEncoder<Args...>::size(args...);
+}
+
+template <typename... Args>
+void Function<Args...>::encode_to(
+    char* out,
+    const typename Args::value_type&... args) const
+{
+    write_hex(out, m_selector, 8);
+    detail::ArgsEncoder<Args...>::encode(
+        out + 8, out + 8, 64 * sizeof...(Args), args...);
+}
+
+} // namespace abi
+} // namespace dcss
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <sstream>
+
+#include "account_cache.h"
+#include "exceptions.h"
+
+namespace dcss {
+
+void AccountCache::open(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::ifstream fin(path);
+    std::string line;
+    uint64_t line_no = 0;
+    while (std::getline(fin, line)) {
+        ++line_no;
+        std::istringstream input(line);
+        std::string id;
+        std::string account;
+
+        if (!(input >> id >> account)) {
+            throw DomainError(
+                path + ':' + std::to_string(line_no) + ": parse error");
+        }
+        try {
+            m_accounts[UInt160(id)] = account;
+        } catch (const LogicError&) {
+            throw DomainError(
+                path + ':' + std::to_string(line_no) + ": invalid node ID");
+        }
+    }
+
+    if (m_file.is_open()) {
+        m_file.close();
+    }
+    m_file.open(path, std::ios::app);
+    if (!m_file.is_open()) {
+        throw DomainError("cannot open " + path);
+    }
+}
+
+std::string AccountCache::find(const UInt160& node) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto it = m_accounts.find(node);
+    return it == m_accounts.end() ? "" : it->second;
+}
+
+void AccountCache::insert(const UInt160& node, const std::string& account)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_accounts[node] = account;
+    if (m_file.is_open()) {
+        m_file << node.to_string() << ' ' << account << '\n';
+        m_file.flush();
+    }
+}
+
+void AccountCache::erase(const UInt160& node)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_accounts.erase(node);
+}
+
+size_t AccountCache::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_accounts.size();
+}
+
+} // namespace dcss
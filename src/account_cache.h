@@ -0,0 +1,87 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_ACCOUNT_CACHE_H__
+#define __DCSS_ACCOUNT_CACHE_H__
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "uint160.h"
+
+namespace dcss {
+
+/** Ethereum accounts of the nodes, indexed by node ID.
+ *
+ * The accounts can be kept in a local file (a line `<node ID> <account>`
+ * per account), so that a restarted network reuses them instead of
+ * creating new ones. Loading the file is linear and makes no call to geth.
+ */
+class AccountCache {
+  public:
+    AccountCache() = default;
+    ~AccountCache() = default;
+    AccountCache(AccountCache const&) = delete;
+    AccountCache& operator=(AccountCache const& x) = delete;
+    AccountCache(AccountCache&&) = delete;
+    AccountCache& operator=(AccountCache&& x) = delete;
+
+    /** Load the accounts of `path` (if it exists), the new accounts are
+     * then appended to it.
+     *
+     * @throw DomainError if the file cannot be opened or parsed
+     */
+    void open(const std::string& path);
+
+    /** Return the account of `node` (empty if unknown). */
+    std::string find(const UInt160& node) const;
+
+    /** Record the account of `node` (in the file too, if any). */
+    void insert(const UInt160& node, const std::string& account);
+
+    /** Forget the account of `node`: in the file, it stands until a new
+     * account of `node` is recorded (the later records win).
+     */
+    void erase(const UInt160& node);
+
+    /** Return the number of accounts. */
+    size_t size() const;
+
+  private:
+    mutable std::mutex m_mutex;
+    std::unordered_map<UInt160, std::string> m_accounts;
+    std::ofstream m_file;
+};
+
+} // namespace dcss
+
+#endif
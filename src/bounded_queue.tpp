@@ -0,0 +1,94 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <utility>
+
+namespace dcss {
+
+template <typename T>
+BoundedQueue<T>::BoundedQueue(size_t capacity)
+    : m_capacity(capacity == 0 ? 1 : capacity), m_closed(false)
+{
+}
+
+/** Enqueue an item, waiting for some room if the queue is full.
+ *
+ * @return false if the queue is closed (the item is dropped).
+ */
+template <typename T>
+bool BoundedQueue<T>::push(T item)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_not_full.wait(
+        lock, [this] { return m_closed || m_items.size() < m_capacity; });
+    if (m_closed) {
+        return false;
+    }
+    m_items.push_back(std::move(item));
+    lock.unlock();
+    m_not_empty.notify_one();
+
+    return true;
+}
+
+/** Dequeue an item, waiting for one if the queue is empty.
+ *
+ * @return false if the queue is closed and empty.
+ */
+template <typename T>
+bool BoundedQueue<T>::pop(T& item)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_not_empty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+    if (m_items.empty()) {
+        return false;
+    }
+    item = std::move(m_items.front());
+    m_items.pop_front();
+    lock.unlock();
+    m_not_full.notify_one();
+
+    return true;
+}
+
+/** Close the queue: wake up every waiter and refuse new items. */
+template <typename T>
+void BoundedQueue<T>::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+    }
+    m_not_empty.notify_all();
+    m_not_full.notify_all();
+}
+
+} // namespace dcss
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+
+#include "buffer.h"
+#include "exceptions.h"
+
+namespace dcss {
+
+Buffer::Buffer(std::vector<uint8_t> bytes)
+    : m_storage(std::make_shared<const std::vector<uint8_t>>(std::move(bytes))),
+      m_offset(0), m_size(m_storage->size())
+{
+}
+
+Buffer::Buffer(const std::string& bytes)
+    : Buffer(std::vector<uint8_t>(bytes.begin(), bytes.end()))
+{
+}
+
+Buffer Buffer::slice(size_t offset, size_t length) const
+{
+    if (offset > m_size || length > m_size - offset) {
+        throw DomainError("slice out of range");
+    }
+    return Buffer(m_storage, m_offset + offset, length);
+}
+
+bool Buffer::shares_storage_with(const Buffer& other) const
+{
+    return m_storage != nullptr && m_storage == other.m_storage;
+}
+
+long Buffer::use_count() const
+{
+    return m_storage.use_count();
+}
+
+std::string Buffer::to_string() const
+{
+    return std::string(begin(), end());
+}
+
+bool operator==(const Buffer& lhs, const Buffer& rhs)
+{
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    // Same storage and same offset: no need to look at the bytes.
+    if (lhs.shares_storage_with(rhs) && lhs.m_offset == rhs.m_offset) {
+        return true;
+    }
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+bool operator!=(const Buffer& lhs, const Buffer& rhs)
+{
+    return !(lhs == rhs);
+}
+
+std::ostream& operator<<(std::ostream& os, const Buffer& buf)
+{
+    return os << "Buffer(size=" << buf.size() << ')';
+}
+
+} // namespace dcss
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_BUFFER_H__
+#define __DCSS_BUFFER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace dcss {
+
+/** An immutable, reference-counted, slice of bytes.
+ *
+ * Copying a Buffer (or taking a slice of it) never copies the underlying
+ * bytes: all the copies share the same storage, which is released when the
+ * last reference goes away.
+ *
+ * This allows a single payload to be stored on several nodes (replicas),
+ * passed through the inter-node communication layer and read back without any
+ * copy.
+ */
+class Buffer {
+  public:
+    /** Create an empty buffer. */
+    Buffer() : m_offset(0), m_size(0) {}
+
+    /** Create a buffer that takes ownership of `bytes`.
+     *
+     * @param bytes the payload (moved into the shared storage).
+     */
+    explicit Buffer(std::vector<uint8_t> bytes);
+
+    /** @see Buffer::Buffer(std::vector<uint8_t>) */
+    explicit Buffer(const std::string& bytes);
+
+    /** Return a pointer to the first byte of the slice. */
+    inline const uint8_t* data() const
+    {
+        return m_storage ? m_storage->data() + m_offset : nullptr;
+    }
+
+    /** Return the size (in bytes) of the slice. */
+    inline size_t size() const
+    {
+        return m_size;
+    }
+
+    /** Check if the slice is empty. */
+    inline bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    inline const uint8_t* begin() const
+    {
+        return data();
+    }
+
+    inline const uint8_t* end() const
+    {
+        return data() + m_size;
+    }
+
+    /** Return a sub-slice of this buffer (no copy involved).
+     *
+     * @param offset offset of the sub-slice, relative to this slice.
+     * @param length length of the sub-slice.
+     * @return a new slice sharing the storage of this buffer.
+     *
+     * @throw DomainError — the sub-slice is out of range.
+     */
+    Buffer slice(size_t offset, size_t length) const;
+
+    /** Check if two buffers share the same underlying storage. */
+    bool shares_storage_with(const Buffer& other) const;
+
+    /** Return the number of buffers referencing the underlying storage. */
+    long use_count() const;
+
+    /** Return a copy of the slice as a string. */
+    std::string to_string() const;
+
+    /** Compare the content of two slices. */
+    friend bool operator==(const Buffer& lhs, const Buffer& rhs);
+    friend bool operator!=(const Buffer& lhs, const Buffer& rhs);
+
+    // Output operator.
+    friend std::ostream& operator<<(std::ostream& os, const Buffer& buf);
+
+    ~Buffer() = default;
+    Buffer(Buffer const&) = default;
+    Buffer& operator=(Buffer const& x) = default;
+    Buffer(Buffer&&) = default;
+    Buffer& operator=(Buffer&& x) = default;
+
+  private:
+    Buffer(
+        std::shared_ptr<const std::vector<uint8_t>> storage,
+        size_t offset,
+        size_t size)
+        : m_storage(std::move(storage)), m_offset(offset), m_size(size)
+    {
+    }
+
+    /** The bytes, shared by every slice created from the same payload. */
+    std::shared_ptr<const std::vector<uint8_t>> m_storage;
+    size_t m_offset; /**< Start of the slice in the storage. */
+    size_t m_size;   /**< Length of the slice.               */
+};
+
+} // namespace dcss
+
+#endif
@@ -37,6 +37,8 @@
 #include "dcss_node.h"
 #include "dcss_node_com.h"
 #include "dht/dht.h"
+#include "exceptions.h"
+#include "latency_model.h"
 #include "shell.h"
 #include "uint160.h"
 #include "utils.h"
@@ -307,6 +309,27 @@ static int cmd_buy_storage(Shell* shell, int argc, char** argv)
     return SHELL_CONT;
 }
 
+static int cmd_buy_file_storage(Shell* shell, int argc, char** argv)
+{
+    if (argc != 3 && argc != 4) {
+        std::cerr << "usage: buy_file_storage KEY N_BYTES [BATCHED]\n";
+        return SHELL_CONT;
+    }
+
+    auto* network = static_cast<Network*>(shell->get_handle());
+    auto* node = static_cast<Node<NodeLocalCom>*>(shell->get_handle2());
+    if (nullptr == node) {
+        std::cerr << "shall jump to a node first\n";
+        return SHELL_CONT;
+    }
+
+    const UInt160 key(argv[1]);
+    const bool batched = argc == 3 || std::string(argv[3]) != "0";
+    network->buy_file_storage(*node, key, stou64(argv[2]), batched);
+
+    return SHELL_CONT;
+}
+
 static int cmd_put_bytes(Shell* shell, int argc, char** argv)
 {
     if (argc != 3) {
@@ -343,6 +366,347 @@ static int cmd_get_bytes(Shell* shell, int argc, char** argv)
     return SHELL_CONT;
 }
 
+static int cmd_open_channel(Shell* shell, int argc, char** argv)
+{
+    if (argc != 5) {
+        std::cerr << "usage: open_channel SELLER DEPOSIT PUT_PRICE GET_PRICE\n";
+        return SHELL_CONT;
+    }
+
+    auto* node = static_cast<Node<NodeLocalCom>*>(shell->get_handle2());
+    if (nullptr == node) {
+        std::cerr << "shall jump to a node first\n";
+        return SHELL_CONT;
+    }
+
+    node->open_channel(
+        argv[1], stou64(argv[2]), stou64(argv[3]), stou64(argv[4]));
+
+    return SHELL_CONT;
+}
+
+static int cmd_settle_channel(Shell* shell, int argc, char** argv)
+{
+    if (argc != 2) {
+        std::cerr << "usage: settle_channel BUYER\n";
+        return SHELL_CONT;
+    }
+
+    auto* node = static_cast<Node<NodeLocalCom>*>(shell->get_handle2());
+    if (nullptr == node) {
+        std::cerr << "shall jump to a node first\n";
+        return SHELL_CONT;
+    }
+
+    node->settle_channel(argv[1]);
+
+    return SHELL_CONT;
+}
+
+static int cmd_dispute_channel(Shell* shell, int argc, char** argv)
+{
+    if (argc != 2) {
+        std::cerr << "usage: dispute_channel SELLER\n";
+        return SHELL_CONT;
+    }
+
+    auto* node = static_cast<Node<NodeLocalCom>*>(shell->get_handle2());
+    if (nullptr == node) {
+        std::cerr << "shall jump to a node first\n";
+        return SHELL_CONT;
+    }
+
+    node->dispute_channel(argv[1]);
+
+    return SHELL_CONT;
+}
+
+static int cmd_bench_pipeline(Shell* shell, int argc, char** argv)
+{
+    if (argc != 5) {
+        std::cerr << "usage: bench_pipeline N_BYTES MAX_THREADS MAX_IN_FLIGHT "
+                     "STRIPE_SIZE\n";
+        return SHELL_CONT;
+    }
+
+    auto* network = static_cast<Network*>(shell->get_handle());
+
+    try {
+        network->bench_pipeline(
+            stou64(argv[1]), stou32(argv[2]), stou32(argv[3]), stou64(argv[4]));
+    } catch (const Exception& exn) {
+        std::cerr << exn.what() << '\n';
+    }
+
+    return SHELL_CONT;
+}
+
+static int cmd_latency(Shell* shell, int argc, char** argv)
+{
+    if (argc != 4) {
+        std::cerr << "usage: latency MEDIAN_MS SLOW_PCT LOSS_PCT\n";
+        return SHELL_CONT;
+    }
+
+    auto* network = static_cast<Network*>(shell->get_handle());
+
+    try {
+        const LatencyModel model(
+            std::stod(argv[1]),
+            0.5,
+            std::stod(argv[2]) / 100.0,
+            10.0,
+            std::stod(argv[3]) / 100.0);
+        network->set_latency_model(model);
+    } catch (const Exception& exn) {
+        std::cerr << exn.what() << '\n';
+    }
+
+    return SHELL_CONT;
+}
+
+static int cmd_bench_reads(Shell* shell, int argc, char** argv)
+{
+    if (argc != 3) {
+        std::cerr << "usage: bench_reads N_READS N_EXTRA\n";
+        return SHELL_CONT;
+    }
+
+    auto* network = static_cast<Network*>(shell->get_handle());
+
+    network->bench_reads(stou32(argv[1]), stou32(argv[2]));
+
+    return SHELL_CONT;
+}
+
+static int cmd_fail(Shell* shell, int argc, char** argv)
+{
+    if (argc != 2) {
+        std::cerr << "usage: fail PERCENTAGE\n";
+        return SHELL_CONT;
+    }
+
+    auto* network = static_cast<Network*>(shell->get_handle());
+
+    network->fail_nodes(stou32(argv[1]) / 100.0);
+
+    return SHELL_CONT;
+}
+
+static int cmd_repair(Shell* shell, int argc, char** argv)
+{
+    if (argc != 4 && argc != 5) {
+        std::cerr << "usage: repair BYTES_PER_SEC CHECKS_PER_SEC MAX_SECS "
+                     "[READS_PER_SEC]\n";
+        return SHELL_CONT;
+    }
+
+    auto* network = static_cast<Network*>(shell->get_handle());
+
+    network->repair(
+        stou64(argv[1]),
+        stou32(argv[2]),
+        stou32(argv[3]),
+        argc == 5 ? stou32(argv[4]) : 0);
+
+    return SHELL_CONT;
+}
+
+static int cmd_rpc_load(Shell* shell, int argc, char** argv)
+{
+    if (argc != 2) {
+        std::cerr << "usage: rpc_load TOP_N|reset\n";
+        return SHELL_CONT;
+    }
+
+    auto* network = static_cast<Network*>(shell->get_handle());
+
+    if (std::string(argv[1]) == "reset") {
+        network->rpc_load().reset();
+    } else {
+        network->report_load(stou32(argv[1]));
+    }
+
+    return SHELL_CONT;
+}
+
+static int cmd_provision_accounts(Shell* shell, int argc, char** /*argv*/)
+{
+    if (argc != 1) {
+        std::cerr << "usage: provision_accounts\n";
+        return SHELL_CONT;
+    }
+
+    auto* network = static_cast<Network*>(shell->get_handle());
+
+    network->provision_accounts();
+
+    return SHELL_CONT;
+}
+
+static int cmd_tx_stats(Shell* shell, int argc, char** /*argv*/)
+{
+    if (argc != 1) {
+        std::cerr << "usage: tx_stats\n";
+        return SHELL_CONT;
+    }
+
+    auto* network = static_cast<Network*>(shell->get_handle());
+
+    network->report_txs();
+
+    return SHELL_CONT;
+}
+
+static int cmd_channel_stats(Shell* shell, int argc, char** /*argv*/)
+{
+    if (argc != 1) {
+        std::cerr << "usage: channel_stats\n";
+        return SHELL_CONT;
+    }
+
+    auto* network = static_cast<Network*>(shell->get_handle());
+
+    network->report_channels();
+
+    return SHELL_CONT;
+}
+
+static int cmd_churn(Shell* shell, int argc, char** argv)
+{
+    if (argc != 4) {
+        std::cerr << "usage: churn N_STEPS PERCENTAGE N_LOOKUPS\n";
+        return SHELL_CONT;
+    }
+
+    auto* network = static_cast<Network*>(shell->get_handle());
+
+    network->churn(stou32(argv[1]), stou32(argv[2]) / 100.0, stou32(argv[3]));
+
+    return SHELL_CONT;
+}
+
+static int cmd_bench_routing(Shell* shell, int argc, char** argv)
+{
+    if (argc != 3) {
+        std::cerr << "usage: bench_routing N_LOOKUPS SELF_LOOKUPS(0|1)\n";
+        return SHELL_CONT;
+    }
+
+    auto* network = static_cast<Network*>(shell->get_handle());
+
+    network->bench_routing(stou32(argv[1]), stou32(argv[2]) != 0);
+
+    return SHELL_CONT;
+}
+
+static int cmd_bench_lookups(Shell* shell, int argc, char** argv)
+{
+    if (argc != 3) {
+        std::cerr << "usage: bench_lookups N_KEYS BATCH_SIZE\n";
+        return SHELL_CONT;
+    }
+
+    auto* network = static_cast<Network*>(shell->get_handle());
+    const uint32_t batch_size = stou32(argv[2]);
+
+    if (batch_size == 0) {
+        std::cerr << "batch size must be positive\n";
+        return SHELL_CONT;
+    }
+    network->bench_lookups(stou32(argv[1]), batch_size);
+
+    return SHELL_CONT;
+}
+
+static int cmd_bench_hot_reads(Shell* shell, int argc, char** argv)
+{
+    if (argc != 4) {
+        std::cerr << "usage: bench_hot_reads N_CLIENTS N_READS ZIPF_S\n";
+        return SHELL_CONT;
+    }
+
+    auto* network = static_cast<Network*>(shell->get_handle());
+
+    network->bench_hot_reads(
+        stou32(argv[1]), stou32(argv[2]), std::stod(argv[3]));
+
+    return SHELL_CONT;
+}
+
+static int cmd_bench_value_cache(Shell* shell, int argc, char** argv)
+{
+    if (argc != 5) {
+        std::cerr << "usage: bench_value_cache N_READS ZIPF_S N_CLIENTS "
+                     "BUDGET\n";
+        return SHELL_CONT;
+    }
+
+    auto* network = static_cast<Network*>(shell->get_handle());
+    const uint32_t n_clients = stou32(argv[3]);
+
+    if (n_clients == 0) {
+        std::cerr << "need at least one client\n";
+        return SHELL_CONT;
+    }
+    network->bench_value_cache(
+        stou32(argv[1]), std::stod(argv[2]), n_clients, stou64(argv[4]));
+
+    return SHELL_CONT;
+}
+
+static int cmd_bench_hot_keys(Shell* shell, int argc, char** argv)
+{
+    if (argc != 7) {
+        std::cerr << "usage: bench_hot_keys N_STEPS N_READS ZIPF_S THRESHOLD "
+                     "N_REPLICAS LIFETIME\n";
+        return SHELL_CONT;
+    }
+
+    auto* network = static_cast<Network*>(shell->get_handle());
+    const uint32_t threshold = stou32(argv[4]);
+
+    if (threshold == 0 || threshold > 15) {
+        std::cerr << "the threshold must be in [1; 15]\n";
+        return SHELL_CONT;
+    }
+    network->bench_hot_keys(
+        stou32(argv[1]),
+        stou32(argv[2]),
+        std::stod(argv[3]),
+        threshold,
+        stou32(argv[5]),
+        stou32(argv[6]));
+
+    return SHELL_CONT;
+}
+
+static int cmd_bench_lookup_cache(Shell* shell, int argc, char** argv)
+{
+    if (argc != 6) {
+        std::cerr << "usage: bench_lookup_cache N_STEPS PERCENTAGE N_LOOKUPS "
+                     "N_CLIENTS N_KEYS\n";
+        return SHELL_CONT;
+    }
+
+    auto* network = static_cast<Network*>(shell->get_handle());
+    const uint32_t n_clients = stou32(argv[4]);
+    const uint32_t n_keys = stou32(argv[5]);
+
+    if (n_clients == 0 || n_keys == 0) {
+        std::cerr << "need at least one client and one key\n";
+        return SHELL_CONT;
+    }
+    network->bench_lookup_cache(
+        stou32(argv[1]),
+        std::stod(argv[2]) / 100.0,
+        stou32(argv[3]),
+        n_clients,
+        n_keys);
+
+    return SHELL_CONT;
+}
+
 struct cmd_def quit_cmd = {"quit", "quit program", cmd_quit};
 struct cmd_def help_cmd = {"help", "help", cmd_help};
 struct cmd_def jump_cmd = {"jump", "jump to a node", cmd_jump};
@@ -373,29 +737,126 @@ struct cmd_def graphviz_cmd = {
 struct cmd_def buy_storage_cmd = {"buy_storage",
                                   "buy N bytes of storage",
                                   cmd_buy_storage};
+struct cmd_def buy_file_storage_cmd = {
+    "buy_file_storage",
+    "buy storage from the holders of a file (in one transaction if BATCHED)",
+    cmd_buy_file_storage};
 struct cmd_def put_bytes_cmd = {"put_bytes",
                                 "put N bytes on storage",
                                 cmd_put_bytes};
 struct cmd_def get_bytes_cmd = {"get_bytes",
                                 "get N bytes from storage",
                                 cmd_get_bytes};
+struct cmd_def open_channel_cmd = {
+    "open_channel",
+    "open a payment channel to SELLER (puts/gets then paid off-chain)",
+    cmd_open_channel};
+struct cmd_def settle_channel_cmd = {
+    "settle_channel",
+    "close the payment channel from BUYER, redeeming its last voucher",
+    cmd_settle_channel};
+struct cmd_def dispute_channel_cmd = {
+    "dispute_channel",
+    "get back the deposit of an expired payment channel to SELLER",
+    cmd_dispute_channel};
+struct cmd_def bench_pipeline_cmd = {
+    "bench_pipeline",
+    "measure the streaming put/get throughput (thread-count sweep)",
+    cmd_bench_pipeline};
+
+struct cmd_def latency_cmd = {"latency",
+                              "set the simulated RPC latency/loss model",
+                              cmd_latency};
+struct cmd_def bench_reads_cmd = {
+    "bench_reads",
+    "measure the read latency with first-n-of-m fetches",
+    cmd_bench_reads};
+struct cmd_def bench_routing_cmd = {"bench_routing",
+                                    "measure the routing tables and lookups",
+                                    cmd_bench_routing};
+struct cmd_def bench_value_cache_cmd = {
+    "bench_value_cache",
+    "compare the LRU and TinyLFU value caches on hot reads",
+    cmd_bench_value_cache};
+struct cmd_def bench_hot_reads_cmd = {
+    "bench_hot_reads",
+    "measure the coalescing of concurrent reads (Zipf distribution)",
+    cmd_bench_hot_reads};
+struct cmd_def bench_hot_keys_cmd = {
+    "bench_hot_keys",
+    "measure the load of the nodes with the popularity replication",
+    cmd_bench_hot_keys};
+struct cmd_def bench_lookup_cache_cmd = {
+    "bench_lookup_cache",
+    "measure the lookup cache on repeated keys under churn",
+    cmd_bench_lookup_cache};
+struct cmd_def bench_lookups_cmd = {
+    "bench_lookups",
+    "compare the lookups one at a time and in batches",
+    cmd_bench_lookups};
+struct cmd_def churn_cmd = {"churn",
+                            "measure the lookups under churn",
+                            cmd_churn};
+struct cmd_def fail_cmd = {"fail",
+                           "put offline a percentage of the nodes",
+                           cmd_fail};
+struct cmd_def repair_cmd = {"repair",
+                             "restore the redundancy of the files, while "
+                             "reading them",
+                             cmd_repair};
+struct cmd_def rpc_load_cmd = {
+    "rpc_load",
+    "report the RPCs served by the nodes (or reset the counters)",
+    cmd_rpc_load};
+struct cmd_def provision_accounts_cmd = {
+    "provision_accounts",
+    "create and unlock the Ethereum accounts of all the nodes",
+    cmd_provision_accounts};
+struct cmd_def channel_stats_cmd = {
+    "channel_stats",
+    "report the bytes paid through the payment channels",
+    cmd_channel_stats};
+struct cmd_def tx_stats_cmd = {
+    "tx_stats",
+    "report the calls made to geth by the transactions",
+    cmd_tx_stats};
 
 struct cmd_def* cmd_defs[] = {
+    &bench_hot_keys_cmd,
+    &bench_hot_reads_cmd,
+    &bench_lookup_cache_cmd,
+    &bench_lookups_cmd,
+    &bench_pipeline_cmd,
+    &bench_reads_cmd,
+    &bench_routing_cmd,
+    &bench_value_cache_cmd,
     &bit_length_cmd,
+    &buy_file_storage_cmd,
     &buy_storage_cmd,
+    &channel_stats_cmd,
     &cheat_lookup_cmd,
+    &churn_cmd,
+    &dispute_channel_cmd,
+    &fail_cmd,
     &find_nearest_cmd,
     &get_bytes_cmd,
     &graphviz_cmd,
     &help_cmd,
     &jump_cmd,
+    &latency_cmd,
     &lookup_cmd,
+    &open_channel_cmd,
+    &provision_accounts_cmd,
     &put_bytes_cmd,
     &quit_cmd,
     &rand_node_cmd,
     &rand_key_cmd,
+    &repair_cmd,
+    &rpc_load_cmd,
     &save_cmd,
+    &settle_channel_cmd,
     &show_cmd,
+    &tx_stats_cmd,
     &verbose_cmd,
     &distance_cmd,
     nullptr,
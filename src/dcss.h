@@ -30,6 +30,7 @@
 #ifndef __DCSS_H__
 #define __DCSS_H__
 
+#include "buffer.h"
 #include "cmds.h"
 #include "config.h"
 #include "dcss_conf.h"
@@ -37,7 +38,14 @@
 #include "dcss_network.h"
 #include "dcss_node.h"
 #include "dht/dht.h"
+#include "erasure_code.h"
 #include "exceptions.h"
+#include "file_pipeline.h"
+#include "geth_mock.h"
+#include "geth_pool.h"
+#include "latency_model.h"
+#include "parallel_fetch.h"
+#include "repair.h"
 #include "shell.h"
 #include "uint160.h"
 #include "utils.h"
@@ -31,20 +31,70 @@
 
 namespace dcss {
 
+namespace {
+
+/** Return the stand-in for geth at `geth_addr`, if any. */
+std::unique_ptr<GethMock> make_mock(const std::string& geth_addr)
+{
+    if (geth_addr == "mock") {
+        return std::make_unique<GethMock>();
+    }
+    if (geth_addr.compare(0, 5, "mock:") == 0) {
+        return std::make_unique<GethMock>(
+            GethMockConf::parse(geth_addr.substr(5)));
+    }
+    return nullptr;
+}
+
+/** Return the connections to geth at `geth_addr`, or to `mock` if any. */
+std::unique_ptr<GethPool> connect_geth(
+    const std::string& geth_addr,
+    GethMock* mock,
+    const GethPoolConf& conf)
+{
+    if (mock == nullptr) {
+        return GethPool::http(geth_addr, conf);
+    }
+    return std::make_unique<GethPool>(
+        [mock](std::chrono::milliseconds /* timeout */) {
+            return mock->connect();
+        },
+        conf);
+}
+
+} // namespace
+
 Conf::Conf(
     uint32_t nb_bits,
     uint32_t k_param,
     uint32_t alpha_param,
     uint32_t nb_nodes,
     const std::string& geth_addr,
-    std::vector<std::string> bootstrap_list)
-    : httpclient(geth_addr), geth(httpclient),
+    std::vector<std::string> bootstrap_list,
+    const GethPoolConf& geth_pool_conf)
+    : geth_mock(make_mock(geth_addr)),
+      geth_pool(connect_geth(geth_addr, geth_mock.get(), geth_pool_conf)),
+      geth(*geth_pool), txs(geth),
       bstraplist(std::move(bootstrap_list))
 {
     this->n_bits = nb_bits;
     this->k = k_param;
     this->alpha = alpha_param;
     this->n_nodes = nb_nodes;
+    this->n_data = 0;
+    this->n_parities = 0;
+    this->replacement_cache_size = k_param;
+    this->bucket_layout = BucketLayout::FIXED;
+    this->n_siblings = 0;
+    this->lookup_batch = 1;
+    this->lookup_cache_size = 0;
+    this->lookup_cache_ttl = 0;
+    this->lookup_cache_prefix = nb_bits;
+    this->value_cache_size = 0;
+    this->value_cache_policy = CachePolicy::TINY_LFU;
+    this->hot_threshold = 0;
+    this->hot_replicas = 1;
+    this->hot_lifetime = 4;
 }
 
 void Conf::save(std::ostream& fout) const
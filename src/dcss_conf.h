@@ -31,16 +31,35 @@
 #define __DCSS_CONF_H__
 
 #include <cstdint>
+#include <memory>
 #include <ostream>
 #include <string>
 #include <vector>
 
-#include <jsonrpccpp/client/connectors/httpclient.h>
-
+#include "account_cache.h"
+#include "geth_mock.h"
+#include "geth_pool.h"
 #include "gethclient.h"
+#include "payment_channel.h"
+#include "tx_manager.h"
+#include "value_cache.h"
 
 namespace dcss {
 
+/** Layout of the routing table (k-buckets). */
+enum class BucketLayout {
+    /** One bucket per distance bit length, all allocated upfront. */
+    FIXED,
+    /** One bucket to start, only the bucket containing our ID is split. */
+    SPLIT,
+    /** Like SPLIT, but also keep the contacts close to our ID even when
+     * their bucket is full (relaxed trie).
+     */
+    RELAXED,
+    /** No k-buckets: every node knows all the nodes (one-hop lookups). */
+    FULL,
+};
+
 class Conf {
   public:
     Conf(
@@ -49,7 +68,8 @@ class Conf {
         uint32_t alpha_param,
         uint32_t nb_nodes,
         const std::string& geth_addr,
-        std::vector<std::string> bootstrap_list);
+        std::vector<std::string> bootstrap_list,
+        const GethPoolConf& geth_pool_conf = GethPoolConf());
 
     void save(std::ostream& fout) const;
 
@@ -57,9 +77,54 @@ class Conf {
     uint32_t k;
     uint32_t alpha;
     uint32_t n_nodes;
+    /** Erasure code parameters (no erasure coding, but replication, if 0). */
+    uint32_t n_data;
+    uint32_t n_parities;
+    /** Size of the replacement cache of the k-buckets (0 to disable). */
+    uint32_t replacement_cache_size;
+    /** Layout of the k-buckets. */
+    BucketLayout bucket_layout;
+    /** Size of the sibling list (0 to disable it). */
+    uint32_t n_siblings;
+    /** Number of keys looked up together by the file workloads (1 to look
+     * them up one at a time).
+     */
+    uint32_t lookup_batch;
+    /** Number of entries of the lookup cache (0 to disable it). */
+    uint32_t lookup_cache_size;
+    /** Lifetime of the lookup cache entries (in ticks, see `Node::tick`). */
+    uint32_t lookup_cache_ttl;
+    /** Length (in bits) of the target prefixes indexing the lookup cache. */
+    uint32_t lookup_cache_prefix;
+    /** Memory budget of the value cache (in bytes, 0 to disable it). */
+    uint64_t value_cache_size;
+    /** Admission and eviction policy of the value cache. */
+    CachePolicy value_cache_policy;
+    /** Number of recent reads from which a stored key gets extra replicas
+     * (0 to disable the popularity replication, at most 15).
+     */
+    uint32_t hot_threshold;
+    /** Number of extra replicas of a popular key pushed by each reader (on
+     * its lookup path).
+     */
+    uint32_t hot_replicas;
+    /** Lifetime of the extra replicas (in ticks), unless renewed. */
+    uint32_t hot_lifetime;
 
-    jsonrpc::HttpClient httpclient;
+    /** In-process stand-in for geth, if the address is "mock" or
+     * "mock:SPEC" (see `GethMockConf::parse`).
+     */
+    std::unique_ptr<GethMock> geth_mock;
+    /** Connections to geth (or to `geth_mock`). */
+    std::unique_ptr<GethPool> geth_pool;
+    /** Calls to geth, from any thread (through `geth_pool`). */
     mutable GethClient geth;
+    /** Transactions sent to `geth` on behalf of the nodes. */
+    mutable TxManager txs;
+    /** Ethereum accounts of the nodes (reused across runs if persisted). */
+    mutable AccountCache accounts;
+    /** Payment channels between the nodes' accounts. */
+    mutable PaymentChannels channels;
     std::vector<std::string> bstraplist;
 };
 
@@ -30,6 +30,10 @@
 #ifndef __DCSS_FILE_H__
 #define __DCSS_FILE_H__
 
+#include <cstdint>
+#include <vector>
+
+#include "buffer.h"
 #include "dht/dht.h"
 #include "uint160.h"
 
@@ -37,10 +41,70 @@ namespace dcss {
 
 class File : public dht::Entry {
   public:
-    File(const UInt160& key, std::string value)
+    File(const UInt160& key, Buffer value)
         : dht::Entry(key, std::move(value))
     {
     }
+
+    /** Create a file made of several parts (stored under their own keys).
+     *
+     * @param key   key of the file
+     * @param parts keys of the parts
+     */
+    File(const UInt160& key, std::vector<UInt160> parts)
+        : dht::Entry(key, Buffer()), m_parts(std::move(parts))
+    {
+    }
+
+    /** Return the keys of the file parts (empty for a plain file). */
+    inline const std::vector<UInt160>& parts() const
+    {
+        return m_parts;
+    }
+
+    /** Return the key of the `idx`-th part of a file.
+     *
+     * The keys of the parts are evenly spread over the keyspace, so that
+     * they are stored on different nodes.
+     *
+     * @param key     key of the file
+     * @param idx     index of the part, in [0; `n_parts`[
+     * @param n_parts number of parts of the file
+     * @param n_bits  size of the keys (in bits)
+     * @return the key of the part.
+     */
+    static UInt160 part_key(
+        const UInt160& key,
+        uint32_t idx,
+        uint32_t n_parts,
+        uint32_t n_bits)
+    {
+        const UInt160 mask(~UInt160(0u) >> (160 - n_bits));
+        const UInt160 step(mask / (n_parts + 1));
+
+        return (key + step * (idx + 1)) & mask;
+    }
+
+    /** Return the key of the `idx`-th stripe of a (streamed) file.
+     *
+     * Unlike `part_key`, the number of stripes doesn't need to be known in
+     * advance: the keys follow a golden ratio sequence, so consecutive
+     * stripes are far apart in the keyspace.
+     *
+     * @param key    key of the file
+     * @param idx    index of the stripe
+     * @param n_bits size of the keys (in bits)
+     * @return the key of the stripe.
+     */
+    static UInt160
+    stripe_key(const UInt160& key, uint32_t idx, uint32_t n_bits)
+    {
+        const UInt160 mask(~UInt160(0u) >> (160 - n_bits));
+        const UInt160 step(mask / 1000u * 618u);
+
+        return (key + step * (idx + 1)) & mask;
+    }
+
     ~File() override = default;
     File(File const&) = delete;
     File& operator=(File const& x) = delete;
@@ -48,7 +112,7 @@ class File : public dht::Entry {
     File& operator=(File&& x) = delete;
 
   private:
-    std::vector<UInt160> parts; /**< Keys of the file parts. */
+    std::vector<UInt160> m_parts; /**< Keys of the file parts. */
 };
 
 } // namespace dcss
@@ -27,21 +27,40 @@
  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  * POSSIBILITY OF SUCH DAMAGE.
  */
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+#include <utility>
 
 #include "bit_map.h"
+#include "buffer.h"
 #include "dcss_conf.h"
 #include "dcss_file.h"
 #include "dcss_network.h"
 #include "dcss_node.h"
 #include "dht/dht.h"
+#include "file_pipeline.h"
+#include "parallel_fetch.h"
+#include "repair.h"
 #include "utils.h"
 
 namespace dcss {
 
-Network::Network(const Conf& configuration) : conf(&configuration) {}
+Network::Network(const Conf& configuration)
+    : conf(&configuration), files_bytes(0)
+{
+    if (conf->n_data != 0) {
+        codec = std::make_unique<ErasureCode>(conf->n_data, conf->n_parities);
+    }
+}
 
 /** Initialize nodes. */
 void Network::initialize_nodes(
@@ -80,6 +99,19 @@ void Network::initialize_nodes(
     // There shall be a responsable for every portion of the keyspace.
     assert(bitmap.is_exhausted());
 
+    // Full membership: the first node meets everyone, the others get the
+    // membership from it.
+    if (conf->bucket_layout == BucketLayout::FULL) {
+        SIM_LOG(INFO) << "distributing the membership...";
+        for (uint32_t i = 1; i < conf->n_nodes; i++) {
+            nodes[0]->ping(*nodes[i]);
+        }
+        for (uint32_t i = 1; i < conf->n_nodes; i++) {
+            nodes[i]->fetch_membership(nodes[0]->addr());
+        }
+        return;
+    }
+
     SIM_LOG(INFO) << "creating inter-nodes connections...";
     // Continue creating conns for the nodes that dont meet the initial number
     // required.
@@ -115,87 +147,1923 @@ void Network::initialize_nodes(
     }
 }
 
-void Network::initialize_files(uint32_t n_files)
+void Network::initialize_files(uint32_t n_files, uint32_t file_size)
 {
     std::uniform_int_distribution<uint64_t> dis(0, nodes.size() - 1);
+    std::uniform_int_distribution<uint32_t> byte_dis(0, UINT8_MAX);
+    const bool batched = conf->lookup_batch > 1;
 
     SIM_LOG(INFO) << "files initialization";
 
-    for (uint32_t i = 0; i < n_files; i++) {
-        CLOG_EVERY_N(1000, INFO, SIM_LOG_ID)
-            << "creating file " << i + 1 << "/" << n_files;
+    for (uint32_t i = 0; i < n_files; i += conf->lookup_batch) {
+        const uint32_t n_batch = std::min(conf->lookup_batch, n_files - i);
+        std::vector<UInt160> keys;
+        std::vector<Buffer> payloads;
+        std::vector<UInt160> to_lookup;
 
-        // Take a random node.
+        // Take a random node: it stores the whole batch.
         std::unique_ptr<Node<NodeLocalCom>>& node = nodes[dis(prng())];
 
-        // Generate a random key for the file.
-        const UInt160 key(UInt160::rand(prng(), conf->n_bits));
+        for (uint32_t j = 0; j < n_batch; ++j) {
+            CLOG_EVERY_N(1000, INFO, SIM_LOG_ID)
+                << "creating file " << i + j + 1 << "/" << n_files;
+
+            // Generate a random key for the file.
+            const UInt160 key(UInt160::rand(prng(), conf->n_bits));
+
+            // Generate the payload: it's shared by every replica.
+            std::vector<uint8_t> bytes(file_size);
+            for (auto& byte : bytes) {
+                byte = static_cast<uint8_t>(byte_dis(prng()));
+            }
+            const std::vector<UInt160> file_keys(lookup_keys(key));
+            to_lookup.insert(
+                to_lookup.end(), file_keys.begin(), file_keys.end());
+            keys.push_back(key);
+            payloads.emplace_back(std::move(bytes));
+        }
+
+        const auto holders(lookup_all(*node, to_lookup, batched));
+        auto first = holders.begin();
+        for (uint32_t j = 0; j < n_batch; ++j) {
+            const auto last = first + (codec ? codec->n_fragments() : 1);
+            const std::vector<std::vector<dht::NodeAddress>> file_holders(
+                first, last);
+
+            if (codec) {
+                store_encoded(*node, keys[j], payloads[j], file_holders);
+            } else {
+                store_replicated(*node, keys[j], payloads[j], file_holders[0]);
+            }
+            files.push_back(keys[j]);
+            files_bytes += payloads[j].size();
+            first = last;
+        }
+    }
+}
+
+/** Return the keys to look up to store or read a file.
+ *
+ * That is the key of the file, if replicated, or the keys of its fragments.
+ */
+std::vector<UInt160> Network::lookup_keys(const UInt160& key) const
+{
+    if (!codec) {
+        return {key};
+    }
+    std::vector<UInt160> keys;
+    for (uint32_t i = 0; i < codec->n_fragments(); ++i) {
+        keys.push_back(
+            File::part_key(key, i, codec->n_fragments(), conf->n_bits));
+    }
+    return keys;
+}
+
+/** Look up the k closest nodes of each key.
+ *
+ * @param node    node performing the lookups
+ * @param keys    the keys to look up
+ * @param batched if true, the keys are looked up together (see
+ *                `Node::node_lookup`), otherwise one at a time
+ */
+std::vector<std::vector<dht::NodeAddress>> Network::lookup_all(
+    Node<NodeLocalCom>& node,
+    const std::vector<UInt160>& keys,
+    bool batched)
+{
+    if (batched) {
+        return node.node_lookup(keys);
+    }
+    std::vector<std::vector<dht::NodeAddress>> results;
+    for (const auto& key : keys) {
+        results.push_back(node.node_lookup(key));
+    }
+    return results;
+}
+
+/** Store the file on the node and replicate it on the k closest nodes. */
+void Network::store_replicated(
+    Node<NodeLocalCom>& node,
+    const UInt160& key,
+    const Buffer& payload,
+    const std::vector<dht::NodeAddress>& holders)
+{
+    SIM_VLOG(1) << "storing " << key << " on " << node.id();
+    node.store(std::make_unique<File>(key, payload));
+
+    // Store file at multiple location.
+    for (const auto& it : holders) {
+        SIM_VLOG(1) << "replicating " << key << " on " << it.id();
+        node.send_store(it, key, payload);
+    }
+}
+
+/** Split the file into fragments, each one stored on the closest node.
+ *
+ * `holders` are the closest nodes to the key of each fragment.
+ */
+void Network::store_encoded(
+    Node<NodeLocalCom>& node,
+    const UInt160& key,
+    const Buffer& payload,
+    const std::vector<std::vector<dht::NodeAddress>>& holders)
+{
+    const std::vector<Buffer> fragments(codec->encode(payload));
+    std::vector<UInt160> parts(lookup_keys(key));
+
+    for (uint32_t i = 0; i < fragments.size(); ++i) {
+        for (const auto& it : holders[i]) {
+            SIM_VLOG(1) << "storing fragment " << i << " of " << key << " ("
+                        << parts[i] << ") on " << it.id();
+            if (node.send_store(it, parts[i], fragments[i])) {
+                break;
+            }
+        }
+    }
 
-        SIM_VLOG(1) << "storing " << key << " on " << node->id();
-        node->store(std::make_unique<File>(key, ""));
-        files.push_back(key);
+    // The owner keeps track of the fragments.
+    node.store(std::make_unique<File>(key, std::move(parts)));
+}
 
-        // Store file at multiple location.
-        for (auto& it : node->node_lookup(key)) {
-            const auto dst = lookup_cheat(it.id().to_string());
+/** Return the nodes holding the replicas or the fragments of a file.
+ *
+ * For a replicated file, the targets are the k closest nodes to its key.
+ * For an encoded file, each fragment is held by the closest node to its key.
+ *
+ * @param key     key of the file
+ * @param holders the closest nodes to each key of `lookup_keys(key)`
+ */
+std::vector<FetchTarget> Network::fetch_targets(
+    const UInt160& key,
+    const std::vector<std::vector<dht::NodeAddress>>& holders) const
+{
+    std::vector<FetchTarget> targets;
 
-            SIM_VLOG(1) << "replicating " << key << " on " << dst->id();
-            dst->store(std::make_unique<File>(key, ""));
+    if (!codec) {
+        for (const auto& holder : holders.front()) {
+            targets.push_back(FetchTarget{key, holder});
         }
+        return targets;
+    }
+    const std::vector<UInt160> parts(lookup_keys(key));
+    for (uint32_t i = 0; i < parts.size(); ++i) {
+        if (!holders[i].empty()) {
+            targets.push_back(FetchTarget{parts[i], holders[i].front()});
+        }
+    }
+    return targets;
+}
+
+/** Fetch a file (the first replica, or the first `n_data` fragments).
+ *
+ * @param node    node performing the read
+ * @param key     key of the file
+ * @param holders the closest nodes to each key of `lookup_keys(key)`
+ * @param n_extra number of requests sent in addition to the minimum
+ * @param latency latency model of the requests
+ */
+FetchResult Network::fetch_file(
+    Node<NodeLocalCom>& node,
+    const UInt160& key,
+    const std::vector<std::vector<dht::NodeAddress>>& holders,
+    uint32_t n_extra,
+    const LatencyFunc& latency)
+{
+    const uint32_t n_needed = codec ? codec->n_data() : 1;
+    const auto fetch = [&node](const FetchTarget& target, Buffer& value) {
+        return node.send_find_value(target.holder, target.key, value);
+    };
+
+    return fetch_first_n(
+        fetch_targets(key, holders),
+        n_needed,
+        n_needed + n_extra,
+        latency_model.timeout(),
+        latency,
+        fetch);
+}
+
+/** Check that a file can be read (and decoded). */
+bool Network::read_file(
+    Node<NodeLocalCom>& node,
+    const UInt160& key,
+    const std::vector<std::vector<dht::NodeAddress>>& holders)
+{
+    const auto no_latency = [](const FetchTarget& /*target*/, double& delay) {
+        delay = 0.0;
+        return true;
+    };
+    const FetchResult result = fetch_file(node, key, holders, 0, no_latency);
+
+    SIM_VLOG(1) << "found " << result.values.size() << " values for " << key;
+    if (!result.complete || !codec) {
+        return result.complete;
+    }
+    try {
+        codec->decode(result.values);
+    } catch (const DomainError& exn) {
+        SIM_LOG(ERROR) << "cannot decode " << key << ": " << exn.what();
+        return false;
     }
+    return true;
 }
 
 /** Check that files are accessible from random nodes. */
 void Network::check_files()
 {
-    std::uniform_int_distribution<uint64_t> dis(0, nodes.size() - 1);
-
     SIM_LOG(INFO) << "files checking";
 
+    const bool batched = conf->lookup_batch > 1;
     uint64_t n_wrong = 0;
     uint64_t n_files = 0;
-    for (auto& file_key : files) {
-        CLOG_EVERY_N(1000, INFO, SIM_LOG_ID)
-            << "checking file " << n_files + 1 << "/" << files.size();
+    for (size_t i = 0; i < files.size(); i += conf->lookup_batch) {
+        const size_t n_batch =
+            std::min<size_t>(conf->lookup_batch, files.size() - i);
+        std::vector<UInt160> to_lookup;
 
-        // Take a random node.
-        std::unique_ptr<Node<NodeLocalCom>>& node = nodes[dis(prng())];
+        // Take a random node: it reads the whole batch.
+        Node<NodeLocalCom>& node = rand_online_node();
+
+        for (size_t j = i; j < i + n_batch; ++j) {
+            const std::vector<UInt160> file_keys(lookup_keys(files[j]));
+            to_lookup.insert(
+                to_lookup.end(), file_keys.begin(), file_keys.end());
+        }
+        const auto holders(lookup_all(node, to_lookup, batched));
+
+        auto first = holders.begin();
+        for (size_t j = i; j < i + n_batch; ++j) {
+            CLOG_EVERY_N(1000, INFO, SIM_LOG_ID)
+                << "checking file " << n_files + 1 << "/" << files.size();
+
+            const auto last = first + (codec ? codec->n_fragments() : 1);
+            if (!read_file(node, files[j], {first, last})) {
+                SIM_LOG(ERROR) << "file " << files[j] << " was not found";
+                n_wrong++;
+            }
+            ++n_files;
+            first = last;
+        }
+    }
+    SIM_LOG(INFO) << n_wrong << "/" << files.size() << " files wrongly stored";
+}
+
+/** Put offline a random fraction of the nodes.
+ *
+ * @param rate fraction of nodes to put offline, in [0; 1].
+ */
+void Network::fail_nodes(double rate)
+{
+    std::vector<Node<NodeLocalCom>*> online;
+
+    for (auto& node : nodes) {
+        if (node->is_online()) {
+            online.push_back(node.get());
+        }
+    }
+    std::shuffle(online.begin(), online.end(), prng());
+
+    const auto n_failures = static_cast<size_t>(
+        std::lround(rate * static_cast<double>(nodes.size())));
+    // Keep at least one node online.
+    for (size_t i = 0; i < n_failures && i + 1 < online.size(); ++i) {
+        online[i]->set_online(false);
+    }
+    SIM_LOG(INFO) << std::min(n_failures, online.size() - 1) << "/"
+                  << nodes.size() << " nodes put offline";
+}
+
+// Probability to lose a file made of `n` pieces (each piece being lost with a
+// probability `p`) if more than `max_loss` pieces are lost.
+static double loss_probability(uint32_t n, uint32_t max_loss, double p)
+{
+    double proba = 0.0;
+
+    for (uint32_t j = max_loss + 1; j <= n; ++j) {
+        const double log_binomial = std::lgamma(n + 1.0) - std::lgamma(j + 1.0)
+                                    - std::lgamma(n - j + 1.0);
+        proba += std::exp(log_binomial) * std::pow(p, j)
+                 * std::pow(1.0 - p, n - j);
+    }
+    return proba;
+}
+
+/** Report the storage overhead and durability of the storage scheme.
+ *
+ * The miss rate is the fraction of nodes currently offline.
+ * Replication (k replicas) is compared to the erasure code (n_data data
+ * fragments + n_parities parity fragments), if any.
+ */
+void Network::report_durability()
+{
+    uint64_t stored_bytes = 0;
+    uint32_t n_offline = 0;
+
+    for (const auto& node : nodes) {
+        stored_bytes += node->stored_bytes();
+        n_offline += node->is_online() ? 0 : 1;
+    }
+
+    const double miss_rate = n_offline / static_cast<double>(nodes.size());
+    SIM_LOG(INFO) << "miss rate: " << miss_rate << " (" << n_offline << "/"
+                  << nodes.size() << " nodes offline)";
+    if (files_bytes != 0) {
+        SIM_LOG(INFO) << "measured storage overhead: "
+                      << static_cast<double>(stored_bytes)
+                             / static_cast<double>(files_bytes)
+                      << " (" << stored_bytes << " bytes stored for "
+                      << files_bytes << " bytes of files)";
+    }
+
+    SIM_LOG(INFO) << "replication (k=" << conf->k
+                  << "): overhead=" << conf->k << ", P(loss)="
+                  << loss_probability(conf->k, conf->k - 1, miss_rate);
+    if (codec) {
+        const uint32_t n = codec->n_fragments();
+        const double overhead = n / static_cast<double>(codec->n_data());
+        SIM_LOG(INFO) << "erasure code (n_data=" << codec->n_data()
+                      << ", n_parities=" << codec->n_parities()
+                      << "): overhead=" << overhead << ", P(loss)="
+                      << loss_probability(n, codec->n_parities(), miss_rate);
+    }
+}
+
+/** Format the number of requests of each RPC. */
+static std::string format_rpcs(const RpcCounters& counters)
+{
+    std::ostringstream out;
+
+    for (size_t i = 0; i < N_RPCS; ++i) {
+        out << (i == 0 ? "" : ", ") << rpc_name(static_cast<Rpc>(i)) << "="
+            << counters.n_served[i];
+    }
+    return out.str();
+}
+
+/** Get the Ethereum accounts of all the nodes ready at once (instead of on
+ * their first use).
+ */
+void Network::provision_accounts()
+{
+    std::vector<Node<NodeLocalCom>*> all_nodes;
+
+    for (const auto& node : nodes) {
+        all_nodes.push_back(node.get());
+    }
+    const auto start = std::chrono::steady_clock::now();
+    Node<NodeLocalCom>::provision_accounts(*conf, all_nodes);
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    uint32_t n_ready = 0;
+    for (const auto& node : nodes) {
+        n_ready += node->is_account_ready() ? 1 : 0;
+    }
+    ETH_LOG(INFO) << n_ready << '/' << nodes.size() << " accounts ready in "
+                  << elapsed.count() << "s (" << conf->accounts.size()
+                  << " cached)";
+}
+
+/** Report the calls made to geth by the transactions of the nodes, and the
+ * connections to geth.
+ */
+void Network::report_txs() const
+{
+    const TxStats stats = conf->txs.stats();
+
+    ETH_LOG(INFO) << "transactions: " << stats.n_sent << " sent, "
+                  << stats.n_mined << " mined, "
+                  << conf->txs.n_in_flight() << " in flight, "
+                  << stats.n_blocks << " blocks scanned, "
+                  << stats.n_nonce_syncs << " nonce syncs, "
+                  << stats.n_fillers << " gaps filled";
+    if (stats.n_mined != 0) {
+        ETH_LOG(INFO) << "calls per mined transaction: "
+                      << static_cast<double>(stats.n_calls)
+                             / static_cast<double>(stats.n_mined);
+    }
+
+    const GethPoolStats pool = conf->geth_pool->stats();
+    ETH_LOG(INFO) << "geth connections: " << conf->geth_pool->n_open()
+                  << " open (" << pool.n_opened << " opened), "
+                  << pool.n_requests << " requests, " << pool.n_waits
+                  << " waited for a connection, " << pool.n_errors
+                  << " failed";
+}
+
+/** Buy storage for a file from the nodes that would hold its replicas (or
+ * fragments), and wait for the purchase to be mined.
+ *
+ * @param node     the buyer
+ * @param key      key of the file
+ * @param nb_bytes size of the file
+ * @param batched  if true, buy from all the holders in a single transaction
+ *                 (`buyStorageBatch`), otherwise one transaction per holder
+ */
+void Network::buy_file_storage(
+    Node<NodeLocalCom>& node,
+    const UInt160& key,
+    uint64_t nb_bytes,
+    bool batched)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<FetchTarget> targets(
+        fetch_targets(key, lookup_all(node, lookup_keys(key), true)));
+    const uint64_t piece_size =
+        codec ? codec->fragment_size(nb_bytes) : nb_bytes;
+
+    std::vector<Node<NodeLocalCom>*> holders;
+    for (const auto& target : targets) {
+        holders.push_back(lookup_cheat(target.holder.id().to_string()));
+    }
+    Node<NodeLocalCom>::provision_accounts(*conf, holders);
+
+    std::vector<std::string> sellers;
+    for (const auto* holder : holders) {
+        if (holder->is_account_ready()) {
+            sellers.push_back(holder->get_eth_account());
+        }
+    }
+    if (sellers.empty()) {
+        // A batch without seller would only burn gas.
+        ETH_LOG(WARNING) << "storage for " << key << " not bought: none of "
+                         << holders.size() << " holders has an account";
+        return;
+    }
+
+    std::vector<std::future<TxReceipt>> purchases;
+    if (batched) {
+        purchases.push_back(node.buy_storage(
+            sellers, std::vector<uint64_t>(sellers.size(), piece_size)));
+    } else {
+        for (const auto& seller : sellers) {
+            purchases.push_back(node.buy_storage(seller, piece_size));
+        }
+    }
+
+    uint32_t n_failed = 0;
+    for (auto& purchase : purchases) {
+        try {
+            n_failed += purchase.get().success ? 0 : 1;
+        } catch (const std::exception&) {
+            ++n_failed;
+        }
+    }
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    ETH_LOG(INFO) << "storage for " << key << " bought from "
+                  << sellers.size() << " sellers (" << piece_size
+                  << " bytes each) in " << purchases.size()
+                  << " transactions, " << n_failed << " failed, "
+                  << elapsed.count() << "s";
+}
+
+/** Report the payment channels opened and closed, and the vouchers signed
+ * (the transactions they saved).
+ */
+void Network::report_channels() const
+{
+    const ChannelStats stats = conf->channels.stats();
+    const double gib = static_cast<double>(stats.n_bytes) / (1 << 30);
+
+    ETH_LOG(INFO) << "payment channels: " << stats.n_opened << " opened, "
+                  << stats.n_closed << " closed, " << stats.n_vouchers
+                  << " vouchers signed for " << stats.n_bytes << " bytes";
+    if (stats.n_bytes != 0) {
+        // Each put/get paid through a channel would otherwise be a
+        // transaction (`buyerPutBytes`/`buyerGetBytes`).
+        ETH_LOG(INFO) << "transactions per GiB: "
+                      << static_cast<double>(stats.n_opened + stats.n_closed)
+                             / gib
+                      << " (" << static_cast<double>(stats.n_vouchers) / gib
+                      << " without the channels)";
+    }
+}
+
+/** Report the load of the online nodes (the RPCs they served since the last
+ * reset of `rpc_load`), and the `top_n` most loaded of them.
+ *
+ * The imbalance of the requests is compared to the imbalance of the stored
+ * bytes (which follows the split of the keyspace amongst the nodes).
+ */
+void Network::report_load(uint32_t top_n) const
+{
+    const std::unordered_map<UInt160, RpcCounters> totals(
+        rpc_counters.totals());
+    const RpcCounters idle{{{0, 0, 0, 0, 0}}, 0, 0, 0};
+    std::vector<std::pair<const Node<NodeLocalCom>*, RpcCounters>> loads;
+    RpcCounters total(idle);
+
+    for (const auto& node : nodes) {
+        if (!node->is_online()) {
+            continue;
+        }
+        const auto it = totals.find(node->id());
+        loads.emplace_back(node.get(), it == totals.end() ? idle : it->second);
+        total += loads.back().second;
+    }
+    if (loads.empty()) {
+        return;
+    }
+
+    SIM_LOG(INFO) << "RPC load: " << total.n_requests() << " requests ("
+                  << format_rpcs(total) << "), bytes in=" << total.bytes_in
+                  << ", bytes out=" << total.bytes_out
+                  << ", entries stored=" << total.n_stored;
+
+    std::vector<double> requests;
+    std::vector<double> stored;
+    uint32_t n_idle = 0;
+    for (const auto& it : loads) {
+        requests.push_back(static_cast<double>(it.second.n_requests()));
+        stored.push_back(static_cast<double>(it.first->stored_bytes()));
+        n_idle += it.second.n_requests() == 0 ? 1 : 0;
+    }
+    const double mean = static_cast<double>(total.n_requests())
+                        / static_cast<double>(loads.size());
+    const double max = *std::max_element(requests.begin(), requests.end());
+    const double median = percentile(requests, 0.5);
+    const double p99 = percentile(requests, 0.99);
+    SIM_LOG(INFO) << "requests per node: mean=" << mean
+                  << ", median=" << median << ", p99=" << p99
+                  << ", max/mean=" << (mean == 0.0 ? 0.0 : max / mean)
+                  << ", Gini=" << gini(requests) << ", idle nodes=" << n_idle
+                  << "/" << loads.size()
+                  << " (stored bytes Gini=" << gini(stored) << ")";
+
+    const size_t n_top = std::min<size_t>(top_n, loads.size());
+    std::partial_sort(
+        loads.begin(),
+        loads.begin() + n_top,
+        loads.end(),
+        [](const std::pair<const Node<NodeLocalCom>*, RpcCounters>& a,
+           const std::pair<const Node<NodeLocalCom>*, RpcCounters>& b) {
+            return a.second.n_requests() > b.second.n_requests();
+        });
+    for (size_t i = 0; i < n_top; ++i) {
+        const RpcCounters& counters = loads[i].second;
+
+        SIM_LOG(INFO) << "#" << i + 1 << " " << loads[i].first->id() << ": "
+                      << counters.n_requests() << " requests ("
+                      << format_rpcs(counters) << "), bytes in/out="
+                      << counters.bytes_in << "/" << counters.bytes_out
+                      << ", stored bytes=" << loads[i].first->stored_bytes();
+    }
+}
+
+static double mb_per_sec(uint64_t n_bytes, std::chrono::duration<double> dt)
+{
+    return static_cast<double>(n_bytes) / (1024.0 * 1024.0) / dt.count();
+}
+
+/** Measure the throughput of the streaming put/get, for 1 to `max_threads`.
+ *
+ * The stripes are encoded with the erasure code given on the command line
+ * (4+2 by default), each fragment being stored on the node closest to its
+ * key. The nodes are not thread-safe, so the RPCs are serialized: the
+ * parallelism comes from the encoding/decoding overlapping the I/O. The
+ * fragments are removed from their holders once read back.
+ *
+ * @param file_size     size of the file to put/get
+ * @param max_threads   maximum number of workers (and senders)
+ * @param max_in_flight maximum number of stripes in flight
+ * @param stripe_size   size of the stripes
+ */
+void Network::bench_pipeline(
+    uint64_t file_size,
+    uint32_t max_threads,
+    uint32_t max_in_flight,
+    uint64_t stripe_size)
+{
+    const uint32_t n_data = codec ? codec->n_data() : 4;
+    const uint32_t n_parities = codec ? codec->n_parities() : 2;
+    Node<NodeLocalCom>& node = rand_online_node();
+    std::mutex node_mutex;
+    // The holder of each fragment stored, to clean up.
+    std::vector<std::pair<dht::NodeAddress, UInt160>> stored;
+
+    const auto store = [&](const UInt160& key, const Buffer& value) {
+        std::lock_guard<std::mutex> lock(node_mutex);
+
+        for (const auto& it : node.node_lookup(key)) {
+            if (node.send_store(it, key, value)) {
+                stored.emplace_back(it, key);
+                return true;
+            }
+        }
+        return false;
+    };
+    const auto fetch = [&](const UInt160& key, Buffer& value) {
+        std::lock_guard<std::mutex> lock(node_mutex);
+
+        for (const auto& it : node.node_lookup(key)) {
+            if (node.send_find_value(it, key, value)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::uniform_int_distribution<int> byte_dis(0, 255);
+    std::string payload(file_size, '\0');
+    for (auto& byte : payload) {
+        byte = static_cast<char>(byte_dis(prng()));
+    }
+
+    SIM_LOG(INFO) << "pipeline: " << file_size << " bytes, stripes of "
+                  << stripe_size << " bytes, " << n_data << "+" << n_parities
+                  << " fragments, " << max_in_flight << " stripes in flight";
+    for (uint32_t n_threads = 1; n_threads <= max_threads; ++n_threads) {
+        FilePipeline pipeline(
+            n_data,
+            n_parities,
+            conf->n_bits,
+            stripe_size,
+            n_threads,
+            n_threads,
+            max_in_flight);
+        const UInt160 key(UInt160::rand(prng(), conf->n_bits));
+        std::istringstream input(payload);
+        std::ostringstream output;
+
+        const auto t0 = std::chrono::steady_clock::now();
+        const std::unique_ptr<File> file = pipeline.put(key, input, store);
+        const auto t1 = std::chrono::steady_clock::now();
+        const uint64_t n_bytes = pipeline.get(*file, output, fetch);
+        const auto t2 = std::chrono::steady_clock::now();
+
+        SIM_LOG(INFO) << n_threads << " thread(s): put "
+                      << mb_per_sec(file_size, t1 - t0) << " MB/s, get "
+                      << mb_per_sec(n_bytes, t2 - t1) << " MB/s"
+                      << (output.str() == payload ? "" : " (CORRUPTED)");
+
+        for (const auto& it : stored) {
+            lookup_cheat(it.first.id().to_string())->erase(it.second);
+        }
+        stored.clear();
+    }
+}
+
+/** Set the latency/loss model used by `bench_reads`. */
+void Network::set_latency_model(const LatencyModel& model)
+{
+    latency_model = model;
+}
+
+/** Measure the read latency of the files, with and without extra requests.
+ *
+ * Each file is read from a random node, first by requesting the minimal
+ * set of holders (a failed request being replaced by a new one), then by
+ * requesting `n_extra` more holders and keeping the first answers.
+ * Only the fetch phase is timed: the holders lookup is the same for both.
+ *
+ * @param n_reads number of reads
+ * @param n_extra number of extra requests
+ */
+void Network::bench_reads(uint32_t n_reads, uint32_t n_extra)
+{
+    if (files.empty()) {
+        SIM_LOG(ERROR) << "no file to read";
+        return;
+    }
+    std::uniform_int_distribution<size_t> file_dis(0, files.size() - 1);
+    const auto latency = [this](const FetchTarget& target, double& delay) {
+        return latency_model.sample(target.holder.id(), prng(), delay);
+    };
+
+    for (const uint32_t extra : {0u, n_extra}) {
+        std::vector<double> latencies;
+        uint64_t n_sent = 0;
+        uint64_t n_cancelled = 0;
+        uint32_t n_incomplete = 0;
+
+        for (uint32_t i = 0; i < n_reads; ++i) {
+            Node<NodeLocalCom>& node = rand_online_node();
+            const UInt160& key = files[file_dis(prng())];
+            const FetchResult result = fetch_file(
+                node,
+                key,
+                lookup_all(node, lookup_keys(key), false),
+                extra,
+                latency);
+
+            latencies.push_back(result.latency);
+            n_sent += result.n_sent;
+            n_cancelled += result.n_cancelled;
+            n_incomplete += result.complete ? 0 : 1;
+        }
+
+        SIM_LOG(INFO) << "reads with " << extra << " extra request(s): p50="
+                      << percentile(latencies, 0.5)
+                      << "ms, p99=" << percentile(latencies, 0.99)
+                      << "ms, p999=" << percentile(latencies, 0.999)
+                      << "ms, requests/read="
+                      << static_cast<double>(n_sent) / n_reads
+                      << ", cancelled/read="
+                      << static_cast<double>(n_cancelled) / n_reads
+                      << ", failed reads=" << n_incomplete << "/" << n_reads;
+        if (extra == n_extra) {
+            break;
+        }
+    }
+}
+
+/** Check the redundancy of a file by asking its holders.
+ *
+ * Each node responsible for a piece (one of the k closest nodes for a
+ * replica, the closest one for a fragment) is asked if it has the piece
+ * (`node` itself being checked locally).
+ *
+ * @param node       node performing the check
+ * @param file       key of the file
+ * @param n_messages incremented by the number of messages exchanged
+ */
+Network::FileProbe Network::probe_file(
+    Node<NodeLocalCom>& node,
+    const UInt160& file,
+    uint64_t& n_messages)
+{
+    FileProbe probe{0, {}, {}};
+    const uint32_t n_pieces = codec ? codec->n_fragments() : 1;
 
-        // Check that at least one node has the file.
-        bool found = false;
-        for (const auto& it : node->node_lookup(file_key)) {
-            const auto dcss_node = lookup_cheat(it.id().to_string());
+    for (uint32_t i = 0; i < n_pieces; ++i) {
+        const UInt160 key(
+            codec ? File::part_key(file, i, n_pieces, conf->n_bits) : file);
+        std::vector<dht::NodeAddress> lacking;
+        Buffer own;
+        // The lookup leaves out the node itself, which may be a holder.
+        bool found = node.find_value(key, own);
+
+        if (found) {
+            ++probe.n_available;
+            if (probe.values.empty() || codec) {
+                probe.values.push_back(own);
+            }
+            if (codec) {
+                continue;
+            }
+        }
+        for (const auto& holder : node.node_lookup(key)) {
+            Buffer value;
 
-            for (const auto& node_file_key : dcss_node->files()) {
-                if (node_file_key == file_key) {
-                    found = true;
+            ++n_messages;
+            if (node.send_find_value(holder, key, value)) {
+                ++probe.n_available;
+                found = true;
+                if (probe.values.empty() || codec) {
+                    probe.values.push_back(value);
+                }
+                // A fragment has a single holder.
+                if (codec) {
                     break;
                 }
+                continue;
+            }
+            // Tell an unanswered request from a missing key.
+            ++n_messages;
+            if (node.send_ping(holder)) {
+                lacking.push_back(holder);
             }
         }
 
-        if (!found) {
-            SIM_LOG(ERROR) << "file " << file_key << " was not found";
-            n_wrong++;
+        if (!codec) {
+            for (const auto& holder : lacking) {
+                probe.missing.emplace_back(key, holder);
+            }
+        } else if (!found && !lacking.empty()) {
+            probe.missing.emplace_back(key, lacking.front());
         }
-        ++n_files;
     }
-    SIM_LOG(INFO) << n_wrong << "/" << files.size() << " files wrongly stored";
+    return probe;
 }
 
-void Network::rand_node(tnode_callback_func cb_func, void* cb_arg)
+/** Return the repair task of a probed file. */
+RepairTask
+Network::make_repair_task(const UInt160& file, const FileProbe& probe)
 {
-    std::uniform_int_distribution<uint64_t> dis(0, nodes.size() - 1);
-    uint64_t x = dis(prng());
-    if (nullptr != cb_func) {
-        cb_func(*nodes[x], cb_arg);
+    const int32_t min_pieces =
+        codec ? static_cast<int32_t>(codec->n_data()) : 1;
+
+    return RepairTask{file,
+                      static_cast<int32_t>(probe.n_available) - min_pieces,
+                      static_cast<uint32_t>(probe.missing.size())};
+}
+
+/** Regenerate the missing pieces of a file.
+ *
+ * @param node       node performing the repair
+ * @param file       key of the file
+ * @param n_messages incremented by the number of messages exchanged
+ * @return the number of bytes transferred.
+ */
+uint64_t Network::repair_file(
+    Node<NodeLocalCom>& node,
+    const UInt160& file,
+    uint64_t& n_messages)
+{
+    // The state may have changed since the detection: probe again.
+    const FileProbe probe = probe_file(node, file, n_messages);
+    const RepairTask task = make_repair_task(file, probe);
+    uint64_t n_bytes = 0;
+
+    if (task.margin < 0 || task.n_missing == 0) {
+        return 0;
+    }
+
+    if (!codec) {
+        // Copy a surviving replica.
+        const Buffer& value = probe.values.front();
+        for (const auto& piece : probe.missing) {
+            ++n_messages;
+            if (node.send_store(piece.second, piece.first, value)) {
+                n_bytes += value.size();
+            }
+        }
+        return n_bytes;
+    }
+
+    // Rebuild the file from `n_data` fragments, then re-encode it.
+    std::vector<Buffer> available(
+        probe.values.begin(), probe.values.begin() + codec->n_data());
+    for (const auto& fragment : available) {
+        n_bytes += fragment.size();
     }
+    std::vector<Buffer> fragments;
+    try {
+        fragments = codec->encode(codec->decode(available));
+    } catch (const DomainError& exn) {
+        SIM_LOG(ERROR) << "cannot repair " << file << ": " << exn.what();
+        return n_bytes;
+    }
+    for (const auto& piece : probe.missing) {
+        for (uint32_t i = 0; i < codec->n_fragments(); ++i) {
+            const UInt160 part_key(
+                File::part_key(file, i, codec->n_fragments(), conf->n_bits));
+            if (piece.first != part_key) {
+                continue;
+            }
+            ++n_messages;
+            if (node.send_store(piece.second, piece.first, fragments[i])) {
+                n_bytes += fragments[i].size();
+            }
+        }
+    }
+    return n_bytes;
 }
 
-void Network::rand_key(tkey_callback_func cb_func, void* cb_arg)
+/** Return the other nodes that should hold a replica of `key`, as known by
+ * `node` (the k closest to `key`, `node` included, but the `dead` ones), or
+ * nothing if `node` is not one of them.
+ */
+std::vector<dht::NodeAddress> Network::replica_neighbors(
+    Node<NodeLocalCom>& node,
+    const UInt160& key,
+    const std::unordered_set<UInt160>& dead)
 {
-    if (nullptr != cb_func) {
-        cb_func(UInt160::rand(prng(), conf->n_bits), cb_arg);
+    const auto n_nearest = static_cast<uint32_t>(conf->k + dead.size() + 1);
+    const UInt160 own_distance(node.distance_to(key));
+    std::vector<dht::NodeAddress> others;
+    uint32_t n_closer = 0;
+
+    for (const auto& addr : node.find_node(key, n_nearest)) {
+        if (addr.id() == node.id() || dead.count(addr.id()) != 0) {
+            continue;
+        }
+        others.push_back(addr);
+        if (dht::compute_distance(addr.id(), key) < own_distance) {
+            ++n_closer;
+        }
+    }
+    if (n_closer >= conf->k) {
+        return {};
+    }
+    std::sort(others.begin(), others.end(), dht::ByDistanceFrom(key));
+    if (others.size() >= conf->k) {
+        others.erase(others.begin() + conf->k - 1, others.end());
+    }
+    return others;
+}
+
+/** Check the replicas of the keys held by `node`, by exchanging keys with
+ * its neighbors.
+ *
+ * The node expects the other closest nodes it knows to each of its keys to
+ * hold it too (see `replica_neighbors`): it sends each of these neighbors,
+ * in a single message, the keys it should hold, and learns the ones it
+ * lacks. A neighbor that doesn't answer is pinged (evicted if gone), and its
+ * keys are sent to the next closest nodes.
+ *
+ * @param node       node checking its keys
+ * @param n_messages incremented by the number of messages exchanged
+ * @return the keys missing replicas.
+ */
+std::unordered_map<UInt160, Network::ReplicaGap>
+Network::exchange_keys(Node<NodeLocalCom>& node, uint64_t& n_messages)
+{
+    // Replicas found and neighbors asked, per key.
+    struct Check {
+        uint32_t n_available;
+        std::vector<dht::NodeAddress> lacking;
+        std::unordered_set<UInt160> asked;
+    };
+    std::unordered_map<UInt160, Check> checks;
+    std::unordered_set<UInt160> dead;
+    std::vector<UInt160> to_check(node.files());
+
+    while (!to_check.empty()) {
+        // A message per neighbor, in a reproducible order.
+        std::map<UInt160, std::pair<dht::NodeAddress, std::vector<UInt160>>>
+            batches;
+
+        for (const auto& key : to_check) {
+            for (const auto& neighbor : replica_neighbors(node, key, dead)) {
+                Check& check = checks.emplace(key, Check{1, {}, {}}).first->second;
+
+                if (check.asked.insert(neighbor.id()).second) {
+                    batches
+                        .emplace(
+                            neighbor.id(),
+                            std::make_pair(neighbor, std::vector<UInt160>()))
+                        .first->second.second.push_back(key);
+                }
+            }
+        }
+        to_check.clear();
+
+        for (const auto& it : batches) {
+            const dht::NodeAddress& neighbor = it.second.first;
+            const std::vector<UInt160>& keys = it.second.second;
+            std::vector<UInt160> missing;
+
+            ++n_messages;
+            if (node.send_keys(neighbor, keys, missing)) {
+                const std::unordered_set<UInt160> lacks(
+                    missing.begin(), missing.end());
+
+                for (const auto& key : keys) {
+                    Check& check = checks.at(key);
+                    if (lacks.count(key) != 0) {
+                        check.lacking.push_back(neighbor);
+                    } else {
+                        ++check.n_available;
+                    }
+                }
+                continue;
+            }
+            ++n_messages;
+            node.send_ping(neighbor);
+            dead.insert(neighbor.id());
+            to_check.insert(to_check.end(), keys.begin(), keys.end());
+        }
+        std::sort(to_check.begin(), to_check.end());
+        to_check.erase(
+            std::unique(to_check.begin(), to_check.end()), to_check.end());
+    }
+
+    std::unordered_map<UInt160, ReplicaGap> gaps;
+    for (auto& it : checks) {
+        if (!it.second.lacking.empty()) {
+            gaps.emplace(
+                it.first,
+                ReplicaGap{
+                    &node, it.second.n_available, std::move(it.second.lacking)});
+        }
+    }
+    return gaps;
+}
+
+/** Copy a replica from the node that found the missing ones.
+ *
+ * @return the number of bytes transferred.
+ */
+uint64_t Network::repair_replicas(
+    const UInt160& key,
+    const ReplicaGap& gap,
+    uint64_t& n_messages)
+{
+    Buffer value;
+    uint64_t n_bytes = 0;
+
+    // The source is gone since: probe the file again.
+    if (!gap.source->is_online() || !gap.source->find_value(key, value)) {
+        return repair_file(rand_online_node(), key, n_messages);
+    }
+    for (const auto& holder : gap.lacking) {
+        ++n_messages;
+        if (gap.source->send_store(holder, key, value)) {
+            n_bytes += value.size();
+        }
+    }
+    return n_bytes;
+}
+
+/** Count the files missing pieces, and the lost ones (too few pieces left to
+ * regenerate them).
+ *
+ * Counted by the simulator, from the keys stored on the online nodes: the
+ * nodes can't tell a lost file (nobody is left to notice it).
+ */
+void Network::count_damage(uint32_t& n_degraded, uint32_t& n_lost) const
+{
+    std::unordered_map<UInt160, uint32_t> n_copies;
+    const uint32_t n_pieces = codec ? codec->n_fragments() : 1;
+    const uint32_t min_pieces = codec ? codec->n_data() : 1;
+
+    for (const auto& node : nodes) {
+        if (node->is_online()) {
+            for (const auto& key : node->files()) {
+                ++n_copies[key];
+            }
+        }
+    }
+    n_degraded = 0;
+    n_lost = 0;
+    for (const auto& file : files) {
+        uint32_t n_available = 0;
+        bool degraded = false;
+
+        for (uint32_t i = 0; i < n_pieces; ++i) {
+            const UInt160 key(
+                codec ? File::part_key(file, i, n_pieces, conf->n_bits)
+                      : file);
+            const auto found = n_copies.find(key);
+            const uint32_t n = found == n_copies.end() ? 0 : found->second;
+
+            // A replica per node, a fragment on a single node.
+            if (codec) {
+                n_available += n == 0 ? 0 : 1;
+                degraded = degraded || n == 0;
+            } else {
+                n_available = n;
+                degraded = n < conf->k;
+            }
+        }
+        if (n_available < min_pieces) {
+            ++n_lost;
+        } else if (degraded) {
+            ++n_degraded;
+        }
+    }
+}
+
+/** Restore the redundancy of the files at a limited rate, while they are
+ * read.
+ *
+ * The repair runs by ticks (of one virtual second). At each tick:
+ * - `scan_batch` nodes (round-robin) check the replicas of their keys by
+ *   exchanging keys with their neighbors (see `exchange_keys`). The
+ *   fragments having a single holder, nobody else knows about them: with an
+ *   erasure code, `scan_batch` files are checked instead, a random node
+ *   asking the holders of each fragment (see `probe_file`). The degraded
+ *   files are queued, the most at-risk first;
+ * - files are repaired as long as the bandwidth budget allows it;
+ * - `n_reads` random files are read, from random nodes.
+ *
+ * The repair ends when a whole round of checks didn't find any file to
+ * repair (or after `max_ticks` ticks).
+ *
+ * @param bandwidth  repair bandwidth (bytes per tick)
+ * @param scan_batch number of nodes (or files) checked per tick
+ * @param max_ticks  maximum duration of the repair (in ticks)
+ * @param n_reads    number of reads per tick
+ * @return what the repair did.
+ */
+RepairStats Network::repair(
+    uint64_t bandwidth,
+    uint32_t scan_batch,
+    uint32_t max_ticks,
+    uint32_t n_reads)
+{
+    TokenBucket bucket(bandwidth, bandwidth);
+    RepairQueue queue;
+    // The replicas found missing by the key exchanges, being queued.
+    std::unordered_map<UInt160, ReplicaGap> gaps;
+    RepairStats stats{0, 0, 0, 0, 0, 0, 0, false, 0, 0};
+    const size_t n_checks = codec ? files.size() : nodes.size();
+    size_t n_clean = 0; // Number of successive checks finding nothing.
+    size_t cursor = 0;
+
+    if (files.empty()) {
+        return stats;
+    }
+    std::uniform_int_distribution<size_t> file_dis(0, files.size() - 1);
+    while (stats.n_ticks < max_ticks
+           && (n_clean < n_checks || !queue.empty())) {
+        ++stats.n_ticks;
+        bucket.tick();
+
+        // Detection.
+        for (uint32_t i = 0; i < scan_batch && n_clean < n_checks; ++i) {
+            const size_t checked = cursor;
+            cursor = (cursor + 1) % n_checks;
+
+            if (codec) {
+                const UInt160& file = files[checked];
+                const RepairTask task = make_repair_task(
+                    file,
+                    probe_file(rand_online_node(), file, stats.n_messages));
+                if (task.margin < 0 || task.n_missing == 0) {
+                    ++n_clean;
+                } else {
+                    n_clean = 0;
+                    queue.push(task);
+                }
+                continue;
+            }
+
+            Node<NodeLocalCom>& node = *nodes[checked];
+            auto found = node.is_online()
+                             ? exchange_keys(node, stats.n_messages)
+                             : std::unordered_map<UInt160, ReplicaGap>();
+            if (found.empty()) {
+                ++n_clean;
+                continue;
+            }
+            n_clean = 0;
+            for (auto& it : found) {
+                const RepairTask task{
+                    it.first,
+                    static_cast<int32_t>(it.second.n_available) - 1,
+                    static_cast<uint32_t>(it.second.lacking.size())};
+                if (queue.push(task)) {
+                    gaps.emplace(it.first, std::move(it.second));
+                }
+            }
+        }
+
+        // Repair, the most at-risk files first.
+        RepairTask task;
+        while (bucket.has_tokens() && queue.pop(task)) {
+            uint64_t repaired = 0;
+            const auto gap = gaps.find(task.file);
+
+            if (gap != gaps.end()) {
+                repaired =
+                    repair_replicas(task.file, gap->second, stats.n_messages);
+                gaps.erase(gap);
+            } else {
+                repaired =
+                    repair_file(rand_online_node(), task.file, stats.n_messages);
+            }
+            SIM_VLOG(1) << "tick " << stats.n_ticks << ": repaired "
+                        << task.file << " (margin " << task.margin << ", "
+                        << task.n_missing << " missing): " << repaired
+                        << " bytes";
+            bucket.consume(repaired);
+            stats.n_bytes += repaired;
+            if (repaired != 0) {
+                ++stats.n_repaired;
+                stats.restored_at = stats.n_ticks;
+            }
+        }
+
+        // The workload goes on meanwhile.
+        for (uint32_t i = 0; i < n_reads; ++i) {
+            Node<NodeLocalCom>& reader = rand_online_node();
+            const UInt160& file = files[file_dis(prng())];
+
+            ++stats.n_reads;
+            if (!read_file(
+                    reader,
+                    file,
+                    lookup_all(
+                        reader, lookup_keys(file), conf->lookup_batch > 1))) {
+                ++stats.n_failed_reads;
+            }
+        }
+    }
+    stats.restored = n_clean >= n_checks && queue.empty();
+    count_damage(stats.n_degraded, stats.n_lost);
+
+    SIM_LOG(INFO) << "repair: " << stats.n_repaired << " repairs, "
+                  << stats.n_degraded << " files still degraded, "
+                  << stats.n_lost << " files lost";
+    SIM_LOG(INFO) << "repair traffic: " << stats.n_bytes << " bytes, "
+                  << stats.n_messages << " messages";
+    if (stats.n_reads != 0) {
+        SIM_LOG(INFO) << "reads meanwhile: " << stats.n_failed_reads << "/"
+                      << stats.n_reads << " failed";
+    }
+    if (stats.restored) {
+        SIM_LOG(INFO) << "full redundancy restored after "
+                      << stats.restored_at << "s (checked after "
+                      << stats.n_ticks << "s)";
+    } else {
+        SIM_LOG(INFO) << "redundancy not restored after " << stats.n_ticks
+                      << "s (" << queue.size() << " files queued)";
+    }
+    return stats;
+}
+
+/** Add a new node to the network.
+ *
+ * The node connects to α random nodes, then looks up its own ID and
+ * announces itself to its neighbors.
+ */
+Node<NodeLocalCom>& Network::join_node()
+{
+    UInt160 id;
+    do {
+        id = UInt160::rand(prng(), conf->n_bits);
+    } while (nodes_map.count(id.to_string()) != 0);
+
+    const dht::NodeAddress addr{id, "127.0.0.1", 0};
+    auto new_node =
+        std::make_unique<Node<NodeLocalCom>>(*conf, addr, NodeLocalCom(this));
+    Node<NodeLocalCom>& node = *new_node;
+    nodes_map[id.to_string()] = new_node.get();
+    nodes.push_back(std::move(new_node));
+
+    SIM_VLOG(1) << "node " << id << " joins";
+    if (conf->bucket_layout == BucketLayout::FULL) {
+        while (!node.fetch_membership(rand_online_node().addr())) {
+        }
+        node.gossip_join();
+        return node;
+    }
+    for (uint32_t i = 0; i < conf->alpha; ++i) {
+        Node<NodeLocalCom>& other = rand_online_node();
+        if (!(other == node)) {
+            node.ping(other);
+            other.ping(node);
+        }
+    }
+    announce(node);
+    return node;
+}
+
+/** Look up the ID of `node`, and introduce it to the nodes found. */
+void Network::announce(Node<NodeLocalCom>& node)
+{
+    for (const auto& neighbor : node.node_lookup(node.id())) {
+        Node<NodeLocalCom>* other = lookup_cheat(neighbor.id().to_string());
+        if (other != nullptr && other->is_online()) {
+            other->ping(node);
+        }
+    }
+}
+
+/** Simulate churn and measure its impact on the lookups.
+ *
+ * At each step, a fraction `rate` of the nodes leave (for good) and as many
+ * new nodes join. Then, the nodes check the liveness of their contacts (see
+ * `Node::flush_pings`), gossip the membership changes (full membership
+ * mode, see `Node::gossip_round`) and random lookups are performed.
+ *
+ * Run with `-r 0` (no replacement cache) to compare with routing tables
+ * that ignore the newcomers once full.
+ *
+ * @param n_steps   number of steps
+ * @param rate      fraction of the nodes leaving (and joining) at each step
+ * @param n_lookups number of lookups per step
+ */
+void Network::churn(uint32_t n_steps, double rate, uint32_t n_lookups)
+{
+    const auto n_churn = static_cast<size_t>(
+        std::lround(rate * static_cast<double>(nodes.size())));
+    LookupSamples samples{{}, 0, 0, 0, 0};
+    uint64_t n_pings = 0;
+    const dht::GossipStats gossip_before = gossip_totals();
+
+    for (uint32_t step = 0; step < n_steps; ++step) {
+        n_pings += churn_step(n_churn);
+        sample_lookups(n_lookups, samples);
+    }
+
+    SIM_LOG(INFO) << "churn: " << n_steps << " steps, " << n_churn
+                  << " nodes leaving/joining per step, replacement cache of "
+                  << conf->replacement_cache_size;
+    report_lookups(samples);
+    SIM_LOG(INFO) << "liveness pings: " << n_pings;
+    if (conf->bucket_layout == BucketLayout::FULL) {
+        dht::GossipStats total = gossip_totals();
+
+        total.n_messages -= gossip_before.n_messages;
+        total.n_events -= gossip_before.n_events;
+        total.n_transferred -= gossip_before.n_transferred;
+        report_gossip(total, n_steps);
+    }
+}
+
+/** Replace `n_churn` nodes, then let every node check its contacts.
+ *
+ * @return the number of liveness pings sent.
+ */
+uint64_t Network::churn_step(size_t n_churn)
+{
+    std::vector<Node<NodeLocalCom>*> online;
+    uint64_t n_pings = 0;
+
+    for (auto& node : nodes) {
+        if (node->is_online()) {
+            online.push_back(node.get());
+        }
+    }
+    std::shuffle(online.begin(), online.end(), prng());
+
+    // Some nodes leave for good (keep at least one node online)…
+    for (size_t i = 0; i < n_churn && i + 1 < online.size(); ++i) {
+        online[i]->set_online(false);
+    }
+    // … and new ones join.
+    for (size_t i = 0; i < n_churn; ++i) {
+        join_node();
+    }
+
+    // Liveness checks, membership gossip and time passing.
+    for (auto& node : nodes) {
+        if (node->is_online()) {
+            n_pings += node->pending_pings();
+            node->flush_pings();
+            node->gossip_round();
+            node->tick();
+        }
+    }
+    return n_pings;
+}
+
+/** Measure the lookup cache on a repeated-key workload, under churn.
+ *
+ * At each step (one tick of the node clocks), a fraction `rate` of the
+ * nodes is replaced, then `n_lookups` lookups are performed by `n_clients`
+ * nodes, the targets being chosen amongst `n_keys` keys with a Zipf
+ * distribution (exponent 1). Run with and without `-C` to compare.
+ */
+void Network::bench_lookup_cache(
+    uint32_t n_steps,
+    double rate,
+    uint32_t n_lookups,
+    uint32_t n_clients,
+    uint32_t n_keys)
+{
+    const auto n_churn = static_cast<size_t>(
+        std::lround(rate * static_cast<double>(nodes.size())));
+    std::vector<UInt160> keys;
+    std::vector<Node<NodeLocalCom>*> clients;
+    LookupSamples samples{{}, 0, 0, 0, 0};
+
+    for (uint32_t i = 0; i < n_keys; ++i) {
+        keys.push_back(UInt160::rand(prng(), conf->n_bits));
+    }
+    std::discrete_distribution<size_t> zipf(zipf_distribution(n_keys, 1.0));
+    for (uint32_t i = 0; i < n_clients; ++i) {
+        clients.push_back(&rand_online_node());
+    }
+    std::uniform_int_distribution<size_t> client_dis(0, n_clients - 1);
+
+    for (uint32_t step = 0; step < n_steps; ++step) {
+        churn_step(n_churn);
+        for (uint32_t i = 0; i < n_lookups; ++i) {
+            Node<NodeLocalCom>*& client = clients[client_dis(prng())];
+
+            // A client that left is replaced.
+            if (!client->is_online()) {
+                client = &rand_online_node();
+            }
+            sample_lookup(*client, keys[zipf(prng())], samples);
+        }
+    }
+
+    dht::LookupCacheStats total{0, 0, 0, 0, 0};
+    for (const auto& node : nodes) {
+        const dht::LookupCacheStats& stats = node->lookup_cache_stats();
+
+        total.n_hits += stats.n_hits;
+        total.n_misses += stats.n_misses;
+        total.n_expired += stats.n_expired;
+        total.n_stale += stats.n_stale;
+        total.n_invalidated += stats.n_invalidated;
+    }
+    report_lookups(samples);
+    SIM_LOG(INFO) << "lookup cache: hits=" << total.n_hits
+                  << ", misses=" << total.n_misses
+                  << ", expired=" << total.n_expired
+                  << ", stale=" << total.n_stale
+                  << ", invalidated=" << total.n_invalidated;
+}
+
+/** Sum the membership maintenance counters of all the nodes. */
+dht::GossipStats Network::gossip_totals() const
+{
+    dht::GossipStats total{0, 0, 0};
+
+    for (const auto& node : nodes) {
+        const dht::GossipStats& stats = node->gossip_stats();
+
+        total.n_messages += stats.n_messages;
+        total.n_events += stats.n_events;
+        total.n_transferred += stats.n_transferred;
+    }
+    return total;
+}
+
+/** Report the bandwidth used to maintain the full membership.
+ *
+ * A membership entry (event or member) is a node ID, an IPv4 address, a
+ * port and the kind of event.
+ */
+void Network::report_gossip(const dht::GossipStats& total, uint32_t n_steps)
+{
+    const uint64_t entry_size = conf->n_bits / 8 + 4 + 2 + 1;
+    uint32_t n_online = 0;
+
+    for (const auto& node : nodes) {
+        if (node->is_online()) {
+            ++n_online;
+        }
+    }
+
+    const double per_node_step =
+        static_cast<double>(n_online) * static_cast<double>(n_steps);
+    SIM_LOG(INFO) << "gossip: " << total.n_messages << " messages, "
+                  << total.n_events << " events, "
+                  << total.n_transferred << " members transferred to joiners";
+    SIM_LOG(INFO) << "membership maintenance: "
+                  << static_cast<double>(
+                         (total.n_events + total.n_transferred) * entry_size)
+                         / per_node_step
+                  << " bytes per node per step";
+}
+
+/** Perform `n_lookups` lookups, from random online nodes to random keys. */
+void Network::sample_lookups(uint32_t n_lookups, LookupSamples& samples)
+{
+    for (uint32_t i = 0; i < n_lookups; ++i) {
+        Node<NodeLocalCom>& node = rand_online_node();
+        const UInt160 key(UInt160::rand(prng(), conf->n_bits));
+
+        sample_lookup(node, key, samples);
+    }
+}
+
+/** Look up `key` from `node`, and add its measures to `samples`. */
+void Network::sample_lookup(
+    Node<NodeLocalCom>& node,
+    const UInt160& key,
+    LookupSamples& samples)
+{
+    const dht::LookupStats before = node.lookup_stats();
+
+    const std::vector<dht::NodeAddress> found = node.node_lookup(key);
+
+    const dht::LookupStats& after = node.lookup_stats();
+    samples.hops.push_back(
+        static_cast<double>(after.n_rounds - before.n_rounds));
+    samples.n_queries += after.n_queries - before.n_queries;
+    samples.n_unresponsive += after.n_unresponsive - before.n_unresponsive;
+    samples.n_authoritative += after.n_authoritative - before.n_authoritative;
+
+    // Did we find the closest online node?
+    if (is_closest(found, key, node)) {
+        ++samples.n_exact;
+    }
+}
+
+/** Check if the first of the `found` nodes is the closest online node to
+ * `key` (other than `node`, which performed the lookup).
+ */
+bool Network::is_closest(
+    const std::vector<dht::NodeAddress>& found,
+    const UInt160& key,
+    const Node<NodeLocalCom>& node) const
+{
+    const Node<NodeLocalCom>* closest = nullptr;
+
+    for (const auto& other : nodes) {
+        if (!other->is_online() || other->id() == node.id()) {
+            continue;
+        }
+        if (closest == nullptr
+            || other->distance_to(key) < closest->distance_to(key)) {
+            closest = other.get();
+        }
+    }
+    return !found.empty() && closest != nullptr
+           && found.front() == closest->addr();
+}
+
+void Network::report_lookups(LookupSamples& samples)
+{
+    const auto n_total = static_cast<double>(samples.hops.size());
+    double sum = 0.0;
+
+    for (const double h : samples.hops) {
+        sum += h;
+    }
+    SIM_LOG(INFO) << "lookups: hops mean=" << sum / n_total
+                  << ", p50=" << percentile(samples.hops, 0.5)
+                  << ", p99=" << percentile(samples.hops, 0.99)
+                  << ", queries="
+                  << static_cast<double>(samples.n_queries) / n_total
+                  << ", stale queries="
+                  << static_cast<double>(samples.n_unresponsive) / n_total
+                  << ", closest found="
+                  << 100.0 * static_cast<double>(samples.n_exact) / n_total
+                  << "%, authoritative answers="
+                  << 100.0 * static_cast<double>(samples.n_authoritative)
+                         / n_total
+                  << "%, latency~" << sum / n_total * latency_model.median()
+                  << " ms";
+}
+
+/** Report the size of the routing tables and the cost of the lookups.
+ *
+ * Run with the different k-buckets layouts (`-R`) to compare them.
+ *
+ * @param n_lookups    number of lookups to perform
+ * @param self_lookups if true, every node first looks up its own ID and
+ *                     introduces itself to its neighbors (as when joining)
+ */
+void Network::bench_routing(uint32_t n_lookups, bool self_lookups)
+{
+    if (self_lookups) {
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            CLOG_EVERY_N(10000, INFO, SIM_LOG_ID)
+                << "self lookup " << i + 1 << "/" << nodes.size();
+            announce(*nodes[i]);
+        }
+    }
+
+    uint64_t n_buckets = 0;
+    uint64_t n_contacts = 0;
+    uint64_t n_bytes = 0;
+
+    for (const auto& node : nodes) {
+        n_buckets += node->bucket_count();
+        n_contacts += node->connection_count();
+        n_bytes += node->routing_table_size();
+    }
+
+    const auto n_nodes = static_cast<double>(nodes.size());
+    SIM_LOG(INFO) << "routing tables: " << nodes.size() << " nodes, "
+                  << static_cast<double>(n_buckets) / n_nodes << " buckets, "
+                  << static_cast<double>(n_contacts) / n_nodes
+                  << " contacts and "
+                  << static_cast<double>(n_bytes) / n_nodes
+                  << " bytes per node (" << n_bytes / (1024 * 1024)
+                  << " MiB in total)";
+
+    LookupSamples samples{{}, 0, 0, 0, 0};
+    sample_lookups(n_lookups, samples);
+    report_lookups(samples);
+}
+
+Node<NodeLocalCom>& Network::rand_online_node()
+{
+    std::uniform_int_distribution<uint64_t> dis(0, nodes.size() - 1);
+
+    while (true) {
+        Node<NodeLocalCom>& node = *nodes[dis(prng())];
+        if (node.is_online()) {
+            return node;
+        }
+    }
+}
+
+void Network::rand_node(tnode_callback_func cb_func, void* cb_arg)
+{
+    std::uniform_int_distribution<uint64_t> dis(0, nodes.size() - 1);
+    uint64_t x = dis(prng());
+    if (nullptr != cb_func) {
+        cb_func(*nodes[x], cb_arg);
+    }
+}
+
+void Network::rand_key(tkey_callback_func cb_func, void* cb_arg)
+{
+    if (nullptr != cb_func) {
+        cb_func(UInt160::rand(prng(), conf->n_bits), cb_arg);
+    }
+}
+
+/** Compare the lookups of keys one at a time and in batches.
+ *
+ * Random keys are looked up by batches of `batch_size` from random nodes,
+ * first one at a time, then together (see `Node::node_lookup`).
+ *
+ * @param n_keys     number of keys to look up
+ * @param batch_size number of keys looked up together
+ */
+void Network::bench_lookups(uint32_t n_keys, uint32_t batch_size)
+{
+    for (const bool batched : {false, true}) {
+        uint64_t n_rounds = 0;
+        uint64_t n_queries = 0;
+        uint64_t n_messages = 0;
+        uint64_t n_exact = 0;
+        std::chrono::duration<double> elapsed(0.0);
+
+        for (uint32_t i = 0; i < n_keys; i += batch_size) {
+            const uint32_t n_batch = std::min(batch_size, n_keys - i);
+            Node<NodeLocalCom>& node = rand_online_node();
+            std::vector<UInt160> keys;
+
+            for (uint32_t j = 0; j < n_batch; ++j) {
+                keys.push_back(UInt160::rand(prng(), conf->n_bits));
+            }
+            const dht::LookupStats before = node.lookup_stats();
+            const auto start = std::chrono::steady_clock::now();
+            const auto found = lookup_all(node, keys, batched);
+            elapsed += std::chrono::steady_clock::now() - start;
+            const dht::LookupStats& after = node.lookup_stats();
+
+            n_rounds += after.n_rounds - before.n_rounds;
+            n_queries += after.n_queries - before.n_queries;
+            n_messages += after.n_messages - before.n_messages;
+            for (uint32_t j = 0; j < n_batch; ++j) {
+                n_exact += is_closest(found[j], keys[j], node) ? 1 : 0;
+            }
+        }
+
+        const auto n_total = static_cast<double>(n_keys);
+        SIM_LOG(INFO) << (batched ? "batched" : "one at a time")
+                      << " lookups: messages/key="
+                      << static_cast<double>(n_messages) / n_total
+                      << ", FIND_NODE/key="
+                      << static_cast<double>(n_queries) / n_total
+                      << ", hops/key="
+                      << static_cast<double>(n_rounds) / n_total
+                      << ", closest found="
+                      << 100.0 * static_cast<double>(n_exact) / n_total
+                      << "%, lookups/s=" << n_total / elapsed.count();
+    }
+}
+
+/** Measure the messages saved by coalescing the concurrent reads of a key.
+ *
+ * `n_clients` threads perform `n_reads` reads through the same node, the
+ * files being chosen with a Zipf distribution of exponent `zipf_s`. The
+ * reads are first performed independently, then by joining the lookups and
+ * reads in flight for the same key (see `Node::read_value`).
+ *
+ * The RPCs last the median latency of the latency model, scaled down (one
+ * simulated millisecond lasts 100 µs), so that the reads overlap.
+ */
+void Network::bench_hot_reads(
+    uint32_t n_clients,
+    uint32_t n_reads,
+    double zipf_s)
+{
+    if (files.empty()) {
+        SIM_LOG(ERROR) << "no file to read";
+        return;
+    }
+    Node<NodeLocalCom>& node = rand_online_node();
+    const auto n_messages = [this]() {
+        uint64_t total = 0;
+        for (const auto& it : rpc_counters.totals()) {
+            total += it.second.n_requests();
+        }
+        return total;
+    };
+
+    // The PRNG is not thread-safe: draw the reads upfront.
+    std::discrete_distribution<size_t> zipf(
+        zipf_distribution(files.size(), zipf_s));
+    std::vector<UInt160> reads;
+    for (uint32_t i = 0; i < n_reads; ++i) {
+        reads.push_back(files[zipf(prng())]);
+    }
+
+    node.set_rpc_delay(std::chrono::microseconds(
+        std::lround(latency_model.median() * 100.0)));
+    for (const bool coalesce : {false, true}) {
+        const Node<NodeLocalCom>::LookupFlight& lookups =
+            node.lookups_in_flight();
+        const Node<NodeLocalCom>::ReadFlight& values = node.reads_in_flight();
+        const uint64_t n_lookups_before = lookups.n_calls();
+        const uint64_t n_shared_lookups_before = lookups.n_shared();
+        const uint64_t n_values_before = values.n_calls();
+        const uint64_t n_shared_values_before = values.n_shared();
+        const uint64_t n_messages_before = n_messages();
+        std::atomic<uint32_t> n_failed(0);
+        std::atomic<uint32_t> next(0);
+
+        node.set_coalescing(coalesce);
+        const auto client = [&]() {
+            for (uint32_t i = next++; i < n_reads; i = next++) {
+                for (const auto& key : lookup_keys(reads[i])) {
+                    Buffer value;
+                    if (!node.read_value(key, value)) {
+                        ++n_failed;
+                        break;
+                    }
+                }
+            }
+        };
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> clients;
+        for (uint32_t i = 0; i < n_clients; ++i) {
+            clients.emplace_back(client);
+        }
+        for (auto& thread : clients) {
+            thread.join();
+        }
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        const auto n_total = static_cast<double>(n_reads);
+        const auto ratio = [](uint64_t n, uint64_t total) {
+            return total == 0 ? 0.0
+                              : 100.0 * static_cast<double>(n)
+                                    / static_cast<double>(total);
+        };
+        SIM_LOG(INFO) << "reads " << (coalesce ? "with" : "without")
+                      << " coalescing: messages/read="
+                      << static_cast<double>(n_messages() - n_messages_before)
+                             / n_total
+                      << ", shared lookups="
+                      << ratio(
+                             lookups.n_shared() - n_shared_lookups_before,
+                             lookups.n_calls() - n_lookups_before)
+                      << "%, shared reads="
+                      << ratio(
+                             values.n_shared() - n_shared_values_before,
+                             values.n_calls() - n_values_before)
+                      << "%, failed reads=" << n_failed << "/" << n_reads
+                      << ", reads/s=" << n_total / elapsed.count();
+    }
+    node.set_coalescing(true);
+    node.set_rpc_delay(std::chrono::microseconds(0));
+}
+
+/** Compare the value caching policies on hot reads.
+ *
+ * `n_clients` nodes perform `n_reads` reads of files chosen with a Zipf
+ * distribution of exponent `zipf_s`, each node caching up to `budget` bytes
+ * of the values it reads. The same reads are replayed with a plain LRU cache
+ * (which admits every value, as the Kademlia caching along the lookup path)
+ * and with TinyLFU admission.
+ */
+void Network::bench_value_cache(
+    uint32_t n_reads,
+    double zipf_s,
+    uint32_t n_clients,
+    uint64_t budget)
+{
+    if (files.empty()) {
+        SIM_LOG(ERROR) << "no file to read";
+        return;
+    }
+    std::vector<Node<NodeLocalCom>*> clients;
+    for (uint32_t i = 0; i < n_clients; ++i) {
+        clients.push_back(&rand_online_node());
+    }
+    // The same node may be drawn several times.
+    std::sort(clients.begin(), clients.end());
+    clients.erase(std::unique(clients.begin(), clients.end()), clients.end());
+
+    std::discrete_distribution<size_t> zipf(
+        zipf_distribution(files.size(), zipf_s));
+    std::uniform_int_distribution<size_t> rand_client(0, clients.size() - 1);
+    std::vector<std::pair<Node<NodeLocalCom>*, UInt160>> reads;
+    for (uint32_t i = 0; i < n_reads; ++i) {
+        reads.emplace_back(clients[rand_client(prng())], files[zipf(prng())]);
+    }
+
+    for (const CachePolicy policy : {CachePolicy::LRU, CachePolicy::TINY_LFU}) {
+        for (auto* client : clients) {
+            client->value_cache() = ValueCache(budget, policy);
+        }
+        uint64_t n_messages = 0;
+        uint32_t n_failed = 0;
+
+        for (const auto& read : reads) {
+            Node<NodeLocalCom>& client = *read.first;
+
+            for (const auto& key : lookup_keys(read.second)) {
+                const uint64_t before = client.lookup_stats().n_messages;
+                Buffer value;
+
+                if (!client.read_value(key, value)) {
+                    ++n_failed;
+                }
+                n_messages += client.lookup_stats().n_messages - before;
+            }
+        }
+
+        ValueCacheStats total{0, 0, 0, 0, 0};
+        for (auto* client : clients) {
+            const ValueCacheStats& stats = client->value_cache().stats();
+
+            total.n_hits += stats.n_hits;
+            total.n_misses += stats.n_misses;
+            total.n_admitted += stats.n_admitted;
+            total.n_rejected += stats.n_rejected;
+            total.n_evicted += stats.n_evicted;
+        }
+        const uint64_t n_gets = total.n_hits + total.n_misses;
+        SIM_LOG(INFO) << (policy == CachePolicy::LRU ? "LRU" : "TinyLFU")
+                      << " value cache: hit rate="
+                      << (n_gets == 0 ? 0.0
+                                      : 100.0 * static_cast<double>(
+                                                    total.n_hits)
+                                            / static_cast<double>(n_gets))
+                      << "%, lookup messages/read="
+                      << static_cast<double>(n_messages) / n_reads
+                      << ", admitted=" << total.n_admitted
+                      << ", rejected=" << total.n_rejected
+                      << ", evicted=" << total.n_evicted
+                      << ", failed reads=" << n_failed;
+    }
+}
+
+/** Measure the load of the nodes serving the reads, with and without the
+ * popularity replication.
+ *
+ * At each of the `n_steps` steps (one tick of the node clocks), random
+ * nodes perform `n_reads` value lookups of files chosen with a Zipf
+ * distribution of exponent `zipf_s`. The reads are performed without extra
+ * replicas, then with the popularity replication (see `Conf::hot_threshold`)
+ * and finally with uniform reads, to let the extra replicas age out.
+ */
+void Network::bench_hot_keys(
+    uint32_t n_steps,
+    uint32_t n_reads,
+    double zipf_s,
+    uint32_t threshold,
+    uint32_t n_replicas,
+    uint32_t lifetime)
+{
+    if (files.empty()) {
+        SIM_LOG(ERROR) << "no file to read";
+        return;
+    }
+
+    struct Phase {
+        const char* name;
+        uint32_t threshold;
+        double zipf_s;
+    };
+    for (const Phase& phase : {Phase{"no replication", 0, zipf_s},
+                               Phase{"popularity replication", threshold,
+                                     zipf_s},
+                               Phase{"cooling down", threshold, 0.0}}) {
+        std::discrete_distribution<size_t> zipf(
+            zipf_distribution(files.size(), phase.zipf_s));
+        std::vector<uint64_t> served_before;
+        uint64_t n_messages = 0;
+        uint64_t n_pushed = 0;
+        uint32_t n_failed = 0;
+
+        for (auto& node : nodes) {
+            node->set_hot_replication(phase.threshold, n_replicas, lifetime);
+            served_before.push_back(node->replication_stats().n_served);
+            n_pushed -= node->replication_stats().n_pushed;
+        }
+        for (uint32_t step = 0; step < n_steps; ++step) {
+            for (uint32_t i = 0; i < n_reads; ++i) {
+                Node<NodeLocalCom>& client = rand_online_node();
+                const uint64_t before = client.lookup_stats().n_messages;
+
+                for (const auto& key : lookup_keys(files[zipf(prng())])) {
+                    Buffer value;
+
+                    if (!client.value_lookup(key, value)) {
+                        ++n_failed;
+                    }
+                }
+                n_messages += client.lookup_stats().n_messages - before;
+            }
+            for (auto& node : nodes) {
+                if (node->is_online()) {
+                    node->tick();
+                }
+            }
+        }
+
+        std::vector<double> loads;
+        uint64_t n_extra = 0;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            n_pushed += nodes[i]->replication_stats().n_pushed;
+            if (nodes[i]->is_online()) {
+                loads.push_back(static_cast<double>(
+                    nodes[i]->replication_stats().n_served
+                    - served_before[i]));
+                n_extra += nodes[i]->n_extra_replicas();
+            }
+        }
+        double total = 0.0;
+        for (const double load : loads) {
+            total += load;
+        }
+        const double mean = total / static_cast<double>(loads.size());
+        const double max = *std::max_element(loads.begin(), loads.end());
+        const auto n_total = static_cast<double>(n_steps) * n_reads;
+
+        SIM_LOG(INFO) << phase.name << ": load max/mean="
+                      << (mean == 0.0 ? 0.0 : max / mean)
+                      << ", Gini=" << gini(loads) << ", messages/read="
+                      << static_cast<double>(n_messages) / n_total
+                      << ", replicas pushed=" << n_pushed
+                      << ", extra replicas=" << n_extra
+                      << ", failed reads=" << n_failed;
+    }
+    for (auto& node : nodes) {
+        node->set_hot_replication(
+            conf->hot_threshold, conf->hot_replicas, conf->hot_lifetime);
     }
 }
 
@@ -32,12 +32,22 @@
 
 #include <cstdint>
 #include <map>
+#include <memory>
 #include <ostream>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include "buffer.h"
 #include "dcss_node.h"
 #include "dcss_node_com.h"
+#include "erasure_code.h"
+#include "latency_model.h"
+#include "parallel_fetch.h"
+#include "repair.h"
+#include "rpc_load.h"
 #include "uint160.h"
 
 namespace dcss {
@@ -60,7 +70,7 @@ class Network {
     void initialize_nodes(
         uint32_t n_initial_conn,
         std::vector<std::string> bstraplist);
-    void initialize_files(uint32_t n_files);
+    void initialize_files(uint32_t n_files, uint32_t file_size);
     void rand_node(tnode_callback_func cb_func, void* cb_arg);
     void rand_key(tkey_callback_func cb_func, void* cb_arg);
     Node<NodeLocalCom>* lookup_cheat(const std::string& id) const;
@@ -68,14 +78,172 @@ class Network {
     void save(std::ostream& fout);
     void graphviz(std::ostream& fout);
     void check_files();
+    void fail_nodes(double rate);
+    void report_durability();
+    void bench_pipeline(
+        uint64_t file_size,
+        uint32_t max_threads,
+        uint32_t max_in_flight,
+        uint64_t stripe_size);
+    void set_latency_model(const LatencyModel& model);
+    void bench_reads(uint32_t n_reads, uint32_t n_extra);
+    RepairStats repair(
+        uint64_t bandwidth,
+        uint32_t scan_batch,
+        uint32_t max_ticks,
+        uint32_t n_reads);
+    void churn(uint32_t n_steps, double rate, uint32_t n_lookups);
+    void bench_routing(uint32_t n_lookups, bool self_lookups);
+    void bench_lookups(uint32_t n_keys, uint32_t batch_size);
+    void bench_hot_reads(uint32_t n_clients, uint32_t n_reads, double zipf_s);
+    void bench_lookup_cache(
+        uint32_t n_steps,
+        double rate,
+        uint32_t n_lookups,
+        uint32_t n_clients,
+        uint32_t n_keys);
+    void bench_value_cache(
+        uint32_t n_reads,
+        double zipf_s,
+        uint32_t n_clients,
+        uint64_t budget);
+    void bench_hot_keys(
+        uint32_t n_steps,
+        uint32_t n_reads,
+        double zipf_s,
+        uint32_t threshold,
+        uint32_t n_replicas,
+        uint32_t lifetime);
+    void report_load(uint32_t top_n) const;
+    void report_txs() const;
+    void report_channels() const;
+    void provision_accounts();
+    void buy_file_storage(
+        Node<NodeLocalCom>& node,
+        const UInt160& key,
+        uint64_t nb_bytes,
+        bool batched);
+
+    /** Return the load of the nodes (recorded by `NodeLocalCom`). */
+    inline RpcLoad& rpc_load() const
+    {
+        return rpc_counters;
+    }
 
   private:
+    /** Measures of a set of lookups. */
+    struct LookupSamples {
+        /** Number of rounds of each lookup. */
+        std::vector<double> hops;
+        /** Number of FIND_NODE sent. */
+        uint64_t n_queries;
+        /** Number of FIND_NODE sent to offline nodes. */
+        uint64_t n_unresponsive;
+        /** Number of lookups that found the closest online node. */
+        uint64_t n_exact;
+        /** Number of lookups ended by an authoritative answer. */
+        uint64_t n_authoritative;
+    };
+    void sample_lookups(uint32_t n_lookups, LookupSamples& samples);
+    void sample_lookup(
+        Node<NodeLocalCom>& node,
+        const UInt160& key,
+        LookupSamples& samples);
+    uint64_t churn_step(size_t n_churn);
+    void report_lookups(LookupSamples& samples);
+    bool is_closest(
+        const std::vector<dht::NodeAddress>& found,
+        const UInt160& key,
+        const Node<NodeLocalCom>& node) const;
+    dht::GossipStats gossip_totals() const;
+    void report_gossip(const dht::GossipStats& total, uint32_t n_steps);
+
+    Node<NodeLocalCom>& rand_online_node();
+    Node<NodeLocalCom>& join_node();
+    void announce(Node<NodeLocalCom>& node);
+    std::vector<UInt160> lookup_keys(const UInt160& key) const;
+    std::vector<std::vector<dht::NodeAddress>> lookup_all(
+        Node<NodeLocalCom>& node,
+        const std::vector<UInt160>& keys,
+        bool batched);
+    void store_replicated(
+        Node<NodeLocalCom>& node,
+        const UInt160& key,
+        const Buffer& payload,
+        const std::vector<dht::NodeAddress>& holders);
+    void store_encoded(
+        Node<NodeLocalCom>& node,
+        const UInt160& key,
+        const Buffer& payload,
+        const std::vector<std::vector<dht::NodeAddress>>& holders);
+    std::vector<FetchTarget> fetch_targets(
+        const UInt160& key,
+        const std::vector<std::vector<dht::NodeAddress>>& holders) const;
+    FetchResult fetch_file(
+        Node<NodeLocalCom>& node,
+        const UInt160& key,
+        const std::vector<std::vector<dht::NodeAddress>>& holders,
+        uint32_t n_extra,
+        const LatencyFunc& latency);
+    bool read_file(
+        Node<NodeLocalCom>& node,
+        const UInt160& key,
+        const std::vector<std::vector<dht::NodeAddress>>& holders);
+
+    /** State of the pieces (replicas or fragments) of a file. */
+    struct FileProbe {
+        /** Number of pieces still available. */
+        uint32_t n_available;
+        /** Some available pieces (enough to regenerate the missing ones). */
+        std::vector<Buffer> values;
+        /** Missing pieces: key of the piece and node that should hold it. */
+        std::vector<std::pair<UInt160, dht::NodeAddress>> missing;
+    };
+    FileProbe probe_file(
+        Node<NodeLocalCom>& node,
+        const UInt160& file,
+        uint64_t& n_messages);
+    RepairTask make_repair_task(const UInt160& file, const FileProbe& probe);
+    uint64_t repair_file(
+        Node<NodeLocalCom>& node,
+        const UInt160& file,
+        uint64_t& n_messages);
+
+    /** Replicas of a key found missing by a key exchange. */
+    struct ReplicaGap {
+        /** Node holding the key, which copies it to the others. */
+        Node<NodeLocalCom>* source;
+        /** Number of replicas found. */
+        uint32_t n_available;
+        /** Nodes that should hold the key, but don't. */
+        std::vector<dht::NodeAddress> lacking;
+    };
+    std::vector<dht::NodeAddress> replica_neighbors(
+        Node<NodeLocalCom>& node,
+        const UInt160& key,
+        const std::unordered_set<UInt160>& dead);
+    std::unordered_map<UInt160, ReplicaGap>
+    exchange_keys(Node<NodeLocalCom>& node, uint64_t& n_messages);
+    uint64_t repair_replicas(
+        const UInt160& key,
+        const ReplicaGap& gap,
+        uint64_t& n_messages);
+    void count_damage(uint32_t& n_degraded, uint32_t& n_lost) const;
+
     const Conf* const conf;
+    /** Codec used to store the files (replication is used if null). */
+    std::unique_ptr<ErasureCode> codec;
+    /** Total size of the stored files (before replication/encoding). */
+    uint64_t files_bytes;
+    /** Latency/loss of the RPCs, for the read benchmarks. */
+    LatencyModel latency_model;
 
     std::vector<std::unique_ptr<Node<NodeLocalCom>>> nodes;
     // Nothing to free: memory is owned by `nodes`.
     std::map<std::string, Node<NodeLocalCom>*> nodes_map;
     std::vector<UInt160> files;
+    /** RPCs served by each node. */
+    mutable RpcLoad rpc_counters;
 };
 
 } // namespace dcss
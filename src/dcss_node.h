@@ -30,12 +30,20 @@
 #ifndef __DCSS_NODE_H__
 #define __DCSS_NODE_H__
 
+#include <chrono>
 #include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <jsonrpccpp/client/connectors/httpclient.h>
 
+#include "buffer.h"
 #include "dht/dht.h"
+#include "single_flight.h"
+#include "tx_manager.h"
 
 class NodeClient;
 
@@ -51,6 +59,11 @@ class UInt160;
 template <typename NodeCom>
 class Node : public dht::Node<NodeCom> {
   public:
+    /** Lookups in flight, indexed by target. */
+    using LookupFlight = SingleFlight<UInt160, std::vector<dht::NodeAddress>>;
+    /** FIND_VALUE in flight, indexed by key. */
+    using ReadFlight = SingleFlight<UInt160, Buffer>;
+
     Node(
         const Conf& configuration,
         const dht::NodeAddress& addr,
@@ -62,27 +75,137 @@ class Node : public dht::Node<NodeCom> {
     Node(Node&&) = delete;
     Node& operator=(Node&& x) = delete;
 
+    static void provision_accounts(
+        const Conf& configuration,
+        const std::vector<Node*>& nodes);
+
     const std::string& get_eth_account() const;
+    /** Return true once the account is created and unlocked. */
+    bool is_account_ready() const
+    {
+        return m_account_ready;
+    }
     void show();
     void set_verbose(bool enable);
+    bool is_online() const;
+    void set_online(bool online);
     void save(std::ostream& fout);
     const std::vector<UInt160>& files() const;
     void graphviz(std::ostream& fout);
 
-    void buy_storage(const std::string& seller, uint64_t nb_bytes);
-    void put_bytes(const std::string& seller, uint64_t nb_bytes);
-    void get_bytes(const std::string& seller, uint64_t nb_bytes);
+    /** Buy storage from `seller`, without waiting for the transaction: the
+     * future is set once it is mined.
+     */
+    std::future<TxReceipt>
+    buy_storage(const std::string& seller, uint64_t nb_bytes);
+    /** Buy `nb_bytes[i]` bytes of storage from each `sellers[i]`, in a
+     * single transaction.
+     */
+    std::future<TxReceipt> buy_storage(
+        const std::vector<std::string>& sellers,
+        const std::vector<uint64_t>& nb_bytes);
+    /** Pay `seller` for `nb_bytes` put: through the channel to `seller`,
+     * if any (the future is then set at once), or else by a transaction.
+     */
+    std::future<TxReceipt>
+    put_bytes(const std::string& seller, uint64_t nb_bytes);
+    /** Pay `seller` for `nb_bytes` got, like `put_bytes`. */
+    std::future<TxReceipt>
+    get_bytes(const std::string& seller, uint64_t nb_bytes);
+
+    /** Open a payment channel to `seller`, escrowing `deposit` tokens: once
+     * mined, the puts and gets are paid off-chain at `put_price` and
+     * `get_price` (the current prices of `seller`), until it is closed or
+     * the deposit is spent.
+     */
+    std::future<TxReceipt> open_channel(
+        const std::string& seller,
+        uint64_t deposit,
+        uint64_t put_price,
+        uint64_t get_price);
+    /** Close the channel from `buyer`, redeeming its last voucher: it is
+     * open again if the transaction fails.
+     */
+    std::future<TxReceipt> settle_channel(const std::string& buyer);
+    /** Close the channel to `seller` (once expired) without paying it. */
+    std::future<TxReceipt> dispute_channel(const std::string& seller);
+
+    using dht::Node<NodeCom>::node_lookup;
+
+    /** Return the k closest nodes to `target_id` (see `dht::Node`), joining
+     * the lookup of the same target in flight, if any.
+     *
+     * Unlike the other methods, the lookups and reads can be called from
+     * several threads (they are serialized on the node).
+     */
+    std::vector<dht::NodeAddress> node_lookup(const UInt160& target_id);
+
+    /** Read the value stored under `key` (see `dht::Node`), joining the read
+     * of the same key in flight, if any.
+     */
+    bool read_value(const UInt160& key, Buffer& value);
+
+    /** Coalesce the concurrent lookups and reads (the default), or not. */
+    void set_coalescing(bool enable);
+
+    /** Make each RPC of the lookups and reads last `rtt` (slept with the
+     * node unlocked, so that the concurrent calls overlap), to simulate
+     * their latency.
+     */
+    void set_rpc_delay(std::chrono::microseconds rtt);
+
+    /** Return the lookups in flight, joined by the concurrent lookups of
+     * the same target.
+     */
+    LookupFlight& lookups_in_flight()
+    {
+        return m_lookups_in_flight;
+    }
+
+    /** Return the reads in flight, joined by the concurrent reads of the
+     * same key.
+     */
+    ReadFlight& reads_in_flight()
+    {
+        return m_reads_in_flight;
+    }
 
   private:
     void on_store(const dht::Entry& entry) override;
+    void on_erase(const dht::Entry& entry) override;
+    /** Read the value of `key`, without joining another read. */
+    bool fetch_value(const UInt160& key, Buffer& value);
+    /** Sleep for `n_rpcs` simulated RPCs (see `set_rpc_delay`). */
+    void wait_rpcs(uint64_t n_rpcs) const;
+    /** Get the account ready, if not yet: return false on failure. */
+    bool provision_account();
+    /** Pay through the channel to `seller`, by signing a new voucher. */
+    std::future<TxReceipt> pay_through_channel(
+        const std::string& seller,
+        uint64_t put_bytes,
+        uint64_t get_bytes);
+    /** Return what to do once the transaction closing the channel `id` is
+     * mined: forget it, or open it again on failure.
+     */
+    std::function<void(bool)> close_channel_when_mined(const std::string& id);
 
     const Conf* const conf;
 
     bool verbose;
+    bool m_online;
 
     std::vector<UInt160> m_file_keys;
+    /** Serializes the lookups and reads (see `node_lookup`). */
+    std::mutex m_mutex;
+    bool m_coalescing;
+    std::chrono::microseconds m_rpc_delay;
+    // After the above: they wait for the lookups and reads running.
+    LookupFlight m_lookups_in_flight;
+    ReadFlight m_reads_in_flight;
     std::string eth_passphrase;
     std::string eth_account;
+    /** True once the account is created and unlocked. */
+    bool m_account_ready;
     jsonrpc::HttpClient* httpclient;
     NodeClient* nodec;
 };
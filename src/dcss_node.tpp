@@ -27,15 +27,28 @@
  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  * POSSIBILITY OF SUCH DAMAGE.
  */
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
-#include <iomanip>
+#include <exception>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <memory>
-#include <sstream>
-
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "abi.h"
 #include "dcss_conf.h"
+#include "exceptions.h"
+#include "geth_batch.h"
 #include "nodeclient.h"
+#include "payment_channel.h"
 #include "uint160.h"
 
 namespace dcss {
@@ -43,11 +56,56 @@ namespace dcss {
 // Address of the DCSS contract on the blockchain.
 #define DCSS_CONTRACT_ADDR "0x5e667a8D97fBDb2D3923a55b295DcB8f5985FB79"
 
-static inline void call_contract(
-    GethClient& geth,
+// Number of blocks after which the buyer can get the deposit of a channel
+// back, if the seller didn't settle it (about a day).
+#define DCSS_CHANNEL_DURATION 5760
+
+// The functions of the DCSS contract (see contracts/QuadIron.sol): their
+// selectors are computed at compile time.
+namespace contract {
+
+constexpr abi::Function<abi::Address, abi::Address, abi::Uint256>
+    BUY_STORAGE("buyStorage(address,address,uint256)");
+constexpr abi::
+    Function<abi::Address, abi::Array<abi::Address>, abi::Array<abi::Uint256>>
+        BUY_STORAGE_BATCH("buyStorageBatch(address,address[],uint256[])");
+constexpr abi::Function<abi::Address, abi::Address, abi::Uint256>
+    BUYER_PUT_BYTES("buyerPutBytes(address,address,uint256)");
+constexpr abi::Function<abi::Address, abi::Address, abi::Uint256>
+    BUYER_GET_BYTES("buyerGetBytes(address,address,uint256)");
+constexpr abi::Function<
+    abi::Bytes32,
+    abi::Address,
+    abi::Uint256,
+    abi::Uint256,
+    abi::Uint256,
+    abi::Uint256>
+    OPEN_CHANNEL(
+        "openChannel(bytes32,address,uint256,uint256,uint256,uint256)");
+constexpr abi::Function<
+    abi::Bytes32,
+    abi::Uint256,
+    abi::Uint256,
+    abi::Uint8,
+    abi::Bytes32,
+    abi::Bytes32>
+    SETTLE_CHANNEL(
+        "settleChannel(bytes32,uint256,uint256,uint8,bytes32,bytes32)");
+constexpr abi::Function<abi::Bytes32>
+    DISPUTE_CHANNEL("disputeChannel(bytes32)");
+
+} // namespace contract
+
+// Submit a transaction calling the contract, without waiting for it to be
+// mined: the outcome is logged, passed to `mined` (true if the transaction
+// succeeded) and returned through the future.
+static inline std::future<TxReceipt> call_contract(
+    TxManager& txs,
     const std::string& node_addr,
     const std::string& contract_addr,
-    const std::string& payload)
+    const std::string& payload,
+    const std::string& what,
+    std::function<void(bool)> mined = nullptr)
 {
     Json::Value params;
 
@@ -55,53 +113,73 @@ static inline void call_contract(
     params["to"] = contract_addr;
     params["data"] = payload;
 
-    const std::string tx_hash = geth.eth_sendTransaction(params);
-    ETH_LOG(TRACE) << "tx_hash=" << tx_hash;
-
-    // FIXME: busy wait is ugly.
-    while (true) {
-        try {
-            const Json::Value receipt = geth.eth_getTransactionReceipt(tx_hash);
-            ETH_LOG(TRACE) << "tx_receipt=" << receipt.toStyledString();
-
-            // TODO: we should probably return a bool to the caller, or raise…
-            if (receipt["status"] == "0x0") {
-                ETH_LOG(WARNING) << "transaction " << tx_hash << " failed";
+    auto done = std::make_shared<std::promise<TxReceipt>>();
+    std::future<TxReceipt> result = done->get_future();
+
+    txs.submit(
+        params,
+        [done, what, mined](
+            const TxReceipt& receipt, std::exception_ptr error) {
+            if (error) {
+                try {
+                    std::rethrow_exception(error);
+                } catch (std::exception& exn) {
+                    ETH_LOG(ERROR) << "cannot " << what << ": " << exn.what();
+                }
+                if (mined) {
+                    mined(false);
+                }
+                done->set_exception(error);
+                return;
+            }
+            if (receipt.success) {
+                ETH_LOG(TRACE) << "transaction " << receipt.hash
+                               << " successed: status="
+                               << receipt.receipt["status"];
             } else {
-              ETH_LOG(TRACE) << "transaction " << tx_hash
-                             << " successed: status=" << receipt["status"];
+                ETH_LOG(WARNING) << "transaction " << receipt.hash
+                                 << " failed (" << what << ')';
             }
-            return;
-        } catch (jsonrpc::JsonRpcException& exn) {
-            if (exn.GetCode() == -32000) {
-                continue; // Transaction is pending…
+            if (mined) {
+                mined(receipt.success);
             }
-            ETH_LOG(ERROR) << exn.what();
-            throw;
-        }
-    }
+            done->set_value(receipt);
+        });
+    return result;
 }
 
-// Encode an integer as an uint256 according to the Ethereum Contract ABI.
-// See https://github.com/ethereum/wiki/wiki/Ethereum-Contract-ABI:
-//
-// > uint<M>: enc(X) is the big-endian encoding of X, padded on the
-// > higher-order (left) side with zero-bytes such that the length is a
-// > multiple of 32 bytes.
-static inline std::string encode_uint256(uint64_t v)
+// Return the outcome of a contract call that couldn't be submitted.
+static inline std::future<TxReceipt> failed_contract_call(
+    const std::string& reason)
 {
-    std::ostringstream oss;
-    oss << std::setfill('0') << std::setw(64) << std::hex << v;
-    return oss.str();
+    std::promise<TxReceipt> failed;
+
+    ETH_LOG(ERROR) << "cannot call the contract: " << reason;
+    failed.set_exception(std::make_exception_ptr(DomainError(reason)));
+    return failed.get_future();
 }
 
-// Address are encoded as uint160.
-static inline std::string encode_address(const std::string& addr)
+// Split a signature returned by `eth_sign` (r, s and v) into the arguments
+// of `ecrecover`: throw a DomainError if it is not 65 hex-encoded bytes.
+static inline void split_signature(
+    const std::string& signature,
+    uint8_t& v,
+    std::string& r,
+    std::string& s)
 {
-    std::ostringstream oss;
-    // Skip the leading 0x, pad for 160 bytes.
-    oss << std::setfill('0') << std::setw(40) << addr.substr(2);
-    return oss.str();
+    if (signature.size() != 2 + 130 || signature.compare(0, 2, "0x") != 0
+        || signature.find_first_not_of("0123456789abcdefABCDEF", 2)
+               != std::string::npos) {
+        throw DomainError("invalid signature: " + signature);
+    }
+
+    r = "0x" + signature.substr(2, 64);
+    s = "0x" + signature.substr(66, 64);
+    v = static_cast<uint8_t>(std::stoul(signature.substr(130), nullptr, 16));
+    // Some clients return the recovery ID (0 or 1) instead.
+    if (v < 27) {
+        v = static_cast<uint8_t>(v + 27);
+    }
 }
 
 // NOLINTNEXTLINE(hicpp-member-init)  (because of FIXME)
@@ -110,6 +188,7 @@ Node<NodeCom>::Node(const Conf& configuration, const dht::NodeAddress& addr, con
   : dht::Node<NodeCom>(addr, configuration, com_iface), conf(&configuration)
 {
     verbose = false;
+    m_online = true;
     // FIXME: to be reworked.
 #if 0
     if (addr.ip() != "127.0.0.1") {
@@ -119,16 +198,118 @@ Node<NodeCom>::Node(const Conf& configuration, const dht::NodeAddress& addr, con
     }
 #endif
 
-    // The passphrase of the account is the hex of the node ID.
+    // The passphrase of the account is the hex of the node ID. The account
+    // is reused if cached, it is created (and unlocked) on first use.
     this->eth_passphrase = this->id().to_string();
-    try {
-        this->eth_account = conf->geth.personal_newAccount(eth_passphrase);
-        conf->geth.personal_unlockAccount(eth_account, eth_passphrase, 0);
-    } catch (jsonrpc::JsonRpcException&) {
-        this->eth_account = "";
+    this->eth_account = conf->accounts.find(this->id());
+    m_account_ready = false;
+    m_coalescing = true;
+    m_rpc_delay = std::chrono::microseconds(0);
+}
+
+/** Get the Ethereum accounts of the nodes ready: create the missing ones
+ * (recorded in the account cache), then unlock them.
+ *
+ * The calls to geth are sent in batches: a round trip per thousand nodes,
+ * instead of one or two per node. A cached account that geth cannot unlock
+ * (unknown to it, or locked by another passphrase) is replaced by a new
+ * one. The accounts that fail otherwise are retried on the next call.
+ */
+template <typename NodeCom>
+void Node<NodeCom>::provision_accounts(
+    const Conf& configuration,
+    const std::vector<Node*>& nodes)
+{
+    // Serialize the provisionings (the nodes' account state).
+    static std::mutex provisioning;
+    std::lock_guard<std::mutex> lock(provisioning);
+    std::vector<Node*> pending(nodes);
+
+    // A second round creates the accounts replacing the stale ones.
+    while (!pending.empty()) {
+        GethBatch accounts(configuration.geth);
+        GethBatch unlocks(configuration.geth);
+        std::vector<Node*> created;
+        std::vector<Node*> locked;
+        std::vector<Node*> stale;
+
+        for (Node* node : pending) {
+            if (!node->m_account_ready && node->eth_account.empty()) {
+                Json::Value params;
+                params.append(node->eth_passphrase);
+                accounts.add("personal_newAccount", params);
+                created.push_back(node);
+            }
+        }
+        bool all_sent = true;
+        try {
+            accounts.send();
+        } catch (jsonrpc::JsonRpcException& exn) {
+            ETH_LOG(ERROR) << "cannot create the accounts: " << exn.what();
+            all_sent = false;
+        }
+        // Even if a later batch failed: these accounts exist now.
+        for (size_t i = 0; i < created.size() && accounts.sent(i); ++i) {
+            if (accounts.error_code(i) == 0 && accounts.result(i).isString()) {
+                created[i]->eth_account = accounts.result(i).asString();
+                configuration.accounts.insert(
+                    created[i]->id(), created[i]->eth_account);
+            }
+        }
+        if (!all_sent) {
+            return;
+        }
+        const std::unordered_set<const Node*> fresh(
+            created.begin(), created.end());
+
+        for (Node* node : pending) {
+            if (!node->m_account_ready && !node->eth_account.empty()) {
+                Json::Value params;
+                params.append(node->eth_account);
+                params.append(node->eth_passphrase);
+                params.append(0);
+                unlocks.add("personal_unlockAccount", params);
+                locked.push_back(node);
+            }
+        }
+        all_sent = true;
+        try {
+            unlocks.send();
+        } catch (jsonrpc::JsonRpcException& exn) {
+            ETH_LOG(ERROR) << "cannot unlock the accounts: " << exn.what();
+            all_sent = false;
+        }
+        for (size_t i = 0; i < locked.size() && unlocks.sent(i); ++i) {
+            Node* node = locked[i];
+
+            if (unlocks.error_code(i) == 0) {
+                node->m_account_ready = unlocks.result(i).asBool();
+            } else if (fresh.count(node) == 0) {
+                ETH_LOG(WARNING) << "cached account " << node->eth_account
+                                 << " of " << node->id()
+                                 << " cannot be unlocked (error "
+                                 << unlocks.error_code(i) << "), replaced";
+                configuration.accounts.erase(node->id());
+                node->eth_account.clear();
+                stale.push_back(node);
+            }
+        }
+        if (!all_sent) {
+            return;
+        }
+        pending.swap(stale);
     }
 }
 
+template <typename NodeCom>
+bool Node<NodeCom>::provision_account()
+{
+    if (!m_account_ready) {
+        provision_accounts(*conf, {this});
+    }
+    return m_account_ready;
+}
+
 template <typename NodeCom>
 const std::string& Node<NodeCom>::get_eth_account() const
 {
@@ -162,6 +343,127 @@ void Node<NodeCom>::on_store(const dht::Entry& entry)
     m_file_keys.push_back(entry.key());
 }
 
+template <typename NodeCom>
+void Node<NodeCom>::on_erase(const dht::Entry& entry)
+{
+    const auto it =
+        std::find(m_file_keys.begin(), m_file_keys.end(), entry.key());
+    if (it != m_file_keys.end()) {
+        m_file_keys.erase(it);
+    }
+}
+
+template <typename NodeCom>
+std::vector<dht::NodeAddress> Node<NodeCom>::node_lookup(const UInt160& target_id)
+{
+    // By value: a lookup outlives its caller if it is joined.
+    const auto lookup = [this, target_id](const LookupFlight::AbandonedFunc&) {
+        std::vector<dht::NodeAddress> nodes;
+        uint64_t n_rounds = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const uint64_t before = this->lookup_stats().n_rounds;
+
+            nodes = dht::Node<NodeCom>::node_lookup(target_id);
+            n_rounds = this->lookup_stats().n_rounds - before;
+        }
+        wait_rpcs(n_rounds);
+        return nodes;
+    };
+
+    if (!m_coalescing) {
+        return lookup(LookupFlight::AbandonedFunc());
+    }
+    return m_lookups_in_flight.run(target_id, lookup);
+}
+
+template <typename NodeCom>
+bool Node<NodeCom>::read_value(const UInt160& key, Buffer& value)
+{
+    if (!m_coalescing) {
+        return fetch_value(key, value);
+    }
+    try {
+        value = m_reads_in_flight.run(
+            key, [this, key](const ReadFlight::AbandonedFunc&) {
+                Buffer found;
+                if (!fetch_value(key, found)) {
+                    throw DomainError("value not found");
+                }
+                return found;
+            });
+    } catch (const DomainError&) {
+        return false;
+    }
+    return true;
+}
+
+// Like `dht::Node::read_value`, but the node is unlocked between the RPCs
+// and the lookup may be joined.
+template <typename NodeCom>
+bool Node<NodeCom>::fetch_value(const UInt160& key, Buffer& value)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (this->find_value(key, value)
+            || this->value_cache().get(key, value)) {
+            return true;
+        }
+    }
+    // The popular values are looked up along their replicas.
+    if (this->hot_replication()) {
+        bool found = false;
+        uint64_t n_rounds = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const uint64_t before = this->lookup_stats().n_rounds;
+
+            found = dht::Node<NodeCom>::read_value(key, value);
+            n_rounds = this->lookup_stats().n_rounds - before;
+        }
+        wait_rpcs(n_rounds);
+        return found;
+    }
+
+    for (const auto& holder : node_lookup(key)) {
+        bool found = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            found = this->send_find_value(holder, key, value);
+            if (found) {
+                this->value_cache().put(key, value);
+            }
+        }
+        wait_rpcs(1);
+        if (found) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename NodeCom>
+void Node<NodeCom>::set_coalescing(bool enable)
+{
+    m_coalescing = enable;
+}
+
+template <typename NodeCom>
+void Node<NodeCom>::set_rpc_delay(std::chrono::microseconds rtt)
+{
+    m_rpc_delay = rtt;
+}
+
+template <typename NodeCom>
+void Node<NodeCom>::wait_rpcs(uint64_t n_rpcs) const
+{
+    if (n_rpcs != 0 && m_rpc_delay.count() != 0) {
+        std::this_thread::sleep_for(m_rpc_delay * n_rpcs);
+    }
+}
+
 template <typename NodeCom>
 const std::vector<UInt160>& Node<NodeCom>::files() const
 {
@@ -183,11 +485,24 @@ void Node<NodeCom>::set_verbose(bool enable)
     this->verbose = enable;
 }
 
+template <typename NodeCom>
+bool Node<NodeCom>::is_online() const
+{
+    return m_online;
+}
+
+/** Simulate a node failure (or its recovery). */
+template <typename NodeCom>
+void Node<NodeCom>::set_online(bool online)
+{
+    m_online = online;
+}
+
 template <typename NodeCom>
 void Node<NodeCom>::save(std::ostream& fout)
 {
-    for (uint32_t i = 1; i < (conf->n_bits + 1); i++) {
-        const auto k_bucket = this->buckets().at(i);
+    for (size_t i = 0; i < this->buckets().size(); i++) {
+        const auto& k_bucket = this->buckets()[i];
 
         if (!k_bucket.empty()) {
             fout << "bucket " << i << "\n";
@@ -206,9 +521,7 @@ void Node<NodeCom>::save(std::ostream& fout)
 template <typename NodeCom>
 void Node<NodeCom>::graphviz(std::ostream& fout)
 {
-    for (uint32_t i = 1; i < (conf->n_bits + 1); i++) {
-        const auto k_bucket = this->buckets().at(i);
-
+    for (const auto& k_bucket : this->buckets()) {
         if (!k_bucket.empty()) {
             for (auto& node : k_bucket) {
                 fout << "node_" << this->id() << " -> node_"
@@ -220,62 +533,282 @@ void Node<NodeCom>::graphviz(std::ostream& fout)
 
 // TODO: factorize all of this
 template <typename NodeCom>
-void Node<NodeCom>::buy_storage(const std::string& seller, uint64_t nb_bytes)
+std::future<TxReceipt>
+Node<NodeCom>::buy_storage(const std::string& seller, uint64_t nb_bytes)
 {
-    // See https://github.com/ethereum/wiki/wiki/Ethereum-Contract-ABI
-    // web3.sha3("buyStorage(address,address,uint256)").substr(0, 8)
-    const std::string selector = "0x366e4d";
-    const std::string payload = selector + encode_address(eth_account)
-                                + encode_address(seller)
-                                + encode_uint256(nb_bytes);
+    if (!provision_account()) {
+        return failed_contract_call("no Ethereum account");
+    }
 
+    std::string payload;
     try {
-        ETH_LOG(INFO) << eth_account
-                      << ": buy " << nb_bytes << " bytes from " << seller;
-        call_contract(conf->geth, eth_account, DCSS_CONTRACT_ADDR, payload);
-    } catch (jsonrpc::JsonRpcException& exn) {
-        ETH_LOG(ERROR) << "cannot buy " << nb_bytes << "bytes from " << seller
-                       << ": " << exn.what() << '\n';
+        payload =
+            contract::BUY_STORAGE.encode(eth_account, seller, nb_bytes);
+    } catch (const DomainError& exn) {
+        return failed_contract_call(exn.what());
     }
+
+    ETH_LOG(INFO) << eth_account
+                  << ": buy " << nb_bytes << " bytes from " << seller;
+    return call_contract(
+        conf->txs,
+        eth_account,
+        DCSS_CONTRACT_ADDR,
+        payload,
+        "buy " + std::to_string(nb_bytes) + " bytes from " + seller);
 }
 
 template <typename NodeCom>
-void Node<NodeCom>::put_bytes(const std::string& seller, uint64_t nb_bytes)
+std::future<TxReceipt> Node<NodeCom>::buy_storage(
+    const std::vector<std::string>& sellers,
+    const std::vector<uint64_t>& nb_bytes)
 {
-    // See https://github.com/ethereum/wiki/wiki/Ethereum-Contract-ABI
-    // web3.sha3("buyerPutBytes(address,address,uint256)").substr(0, 8)
-    const std::string selector = "0xed69a0";
-    const std::string payload = selector + encode_address(eth_account)
-                                + encode_address(seller)
-                                + encode_uint256(nb_bytes);
+    if (sellers.size() != nb_bytes.size()) {
+        return failed_contract_call("as many sellers as amounts expected");
+    }
+    if (!provision_account()) {
+        return failed_contract_call("no Ethereum account");
+    }
+
+    std::string payload;
+    try {
+        payload = contract::BUY_STORAGE_BATCH.encode(
+            eth_account, sellers, nb_bytes);
+    } catch (const DomainError& exn) {
+        return failed_contract_call(exn.what());
+    }
+
+    ETH_LOG(INFO) << eth_account << ": buy storage from " << sellers.size()
+                  << " sellers";
+    return call_contract(
+        conf->txs,
+        eth_account,
+        DCSS_CONTRACT_ADDR,
+        payload,
+        "buy storage from " + std::to_string(sellers.size()) + " sellers");
+}
+
+template <typename NodeCom>
+std::future<TxReceipt>
+Node<NodeCom>::put_bytes(const std::string& seller, uint64_t nb_bytes)
+{
+    if (!provision_account()) {
+        return failed_contract_call("no Ethereum account");
+    }
+    if (conf->channels.is_open(eth_account, seller)) {
+        return pay_through_channel(seller, nb_bytes, 0);
+    }
 
+    std::string payload;
     try {
-        ETH_LOG(INFO) << eth_account
-                      << ": put " << nb_bytes << " bytes from " << seller;
-        call_contract(conf->geth, eth_account, DCSS_CONTRACT_ADDR, payload);
-    } catch (jsonrpc::JsonRpcException& exn) {
-        ETH_LOG(ERROR) << "cannot put " << nb_bytes << "bytes from " << seller
-                       << ": " << exn.what() << '\n';
+        payload =
+            contract::BUYER_PUT_BYTES.encode(eth_account, seller, nb_bytes);
+    } catch (const DomainError& exn) {
+        return failed_contract_call(exn.what());
     }
+
+    ETH_LOG(INFO) << eth_account
+                  << ": put " << nb_bytes << " bytes from " << seller;
+    return call_contract(
+        conf->txs,
+        eth_account,
+        DCSS_CONTRACT_ADDR,
+        payload,
+        "put " + std::to_string(nb_bytes) + " bytes from " + seller);
 }
 
 template <typename NodeCom>
-void Node<NodeCom>::get_bytes(const std::string& seller, uint64_t nb_bytes)
+std::future<TxReceipt>
+Node<NodeCom>::get_bytes(const std::string& seller, uint64_t nb_bytes)
 {
-    // See https://github.com/ethereum/wiki/wiki/Ethereum-Contract-ABI
-    // web3.sha3("buyerGetBytes(address,address,uint256)").substr(0, 8)
-    const std::string selector = "0xdad071";
-    const std::string payload = selector + encode_address(eth_account)
-                                + encode_address(seller)
-                                + encode_uint256(nb_bytes);
+    if (!provision_account()) {
+        return failed_contract_call("no Ethereum account");
+    }
+    if (conf->channels.is_open(eth_account, seller)) {
+        return pay_through_channel(seller, 0, nb_bytes);
+    }
 
+    std::string payload;
     try {
-        ETH_LOG(INFO) << eth_account
-                      << ": get " << nb_bytes << " bytes from " << seller;
-    } catch (jsonrpc::JsonRpcException& exn) {
-        ETH_LOG(ERROR) << "cannot get " << nb_bytes << "bytes from " << seller
-                       << ": " << exn.what() << '\n';
+        payload =
+            contract::BUYER_GET_BYTES.encode(eth_account, seller, nb_bytes);
+    } catch (const DomainError& exn) {
+        return failed_contract_call(exn.what());
     }
+
+    ETH_LOG(INFO) << eth_account
+                  << ": get " << nb_bytes << " bytes from " << seller;
+    return call_contract(
+        conf->txs,
+        eth_account,
+        DCSS_CONTRACT_ADDR,
+        payload,
+        "get " + std::to_string(nb_bytes) + " bytes from " + seller);
+}
+
+template <typename NodeCom>
+std::future<TxReceipt> Node<NodeCom>::pay_through_channel(
+    const std::string& seller,
+    uint64_t put_bytes,
+    uint64_t get_bytes)
+{
+    std::promise<TxReceipt> paid;
+
+    try {
+        const PaymentChannel channel =
+            conf->channels.pay(eth_account, seller, put_bytes, get_bytes);
+        Voucher voucher{channel.put_bytes, channel.get_bytes, ""};
+        const std::string message =
+            voucher_message(DCSS_CONTRACT_ADDR, channel.id, voucher);
+        voucher.signature = conf->geth.eth_sign(eth_account, message);
+        conf->channels.deliver(channel.id, voucher);
+
+        ETH_LOG(TRACE) << eth_account << ": " << channel.id << " pays "
+                       << voucher.put_bytes << " bytes put, "
+                       << voucher.get_bytes << " bytes got";
+        // Nothing to mine.
+        paid.set_value(TxReceipt{"", true, Json::Value()});
+    } catch (std::exception& exn) {
+        ETH_LOG(ERROR) << "cannot pay " << seller << " through a channel: "
+                       << exn.what();
+        paid.set_exception(std::current_exception());
+    }
+    return paid.get_future();
+}
+
+template <typename NodeCom>
+std::function<void(bool)>
+Node<NodeCom>::close_channel_when_mined(const std::string& id)
+{
+    PaymentChannels* channels = &conf->channels;
+
+    return [channels, id](bool success) {
+        if (success) {
+            channels->close(id);
+        } else {
+            channels->reopen(id);
+        }
+    };
+}
+
+template <typename NodeCom>
+std::future<TxReceipt>
+Node<NodeCom>::open_channel(
+    const std::string& seller,
+    uint64_t deposit,
+    uint64_t put_price,
+    uint64_t get_price)
+{
+    if (!provision_account()) {
+        return failed_contract_call("no Ethereum account");
+    }
+
+    std::string id;
+    std::string payload;
+    try {
+        id = conf->channels.open(
+            eth_account, seller, deposit, put_price, get_price);
+        payload = contract::OPEN_CHANNEL.encode(
+            id,
+            seller,
+            deposit,
+            put_price,
+            get_price,
+            DCSS_CHANNEL_DURATION);
+    } catch (const DomainError& exn) {
+        conf->channels.close(id);
+        return failed_contract_call(exn.what());
+    }
+
+    ETH_LOG(INFO) << eth_account << ": open " << id << " to " << seller
+                  << " with " << deposit << " tokens";
+    PaymentChannels* channels = &conf->channels;
+    return call_contract(
+        conf->txs,
+        eth_account,
+        DCSS_CONTRACT_ADDR,
+        payload,
+        "open a channel to " + seller,
+        [channels, id](bool success) {
+            if (success) {
+                channels->confirm(id);
+            } else {
+                channels->close(id);
+            }
+        });
+}
+
+template <typename NodeCom>
+std::future<TxReceipt>
+Node<NodeCom>::settle_channel(const std::string& buyer)
+{
+    if (!provision_account()) {
+        return failed_contract_call("no Ethereum account");
+    }
+
+    std::string payload;
+    std::string id;
+    try {
+        // No more vouchers: the last one is redeemed.
+        const PaymentChannel channel =
+            conf->channels.start_closing(buyer, eth_account);
+        id = channel.id;
+        if (channel.voucher.signature.empty()) {
+            conf->channels.reopen(id);
+            return failed_contract_call("no voucher from " + buyer);
+        }
+
+        uint8_t v = 0;
+        std::string r;
+        std::string s;
+        split_signature(channel.voucher.signature, v, r, s);
+        payload = contract::SETTLE_CHANNEL.encode(
+            id,
+            channel.voucher.put_bytes,
+            channel.voucher.get_bytes,
+            v,
+            r,
+            s);
+    } catch (const DomainError& exn) {
+        conf->channels.reopen(id);
+        return failed_contract_call(exn.what());
+    }
+
+    ETH_LOG(INFO) << eth_account << ": settle " << id << " from " << buyer;
+    return call_contract(
+        conf->txs,
+        eth_account,
+        DCSS_CONTRACT_ADDR,
+        payload,
+        "settle the channel from " + buyer,
+        close_channel_when_mined(id));
+}
+
+template <typename NodeCom>
+std::future<TxReceipt>
+Node<NodeCom>::dispute_channel(const std::string& seller)
+{
+    if (!provision_account()) {
+        return failed_contract_call("no Ethereum account");
+    }
+
+    std::string id;
+    try {
+        id = conf->channels.start_closing(eth_account, seller).id;
+    } catch (const DomainError& exn) {
+        return failed_contract_call(exn.what());
+    }
+
+    const std::string payload = contract::DISPUTE_CHANNEL.encode(id);
+
+    ETH_LOG(INFO) << eth_account << ": dispute " << id << " to " << seller;
+    return call_contract(
+        conf->txs,
+        eth_account,
+        DCSS_CONTRACT_ADDR,
+        payload,
+        "dispute the channel to " + seller,
+        close_channel_when_mined(id));
 }
 
 } // namespace dcss
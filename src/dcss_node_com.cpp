@@ -28,26 +28,186 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "dcss_file.h"
 #include "dcss_network.h"
 #include "dcss_node_com.h"
 
 namespace dcss {
 
+// Offline nodes don't answer to any RPC.
+static inline dcss::Node<NodeLocalCom>*
+online_node(const Network* network, const dht::NodeAddress& addr)
+{
+    dcss::Node<NodeLocalCom>* node =
+        network->lookup_cheat(addr.id().to_string());
+    return (node != nullptr && node->is_online()) ? node : nullptr;
+}
+
 bool NodeLocalCom::ping(const dht::NodeAddress& addr)
 {
-    (void)addr; // Unused for now, later we may implement offline node.
+    if (online_node(m_network, addr) == nullptr) {
+        return false;
+    }
+    m_network->rpc_load().record(
+        addr.id(), Rpc::PING, WIRE_KEY_SIZE, WIRE_KEY_SIZE);
     return true;
 }
 
 std::vector<dht::NodeAddress> NodeLocalCom::find_node(
     const dht::NodeAddress& addr,
     const UInt160& target_id,
-    uint32_t nb_nodes)
+    uint32_t nb_nodes,
+    bool& authoritative)
 {
-    dcss::Node<NodeLocalCom>* node =
-        m_network->lookup_cheat(addr.id().to_string());
-    return (node != nullptr) ? node->find_node(target_id, nb_nodes)
-                             : std::vector<dht::NodeAddress>();
+    dcss::Node<NodeLocalCom>* node = online_node(m_network, addr);
+
+    authoritative = false;
+    if (node == nullptr) {
+        return {};
+    }
+    std::vector<dht::NodeAddress> nodes(
+        node->find_node(target_id, nb_nodes, authoritative));
+
+    m_network->rpc_load().record(
+        addr.id(),
+        Rpc::FIND_NODE,
+        WIRE_KEY_SIZE,
+        nodes.size() * WIRE_CONTACT_SIZE);
+    return nodes;
+}
+
+bool NodeLocalCom::find_nodes(
+    const dht::NodeAddress& addr,
+    const std::vector<UInt160>& targets,
+    uint32_t nb_nodes,
+    std::vector<dht::FindNodeAnswer>& answers)
+{
+    dcss::Node<NodeLocalCom>* node = online_node(m_network, addr);
+    if (node == nullptr) {
+        return false;
+    }
+    uint64_t n_contacts = 0;
+
+    answers.clear();
+    for (const auto& target_id : targets) {
+        bool authoritative = false;
+        std::vector<dht::NodeAddress> nodes(
+            node->find_node(target_id, nb_nodes, authoritative));
+
+        n_contacts += nodes.size();
+        answers.push_back(dht::FindNodeAnswer{std::move(nodes), authoritative});
+    }
+    // A single message.
+    m_network->rpc_load().record(
+        addr.id(),
+        Rpc::FIND_NODE,
+        targets.size() * WIRE_KEY_SIZE,
+        n_contacts * WIRE_CONTACT_SIZE);
+    return true;
+}
+
+bool NodeLocalCom::store(
+    const dht::NodeAddress& addr,
+    const UInt160& key,
+    const Buffer& value)
+{
+    dcss::Node<NodeLocalCom>* node = online_node(m_network, addr);
+    if (node == nullptr) {
+        return false;
+    }
+    // Local nodes share the payload: only the reference count is updated.
+    node->store(std::make_unique<File>(key, value));
+    m_network->rpc_load().record(
+        addr.id(), Rpc::STORE, WIRE_KEY_SIZE + value.size(), 0, 1);
+    return true;
+}
+
+bool NodeLocalCom::find_value(
+    const dht::NodeAddress& addr,
+    const UInt160& key,
+    Buffer& value)
+{
+    dcss::Node<NodeLocalCom>* node = online_node(m_network, addr);
+    dht::FindValueAnswer answer;
+
+    if (node == nullptr) {
+        return false;
+    }
+    const bool found = node->serve_value(key, 0, answer);
+
+    m_network->rpc_load().record(
+        addr.id(), Rpc::FIND_VALUE, WIRE_KEY_SIZE, answer.value.size());
+    value = answer.value;
+    return found;
+}
+
+bool NodeLocalCom::find_value(
+    const dht::NodeAddress& addr,
+    const UInt160& key,
+    uint32_t nb_nodes,
+    dht::FindValueAnswer& answer)
+{
+    dcss::Node<NodeLocalCom>* node = online_node(m_network, addr);
+    if (node == nullptr) {
+        return false;
+    }
+    node->serve_value(key, nb_nodes, answer);
+    m_network->rpc_load().record(
+        addr.id(),
+        Rpc::FIND_VALUE,
+        WIRE_KEY_SIZE,
+        answer.found ? answer.value.size()
+                     : answer.nodes.size() * WIRE_CONTACT_SIZE);
+    return true;
+}
+
+bool NodeLocalCom::store_replica(
+    const dht::NodeAddress& addr,
+    const UInt160& key,
+    const Buffer& value,
+    uint32_t lifetime)
+{
+    dcss::Node<NodeLocalCom>* node = online_node(m_network, addr);
+    if (node == nullptr) {
+        return false;
+    }
+    node->store_replica(std::make_unique<File>(key, value), lifetime);
+    m_network->rpc_load().record(
+        addr.id(), Rpc::STORE, WIRE_KEY_SIZE + value.size(), 0, 1);
+    return true;
+}
+
+bool NodeLocalCom::gossip(
+    const dht::NodeAddress& addr,
+    const std::vector<dht::MemberEvent>& events)
+{
+    dcss::Node<NodeLocalCom>* node = online_node(m_network, addr);
+    if (node == nullptr) {
+        return false;
+    }
+    node->on_gossip(events);
+    // An event: the contact, and whether it joined or left.
+    m_network->rpc_load().record(
+        addr.id(), Rpc::GOSSIP, events.size() * (WIRE_CONTACT_SIZE + 1), 0);
+    return true;
+}
+
+bool NodeLocalCom::exchange_keys(
+    const dht::NodeAddress& addr,
+    const std::vector<UInt160>& keys,
+    std::vector<UInt160>& missing)
+{
+    dcss::Node<NodeLocalCom>* node = online_node(m_network, addr);
+    if (node == nullptr) {
+        return false;
+    }
+    missing = node->missing_keys(keys);
+    m_network->rpc_load().record(
+        addr.id(),
+        Rpc::KEY_EXCHANGE,
+        keys.size() * WIRE_KEY_SIZE,
+        missing.size() * WIRE_KEY_SIZE);
+    return true;
 }
 
 } // namespace dcss
@@ -46,7 +46,45 @@ class NodeLocalCom : public dht::NodeComBase {
     std::vector<dht::NodeAddress> find_node(
         const dht::NodeAddress& addr,
         const UInt160& target_id,
-        uint32_t nb_nodes) override;
+        uint32_t nb_nodes,
+        bool& authoritative) override;
+
+    bool find_nodes(
+        const dht::NodeAddress& addr,
+        const std::vector<UInt160>& targets,
+        uint32_t nb_nodes,
+        std::vector<dht::FindNodeAnswer>& answers) override;
+
+    bool store(
+        const dht::NodeAddress& addr,
+        const UInt160& key,
+        const Buffer& value) override;
+
+    bool find_value(
+        const dht::NodeAddress& addr,
+        const UInt160& key,
+        Buffer& value) override;
+
+    bool find_value(
+        const dht::NodeAddress& addr,
+        const UInt160& key,
+        uint32_t nb_nodes,
+        dht::FindValueAnswer& answer) override;
+
+    bool store_replica(
+        const dht::NodeAddress& addr,
+        const UInt160& key,
+        const Buffer& value,
+        uint32_t lifetime) override;
+
+    bool gossip(
+        const dht::NodeAddress& addr,
+        const std::vector<dht::MemberEvent>& events) override;
+
+    bool exchange_keys(
+        const dht::NodeAddress& addr,
+        const std::vector<UInt160>& keys,
+        std::vector<UInt160>& missing) override;
 
     NodeLocalCom() = delete;
     ~NodeLocalCom() override = default;
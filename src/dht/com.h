@@ -30,11 +30,46 @@
 #ifndef __DCSS_DHT_COM_H__
 #define __DCSS_DHT_COM_H__
 
+#include <vector>
+
 #include "address.h"
+#include "buffer.h"
 
 namespace dcss {
 namespace dht {
 
+/** A change of the membership, propagated by gossip. */
+struct MemberEvent {
+    /** The node that joined or left. */
+    NodeAddress addr;
+    /** True if the node joined, false if it left. */
+    bool joined;
+};
+
+/** Answer of a node to one of the targets of a multi-target FIND_NODE. */
+struct FindNodeAnswer {
+    /** The closest nodes to the target known by the queried node. */
+    std::vector<NodeAddress> nodes;
+    /** True if the queried node knows for sure the closest nodes. */
+    bool authoritative;
+};
+
+/** Answer of a node to a FIND_VALUE sent during a lookup. */
+struct FindValueAnswer {
+    /** True if the queried node has the value. */
+    bool found;
+    /** The value, if found (shared with the node, not copied). */
+    Buffer value;
+    /** The closest nodes to the key known by the queried node, if the value
+     * isn't found.
+     */
+    std::vector<NodeAddress> nodes;
+    /** True if the value is popular: the reader should replicate it on its
+     * lookup path.
+     */
+    bool hot;
+};
+
 /** Abstract class for inter-node communication. */
 class NodeComBase {
   public:
@@ -50,9 +85,12 @@ class NodeComBase {
     /** Return the `k` nodes, amongst the known nodes, closest to node
      * `target_id`.
      *
-     * @param addr      address of the node to query
-     * @param target_id the targeted node
-     * @param nb_nodes  the number of node to return
+     * @param addr          address of the node to query
+     * @param target_id     the targeted node
+     * @param nb_nodes      the number of node to return
+     * @param authoritative set to true if the queried node knows for sure
+     *                      the closest nodes (`target_id` is in the range of
+     *                      its sibling list), false otherwise.
      * @return the list of the `nb_nodes` nodes that are the closest to
      * `target_id`.
      *
@@ -62,7 +100,94 @@ class NodeComBase {
     virtual std::vector<NodeAddress> find_node(
         const NodeAddress& addr,
         const UInt160& target_id,
-        uint32_t nb_nodes) = 0;
+        uint32_t nb_nodes,
+        bool& authoritative) = 0;
+
+    /** Multi-target FIND_NODE: one message for several targets.
+     *
+     * @param addr     address of the node to query
+     * @param targets  the targeted nodes
+     * @param nb_nodes the number of node to return for each target
+     * @param answers  set to the answer for each target (in the same order)
+     * @return true if the node answered, false otherwise.
+     */
+    virtual bool find_nodes(
+        const NodeAddress& addr,
+        const std::vector<UInt160>& targets,
+        uint32_t nb_nodes,
+        std::vector<FindNodeAnswer>& answers) = 0;
+
+    /** Store a value on a node.
+     *
+     * @param addr  address of the node where the value must be stored
+     * @param key   the key of the value
+     * @param value the value to store (shared with the caller, not copied)
+     * @return true if the value has been stored, false otherwise.
+     */
+    virtual bool
+    store(const NodeAddress& addr, const UInt160& key, const Buffer& value) = 0;
+
+    /** Retrieve a value from a node.
+     *
+     * @param addr  address of the node to query
+     * @param key   the key of the value
+     * @param value the retrieved value (shared with the node, not copied)
+     * @return true if the node has the value, false otherwise.
+     */
+    virtual bool
+    find_value(const NodeAddress& addr, const UInt160& key, Buffer& value) = 0;
+
+    /** Retrieve a value from a node, or else the closest nodes to its key
+     * (FIND_VALUE as a lookup step).
+     *
+     * @param addr     address of the node to query
+     * @param key      the key of the value
+     * @param nb_nodes the number of node to return if the value isn't found
+     * @param answer   set to the answer of the node
+     * @return true if the node answered, false otherwise.
+     */
+    virtual bool find_value(
+        const NodeAddress& addr,
+        const UInt160& key,
+        uint32_t nb_nodes,
+        FindValueAnswer& answer) = 0;
+
+    /** Store a temporary replica of a popular value on a node.
+     *
+     * @param addr     address of the node where the replica must be stored
+     * @param key      the key of the value
+     * @param value    the value to store (shared with the caller, not copied)
+     * @param lifetime number of ticks the replica is kept, unless renewed
+     * @return true if the replica has been stored, false otherwise.
+     */
+    virtual bool store_replica(
+        const NodeAddress& addr,
+        const UInt160& key,
+        const Buffer& value,
+        uint32_t lifetime) = 0;
+
+    /** Send membership events to a node.
+     *
+     * @param addr   address of the node to inform
+     * @param events the membership changes
+     * @return true if the node received them, false otherwise.
+     */
+    virtual bool gossip(
+        const NodeAddress& addr,
+        const std::vector<MemberEvent>& events) = 0;
+
+    /** Send keys to a node, which answers the ones it doesn't store (to
+     * check the replicas it should hold).
+     *
+     * @param addr    address of the node to query
+     * @param keys    the keys
+     * @param missing set to the keys the node doesn't store
+     * @return true if the node answered, false otherwise.
+     */
+    virtual bool exchange_keys(
+        const NodeAddress& addr,
+        const std::vector<UInt160>& keys,
+        std::vector<UInt160>& missing) = 0;
 
     NodeComBase() = default;
     NodeComBase(NodeComBase const&) = default;
@@ -30,6 +30,7 @@
 #ifndef __DCSS_DHT_ENTRY_H__
 #define __DCSS_DHT_ENTRY_H__
 
+#include "buffer.h"
 #include "uint160.h"
 
 namespace dcss {
@@ -41,10 +42,9 @@ class Entry {
     /** Create a new DHT item identified by `id` and stored on `node`.
      *
      * @param key   a unique key that identify the entry
-     * @param value the entry payload
+     * @param value the entry payload (shared, not copied)
      */
-    Entry(UInt160 key, std::string value)
-        : m_key(key), m_value(std::move(value))
+    Entry(UInt160 key, Buffer value) : m_key(key), m_value(std::move(value))
     {
     }
     virtual ~Entry() = default;
@@ -56,7 +56,7 @@ class Entry {
     };
 
     /** Return the entry value. */
-    inline const std::string& value() const
+    inline const Buffer& value() const
     {
         return m_value;
     };
@@ -68,7 +68,7 @@ class Entry {
 
   private:
     UInt160 m_key;       /**< Key of the entry in the DHT.   */
-    std::string m_value; /**< Value of the entry in the DHT. */
+    Buffer m_value;      /**< Value of the entry in the DHT. */
 };
 
 } // namespace dht
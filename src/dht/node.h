@@ -30,19 +30,75 @@
 #ifndef __DCSS_DHT_NODE_H__
 #define __DCSS_DHT_NODE_H__
 
+#include <cstdint>
 #include <list>
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "address.h"
+#include "com.h"
+#include "buffer.h"
+#include "value_cache.h"
 
 namespace dcss {
 
 class Conf;
+enum class BucketLayout;
 
 namespace dht {
 
+/** Counters of the lookups performed by a node. */
+struct LookupStats {
+    /** Number of lookups. */
+    uint64_t n_lookups;
+    /** Number of rounds (hops) of queries. */
+    uint64_t n_rounds;
+    /** Number of FIND_NODE sent (one per target). */
+    uint64_t n_queries;
+    /** Number of messages carrying them (see `node_lookup` of targets). */
+    uint64_t n_messages;
+    /** Number of FIND_NODE left unanswered (stale contacts). */
+    uint64_t n_unresponsive;
+    /** Number of lookups ended by an authoritative answer. */
+    uint64_t n_authoritative;
+};
+
+/** Counters of the lookup cache. */
+struct LookupCacheStats {
+    /** Number of lookups answered from the cache. */
+    uint64_t n_hits;
+    /** Number of lookups not answered from the cache. */
+    uint64_t n_misses;
+    /** Number of entries dropped because expired. */
+    uint64_t n_expired;
+    /** Number of entries that failed their validation. */
+    uint64_t n_stale;
+    /** Number of entries dropped because a contact failed. */
+    uint64_t n_invalidated;
+};
+
+/** Counters of the popularity replication. */
+struct ReplicationStats {
+    /** Number of FIND_VALUE served (the load of the node). */
+    uint64_t n_served;
+    /** Number of extra replicas pushed to other nodes (renewals included). */
+    uint64_t n_pushed;
+    /** Number of extra replicas dropped because expired. */
+    uint64_t n_expired;
+};
+
+/** Counters of the membership maintenance (full membership mode). */
+struct GossipStats {
+    /** Number of gossip messages sent. */
+    uint64_t n_messages;
+    /** Number of membership events sent. */
+    uint64_t n_events;
+    /** Number of members received when joining (state transfer). */
+    uint64_t n_transferred;
+};
+
 /** A node of the DHT. */
 template <typename NodeCom>
 class Node {
@@ -77,34 +133,301 @@ class Node {
     std::vector<NodeAddress>
     find_node(const UInt160& target_id, uint32_t nb_nodes);
 
-    std::vector<NodeAddress> find_value(const UInt160& key);
+    /** Return the `k` nodes, amongst the known nodes, closest to node
+     * `target_id`.
+     *
+     * If `target_id` is in the range of the sibling list, the answer comes
+     * from the sibling list (and this node), and is authoritative: there is
+     * no closer node than the returned ones.
+     *
+     * @param target_id     the targeted node.
+     * @param nb_nodes      the number of node to return.
+     * @param authoritative set to true if the answer is authoritative.
+     * @return the list of the `nb_nodes` nodes that are the closest to
+     * `target_id`.
+     */
+    std::vector<NodeAddress> find_node(
+        const UInt160& target_id,
+        uint32_t nb_nodes,
+        bool& authoritative);
+
+    /** Return the value stored under `key` on this node, if any.
+     *
+     * @param key   the key of the value.
+     * @param value the value, if found (shared with the entry, not copied).
+     * @return true if the value is stored on this node, false otherwise.
+     */
+    bool find_value(const UInt160& key, Buffer& value) const;
 
     /** Store the specified entry on the node.
+     *
+     * If an entry with the same key already exists, it is replaced.
      *
      * @param entry the entry to store.
      */
     void store(std::unique_ptr<Entry> entry);
 
+    /** Remove the entry stored under `key` on this node, if any.
+     *
+     * @param key the key of the entry.
+     * @return true if an entry was removed, false otherwise.
+     */
+    bool erase(const UInt160& key);
+
+    /** Send a PING to the node `addr`.
+     *
+     * @param addr the node to probe.
+     * @return true if the node answered, false otherwise.
+     */
+    bool send_ping(const NodeAddress& addr);
+
+    /** Send a STORE to the node `addr`.
+     *
+     * @param addr  the node where the value must be stored.
+     * @param key   the key of the value.
+     * @param value the value to store.
+     * @return true if the value has been stored, false otherwise.
+     */
+    bool send_store(
+        const NodeAddress& addr,
+        const UInt160& key,
+        const Buffer& value);
+
+    /** Send a FIND_VALUE to the node `addr`.
+     *
+     * @param addr  the node to query.
+     * @param key   the key of the value.
+     * @param value the value, if found.
+     * @return true if the value was found on `addr`, false otherwise.
+     */
+    bool send_find_value(
+        const NodeAddress& addr,
+        const UInt160& key,
+        Buffer& value);
+
+    /** Send a key exchange to the node `addr`.
+     *
+     * @param addr    the node to query.
+     * @param keys    the keys `addr` should store.
+     * @param missing set to the keys `addr` doesn't store.
+     * @return true if `addr` answered, false otherwise.
+     */
+    bool send_keys(
+        const NodeAddress& addr,
+        const std::vector<UInt160>& keys,
+        std::vector<UInt160>& missing);
+
+    /** Answer a key exchange: return the keys not stored on this node. */
+    std::vector<UInt160> missing_keys(const std::vector<UInt160>& keys) const;
+
+    /** Answer a FIND_VALUE received from another node.
+     *
+     * The reads of the stored keys are counted: a key read at least
+     * `hot_threshold` times recently is answered as popular (the reader
+     * replicates it on its lookup path, see `value_lookup`), and its extra
+     * replica here, if any, is renewed.
+     *
+     * @param key      the key of the value.
+     * @param nb_nodes the number of node to return if the value isn't here.
+     * @param answer   set to the answer.
+     * @return true if the value is stored on this node, false otherwise.
+     */
+    bool serve_value(
+        const UInt160& key,
+        uint32_t nb_nodes,
+        FindValueAnswer& answer);
+
+    /** Store a temporary replica of a popular value.
+     *
+     * The replica is dropped after `lifetime` ticks, unless renewed. A value
+     * already stored for good is left as is.
+     *
+     * @param entry    the entry to store.
+     * @param lifetime lifetime of the replica (in ticks).
+     */
+    void store_replica(std::unique_ptr<Entry> entry, uint32_t lifetime);
+
+    /** Look a value up: the lookup stops at the first node that has it.
+     *
+     * If the value is popular, it is replicated on the `hot_replicas` nodes
+     * the closest to the key amongst the queried ones: the next lookups
+     * coming the same way stop there, and the replicas get farther from the
+     * key as long as the key is popular.
+     *
+     * @param key   the key of the value.
+     * @param value the value, if found.
+     * @return true if the value was found, false otherwise.
+     */
+    bool value_lookup(const UInt160& key, Buffer& value);
+
+    /** Read the value stored under `key`.
+     *
+     * The value is taken from this node, or from its value cache, or else
+     * fetched from the closest nodes to `key` (and offered to the cache).
+     * With the popularity replication, the value is looked up with
+     * `value_lookup`.
+     *
+     * @param key   the key of the value.
+     * @param value the value, if found.
+     * @return true if the value was found, false otherwise.
+     */
+    bool read_value(const UInt160& key, Buffer& value);
+
+    /** Return the cache of the values read by this node. */
+    inline ValueCache& value_cache()
+    {
+        return m_value_cache;
+    }
+
     /** Return the k node that are the closest to `target_id`
      *
      * This method will communicate with other nodes, it is not limited to its
      * own known nodes.
      *
+     * If the lookup cache holds the nodes found for a target of the same
+     * prefix, the closest of them is asked to confirm them (a single
+     * FIND_NODE) instead of performing the whole lookup.
+     *
      * @param target_id the targeted node.
      * @return the list of the `k` nodes that are the closest to `target_id`.
      */
     // TODO: eventually, this should probably be private.
     std::vector<NodeAddress> node_lookup(const UInt160& target_id);
 
+    /** Return the k node that are the closest to each target.
+     *
+     * The lookups progress together, round by round: the FIND_NODE sent to
+     * the same node during a round are grouped into a single message, and
+     * the nodes learned for one target are shared with the others (close
+     * targets have overlapping shortlists).
+     *
+     * @param targets the targeted nodes.
+     * @return the list of the `k` closest nodes of each target (in the same
+     * order).
+     */
+    std::vector<std::vector<NodeAddress>>
+    node_lookup(const std::vector<UInt160>& targets);
+
     /** Computes the distance to the specified node ID/key. */
     inline UInt160 distance_to(const UInt160& id) const
     {
         return compute_distance(m_addr.id(), id);
     }
 
+    /** Return the number of bytes stored on this node. */
+    uint64_t stored_bytes() const;
+
     /** Computes the number of nodes that this node can connect to. */
     uint32_t connection_count() const;
 
+    /** Return the number of k-buckets of the routing table. */
+    inline size_t bucket_count() const
+    {
+        return m_buckets.size();
+    }
+
+    /** Return the (approximate) memory used by the routing table, in bytes.
+     *
+     * Both the k-buckets and their replacement caches are accounted.
+     */
+    size_t routing_table_size() const;
+
+    /** Check the liveness of the contacts scheduled for a ping.
+     *
+     * When a new contact arrives in a full k-bucket, it is parked in the
+     * replacement cache of the bucket and the least recently seen contact of
+     * the bucket is scheduled for a ping. The pings are sent in a batch, by
+     * this method, so that a full bucket never blocks the caller:
+     * - a contact that answers is moved in front of its bucket.
+     * - a contact that doesn't answer is evicted and replaced by the most
+     *   recently seen contact of the replacement cache.
+     */
+    void flush_pings();
+
+    /** Get the whole membership from `contact` (full membership mode).
+     *
+     * @param contact a node already in the DHT
+     * @return true if `contact` answered, false otherwise.
+     */
+    bool fetch_membership(const NodeAddress& contact);
+
+    /** Announce our arrival by gossip (full membership mode). */
+    void gossip_join();
+
+    /** Send the pending membership events to log2(N) + 1 random members.
+     *
+     * Each node forwards an event once, when it learns it ("infect and
+     * die"): with this fanout, every node gets it with high probability. A
+     * member that doesn't receive the events is considered gone (and this is
+     * gossiped as well).
+     */
+    void gossip_round();
+
+    /** Handle the membership events received from another node.
+     *
+     * The events that bring news are applied and forwarded.
+     */
+    void on_gossip(const std::vector<MemberEvent>& events);
+
+    /** Return the counters of the membership maintenance. */
+    inline const GossipStats& gossip_stats() const
+    {
+        return m_gossip_stats;
+    }
+
+    /** Return the counters of the lookup cache. */
+    inline const LookupCacheStats& lookup_cache_stats() const
+    {
+        return m_lookup_cache_stats;
+    }
+
+    /** Advance the clock of the node (expiring the old cache entries and
+     * extra replicas).
+     */
+    void tick();
+
+    /** Change the parameters of the popularity replication (see `Conf`). */
+    void set_hot_replication(
+        uint32_t threshold,
+        uint32_t n_replicas,
+        uint32_t lifetime);
+
+    /** Return true if the popular values are replicated. */
+    inline bool hot_replication() const
+    {
+        return m_hot_threshold > 0;
+    }
+
+    /** Return the counters of the popularity replication. */
+    inline const ReplicationStats& replication_stats() const
+    {
+        return m_replication_stats;
+    }
+
+    /** Return the number of extra replicas stored on this node. */
+    inline size_t n_extra_replicas() const
+    {
+        return m_replica_expiry.size();
+    }
+
+    /** Return the number of contacts waiting for a ping. */
+    inline size_t pending_pings() const
+    {
+        return m_ping_queue.size();
+    }
+
+    /** Return the sibling list (closest contacts to our ID, sorted). */
+    inline const std::vector<NodeAddress>& siblings() const
+    {
+        return m_siblings;
+    }
+
+    /** Return the counters of the lookups performed by this node. */
+    inline const LookupStats& lookup_stats() const
+    {
+        return m_lookup_stats;
+    }
+
     /** Return the node's ID. */
     inline const UInt160& id() const
     {
@@ -130,31 +453,136 @@ class Node {
   protected:
     bool register_node(Node* node, bool contacted_us);
 
-    const std::unordered_map<uint32_t, std::list<NodeAddress>>& buckets() const
+    const std::vector<std::list<NodeAddress>>& buckets() const
     {
         return m_buckets;
     }
 
   private:
     virtual void on_store(const Entry& /* entry */) {}
+    virtual void on_erase(const Entry& /* entry */) {}
 
     /** Refresh the routing table.
+     *
+     * The sibling list is updated first (see `add_sibling`), then the
+     * k-buckets.
      *
      * If the node already exists it is moved in front of the bucket.
      * If the node is new:
      * - bucket not full: insert in front.
-     * - bucket full: ping the least recently seen node in the bucket:
-     *   - it respond: we move it to the front and ignore `node_id`.
-     *   - it doesn't respond: evict it and insert `node_id` in front.
+     * - bucket full and containing our ID (split layouts): split it, and
+     *   retry.
+     * - bucket full, relaxed layout and `node_id` amongst the k closest
+     *   contacts to our ID: insert in front anyway (up to k extra contacts).
+     * - bucket full: put `node_id` in the replacement cache of the bucket
+     *   and schedule a ping of the least recently seen node in the bucket
+     *   (see `flush_pings`).
      *
      * @param addr the address of the last node seen
      */
     void refresh_routing_table(const NodeAddress& addr);
 
+    /** Handle a contact that didn't answer to a request.
+     *
+     * The contact is replaced right away if the replacement cache of its
+     * bucket isn't empty (otherwise it's kept: it may be a transient
+     * failure).
+     */
+    void on_unresponsive(const NodeAddress& addr);
+
+    /** Remove a contact from its bucket, and replace it from the cache. */
+    void evict(const NodeAddress& addr);
+
+    /** Insert `addr` in the sibling list, if it's amongst the s closest. */
+    void add_sibling(const NodeAddress& addr);
+
+    /** Remove `addr` from the sibling list, if present. */
+    void remove_sibling(const NodeAddress& addr);
+
+    /** Return the index of the k-bucket covering `node_id`.
+     *
+     * With the fixed layout, the index is the bit length of the distance.
+     * With the split layouts, the bucket `i` covers the distances whose bit
+     * length is `n_bits - i`, except the last one (which contains our ID) that
+     * covers all the shorter distances.
+     */
+    size_t bucket_index(const UInt160& node_id) const;
+
+    /** Split the last k-bucket (the one containing our ID) in two. */
+    void split_bucket();
+
+    /** State of a lookup of a value (see `value_lookup`). */
+    struct ValueSearch {
+        /** The value, once found. */
+        Buffer value;
+        bool found;
+        /** True if the value is popular (see `serve_value`). */
+        bool hot;
+        /** The queried nodes that don't have the value. */
+        std::vector<NodeAddress> missed;
+    };
+
+    /** Look up `target_id` from scratch (see `node_lookup`).
+     *
+     * @param target_id the targeted node.
+     * @param search    the value looked up (the queries are FIND_VALUE and
+     *                  the lookup stops once it is found), null for a node
+     *                  lookup.
+     */
+    std::vector<NodeAddress>
+    iterative_lookup(const UInt160& target_id, ValueSearch* search);
+
+    /** Return the prefix of `target_id` indexing the lookup cache. */
+    inline UInt160 cache_prefix(const UInt160& target_id) const
+    {
+        return target_id >> (m_keysize - m_lookup_cache_prefix);
+    }
+
+    bool
+    cached_lookup(const UInt160& target_id, std::vector<NodeAddress>& nodes);
+    void cache_lookup(
+        const UInt160& target_id,
+        const std::vector<NodeAddress>& nodes);
+    void uncache_contact(const UInt160& node_id);
+
+    /** Return the `nb_nodes` members closest to `target_id`. */
+    std::vector<NodeAddress>
+    find_member(const UInt160& target_id, uint32_t nb_nodes) const;
+
+    /** Add a node to the membership (unless it's known to be gone).
+     *
+     * @return true if the node is a new member, false otherwise.
+     */
+    bool add_member(const NodeAddress& addr);
+
+    /** Remove a node from the membership, for good.
+     *
+     * @return true if the node was a member, false otherwise.
+     */
+    bool remove_member(const NodeAddress& addr);
+
+    /** Queue a membership event for the next gossip round. */
+    void spread(const MemberEvent& event);
+
+    /** Check if `addr` would be amongst the k closest contacts to our ID.
+     *
+     * @param addr   the contact to check
+     * @param bucket index of its bucket
+     */
+    bool is_near(const NodeAddress& addr, size_t bucket) const;
+
     /** Call FIND_NODE on the list of specified nodes.
      *
      * @param nodes_to_query node to query
      * @param target_id      the ID of the target
+     * @param queried        updated with the queried nodes
+     * @param unresponsive   updated with the nodes that didn't answer
+     * @param authoritative  set to the first authoritative answer, if any
+     *                       (the remaining nodes are not queried), null to
+     *                       ignore the authoritative answers
+     * @param search         the value looked up, if any (sending FIND_VALUE
+     *                       instead, the remaining nodes are not queried
+     *                       once it is found)
      * @return the aggregated responses from the queried nodes.
      *
      * @note the returned value is unsorted and may contains duplicates.
@@ -162,18 +590,82 @@ class Node {
     std::vector<NodeAddress> send_find_node(
         const std::vector<NodeAddress>& nodes_to_query,
         const UInt160& target_id,
-        std::unordered_set<UInt160>& queried);
+        std::unordered_set<UInt160>& queried,
+        std::unordered_set<UInt160>& unresponsive,
+        std::vector<NodeAddress>* authoritative,
+        ValueSearch* search);
 
     NodeAddress m_addr; /**< The node ID.                          */
     uint32_t m_keysize; /**< Size of the keys (in bits).           */
     uint32_t m_k;       /**< k: system-wide replication parameter. */
     uint32_t m_alpha;   /**< α: system-wide concurrency parameter. */
 
-    /** The list of k-bucket. */
+    /** Layout of the routing table. */
+    BucketLayout m_layout;
+    /** The list of k-bucket (see `bucket_index`). */
     // TODO: should probably use a heap/priority queue instead of a list here.
-    std::unordered_map<uint32_t, std::list<NodeAddress>> m_buckets;
-    /** The entries stored on this node. */
-    std::vector<std::unique_ptr<Entry>> m_entries;
+    std::vector<std::list<NodeAddress>> m_buckets;
+    /** Replacement cache of each k-bucket (most recently seen in front). */
+    std::vector<std::list<NodeAddress>> m_replacements;
+    /** Maximum size of a replacement cache (0 to ignore the newcomers). */
+    uint32_t m_cache_size;
+    /** Size of the sibling list (0 to disable it). */
+    uint32_t m_n_siblings;
+    /** The s closest contacts to our ID, sorted by distance (S/Kademlia).
+     *
+     * Once checked by a lookup of our own ID, all the nodes closer than the
+     * farthest sibling are supposed to be known (newcomers announce
+     * themselves when joining), so that FIND_NODE in this range can be
+     * answered authoritatively.
+     */
+    std::vector<NodeAddress> m_siblings;
+    /** Sibling list checked by a lookup of our own ID (trusted from then). */
+    bool m_siblings_ready;
+    /** All the nodes, sorted by ID (full membership mode). */
+    std::vector<NodeAddress> m_members;
+    /** The nodes known to have left (their IDs are never reused). */
+    std::unordered_set<UInt160> m_departed;
+    /** Membership events to gossip at the next round. */
+    std::vector<MemberEvent> m_rumors;
+    /** Counters of the membership maintenance. */
+    GossipStats m_gossip_stats;
+    /** Contacts to ping (least recently seen contacts of full buckets). */
+    std::vector<NodeAddress> m_ping_queue;
+    std::unordered_set<UInt160> m_ping_scheduled;
+    /** Counters of the lookups performed by this node. */
+    LookupStats m_lookup_stats;
+    /** A resolved lookup, cached. */
+    struct CachedLookup {
+        /** Prefix of the targets (see `cache_prefix`). */
+        UInt160 prefix;
+        /** The k closest nodes to the last target of this prefix. */
+        std::vector<NodeAddress> nodes;
+        /** Time (see `tick`) from which the entry is expired. */
+        uint64_t expiry;
+    };
+    /** The lookup cache, most recently used entries first. */
+    std::list<CachedLookup> m_lookup_cache;
+    std::unordered_map<UInt160, typename std::list<CachedLookup>::iterator>
+        m_lookup_cache_index;
+    uint32_t m_lookup_cache_size;
+    uint32_t m_lookup_cache_ttl;
+    uint32_t m_lookup_cache_prefix;
+    LookupCacheStats m_lookup_cache_stats;
+    /** Clock of the node (see `tick`). */
+    uint64_t m_clock;
+    /** Cache of the values read by this node. */
+    ValueCache m_value_cache;
+    /** Popularity replication parameters (see `Conf`). */
+    uint32_t m_hot_threshold;
+    uint32_t m_hot_replicas;
+    uint32_t m_hot_lifetime;
+    /** Recent reads of the stored keys. */
+    CountMinSketch m_access_sketch;
+    /** Expiry time (see `tick`) of the extra replicas stored here. */
+    std::unordered_map<UInt160, uint64_t> m_replica_expiry;
+    ReplicationStats m_replication_stats;
+    /** The entries stored on this node, indexed by key. */
+    std::unordered_map<UInt160, std::unique_ptr<Entry>> m_entries;
     /** Module for the inter-node communication. */
     NodeCom m_com_iface;
 };
@@ -30,6 +30,8 @@
 #include <algorithm>
 #include <cassert>
 #include <iterator>
+#include <limits>
+#include <random>
 
 #include "com.h"
 #include "core.h"
@@ -42,6 +44,9 @@
 namespace dcss {
 namespace dht {
 
+/** Width of the sketch counting the reads of the keys stored on a node. */
+static const uint32_t ACCESS_SKETCH_WIDTH = 256;
+
 class ByDistanceFrom {
   public:
     explicit ByDistanceFrom(const UInt160& target_id) : m_target(target_id) {}
@@ -65,27 +70,81 @@ class ByDistanceFrom {
 template <typename NodeCom>
 Node<NodeCom>::Node(NodeAddress addr, const Conf& configuration,
                     const NodeCom& com_iface)
-    : m_addr(addr), m_com_iface(com_iface)
+    : m_addr(addr), m_gossip_stats{0, 0, 0}, m_lookup_stats{0, 0, 0, 0, 0, 0},
+      m_lookup_cache_stats{0, 0, 0, 0, 0}, m_clock(0),
+      m_value_cache(
+          configuration.value_cache_size, configuration.value_cache_policy),
+      m_hot_threshold(configuration.hot_threshold),
+      m_hot_replicas(configuration.hot_replicas),
+      m_hot_lifetime(configuration.hot_lifetime),
+      m_access_sketch(m_hot_threshold > 0 ? ACCESS_SKETCH_WIDTH : 1),
+      m_replication_stats{0, 0, 0}, m_com_iface(com_iface)
 {
     m_keysize = configuration.n_bits;
     m_k = configuration.k;
     m_alpha = configuration.alpha;
+    m_cache_size = configuration.replacement_cache_size;
+    m_layout = configuration.bucket_layout;
+    m_n_siblings = configuration.n_siblings;
+    m_siblings_ready = false;
+    m_lookup_cache_size = configuration.lookup_cache_size;
+    m_lookup_cache_ttl = configuration.lookup_cache_ttl;
+    m_lookup_cache_prefix =
+        std::min(configuration.lookup_cache_prefix, m_keysize);
 
-    // Initialize the k-buckets.
-    for (uint32_t i = 0; i < (m_keysize + 1); i++) {
-        m_buckets[i] = std::list<NodeAddress>();
+    // Initialize the k-buckets: all of them upfront for the fixed layout, a
+    // single one (covering the whole keyspace) for the split layouts and
+    // none in full membership mode.
+    size_t n_buckets = 1;
+    if (m_layout == BucketLayout::FIXED) {
+        n_buckets = m_keysize + 1;
+    } else if (m_layout == BucketLayout::FULL) {
+        n_buckets = 0;
     }
+    m_buckets.resize(n_buckets);
+    m_replacements.resize(n_buckets);
 }
 
 template <typename NodeCom>
 uint32_t Node<NodeCom>::connection_count() const
 {
-    uint32_t total = 0;
+    uint32_t total = static_cast<uint32_t>(m_members.size());
+
+    for (const auto& bucket : m_buckets) {
+        total += static_cast<uint32_t>(bucket.size());
+    }
+
+    return total;
+}
+
+template <typename NodeCom>
+size_t Node<NodeCom>::routing_table_size() const
+{
+    // A std::list node: the contact and two pointers.
+    const size_t node_size = sizeof(NodeAddress) + 2 * sizeof(void*);
+    size_t n_contacts = 0;
 
-    for (uint32_t i = 0; i < (m_keysize + 1); i++) {
-        total += static_cast<uint32_t>(m_buckets.at(i).size());
+    for (size_t i = 0; i < m_buckets.size(); ++i) {
+        n_contacts += m_buckets[i].size() + m_replacements[i].size();
     }
+    // Membership: a sorted array, plus a hash set of the departed nodes.
+    const size_t members_size = m_members.capacity() * sizeof(NodeAddress)
+                                + m_departed.size() * (sizeof(UInt160) + 16)
+                                + m_departed.bucket_count() * sizeof(void*);
+
+    return sizeof(std::list<NodeAddress>)
+               * (m_buckets.capacity() + m_replacements.capacity())
+           + n_contacts * node_size + members_size;
+}
+
+template <typename NodeCom>
+uint64_t Node<NodeCom>::stored_bytes() const
+{
+    uint64_t total = 0;
 
+    for (const auto& it : m_entries) {
+        total += it.second->value().size();
+    }
     return total;
 }
 
@@ -101,18 +160,61 @@ void Node<NodeCom>::ping(const Node& node)
 template <typename NodeCom>
 std::vector<NodeAddress> Node<NodeCom>::find_node(const UInt160& target_id,
                                                   uint32_t nb_nodes)
+{
+    bool authoritative = false;
+
+    return find_node(target_id, nb_nodes, authoritative);
+}
+
+template <typename NodeCom>
+std::vector<NodeAddress> Node<NodeCom>::find_node(
+    const UInt160& target_id,
+    uint32_t nb_nodes,
+    bool& authoritative)
 {
     DHT_LOG(TRACE) << "node " << id()
                    << ": FIND_NODE(" << target_id << ", " << nb_nodes << ')';
 
+    authoritative = false;
+    if (m_layout == BucketLayout::FULL) {
+        return find_member(target_id, nb_nodes);
+    }
+    // Targets close to our ID are answered from the sibling list.
+    if (nb_nodes != 0 && m_n_siblings != 0 && m_siblings_ready
+        && m_siblings.size() == m_n_siblings) {
+        // A self lookup only checks the k closest siblings.
+        const NodeAddress& edge = m_siblings[std::min(m_n_siblings, m_k) - 1];
+        const int radius = distance_to(edge.id()).bit_length();
+
+        if (distance_to(target_id).bit_length() < radius) {
+            std::vector<NodeAddress> nearest(m_siblings);
+
+            nearest.push_back(m_addr);
+            std::sort(
+                nearest.begin(), nearest.end(), ByDistanceFrom(target_id));
+            if (nearest.size() > nb_nodes) {
+                nearest.erase(nearest.begin() + nb_nodes, nearest.end());
+            }
+            // Any node closer to the target than the farthest returned node
+            // is less than `radius` bits away from us: it's a sibling.
+            const int reach =
+                compute_distance(nearest.back().id(), target_id).bit_length();
+            if (reach < radius) {
+                DHT_VLOG(3) << "authoritative answer from the sibling list";
+                authoritative = true;
+                return nearest;
+            }
+        }
+    }
+
     const UInt160 distance(distance_to(target_id));
-    const uint32_t bucket_idx = distance.bit_length();
+    const size_t bucket_idx = bucket_index(target_id);
     std::vector<NodeAddress> closest;
 
     DHT_VLOG(1) << "distance=" << distance << ", k-bucket=" << bucket_idx;
 
     // First look in the corresponding k-bucket.
-    assert(bucket_idx <= m_buckets.size());
+    assert(bucket_idx < m_buckets.size());
     // FIXME: copy could be avoided here.
     std::list<NodeAddress> k_bucket = m_buckets[bucket_idx];
 
@@ -131,7 +233,7 @@ std::vector<NodeAddress> Node<NodeCom>::find_node(const UInt160& target_id,
         std::list<NodeAddress> all;
 
         // Find remaining nearest nodes.
-        for (uint32_t i = 0; i != m_buckets.size(); ++i) {
+        for (size_t i = 0; i != m_buckets.size(); ++i) {
             if (bucket_idx == i) {
                 continue;
             }
@@ -152,20 +254,248 @@ std::vector<NodeAddress> Node<NodeCom>::find_node(const UInt160& target_id,
 }
 
 template <typename NodeCom>
-std::vector<NodeAddress> Node<NodeCom>::find_value(const UInt160& key)
+bool Node<NodeCom>::find_value(const UInt160& key, Buffer& value) const
 {
     DHT_LOG(TRACE) << "node " << id() << ": FIND_VALUE(" << key << ')';
-    (void)key;
-    return {};
+
+    const auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        return false;
+    }
+    value = it->second->value();
+    return true;
 }
 
 template <typename NodeCom>
 void Node<NodeCom>::store(std::unique_ptr<Entry> entry)
 {
     DHT_LOG(TRACE) << "node " << id() << ": STORE(" << entry->key() << ')';
-    // TODO real implem: call node_lookup and send STORE to the returned nodes.
-    m_entries.push_back(std::move(entry));
-    on_store(*m_entries.back());
+
+    const UInt160 key(entry->key());
+    std::unique_ptr<Entry>& slot = m_entries[key];
+    const bool was_empty = !slot;
+
+    // Stored for good, not as a temporary replica anymore.
+    const bool was_replica = m_replica_expiry.erase(key) != 0;
+    slot = std::move(entry);
+    // A key stored again replaces its entry, it is reported once.
+    if (was_empty || was_replica) {
+        on_store(*slot);
+    }
+}
+
+template <typename NodeCom>
+bool Node<NodeCom>::erase(const UInt160& key)
+{
+    const auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        return false;
+    }
+    // Only the entries stored for good were reported.
+    if (m_replica_expiry.erase(key) == 0) {
+        on_erase(*it->second);
+    }
+    m_entries.erase(it);
+    return true;
+}
+
+template <typename NodeCom>
+void Node<NodeCom>::store_replica(
+    std::unique_ptr<Entry> entry,
+    uint32_t lifetime)
+{
+    DHT_LOG(TRACE) << "node " << id() << ": STORE_REPLICA(" << entry->key()
+                   << ", " << lifetime << ')';
+
+    const UInt160 key(entry->key());
+    const auto stored = m_entries.find(key);
+    if (stored != m_entries.end() && m_replica_expiry.count(key) == 0) {
+        return;
+    }
+    m_entries[key] = std::move(entry);
+    uint64_t& expiry = m_replica_expiry[key];
+    expiry = std::max(expiry, m_clock + lifetime);
+}
+
+template <typename NodeCom>
+bool Node<NodeCom>::serve_value(
+    const UInt160& key,
+    uint32_t nb_nodes,
+    FindValueAnswer& answer)
+{
+    ++m_replication_stats.n_served;
+    answer.hot = false;
+    answer.found = find_value(key, answer.value);
+    if (!answer.found) {
+        answer.nodes = find_node(key, nb_nodes);
+        return false;
+    }
+    answer.nodes.clear();
+    if (m_hot_threshold > 0) {
+        m_access_sketch.increment(key);
+        answer.hot = m_access_sketch.estimate(key) >= m_hot_threshold;
+
+        const auto replica = m_replica_expiry.find(key);
+        if (answer.hot && replica != m_replica_expiry.end()) {
+            replica->second =
+                std::max(replica->second, m_clock + m_hot_lifetime);
+        }
+    }
+    return true;
+}
+
+template <typename NodeCom>
+void Node<NodeCom>::tick()
+{
+    ++m_clock;
+
+    for (auto it = m_replica_expiry.begin(); it != m_replica_expiry.end();) {
+        if (it->second <= m_clock) {
+            DHT_VLOG(3) << "replica of " << it->first << " expired";
+            m_entries.erase(it->first);
+            it = m_replica_expiry.erase(it);
+            ++m_replication_stats.n_expired;
+        } else {
+            ++it;
+        }
+    }
+}
+
+template <typename NodeCom>
+void Node<NodeCom>::set_hot_replication(
+    uint32_t threshold,
+    uint32_t n_replicas,
+    uint32_t lifetime)
+{
+    m_hot_threshold = threshold;
+    m_hot_replicas = n_replicas;
+    m_hot_lifetime = lifetime;
+    m_access_sketch = CountMinSketch(threshold > 0 ? ACCESS_SKETCH_WIDTH : 1);
+}
+
+template <typename NodeCom>
+bool Node<NodeCom>::send_ping(const NodeAddress& addr)
+{
+    DHT_LOG(TRACE) << "node " << id() << ": send PING to " << addr;
+    if (!m_com_iface.ping(addr)) {
+        on_unresponsive(addr);
+        return false;
+    }
+    refresh_routing_table(addr);
+    return true;
+}
+
+template <typename NodeCom>
+bool Node<NodeCom>::send_store(
+    const NodeAddress& addr,
+    const UInt160& key,
+    const Buffer& value)
+{
+    DHT_LOG(TRACE) << "node " << id() << ": send STORE(" << key << ", "
+                   << value.size() << " bytes) to " << addr;
+    if (!m_com_iface.store(addr, key, value)) {
+        return false;
+    }
+    refresh_routing_table(addr);
+    return true;
+}
+
+template <typename NodeCom>
+bool Node<NodeCom>::send_find_value(
+    const NodeAddress& addr,
+    const UInt160& key,
+    Buffer& value)
+{
+    DHT_LOG(TRACE) << "node " << id() << ": send FIND_VALUE(" << key
+                   << ") to " << addr;
+    if (!m_com_iface.find_value(addr, key, value)) {
+        return false;
+    }
+    refresh_routing_table(addr);
+    return true;
+}
+
+template <typename NodeCom>
+bool Node<NodeCom>::send_keys(
+    const NodeAddress& addr,
+    const std::vector<UInt160>& keys,
+    std::vector<UInt160>& missing)
+{
+    DHT_LOG(TRACE) << "node " << id() << ": send " << keys.size()
+                   << " keys to " << addr;
+    if (!m_com_iface.exchange_keys(addr, keys, missing)) {
+        return false;
+    }
+    refresh_routing_table(addr);
+    return true;
+}
+
+template <typename NodeCom>
+std::vector<UInt160>
+Node<NodeCom>::missing_keys(const std::vector<UInt160>& keys) const
+{
+    std::vector<UInt160> missing;
+
+    for (const auto& key : keys) {
+        if (m_entries.count(key) == 0) {
+            missing.push_back(key);
+        }
+    }
+    return missing;
+}
+
+template <typename NodeCom>
+bool Node<NodeCom>::value_lookup(const UInt160& key, Buffer& value)
+{
+    ValueSearch search{Buffer(), false, false, {}};
+
+    ++m_lookup_stats.n_lookups;
+    if (find_value(key, value)) {
+        return true;
+    }
+    iterative_lookup(key, &search);
+    if (!search.found) {
+        return false;
+    }
+    value = search.value;
+    if (search.hot) {
+        std::sort(
+            search.missed.begin(), search.missed.end(), ByDistanceFrom(key));
+        search.missed.erase(
+            std::unique(search.missed.begin(), search.missed.end()),
+            search.missed.end());
+        for (size_t i = 0; i < search.missed.size() && i < m_hot_replicas;
+             ++i) {
+            DHT_VLOG(3) << "replicating " << key << " on " << search.missed[i];
+            if (m_com_iface.store_replica(
+                    search.missed[i], key, value, m_hot_lifetime)) {
+                ++m_replication_stats.n_pushed;
+            }
+        }
+    }
+    return true;
+}
+
+template <typename NodeCom>
+bool Node<NodeCom>::read_value(const UInt160& key, Buffer& value)
+{
+    if (find_value(key, value) || m_value_cache.get(key, value)) {
+        return true;
+    }
+    if (m_hot_threshold > 0) {
+        if (!value_lookup(key, value)) {
+            return false;
+        }
+        m_value_cache.put(key, value);
+        return true;
+    }
+    for (const auto& holder : node_lookup(key)) {
+        if (send_find_value(holder, key, value)) {
+            m_value_cache.put(key, value);
+            return true;
+        }
+    }
+    return false;
 }
 
 template <typename NodeCom>
@@ -174,56 +504,442 @@ void Node<NodeCom>::refresh_routing_table(const NodeAddress& addr)
     if (m_addr == addr) {
         throw dcss::LogicError("cannot add ourself in our own routing table");
     }
+    if (m_layout == BucketLayout::FULL) {
+        add_member(addr);
+        return;
+    }
+    add_sibling(addr);
 
-    const uint32_t bit_length = distance_to(addr.id()).bit_length();
-    std::list<NodeAddress>& bucket = m_buckets[bit_length];
-
+    size_t idx = bucket_index(addr.id());
     const auto it = std::find_if(
-        bucket.begin(), bucket.end(), [&addr](const NodeAddress& n) {
-            return n == addr;
-    });
+        m_buckets[idx].begin(), m_buckets[idx].end(),
+        [&addr](const NodeAddress& n) { return n == addr; });
     // The node is known: move it in front.
-    if (it != bucket.end()) {
+    if (it != m_buckets[idx].end()) {
         DHT_VLOG(5) << id() << ": move " << addr.id() << "in front of the "
-                    << bit_length << "-bucket";
-        bucket.splice(bucket.begin(), bucket, it);
+                    << idx << "-bucket";
+        m_buckets[idx].splice(m_buckets[idx].begin(), m_buckets[idx], it);
         return;
     }
 
+    // The bucket containing our ID is split when full.
+    while (m_layout != BucketLayout::FIXED && idx + 1 == m_buckets.size()
+           && m_buckets[idx].size() >= m_k && m_buckets.size() < m_keysize) {
+        split_bucket();
+        idx = bucket_index(addr.id());
+    }
+    std::list<NodeAddress>& bucket = m_buckets[idx];
+
     // New node check if there is room for it in the bucket.
-    if (bucket.size() < m_k) {
+    if (bucket.size() < m_k
+        || (m_layout == BucketLayout::RELAXED && bucket.size() < 2 * m_k
+            && is_near(addr, idx))) {
         // Yes, insert in front.
         DHT_VLOG(5) << id() << ": insert " << addr.id() << "in front of the "
-                    << bit_length << "-bucket";
+                    << idx << "-bucket";
         bucket.push_front(addr);
         return;
     }
-    // TODO: handle the case when the bucket is full.
-    DHT_VLOG(5) << id() << ": ignore " << addr.id() << ", "
-                << bit_length << "-bucket is full";
+    if (m_cache_size == 0) {
+        DHT_VLOG(5) << id() << ": ignore " << addr.id() << ", "
+                    << idx << "-bucket is full";
+        return;
+    }
+
+    // Bucket is full: keep the newcomer as a replacement and check (later)
+    // if the least recently seen contact is still alive.
+    std::list<NodeAddress>& cache = m_replacements[idx];
+    cache.remove(addr);
+    cache.push_front(addr);
+    if (cache.size() > m_cache_size) {
+        cache.pop_back();
+    }
+    if (m_ping_scheduled.insert(bucket.back().id()).second) {
+        m_ping_queue.push_back(bucket.back());
+    }
+    DHT_VLOG(5) << id() << ": cache " << addr.id() << ", "
+                << idx << "-bucket is full";
+}
+
+template <typename NodeCom>
+void Node<NodeCom>::evict(const NodeAddress& addr)
+{
+    uncache_contact(addr.id());
+    if (m_layout == BucketLayout::FULL) {
+        remove_member(addr);
+        return;
+    }
+
+    const size_t idx = bucket_index(addr.id());
+    std::list<NodeAddress>& bucket = m_buckets[idx];
+    std::list<NodeAddress>& cache = m_replacements[idx];
+
+    DHT_VLOG(5) << id() << ": evict " << addr.id() << " from the "
+                << idx << "-bucket";
+    remove_sibling(addr);
+    bucket.remove(addr);
+    if (!cache.empty() && bucket.size() < m_k) {
+        bucket.push_front(cache.front());
+        cache.pop_front();
+    }
+}
+
+template <typename NodeCom>
+void Node<NodeCom>::on_unresponsive(const NodeAddress& addr)
+{
+    uncache_contact(addr.id());
+    // A member that doesn't answer is gone: tell the others.
+    if (m_layout == BucketLayout::FULL) {
+        if (remove_member(addr)) {
+            spread({addr, false});
+        }
+        return;
+    }
+    // Siblings are trusted for authoritative answers: drop them right away.
+    remove_sibling(addr);
+    if (!m_replacements[bucket_index(addr.id())].empty()) {
+        evict(addr);
+    }
+}
+
+template <typename NodeCom>
+std::vector<NodeAddress>
+Node<NodeCom>::find_member(const UInt160& target_id, uint32_t nb_nodes) const
+{
+    auto first = m_members.cbegin();
+    auto last = m_members.cend();
+
+    // The closest nodes share the longest prefix with the target: look for
+    // the smallest subtree (i.e. range of IDs) holding enough members.
+    for (uint32_t bits = 0; bits < m_keysize; ++bits) {
+        const UInt160 low((target_id >> bits) << bits);
+        const UInt160 high(low | ((UInt160(1u) << bits) - UInt160(1u)));
+
+        first = std::lower_bound(
+            m_members.cbegin(), m_members.cend(), low,
+            [](const NodeAddress& n, const UInt160& n_id) {
+                return n.id() < n_id;
+            });
+        last = std::upper_bound(
+            first, m_members.cend(), high,
+            [](const UInt160& n_id, const NodeAddress& n) {
+                return n_id < n.id();
+            });
+        if (static_cast<size_t>(last - first) >= nb_nodes) {
+            break;
+        }
+        first = m_members.cbegin();
+        last = m_members.cend();
+    }
+
+    std::vector<NodeAddress> nearest(first, last);
+    const auto n_nodes = std::min<size_t>(nb_nodes, nearest.size());
+    std::partial_sort(nearest.begin(), nearest.begin() + n_nodes,
+                      nearest.end(), ByDistanceFrom(target_id));
+    nearest.erase(nearest.begin() + n_nodes, nearest.end());
+
+    return nearest;
+}
+
+template <typename NodeCom>
+bool Node<NodeCom>::add_member(const NodeAddress& addr)
+{
+    if (m_departed.count(addr.id()) != 0) {
+        return false;
+    }
+    const auto it = std::lower_bound(
+        m_members.begin(), m_members.end(), addr,
+        [](const NodeAddress& a, const NodeAddress& b) {
+            return a.id() < b.id();
+        });
+    if (it != m_members.end() && *it == addr) {
+        return false;
+    }
+    m_members.insert(it, addr);
+    return true;
+}
+
+template <typename NodeCom>
+bool Node<NodeCom>::remove_member(const NodeAddress& addr)
+{
+    m_departed.insert(addr.id());
+
+    const auto it = std::lower_bound(
+        m_members.begin(), m_members.end(), addr,
+        [](const NodeAddress& a, const NodeAddress& b) {
+            return a.id() < b.id();
+        });
+    if (it == m_members.end() || !(*it == addr)) {
+        return false;
+    }
+    m_members.erase(it);
+    return true;
+}
+
+template <typename NodeCom>
+void Node<NodeCom>::spread(const MemberEvent& event)
+{
+    m_rumors.push_back(event);
+}
+
+template <typename NodeCom>
+bool Node<NodeCom>::fetch_membership(const NodeAddress& contact)
+{
+    bool authoritative = false;
+    std::vector<NodeAddress> members = m_com_iface.find_node(
+        contact, id(), std::numeric_limits<uint32_t>::max(), authoritative);
+
+    if (members.empty()) {
+        return false;
+    }
+    m_gossip_stats.n_transferred += members.size();
+
+    members.push_back(contact);
+    members.insert(members.end(), m_members.begin(), m_members.end());
+    std::sort(members.begin(), members.end(),
+              [](const NodeAddress& a, const NodeAddress& b) {
+                  return a.id() < b.id();
+              });
+    members.erase(std::unique(members.begin(), members.end()), members.end());
+    members.erase(
+        std::remove_if(members.begin(), members.end(),
+                       [this](const NodeAddress& n) {
+                           return n == m_addr
+                                  || m_departed.count(n.id()) != 0;
+                       }),
+        members.end());
+    m_members.swap(members);
+
+    return true;
+}
+
+template <typename NodeCom>
+void Node<NodeCom>::gossip_join()
+{
+    spread({m_addr, true});
+}
+
+template <typename NodeCom>
+void Node<NodeCom>::gossip_round()
+{
+    if (m_rumors.empty()) {
+        return;
+    }
+
+    std::vector<MemberEvent> events;
+    events.swap(m_rumors);
+
+    uint32_t fanout = 1;
+    for (size_t n = m_members.size(); n > 1; n >>= 1) {
+        ++fanout;
+    }
+    for (uint32_t i = 0; i < fanout && !m_members.empty(); ++i) {
+        std::uniform_int_distribution<size_t> dis(0, m_members.size() - 1);
+        const NodeAddress peer = m_members[dis(prng())];
+
+        ++m_gossip_stats.n_messages;
+        m_gossip_stats.n_events += events.size();
+        if (!m_com_iface.gossip(peer, events)) {
+            on_unresponsive(peer);
+        }
+    }
+}
+
+template <typename NodeCom>
+void Node<NodeCom>::on_gossip(const std::vector<MemberEvent>& events)
+{
+    for (const auto& event : events) {
+        if (event.addr == m_addr) {
+            continue;
+        }
+        const bool news = event.joined ? add_member(event.addr)
+                                       : remove_member(event.addr);
+        if (news) {
+            spread(event);
+        }
+    }
+}
+
+template <typename NodeCom>
+void Node<NodeCom>::add_sibling(const NodeAddress& addr)
+{
+    if (m_n_siblings == 0) {
+        return;
+    }
+
+    const auto it = std::lower_bound(m_siblings.begin(), m_siblings.end(),
+                                     addr, ByDistanceFrom(m_addr.id()));
+    // Already known.
+    if (it != m_siblings.end() && *it == addr) {
+        return;
+    }
+    const auto pos = it - m_siblings.begin();
+    if (m_siblings.size() == m_n_siblings) {
+        // Farther than all the siblings.
+        if (it == m_siblings.end()) {
+            return;
+        }
+        m_siblings.pop_back();
+    }
+    m_siblings.insert(m_siblings.begin() + pos, addr);
+}
+
+template <typename NodeCom>
+void Node<NodeCom>::remove_sibling(const NodeAddress& addr)
+{
+    const auto it = std::find(m_siblings.begin(), m_siblings.end(), addr);
+
+    if (it != m_siblings.end()) {
+        m_siblings.erase(it);
+    }
+}
+
+template <typename NodeCom>
+size_t Node<NodeCom>::bucket_index(const UInt160& node_id) const
+{
+    const uint32_t bit_length = distance_to(node_id).bit_length();
+
+    if (m_layout == BucketLayout::FIXED) {
+        return bit_length;
+    }
+    return std::min<size_t>(m_keysize - bit_length, m_buckets.size() - 1);
+}
+
+template <typename NodeCom>
+void Node<NodeCom>::split_bucket()
+{
+    std::list<NodeAddress> contacts;
+    std::list<NodeAddress> replacements;
+
+    contacts.swap(m_buckets.back());
+    replacements.swap(m_replacements.back());
+    m_buckets.emplace_back();
+    m_replacements.emplace_back();
+    DHT_VLOG(5) << id() << ": split the " << m_buckets.size() - 2 << "-bucket";
+
+    // Dispatch the contacts between the two halves (keeping their order).
+    for (const auto& addr : contacts) {
+        m_buckets[bucket_index(addr.id())].push_back(addr);
+    }
+    for (const auto& addr : replacements) {
+        m_replacements[bucket_index(addr.id())].push_back(addr);
+    }
+}
+
+template <typename NodeCom>
+bool Node<NodeCom>::is_near(const NodeAddress& addr, size_t bucket) const
+{
+    const UInt160 distance(distance_to(addr.id()));
+    uint32_t n_closer = 0;
+
+    // Closer contacts can only be in this bucket or in the following ones.
+    for (size_t i = bucket; i < m_buckets.size(); ++i) {
+        for (const auto& contact : m_buckets[i]) {
+            if (distance_to(contact.id()) < distance && ++n_closer >= m_k) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <typename NodeCom>
+void Node<NodeCom>::flush_pings()
+{
+    std::vector<NodeAddress> to_ping;
+
+    to_ping.swap(m_ping_queue);
+    m_ping_scheduled.clear();
+
+    for (const auto& addr : to_ping) {
+        std::list<NodeAddress>& bucket = m_buckets[bucket_index(addr.id())];
+
+        const auto it = std::find(bucket.begin(), bucket.end(), addr);
+        // Already evicted.
+        if (it == bucket.end()) {
+            continue;
+        }
+        DHT_LOG(TRACE) << "node " << id() << ": send PING to " << addr;
+        if (m_com_iface.ping(addr)) {
+            bucket.splice(bucket.begin(), bucket, it);
+        } else {
+            evict(addr);
+        }
+    }
 }
 
 template <typename NodeCom>
 std::vector<NodeAddress> Node<NodeCom>::send_find_node(
     const std::vector<NodeAddress>& nodes_to_query,
     const UInt160& target_id,
-    std::unordered_set<UInt160>& queried)
+    std::unordered_set<UInt160>& queried,
+    std::unordered_set<UInt160>& unresponsive,
+    std::vector<NodeAddress>* authoritative,
+    ValueSearch* search)
 {
     std::vector<NodeAddress> answers;
 
+    // The queries are sent in parallel: one round trip.
+    if (!nodes_to_query.empty()) {
+        ++m_lookup_stats.n_rounds;
+        m_lookup_stats.n_queries += nodes_to_query.size();
+        m_lookup_stats.n_messages += nodes_to_query.size();
+    }
     for (auto& remote_node : nodes_to_query) {
-        DHT_LOG(TRACE) << "node " << id()
-                       << ": send FIND_NODE(" << target_id << ", " <<  m_k
-                       << ") to " << remote_node;
-        const auto nodes = m_com_iface.find_node(remote_node, target_id, m_k);
+        bool is_authoritative = false;
+        std::vector<NodeAddress> nodes;
+
+        if (search != nullptr) {
+            DHT_LOG(TRACE) << "node " << id() << ": send FIND_VALUE("
+                           << target_id << ", " << m_k << ") to "
+                           << remote_node;
+            FindValueAnswer answer;
+
+            if (m_com_iface.find_value(remote_node, target_id, m_k, answer)) {
+                if (answer.found) {
+                    DHT_VLOG(3) << "value found on " << remote_node;
+                    search->value = answer.value;
+                    search->found = true;
+                    search->hot = answer.hot;
+                    queried.insert(remote_node.id());
+                    refresh_routing_table(remote_node);
+                    break;
+                }
+                search->missed.push_back(remote_node);
+                nodes = std::move(answer.nodes);
+            }
+        } else {
+            DHT_LOG(TRACE) << "node " << id() << ": send FIND_NODE("
+                           << target_id << ", " << m_k << ") to "
+                           << remote_node;
+            nodes = m_com_iface.find_node(
+                remote_node, target_id, m_k, is_authoritative);
+        }
 
         // Don't add ourselves into the list of answers.
         std::copy_if(nodes.cbegin(), nodes.cend(), back_inserter(answers),
                      [this](const NodeAddress& n) { return n.id() != id(); });
         queried.insert(remote_node.id());
+        if (nodes.empty()) {
+            unresponsive.insert(remote_node.id());
+            ++m_lookup_stats.n_unresponsive;
+            on_unresponsive(remote_node);
+        } else {
+            refresh_routing_table(remote_node);
+        }
 
         DHT_VLOG(5) << "from " << remote_node
                     << ": nodes(" << nodes.size() << ")=" << nodes;
+
+        // The remote node knows the closest nodes for sure: we're done.
+        if (is_authoritative && authoritative != nullptr) {
+            std::copy_if(
+                nodes.cbegin(), nodes.cend(), back_inserter(*authoritative),
+                [this](const NodeAddress& n) { return n.id() != id(); });
+            if (!authoritative->empty()) {
+                break;
+            }
+        }
     }
 
     std::sort(answers.begin(), answers.end(), ByDistanceFrom(target_id));
@@ -235,17 +951,17 @@ std::vector<NodeAddress> Node<NodeCom>::send_find_node(
     return answers;
 }
 
-/* Remove the nodes already queried from `nodes`. */
-static inline void remove_queried_nodes(
+/* Remove the nodes belonging to `set` (e.g. already queried) from `nodes`. */
+static inline void remove_nodes(
     std::vector<NodeAddress>& nodes,
-    const std::unordered_set<UInt160>& queried)
+    const std::unordered_set<UInt160>& set)
 {
     nodes.erase(
         std::remove_if(
             nodes.begin(),
             nodes.end(),
-            [&queried](const NodeAddress& n) {
-                return queried.find(n.id()) != queried.end();
+            [&set](const NodeAddress& n) {
+                return set.find(n.id()) != set.end();
             }),
         nodes.end());
 }
@@ -290,16 +1006,60 @@ static inline bool is_subset(
 
 template <typename NodeCom>
 std::vector<NodeAddress> Node<NodeCom>::node_lookup(const UInt160& target_id)
+{
+    std::vector<NodeAddress> nodes;
+
+    ++m_lookup_stats.n_lookups;
+    // We know every node: no need to ask anyone.
+    if (m_layout == BucketLayout::FULL) {
+        return find_member(target_id, m_k);
+    }
+    // Looking up our own ID is how we check our sibling list: no shortcut.
+    if (target_id != id() && cached_lookup(target_id, nodes)) {
+        return nodes;
+    }
+    nodes = iterative_lookup(target_id, nullptr);
+    if (target_id != id()) {
+        cache_lookup(target_id, nodes);
+    }
+    return nodes;
+}
+
+template <typename NodeCom>
+std::vector<NodeAddress>
+Node<NodeCom>::iterative_lookup(
+    const UInt160& target_id,
+    ValueSearch* search)
 {
     std::unordered_set<UInt160> queried({m_addr.id()});
+    std::unordered_set<UInt160> unresponsive;
     std::vector<NodeAddress> answers;
+    std::vector<NodeAddress> shortlist;
+    std::vector<NodeAddress> authoritative;
+    bool is_sibling = false;
     unsigned round = 0;
+    // Looking up our own ID is how we check our sibling list: no shortcut.
+    const bool self_lookup = target_id == id();
+    // FIND_VALUE answers are never authoritative.
+    std::vector<NodeAddress>* const shortcut =
+        self_lookup || search != nullptr ? nullptr : &authoritative;
 
     DHT_VLOG(1) << "node lookup for " << target_id;
 
-    // Query the α nodes locally known as the closest to the target.
-    std::vector<NodeAddress> to_query = find_node(target_id, m_alpha);
-    answers = send_find_node(to_query, target_id, queried);
+    // Query the α nodes locally known as the closest to the target (the
+    // other known k-closest are kept as fallback, should they not answer).
+    shortlist = find_node(target_id, m_k, is_sibling);
+    // The target is in our own neighborhood: no need to ask anyone (but
+    // the holders of the value).
+    if (is_sibling && !self_lookup && search == nullptr) {
+        remove_nodes(shortlist, queried);
+        ++m_lookup_stats.n_authoritative;
+        return shortlist;
+    }
+    std::vector<NodeAddress> to_query;
+    safe_copy_n(shortlist, m_alpha, to_query);
+    answers = send_find_node(
+        to_query, target_id, queried, unresponsive, shortcut, search);
 
     DHT_VLOG(3) << "INIT: to_query: " << to_query.size()
                 << ", queried: " << queried.size()
@@ -307,6 +1067,13 @@ std::vector<NodeAddress> Node<NodeCom>::node_lookup(const UInt160& target_id)
     DHT_VLOG(5) << "INIT: to_query(" << to_query.size() << ")=" << to_query;
     DHT_VLOG(5) << "INIT: answers("  << answers.size()  << ")=" << answers;
     DHT_VLOG(7) << "INIT: queried("  << queried.size()  << ")=" << queried;
+    if (search != nullptr && search->found) {
+        return {};
+    }
+    if (!authoritative.empty()) {
+        ++m_lookup_stats.n_authoritative;
+        return authoritative;
+    }
 
     while (true) {
 #define ROUND_VLOG(_level)  DHT_VLOG(_level) << "ROUND " << round << ": "
@@ -314,46 +1081,75 @@ std::vector<NodeAddress> Node<NodeCom>::node_lookup(const UInt160& target_id)
         DHT_VLOG(3) << "lookup node: ROUND " << ++round;
         std::vector<NodeAddress> k_nodes;
 
-        // From the answers of the previous round, only keep the k-closest.
+        // Merge the answers of the previous round with the closest nodes
+        // known so far (so that a round without answers, e.g. only dead
+        // nodes queried, doesn't lose them) and only keep the k-closest
+        // nodes that answered (or haven't been queried yet).
+        answers.insert(answers.end(), shortlist.begin(), shortlist.end());
+        std::sort(answers.begin(), answers.end(), ByDistanceFrom(target_id));
+        answers.erase(
+            std::unique(answers.begin(), answers.end()), answers.end());
+        remove_nodes(answers, unresponsive);
         safe_copy_n(answers, m_k, k_nodes);
+        shortlist = k_nodes;
         ROUND_VLOG(5) << "k_nodes(" << k_nodes.size() <<  ")= " << k_nodes;
 
         // For querying, only keep the new nodes.
         std::vector<NodeAddress> k_new_nodes(k_nodes);
-        remove_queried_nodes(k_new_nodes, queried);
+        remove_nodes(k_new_nodes, queried);
         ROUND_VLOG(5) << "k_new_nodes(" << k_new_nodes.size()
                       <<  ")= " << k_new_nodes;
 
         // Query α nodes from the k-closest.
         to_query.clear();
         safe_copy_n(k_new_nodes, m_alpha, to_query);
-        answers = send_find_node(to_query, target_id, queried);
+        answers = send_find_node(
+            to_query, target_id, queried, unresponsive, shortcut, search);
         ROUND_VLOG(3) << "queried alpha nodes";
         ROUND_VLOG(5) << "to_query(" << to_query.size() << ")=" << to_query;
         ROUND_VLOG(5) << "answers("  << answers.size()  << ")=" << answers;
         ROUND_VLOG(7) << "queried("  << queried.size()  << ")=" << queried;
+        if (search != nullptr && search->found) {
+            return {};
+        }
+        if (!authoritative.empty()) {
+            ++m_lookup_stats.n_authoritative;
+            return authoritative;
+        }
 
         // We already have queried (and got an answer) from the k closest nodes
         // we know: return them.
         if (to_query.empty() && is_subset(k_nodes, queried)) {
             DHT_VLOG(1) << "found " << k_nodes.size()
                         << " nodes for " << target_id << ": " << k_nodes;
+            if (self_lookup) {
+                m_siblings_ready = true;
+            }
             return k_nodes;
         }
 
         // If we haven't found a closer node, we query the remaining nodes.
         if (!has_found_closer_nodes(k_nodes, answers, target_id)) {
-            const auto rem_begin = k_new_nodes.begin() + m_alpha;
+            const size_t n_sent = std::min<size_t>(m_alpha, k_new_nodes.size());
+            const auto rem_begin = k_new_nodes.begin() + n_sent;
 
             to_query.clear();
             std::copy(rem_begin, k_new_nodes.end(), back_inserter(to_query));
 
-            const auto new_ans(send_find_node(to_query, target_id, queried));
+            const auto new_ans(send_find_node(
+                to_query, target_id, queried, unresponsive, shortcut, search));
             answers.insert(answers.end(), new_ans.begin(), new_ans.end());
             ROUND_VLOG(5) << "queried remaining nodes";
             ROUND_VLOG(5) << "to_query(" << to_query.size() << ")=" << to_query;
             ROUND_VLOG(5) << "answers("  << answers.size()  << ")=" << answers;
             ROUND_VLOG(7) << "queried("  << queried.size()  << ")=" << queried;
+            if (search != nullptr && search->found) {
+                return {};
+            }
+            if (!authoritative.empty()) {
+                ++m_lookup_stats.n_authoritative;
+                return authoritative;
+            }
         }
 
         ROUND_VLOG(3) << "to_query: " << to_query.size()
@@ -367,5 +1163,331 @@ std::vector<NodeAddress> Node<NodeCom>::node_lookup(const UInt160& target_id)
     return {};
 }
 
+template <typename NodeCom>
+std::vector<std::vector<NodeAddress>>
+Node<NodeCom>::node_lookup(const std::vector<UInt160>& targets)
+{
+    // State of a lookup still in progress.
+    struct Lookup {
+        size_t target;                      // Index in `targets`.
+        std::vector<NodeAddress> shortlist; // k closest nodes known so far.
+        std::unordered_set<UInt160> queried;
+        bool stalled; // No closer node found by the last round.
+    };
+    std::vector<std::vector<NodeAddress>> results(targets.size());
+    std::vector<Lookup> pending;
+    std::unordered_set<UInt160> unresponsive;
+    const auto not_self = [this](const NodeAddress& n) {
+        return n.id() != id();
+    };
+
+    DHT_VLOG(1) << "node lookup for " << targets.size() << " targets";
+    m_lookup_stats.n_lookups += targets.size();
+
+    for (size_t i = 0; i < targets.size(); ++i) {
+        // We know every node: no need to ask anyone.
+        if (m_layout == BucketLayout::FULL) {
+            results[i] = find_member(targets[i], m_k);
+            continue;
+        }
+        if (targets[i] != id() && cached_lookup(targets[i], results[i])) {
+            continue;
+        }
+        bool is_sibling = false;
+        Lookup lookup{
+            i, find_node(targets[i], m_k, is_sibling), {id()}, false};
+
+        remove_nodes(lookup.shortlist, lookup.queried);
+        // The target is in our own neighborhood: no need to ask anyone.
+        if (is_sibling && targets[i] != id()) {
+            ++m_lookup_stats.n_authoritative;
+            results[i] = std::move(lookup.shortlist);
+            continue;
+        }
+        pending.push_back(std::move(lookup));
+    }
+
+    while (!pending.empty()) {
+        // Query the α closest nodes not queried yet of each lookup (all the
+        // remaining k closest if the last round didn't get closer), grouping
+        // the targets by queried node: one message per node.
+        std::unordered_map<UInt160, size_t> message_of;
+        std::vector<NodeAddress> to_query;
+        std::vector<std::vector<size_t>> messages;
+
+        for (size_t j = 0; j < pending.size(); ++j) {
+            const uint32_t n_max = pending[j].stalled ? m_k : m_alpha;
+            uint32_t n_picked = 0;
+
+            for (const auto& addr : pending[j].shortlist) {
+                if (n_picked == n_max) {
+                    break;
+                }
+                if (!pending[j].queried.insert(addr.id()).second) {
+                    continue;
+                }
+                const auto it = message_of.emplace(addr.id(), to_query.size());
+                if (it.second) {
+                    to_query.push_back(addr);
+                    messages.emplace_back();
+                }
+                messages[it.first->second].push_back(j);
+                ++n_picked;
+            }
+            if (n_picked != 0) {
+                ++m_lookup_stats.n_rounds;
+            }
+        }
+
+        // The messages are sent in parallel: one round trip.
+        std::vector<NodeAddress> learned;
+        std::vector<bool> done(pending.size(), false);
+        for (size_t m = 0; m < to_query.size(); ++m) {
+            std::vector<UInt160> message_targets;
+            std::vector<FindNodeAnswer> answers;
+
+            for (const size_t j : messages[m]) {
+                message_targets.push_back(targets[pending[j].target]);
+            }
+            DHT_LOG(TRACE) << "node " << id() << ": send FIND_NODE("
+                           << message_targets.size() << " targets, " << m_k
+                           << ") to " << to_query[m];
+            ++m_lookup_stats.n_messages;
+            m_lookup_stats.n_queries += message_targets.size();
+            if (!m_com_iface.find_nodes(
+                    to_query[m], message_targets, m_k, answers)) {
+                unresponsive.insert(to_query[m].id());
+                m_lookup_stats.n_unresponsive += message_targets.size();
+                on_unresponsive(to_query[m]);
+                continue;
+            }
+            refresh_routing_table(to_query[m]);
+
+            for (size_t t = 0; t < answers.size() && t < messages[m].size();
+                 ++t) {
+                const size_t j = messages[m][t];
+                const Lookup& lookup = pending[j];
+                std::vector<NodeAddress> nodes;
+
+                std::copy_if(
+                    answers[t].nodes.cbegin(), answers[t].nodes.cend(),
+                    back_inserter(nodes), not_self);
+                // The remote node knows the closest nodes for sure: done.
+                if (answers[t].authoritative && !done[j] && !nodes.empty()
+                    && targets[lookup.target] != id()) {
+                    ++m_lookup_stats.n_authoritative;
+                    results[lookup.target] = nodes;
+                    done[j] = true;
+                }
+                learned.insert(learned.end(), nodes.begin(), nodes.end());
+            }
+        }
+        std::sort(
+            learned.begin(), learned.end(),
+            [](const NodeAddress& a, const NodeAddress& b) {
+                return a.id() < b.id();
+            });
+        learned.erase(std::unique(learned.begin(), learned.end()),
+                      learned.end());
+        remove_nodes(learned, unresponsive);
+
+        // Every lookup merges the nodes learned during the round (whatever
+        // the target they were asked for) into its shortlist, and is over
+        // once its k closest nodes have all answered.
+        std::vector<Lookup> still_pending;
+        for (size_t j = 0; j < pending.size(); ++j) {
+            Lookup& lookup = pending[j];
+            const UInt160& target_id = targets[lookup.target];
+            std::vector<NodeAddress>& shortlist = lookup.shortlist;
+
+            if (done[j]) {
+                continue;
+            }
+            remove_nodes(shortlist, unresponsive);
+            const bool had_nodes = !shortlist.empty();
+            const UInt160 best(
+                had_nodes ? compute_distance(shortlist.front().id(), target_id)
+                          : UInt160());
+            const bool full = shortlist.size() >= m_k;
+            const UInt160 farthest(
+                full ? compute_distance(shortlist.back().id(), target_id)
+                     : UInt160());
+            for (const auto& addr : learned) {
+                if (!full
+                    || compute_distance(addr.id(), target_id) < farthest) {
+                    shortlist.push_back(addr);
+                }
+            }
+            std::sort(
+                shortlist.begin(), shortlist.end(), ByDistanceFrom(target_id));
+            shortlist.erase(
+                std::unique(shortlist.begin(), shortlist.end()),
+                shortlist.end());
+            if (shortlist.size() > m_k) {
+                shortlist.erase(shortlist.begin() + m_k, shortlist.end());
+            }
+            const bool closer =
+                !shortlist.empty()
+                && compute_distance(shortlist.front().id(), target_id) < best;
+            lookup.stalled = had_nodes && !closer;
+
+            if (is_subset(shortlist, lookup.queried)) {
+                DHT_VLOG(1) << "found " << shortlist.size() << " nodes for "
+                            << target_id << ": " << shortlist;
+                if (target_id == id()) {
+                    m_siblings_ready = true;
+                }
+                results[lookup.target] = std::move(shortlist);
+            } else {
+                still_pending.push_back(std::move(lookup));
+            }
+        }
+        pending.swap(still_pending);
+    }
+    for (size_t i = 0; i < targets.size(); ++i) {
+        if (targets[i] != id() && m_layout != BucketLayout::FULL) {
+            cache_lookup(targets[i], results[i]);
+        }
+    }
+    return results;
+}
+
+/** Look up `target_id` in the lookup cache, and validate the entry found.
+ *
+ * The closest cached node to the target is asked for the closest nodes it
+ * knows (the closest nodes to a target know its neighborhood): the entry is
+ * stale if one of them is closer to the target, otherwise their answer is
+ * merged into the entry (catching up with the newcomers).
+ *
+ * @param target_id the targeted node.
+ * @param nodes     set to the k closest nodes, if found.
+ * @return true if the cache answered, false otherwise.
+ */
+template <typename NodeCom>
+bool Node<NodeCom>::cached_lookup(
+    const UInt160& target_id,
+    std::vector<NodeAddress>& nodes)
+{
+    if (m_lookup_cache_size == 0) {
+        return false;
+    }
+    const auto it = m_lookup_cache_index.find(cache_prefix(target_id));
+    if (it == m_lookup_cache_index.end()) {
+        ++m_lookup_cache_stats.n_misses;
+        return false;
+    }
+    if (it->second->expiry <= m_clock) {
+        m_lookup_cache.erase(it->second);
+        m_lookup_cache_index.erase(it);
+        ++m_lookup_cache_stats.n_expired;
+        ++m_lookup_cache_stats.n_misses;
+        return false;
+    }
+    std::vector<NodeAddress> candidates(it->second->nodes);
+    std::sort(candidates.begin(), candidates.end(), ByDistanceFrom(target_id));
+    const NodeAddress closest(candidates.front());
+    const UInt160 best(compute_distance(closest.id(), target_id));
+    std::vector<FindNodeAnswer> answers;
+
+    DHT_LOG(TRACE) << "node " << id() << ": send FIND_NODE(" << target_id
+                   << ", " << m_k << ") to " << closest << " (validation)";
+    ++m_lookup_stats.n_rounds;
+    ++m_lookup_stats.n_queries;
+    ++m_lookup_stats.n_messages;
+    // Unlike an empty answer (a node knowing nobody), no answer at all is
+    // a failure.
+    if (!m_com_iface.find_nodes(closest, {target_id}, m_k, answers)
+        || answers.size() != 1) {
+        ++m_lookup_stats.n_unresponsive;
+        ++m_lookup_cache_stats.n_misses;
+        // Drops the entry (and the others holding this contact).
+        on_unresponsive(closest);
+        return false;
+    }
+    refresh_routing_table(closest);
+
+    for (const auto& addr : answers.front().nodes) {
+        if (addr.id() == id()) {
+            continue;
+        }
+        candidates.push_back(addr);
+        if (compute_distance(addr.id(), target_id) < best) {
+            DHT_VLOG(3) << "stale lookup cache entry for " << target_id;
+            const auto stale = m_lookup_cache_index.find(
+                cache_prefix(target_id));
+            if (stale != m_lookup_cache_index.end()) {
+                m_lookup_cache.erase(stale->second);
+                m_lookup_cache_index.erase(stale);
+            }
+            ++m_lookup_cache_stats.n_stale;
+            ++m_lookup_cache_stats.n_misses;
+            return false;
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), ByDistanceFrom(target_id));
+    candidates.erase(
+        std::unique(candidates.begin(), candidates.end()), candidates.end());
+    if (candidates.size() > m_k) {
+        candidates.erase(candidates.begin() + m_k, candidates.end());
+    }
+    const auto entry = m_lookup_cache_index.find(cache_prefix(target_id));
+    if (entry != m_lookup_cache_index.end()) {
+        entry->second->nodes = candidates;
+        m_lookup_cache.splice(
+            m_lookup_cache.begin(), m_lookup_cache, entry->second);
+    }
+    ++m_lookup_cache_stats.n_hits;
+    nodes = std::move(candidates);
+    return true;
+}
+
+/** Cache the k closest nodes found for `target_id` (under its prefix). */
+template <typename NodeCom>
+void Node<NodeCom>::cache_lookup(
+    const UInt160& target_id,
+    const std::vector<NodeAddress>& nodes)
+{
+    if (m_lookup_cache_size == 0 || nodes.empty()) {
+        return;
+    }
+    const UInt160 prefix(cache_prefix(target_id));
+    const uint64_t expiry = m_clock + m_lookup_cache_ttl;
+    const auto it = m_lookup_cache_index.find(prefix);
+
+    if (it != m_lookup_cache_index.end()) {
+        it->second->nodes = nodes;
+        it->second->expiry = expiry;
+        m_lookup_cache.splice(
+            m_lookup_cache.begin(), m_lookup_cache, it->second);
+        return;
+    }
+    m_lookup_cache.push_front(CachedLookup{prefix, nodes, expiry});
+    m_lookup_cache_index.emplace(prefix, m_lookup_cache.begin());
+    if (m_lookup_cache.size() > m_lookup_cache_size) {
+        m_lookup_cache_index.erase(m_lookup_cache.back().prefix);
+        m_lookup_cache.pop_back();
+    }
+}
+
+/** Drop the cache entries holding the node `node_id` (which failed). */
+template <typename NodeCom>
+void Node<NodeCom>::uncache_contact(const UInt160& node_id)
+{
+    for (auto it = m_lookup_cache.begin(); it != m_lookup_cache.end();) {
+        const auto found = std::find_if(
+            it->nodes.cbegin(), it->nodes.cend(),
+            [&node_id](const NodeAddress& n) { return n.id() == node_id; });
+
+        if (found == it->nodes.cend()) {
+            ++it;
+            continue;
+        }
+        m_lookup_cache_index.erase(it->prefix);
+        it = m_lookup_cache.erase(it);
+        ++m_lookup_cache_stats.n_invalidated;
+    }
+}
+
 } // namespace dht
 } // namespace dcss
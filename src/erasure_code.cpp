@@ -0,0 +1,281 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "erasure_code.h"
+#include "exceptions.h"
+
+namespace dcss {
+
+// Words are 2-byte long (the FNT works in GF(65537)).
+static const unsigned WORD_SIZE = 2;
+// Number of words per packet.
+static const size_t PKT_SIZE = 64;
+// Fragments size must be a multiple of the packet size (in bytes).
+static const uint64_t ALIGNMENT = WORD_SIZE * PKT_SIZE;
+
+// Fragment header: index (4 bytes), payload size (8 bytes), props size (4).
+static const size_t HEADER_SIZE = 4 + 8 + 4;
+
+/** A parsed fragment. */
+struct FragmentView {
+    uint32_t index;
+    uint64_t size;
+    std::string props;
+    Buffer payload;
+};
+
+static void put_uint(std::vector<uint8_t>& out, uint64_t v, unsigned n_bytes)
+{
+    for (unsigned i = 0; i < n_bytes; ++i) {
+        out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+}
+
+static uint64_t get_uint(const uint8_t* in, unsigned n_bytes)
+{
+    uint64_t v = 0;
+
+    for (unsigned i = 0; i < n_bytes; ++i) {
+        v |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return v;
+}
+
+static Buffer make_fragment(
+    uint32_t index,
+    uint64_t size,
+    const std::string& props,
+    const uint8_t* payload,
+    size_t payload_size)
+{
+    std::vector<uint8_t> bytes;
+
+    bytes.reserve(HEADER_SIZE + props.size() + payload_size);
+    put_uint(bytes, index, 4);
+    put_uint(bytes, size, 8);
+    put_uint(bytes, props.size(), 4);
+    bytes.insert(bytes.end(), props.begin(), props.end());
+    bytes.insert(bytes.end(), payload, payload + payload_size);
+
+    return Buffer(std::move(bytes));
+}
+
+static FragmentView parse_fragment(const Buffer& fragment)
+{
+    if (fragment.size() < HEADER_SIZE) {
+        throw DomainError("truncated fragment header");
+    }
+    const uint8_t* bytes = fragment.data();
+    const auto index = static_cast<uint32_t>(get_uint(bytes, 4));
+    const uint64_t size = get_uint(bytes + 4, 8);
+    const size_t props_size = get_uint(bytes + 4 + 8, 4);
+
+    if (fragment.size() < HEADER_SIZE + props_size) {
+        throw DomainError("truncated fragment properties");
+    }
+    const auto props_begin = bytes + HEADER_SIZE;
+    const size_t payload_offset = HEADER_SIZE + props_size;
+
+    return {
+        index,
+        size,
+        std::string(props_begin, props_begin + props_size),
+        fragment.slice(payload_offset, fragment.size() - payload_offset),
+    };
+}
+
+// Return `n_data`, once the parameters are checked: QuadIron must not see
+// an empty code.
+static uint32_t checked_n_data(uint32_t n_data, uint32_t n_parities)
+{
+    if (n_data == 0 || n_parities == 0) {
+        throw DomainError("erasure code needs data and parity fragments");
+    }
+    return n_data;
+}
+
+ErasureCode::ErasureCode(uint32_t n_data, uint32_t n_parities)
+    : m_n_data(checked_n_data(n_data, n_parities)), m_n_parities(n_parities),
+      m_fec(
+          quadiron::fec::FecType::SYSTEMATIC,
+          WORD_SIZE,
+          n_data,
+          n_parities,
+          PKT_SIZE)
+{
+}
+
+uint64_t ErasureCode::fragment_size(uint64_t size) const
+{
+    const uint64_t per_fragment = (size + m_n_data - 1) / m_n_data;
+
+    return (per_fragment + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+std::vector<Buffer> ErasureCode::encode(const Buffer& data)
+{
+    const uint64_t frag_size = fragment_size(data.size());
+    std::vector<Buffer> fragments;
+
+    // Pad the payload so that it can be evenly split.
+    std::string padded(data.begin(), data.end());
+    padded.resize(frag_size * m_n_data, '\0');
+
+    std::vector<std::unique_ptr<std::istringstream>> data_streams;
+    std::vector<std::unique_ptr<std::ostringstream>> parity_streams;
+    std::vector<std::istream*> d_bufs;
+    std::vector<std::ostream*> c_bufs;
+    std::vector<quadiron::Properties> c_props(m_n_parities);
+
+    for (uint32_t i = 0; i < m_n_data; ++i) {
+        data_streams.push_back(std::make_unique<std::istringstream>(
+            padded.substr(i * frag_size, frag_size)));
+        d_bufs.push_back(data_streams.back().get());
+    }
+    for (uint32_t i = 0; i < m_n_parities; ++i) {
+        parity_streams.push_back(std::make_unique<std::ostringstream>());
+        c_bufs.push_back(parity_streams.back().get());
+    }
+    if (frag_size != 0) {
+        m_fec.encode_bufs(d_bufs, c_bufs, c_props);
+    }
+
+    fragments.reserve(n_fragments());
+    for (uint32_t i = 0; i < m_n_data; ++i) {
+        const auto begin = reinterpret_cast<const uint8_t*>(padded.data());
+        fragments.push_back(make_fragment(
+            i, data.size(), "", begin + i * frag_size, frag_size));
+    }
+    for (uint32_t i = 0; i < m_n_parities; ++i) {
+        std::ostringstream props;
+        props << c_props[i];
+
+        const std::string parity(parity_streams[i]->str());
+        fragments.push_back(make_fragment(
+            m_n_data + i,
+            data.size(),
+            props.str(),
+            reinterpret_cast<const uint8_t*>(parity.data()),
+            parity.size()));
+    }
+
+    return fragments;
+}
+
+Buffer ErasureCode::decode(const std::vector<Buffer>& fragments)
+{
+    std::map<uint32_t, FragmentView> available;
+
+    for (const auto& fragment : fragments) {
+        FragmentView view(parse_fragment(fragment));
+
+        if (view.index >= n_fragments()) {
+            throw DomainError("invalid fragment index");
+        }
+        if (!available.empty() && available.begin()->second.size != view.size) {
+            throw DomainError("fragments from different payloads");
+        }
+        available.emplace(view.index, std::move(view));
+    }
+    if (available.size() < m_n_data) {
+        throw DomainError("not enough fragments to decode");
+    }
+
+    const uint64_t size = available.begin()->second.size;
+    const uint64_t frag_size = fragment_size(size);
+
+    std::vector<std::unique_ptr<std::istringstream>> in_streams;
+    std::vector<std::unique_ptr<std::ostringstream>> out_streams(m_n_data);
+    std::vector<std::istream*> d_bufs(m_n_data, nullptr);
+    std::vector<std::istream*> c_bufs(m_n_parities, nullptr);
+    std::vector<std::ostream*> r_bufs(m_n_data, nullptr);
+    std::vector<quadiron::Properties> c_props(m_n_parities);
+    bool missing_data = false;
+
+    for (const auto& it : available) {
+        const FragmentView& view = it.second;
+
+        in_streams.push_back(
+            std::make_unique<std::istringstream>(view.payload.to_string()));
+        if (view.index < m_n_data) {
+            d_bufs[view.index] = in_streams.back().get();
+        } else {
+            const uint32_t idx = view.index - m_n_data;
+            std::istringstream props(view.props);
+
+            c_bufs[idx] = in_streams.back().get();
+            props >> c_props[idx];
+        }
+    }
+    for (uint32_t i = 0; i < m_n_data; ++i) {
+        if (d_bufs[i] == nullptr) {
+            out_streams[i] = std::make_unique<std::ostringstream>();
+            r_bufs[i] = out_streams[i].get();
+            missing_data = true;
+        }
+    }
+    if (missing_data && frag_size != 0) {
+        if (!m_fec.decode_bufs(d_bufs, c_bufs, c_props, r_bufs)) {
+            throw DomainError("cannot decode the fragments");
+        }
+    }
+
+    // Reassemble the payload and strip the padding.
+    std::vector<uint8_t> bytes;
+    bytes.reserve(frag_size * m_n_data);
+    for (uint32_t i = 0; i < m_n_data; ++i) {
+        const auto it = available.find(i);
+
+        if (it != available.end()) {
+            const Buffer& payload = it->second.payload;
+            bytes.insert(bytes.end(), payload.begin(), payload.end());
+        } else {
+            const std::string rebuilt(out_streams[i]->str());
+            bytes.insert(bytes.end(), rebuilt.begin(), rebuilt.end());
+        }
+    }
+    if (bytes.size() < size) {
+        throw DomainError("decoded payload is truncated");
+    }
+    bytes.resize(size);
+
+    return Buffer(std::move(bytes));
+}
+
+uint32_t ErasureCode::fragment_index(const Buffer& fragment)
+{
+    return parse_fragment(fragment).index;
+}
+
+} // namespace dcss
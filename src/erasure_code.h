@@ -0,0 +1,127 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_ERASURE_CODE_H__
+#define __DCSS_ERASURE_CODE_H__
+
+#include <cstdint>
+#include <vector>
+
+#include <quadiron/quadiron.h>
+
+#include "buffer.h"
+
+namespace dcss {
+
+/** Systematic erasure code, built upon QuadIron's NTT-based Reed-Solomon.
+ *
+ * A payload is split into `n_data` data fragments, from which `n_parities`
+ * parity fragments are computed. The payload can be rebuilt from any
+ * `n_data` fragments out of the `n_data + n_parities`.
+ *
+ * Each encoded fragment is self-describing (it embeds its index, the size of
+ * the original payload and the properties needed by the decoder), so a reader
+ * only needs to collect enough fragments to decode.
+ *
+ * @note an instance is not thread-safe: use one instance per thread.
+ */
+class ErasureCode {
+  public:
+    /** Create a new code.
+     *
+     * @param n_data     number of data fragments
+     * @param n_parities number of parity fragments
+     *
+     * @throw DomainError — invalid parameters.
+     */
+    ErasureCode(uint32_t n_data, uint32_t n_parities);
+
+    /** Return the number of data fragments. */
+    inline uint32_t n_data() const
+    {
+        return m_n_data;
+    }
+
+    /** Return the number of parity fragments. */
+    inline uint32_t n_parities() const
+    {
+        return m_n_parities;
+    }
+
+    /** Return the total number of fragments. */
+    inline uint32_t n_fragments() const
+    {
+        return m_n_data + m_n_parities;
+    }
+
+    /** Return the size of a fragment payload (padding included).
+     *
+     * @param size size of the original payload.
+     */
+    uint64_t fragment_size(uint64_t size) const;
+
+    /** Encode a payload.
+     *
+     * @param data the payload to encode.
+     * @return the `n_fragments()` encoded fragments (data fragments first).
+     */
+    std::vector<Buffer> encode(const Buffer& data);
+
+    /** Rebuild a payload from its fragments.
+     *
+     * @param fragments at least `n_data()` distinct fragments (in any order).
+     * @return the original payload.
+     *
+     * @throw DomainError — not enough fragments or corrupted fragment.
+     */
+    Buffer decode(const std::vector<Buffer>& fragments);
+
+    /** Return the index of an encoded fragment.
+     *
+     * @throw DomainError — corrupted fragment.
+     */
+    static uint32_t fragment_index(const Buffer& fragment);
+
+    ~ErasureCode() = default;
+    ErasureCode(ErasureCode const&) = delete;
+    ErasureCode& operator=(ErasureCode const& x) = delete;
+    ErasureCode(ErasureCode&&) = delete;
+    ErasureCode& operator=(ErasureCode&& x) = delete;
+
+  private:
+    uint32_t m_n_data;     /**< Number of data fragments.   */
+    uint32_t m_n_parities; /**< Number of parity fragments. */
+
+    /** The underlying codec (FNT-based Reed-Solomon). */
+    quadiron::fec::RsFnt<uint32_t> m_fec;
+};
+
+} // namespace dcss
+
+#endif
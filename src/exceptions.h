@@ -57,6 +57,13 @@ class DomainError : public Exception {
     explicit DomainError(const char* reason) : Exception(reason) {}
 };
 
+/** An operation given up by its caller. */
+class CancelledError : public Exception {
+  public:
+    explicit CancelledError(const std::string& reason) : Exception(reason) {}
+    explicit CancelledError(const char* reason) : Exception(reason) {}
+};
+
 } // namespace dcss
 
 #endif
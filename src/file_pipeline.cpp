@@ -0,0 +1,433 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "erasure_code.h"
+#include "exceptions.h"
+#include "file_pipeline.h"
+
+namespace dcss {
+
+/** A stripe going through the pipeline. */
+struct Stripe {
+    Stripe(uint32_t stripe_idx, const UInt160& stripe_key)
+        : idx(stripe_idx), key(stripe_key), remaining(0), n_failures(0)
+    {
+    }
+
+    uint32_t idx;
+    UInt160 key;
+    Buffer data;
+    std::vector<Buffer> fragments;
+    /** Number of fragments not yet stored. */
+    std::atomic<uint32_t> remaining;
+    /** Number of fragments that couldn't be stored. */
+    std::atomic<uint32_t> n_failures;
+};
+
+/** A fragment waiting to be sent. */
+struct FragmentJob {
+    std::shared_ptr<Stripe> stripe;
+    uint32_t idx;
+};
+
+/** Bound the number of stripes in flight. */
+class Window {
+  public:
+    explicit Window(uint32_t size) : m_available(size), m_aborted(false) {}
+
+    /** Wait for a free slot.
+     *
+     * @return false if the window has been aborted.
+     */
+    bool acquire()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_cond.wait(lock, [this] { return m_aborted || m_available > 0; });
+        if (m_aborted) {
+            return false;
+        }
+        --m_available;
+        return true;
+    }
+
+    void release()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_available;
+        }
+        m_cond.notify_one();
+    }
+
+    void abort()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_aborted = true;
+        }
+        m_cond.notify_all();
+    }
+
+  private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    uint32_t m_available;
+    bool m_aborted;
+};
+
+/** Keep the first error raised by a stage. */
+class PipelineError {
+  public:
+    PipelineError() : m_failed(false) {}
+
+    void set(std::exception_ptr exn)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_exn) {
+            m_exn = std::move(exn);
+        }
+        m_failed = true;
+    }
+
+    bool failed() const
+    {
+        return m_failed;
+    }
+
+    void rethrow()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_exn) {
+            std::rethrow_exception(m_exn);
+        }
+    }
+
+  private:
+    std::mutex m_mutex;
+    std::exception_ptr m_exn;
+    std::atomic<bool> m_failed;
+};
+
+static void join_all(std::vector<std::thread>& threads)
+{
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+}
+
+FilePipeline::FilePipeline(
+    uint32_t n_data,
+    uint32_t n_parities,
+    uint32_t n_bits,
+    uint64_t stripe_size,
+    uint32_t n_workers,
+    uint32_t n_senders,
+    uint32_t max_in_flight)
+    : m_n_data(n_data), m_n_parities(n_parities), m_n_bits(n_bits),
+      m_stripe_size(stripe_size), m_n_workers(n_workers),
+      m_n_senders(n_senders), m_max_in_flight(max_in_flight)
+{
+    if (n_data == 0 || stripe_size == 0) {
+        throw DomainError("pipeline: empty stripes");
+    }
+    // Checked here: the codec of each worker is built in its thread.
+    if (n_parities == 0) {
+        throw DomainError("pipeline: no parity fragment");
+    }
+    if (n_workers == 0 || n_senders == 0 || max_in_flight == 0) {
+        throw DomainError("pipeline: no thread or no stripe in flight");
+    }
+}
+
+/** Read, encode and store a file.
+ *
+ * A fragment is allowed to be lost, as long as each stripe has at most
+ * `n_parities` lost fragments.
+ *
+ * @param key   key of the file
+ * @param input stream to read the file from (until EOF)
+ * @param store function used to store the fragments
+ * @return the manifest of the file (the keys of its stripes).
+ *
+ * @throw DomainError — a stripe couldn't be stored.
+ */
+std::unique_ptr<File> FilePipeline::put(
+    const UInt160& key,
+    std::istream& input,
+    const StoreFunc& store)
+{
+    const uint32_t n_fragments = m_n_data + m_n_parities;
+    Window window(m_max_in_flight);
+    PipelineError error;
+    BoundedQueue<std::shared_ptr<Stripe>> to_encode(m_max_in_flight);
+    BoundedQueue<FragmentJob> to_send(m_max_in_flight * n_fragments);
+    std::vector<std::thread> workers;
+    std::vector<std::thread> senders;
+
+    for (uint32_t i = 0; i < m_n_workers; ++i) {
+        workers.emplace_back([&] {
+            ErasureCode codec(m_n_data, m_n_parities);
+            std::shared_ptr<Stripe> stripe;
+
+            while (to_encode.pop(stripe)) {
+                if (error.failed()) {
+                    continue;
+                }
+                try {
+                    stripe->fragments = codec.encode(stripe->data);
+                    stripe->data = Buffer(); // Release the input bytes.
+                    stripe->remaining = n_fragments;
+                    for (uint32_t idx = 0; idx < n_fragments; ++idx) {
+                        to_send.push(FragmentJob{stripe, idx});
+                    }
+                } catch (...) {
+                    error.set(std::current_exception());
+                    window.abort();
+                }
+            }
+        });
+    }
+
+    for (uint32_t i = 0; i < m_n_senders; ++i) {
+        senders.emplace_back([&] {
+            FragmentJob job;
+
+            while (to_send.pop(job)) {
+                Stripe& stripe = *job.stripe;
+
+                if (!error.failed()) {
+                    try {
+                        const UInt160 frag_key(File::part_key(
+                            stripe.key, job.idx, n_fragments, m_n_bits));
+
+                        if (!store(frag_key, stripe.fragments[job.idx])) {
+                            ++stripe.n_failures;
+                        }
+                    } catch (...) {
+                        error.set(std::current_exception());
+                        window.abort();
+                    }
+                }
+                stripe.fragments[job.idx] = Buffer();
+                if (--stripe.remaining == 0) {
+                    if (stripe.n_failures > m_n_parities) {
+                        error.set(std::make_exception_ptr(DomainError(
+                            "pipeline: cannot store stripe "
+                            + std::to_string(stripe.idx))));
+                        window.abort();
+                    }
+                    window.release();
+                }
+                job.stripe.reset();
+            }
+        });
+    }
+
+    // Producer: cut the input into stripes.
+    std::vector<UInt160> stripe_keys;
+    std::vector<uint8_t> bytes;
+    while (input.good() && window.acquire()) {
+        bytes.resize(m_stripe_size);
+        input.read(
+            reinterpret_cast<char*>(bytes.data()),
+            static_cast<std::streamsize>(bytes.size()));
+        const auto n_read = static_cast<size_t>(input.gcount());
+        if (n_read == 0) {
+            window.release();
+            break;
+        }
+        bytes.resize(n_read);
+
+        const auto idx = static_cast<uint32_t>(stripe_keys.size());
+        auto stripe = std::make_shared<Stripe>(
+            idx, File::stripe_key(key, idx, m_n_bits));
+        stripe->data = Buffer(std::move(bytes));
+        bytes = std::vector<uint8_t>();
+        stripe_keys.push_back(stripe->key);
+        to_encode.push(std::move(stripe));
+    }
+
+    to_encode.close();
+    join_all(workers);
+    to_send.close();
+    join_all(senders);
+    error.rethrow();
+
+    return std::make_unique<File>(key, std::move(stripe_keys));
+}
+
+/** Fetch, decode and write a file.
+ *
+ * @param file   manifest of the file (as returned by `put`)
+ * @param output stream to write the file to
+ * @param fetch  function used to fetch the fragments
+ * @return the number of bytes written.
+ *
+ * @throw DomainError — a stripe couldn't be rebuilt.
+ */
+uint64_t FilePipeline::get(
+    const File& file,
+    std::ostream& output,
+    const FetchFunc& fetch)
+{
+    const uint32_t n_fragments = m_n_data + m_n_parities;
+    const std::vector<UInt160>& stripe_keys = file.parts();
+    Window window(m_max_in_flight);
+    PipelineError error;
+    BoundedQueue<std::shared_ptr<Stripe>> to_fetch(m_max_in_flight);
+    BoundedQueue<std::shared_ptr<Stripe>> to_decode(m_max_in_flight);
+    std::vector<std::thread> senders;
+    std::vector<std::thread> workers;
+
+    // Decoded stripes, waiting to be written in order.
+    std::mutex decoded_mutex;
+    std::condition_variable decoded_cond;
+    std::map<uint32_t, Buffer> decoded;
+
+    const auto fail = [&](std::exception_ptr exn) {
+        error.set(std::move(exn));
+        window.abort();
+        // Synchronize with the writer, to not miss its wake-up.
+        {
+            std::lock_guard<std::mutex> lock(decoded_mutex);
+        }
+        decoded_cond.notify_all();
+    };
+
+    // Feeder: schedule the stripes, within the limits of the window.
+    std::thread feeder([&] {
+        for (uint32_t idx = 0; idx < stripe_keys.size(); ++idx) {
+            if (!window.acquire()) {
+                break;
+            }
+            to_fetch.push(std::make_shared<Stripe>(idx, stripe_keys[idx]));
+        }
+        to_fetch.close();
+    });
+
+    for (uint32_t i = 0; i < m_n_senders; ++i) {
+        senders.emplace_back([&] {
+            std::shared_ptr<Stripe> stripe;
+
+            while (to_fetch.pop(stripe)) {
+                if (error.failed()) {
+                    continue;
+                }
+                try {
+                    // Any `n_data` fragments are enough.
+                    for (uint32_t idx = 0; idx < n_fragments; ++idx) {
+                        const UInt160 frag_key(File::part_key(
+                            stripe->key, idx, n_fragments, m_n_bits));
+                        Buffer value;
+
+                        if (fetch(frag_key, value)) {
+                            stripe->fragments.push_back(std::move(value));
+                        }
+                        if (stripe->fragments.size() == m_n_data) {
+                            break;
+                        }
+                    }
+                    to_decode.push(std::move(stripe));
+                } catch (...) {
+                    fail(std::current_exception());
+                }
+            }
+        });
+    }
+
+    for (uint32_t i = 0; i < m_n_workers; ++i) {
+        workers.emplace_back([&] {
+            ErasureCode codec(m_n_data, m_n_parities);
+            std::shared_ptr<Stripe> stripe;
+
+            while (to_decode.pop(stripe)) {
+                if (error.failed()) {
+                    continue;
+                }
+                try {
+                    Buffer data = codec.decode(stripe->fragments);
+                    {
+                        std::lock_guard<std::mutex> lock(decoded_mutex);
+                        decoded.emplace(stripe->idx, std::move(data));
+                    }
+                    decoded_cond.notify_all();
+                } catch (...) {
+                    fail(std::current_exception());
+                }
+            }
+        });
+    }
+
+    // Writer: output the stripes in order.
+    uint64_t n_written = 0;
+    for (uint32_t idx = 0; idx < stripe_keys.size(); ++idx) {
+        Buffer data;
+        {
+            std::unique_lock<std::mutex> lock(decoded_mutex);
+
+            decoded_cond.wait(lock, [&] {
+                return error.failed() || decoded.count(idx) != 0;
+            });
+            if (error.failed()) {
+                break;
+            }
+            data = std::move(decoded[idx]);
+            decoded.erase(idx);
+        }
+        output.write(
+            reinterpret_cast<const char*>(data.data()),
+            static_cast<std::streamsize>(data.size()));
+        n_written += data.size();
+        window.release();
+    }
+
+    feeder.join();
+    join_all(senders);
+    to_decode.close();
+    join_all(workers);
+    error.rethrow();
+
+    return n_written;
+}
+
+} // namespace dcss
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_FILE_PIPELINE_H__
+#define __DCSS_FILE_PIPELINE_H__
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <ostream>
+
+#include "buffer.h"
+#include "dcss_file.h"
+#include "uint160.h"
+
+namespace dcss {
+
+/** Streaming put/get of large files, erasure-coded stripe by stripe.
+ *
+ * On put, the calling thread reads the input by fixed-size stripes, a pool
+ * of workers erasure-codes the stripes in parallel and a pool of senders
+ * stores the fragments concurrently. On get, the pipeline is reversed:
+ * senders fetch the fragments, workers decode the stripes and the calling
+ * thread writes them, in order, to the output.
+ *
+ * At most `max_in_flight` stripes are alive at any time, so the memory
+ * usage is bounded by `max_in_flight * stripe_size * (n_data + n_parities)
+ * / n_data` whatever the size of the file.
+ *
+ * The fragment `j` of the stripe `s` of a file is stored under the key
+ * `File::part_key(File::stripe_key(key, s, n_bits), j, ...)`, the manifest
+ * (returned by `put`) lists the stripe keys.
+ */
+class FilePipeline {
+  public:
+    /** Store a value under a key, called concurrently by the senders. */
+    using StoreFunc = std::function<bool(const UInt160&, const Buffer&)>;
+    /** Fetch a value by key, called concurrently by the senders. */
+    using FetchFunc = std::function<bool(const UInt160&, Buffer&)>;
+
+    /** Create a new pipeline.
+     *
+     * @param n_data        number of data fragments per stripe
+     * @param n_parities    number of parity fragments per stripe
+     * @param n_bits        size of the keys (in bits)
+     * @param stripe_size   size of a stripe (in bytes)
+     * @param n_workers     number of encoding/decoding threads
+     * @param n_senders     number of storing/fetching threads
+     * @param max_in_flight maximum number of stripes being processed
+     *
+     * @throw DomainError — invalid parameters.
+     */
+    FilePipeline(
+        uint32_t n_data,
+        uint32_t n_parities,
+        uint32_t n_bits,
+        uint64_t stripe_size,
+        uint32_t n_workers,
+        uint32_t n_senders,
+        uint32_t max_in_flight);
+
+    std::unique_ptr<File>
+    put(const UInt160& key, std::istream& input, const StoreFunc& store);
+    uint64_t
+    get(const File& file, std::ostream& output, const FetchFunc& fetch);
+
+    ~FilePipeline() = default;
+    FilePipeline(FilePipeline const&) = delete;
+    FilePipeline& operator=(FilePipeline const& x) = delete;
+    FilePipeline(FilePipeline&&) = delete;
+    FilePipeline& operator=(FilePipeline&& x) = delete;
+
+  private:
+    uint32_t m_n_data;
+    uint32_t m_n_parities;
+    uint32_t m_n_bits;
+    uint64_t m_stripe_size;
+    uint32_t m_n_workers;
+    uint32_t m_n_senders;
+    uint32_t m_max_in_flight;
+};
+
+} // namespace dcss
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+#include <map>
+
+#include "exceptions.h"
+#include "geth_batch.h"
+
+namespace dcss {
+
+GethBatch::GethBatch(GethClient& geth, size_t max_size)
+    : m_geth(geth), m_max_size(std::max<size_t>(max_size, 1)), m_n_sent(0),
+      m_n_requests(0)
+{
+}
+
+size_t GethBatch::add(const std::string& method, const Json::Value& params)
+{
+    m_calls.push_back({method, params, Json::Value(), 0, ""});
+    return m_calls.size() - 1;
+}
+
+void GethBatch::send()
+{
+    while (m_n_sent < m_calls.size()) {
+        const size_t end = std::min(m_n_sent + m_max_size, m_calls.size());
+        jsonrpc::BatchCall batch;
+        std::map<size_t, int> ids;
+
+        for (size_t i = m_n_sent; i < end; ++i) {
+            ids[i] = batch.addCall(m_calls[i].method, m_calls[i].params);
+        }
+        jsonrpc::BatchResponse answers = m_geth.CallProcedures(batch);
+        ++m_n_requests;
+
+        for (size_t i = m_n_sent; i < end; ++i) {
+            Json::Value id(ids[i]);
+            Call& call = m_calls[i];
+
+            call.error_code = answers.getErrorCode(id);
+            if (call.error_code != 0) {
+                call.error_message = answers.getErrorMessage(ids[i]);
+            } else {
+                call.result = answers.getResult(ids[i]);
+            }
+        }
+        m_n_sent = end;
+    }
+}
+
+bool GethBatch::sent(size_t i) const
+{
+    return i < m_n_sent;
+}
+
+const Json::Value& GethBatch::result(size_t i) const
+{
+    if (i >= m_n_sent) {
+        throw LogicError("call not sent");
+    }
+    const Call& call = m_calls[i];
+    if (call.error_code != 0) {
+        throw jsonrpc::JsonRpcException(call.error_code, call.error_message);
+    }
+    return call.result;
+}
+
+int GethBatch::error_code(size_t i) const
+{
+    if (i >= m_n_sent) {
+        throw LogicError("call not sent");
+    }
+    return m_calls[i].error_code;
+}
+
+size_t GethBatch::size() const
+{
+    return m_calls.size();
+}
+
+uint64_t GethBatch::n_requests() const
+{
+    return m_n_requests;
+}
+
+} // namespace dcss
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_GETH_BATCH_H__
+#define __DCSS_GETH_BATCH_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gethclient.h"
+
+namespace dcss {
+
+/** Calls to geth sent together, as JSON-RPC 2.0 batches.
+ *
+ * The calls are collected by `add`, then sent by `send` in batches of at
+ * most `max_size` calls (one HTTP round trip each). The answers are
+ * matched to the calls by their ID.
+ */
+class GethBatch {
+  public:
+    explicit GethBatch(GethClient& geth, size_t max_size = 1000);
+
+    /** Add a call, return its index (to get its result). */
+    size_t add(const std::string& method, const Json::Value& params);
+
+    /** Send the calls added since the previous `send`.
+     *
+     * Throws if a batch cannot be sent at all; the errors of the calls
+     * themselves are returned by `result`.
+     */
+    void send();
+
+    /** Return true if the call has been sent (and answered). */
+    bool sent(size_t i) const;
+
+    /** Return the result of a call (once sent), or throw its error. */
+    const Json::Value& result(size_t i) const;
+
+    /** Return the error code of a call (0 if it succeeded). */
+    int error_code(size_t i) const;
+
+    /** Return the number of calls. */
+    size_t size() const;
+
+    /** Return the number of round trips made so far. */
+    uint64_t n_requests() const;
+
+  private:
+    struct Call {
+        std::string method;
+        Json::Value params;
+        Json::Value result;
+        int error_code;
+        std::string error_message;
+    };
+
+    GethClient& m_geth;
+    const size_t m_max_size;
+    std::vector<Call> m_calls;
+    /** Index of the first call not sent yet. */
+    size_t m_n_sent;
+    uint64_t m_n_requests;
+};
+
+} // namespace dcss
+
+#endif
@@ -0,0 +1,342 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <sstream>
+#include <thread>
+
+#include "exceptions.h"
+#include "geth_mock.h"
+#include "keccak.h"
+#include "utils.h"
+
+namespace dcss {
+
+namespace {
+
+/** Error codes of geth. */
+constexpr int SERVER_ERROR = -32000;
+constexpr int METHOD_NOT_FOUND = -32601;
+constexpr int PARSE_ERROR = -32700;
+
+Json::Value result(const Json::Value& value)
+{
+    Json::Value answer;
+    answer["result"] = value;
+    return answer;
+}
+
+Json::Value error(int code, const std::string& message)
+{
+    Json::Value answer;
+    answer["error"]["code"] = code;
+    answer["error"]["message"] = message;
+    return answer;
+}
+
+std::string quantity(uint64_t n)
+{
+    std::ostringstream oss;
+    oss << "0x" << std::hex << n;
+    return oss.str();
+}
+
+/** Return the Keccak-256 digest of `data` in hexadecimal, truncated to its
+ * last `n_bytes` bytes.
+ */
+std::string hash(const std::string& data, size_t n_bytes = 32)
+{
+    static const char* const DIGITS = "0123456789abcdef";
+    const keccak::Digest digest = keccak::keccak256(data.data(), data.size());
+    std::string hex = "0x";
+
+    for (size_t i = sizeof(digest.bytes) - n_bytes; i < sizeof(digest.bytes);
+         ++i) {
+        hex += DIGITS[digest.bytes[i] >> 4];
+        hex += DIGITS[digest.bytes[i] & 0xf];
+    }
+    return hex;
+}
+
+} // namespace
+
+GethMockConf GethMockConf::parse(const std::string& spec)
+{
+    GethMockConf conf;
+    std::istringstream input(spec);
+    std::string field;
+    std::vector<std::string> fields;
+
+    while (!std::getline(input, field, ',').fail()) {
+        fields.push_back(field);
+    }
+    if (fields.empty() || fields.size() > 4) {
+        throw DomainError("geth mock: bad specification " + spec);
+    }
+    conf.block_time = std::chrono::milliseconds(stou32(fields[0]));
+    if (conf.block_time.count() == 0) {
+        throw DomainError("geth mock: the block time must not be zero");
+    }
+    if (fields.size() > 1) {
+        conf.latency = std::chrono::milliseconds(stou32(fields[1]));
+    }
+    if (fields.size() > 2) {
+        conf.failure_rate = stou32(fields[2]) / 100.0;
+    }
+    if (fields.size() > 3) {
+        conf.revert_rate = stou32(fields[3]) / 100.0;
+    }
+    if (conf.failure_rate > 1 || conf.revert_rate > 1) {
+        throw DomainError("geth mock: rates are percentages");
+    }
+    return conf;
+}
+
+GethMock::GethMock(const GethMockConf& conf)
+    : m_conf(conf), m_start(Clock::now()), m_prng(conf.seed), m_stats()
+{
+    if (m_conf.block_time.count() <= 0) {
+        throw LogicError("geth mock: the block time must be positive");
+    }
+}
+
+std::string GethMock::handle(const std::string& request)
+{
+    Json::Reader reader;
+    Json::Value calls;
+    Json::Value answers;
+
+    if (m_conf.latency.count() > 0) {
+        std::this_thread::sleep_for(m_conf.latency);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_stats.n_requests;
+    if (!reader.parse(request, calls)) {
+        answers = error(PARSE_ERROR, "parse error");
+        answers["jsonrpc"] = "2.0";
+        answers["id"] = Json::Value();
+    } else if (calls.isArray()) {
+        answers = Json::Value(Json::arrayValue);
+        for (const Json::Value& call : calls) {
+            answers.append(answer_call(call));
+        }
+    } else {
+        answers = answer_call(calls);
+    }
+    return Json::FastWriter().write(answers);
+}
+
+void GethMock::SendRPCMessage(const std::string& message, std::string& result)
+{
+    result = handle(message);
+}
+
+std::unique_ptr<jsonrpc::IClientConnector> GethMock::connect()
+{
+    return std::make_unique<Connection>(*this);
+}
+
+uint64_t GethMock::head() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return head_locked();
+}
+
+GethMockStats GethMock::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+Json::Value GethMock::answer_call(const Json::Value& call)
+{
+    const std::string method = call["method"].asString();
+    const Json::Value& params = call["params"];
+    Json::Value answer;
+
+    ++m_stats.n_calls;
+    if (draw(m_conf.failure_rate)) {
+        ++m_stats.n_failures;
+        answer = error(SERVER_ERROR, "injected failure");
+    } else if (method == "eth_sendTransaction") {
+        answer = send_transaction(params[0]);
+    } else if (method == "eth_getTransactionReceipt") {
+        answer = get_receipt(params[0].asString());
+    } else if (method == "eth_blockNumber") {
+        answer = result(quantity(head_locked()));
+    } else if (method == "eth_getBlockByNumber") {
+        answer = get_block(params[0].asString());
+    } else if (method == "eth_getTransactionCount") {
+        const auto it = m_accounts.find(params[0].asString());
+        answer = result(
+            quantity(it == m_accounts.end() ? 0 : it->second.next_nonce));
+    } else if (method == "eth_sign") {
+        answer = sign(params[0].asString(), params[1].asString());
+    } else if (method == "personal_newAccount") {
+        answer = new_account(params[0].asString());
+    } else if (method == "personal_unlockAccount") {
+        answer = unlock_account(params[0].asString(), params[1].asString());
+    } else {
+        answer = error(
+            METHOD_NOT_FOUND,
+            "the method " + method + " does not exist/is not available");
+    }
+    answer["jsonrpc"] = "2.0";
+    answer["id"] = call["id"];
+    return answer;
+}
+
+Json::Value GethMock::send_transaction(const Json::Value& tx)
+{
+    const auto it = m_accounts.find(tx["from"].asString());
+    if (it == m_accounts.end() || !it->second.unlocked) {
+        return error(SERVER_ERROR, "authentication needed: password or unlock");
+    }
+    Account& account = it->second;
+    const uint64_t nonce =
+        tx.isMember("nonce") ? stou64(tx["nonce"].asString(), nullptr, 16)
+                             : account.next_nonce;
+    if (nonce < account.next_nonce) {
+        return error(SERVER_ERROR, "nonce too low");
+    }
+    if (account.queued.count(nonce) != 0) {
+        return error(SERVER_ERROR, "replacement transaction underpriced");
+    }
+
+    const std::string tx_hash =
+        hash(it->first + ':' + std::to_string(nonce) + ':' +
+             tx["data"].asString());
+    ++m_stats.n_transactions;
+    if (draw(m_conf.revert_rate)) {
+        ++m_stats.n_reverts;
+        m_reverted.insert(tx_hash);
+    }
+
+    // Mine what the transaction makes executable in the next block.
+    const uint64_t block = head_locked() + 1;
+    account.queued[nonce] = tx_hash;
+    for (auto queued = account.queued.find(account.next_nonce);
+         queued != account.queued.end();
+         queued = account.queued.find(account.next_nonce)) {
+        m_blocks[block].push_back(queued->second);
+        m_mined_in[queued->second] = block;
+        account.queued.erase(queued);
+        ++account.next_nonce;
+    }
+    return result(tx_hash);
+}
+
+Json::Value GethMock::get_receipt(const std::string& tx_hash)
+{
+    const auto it = m_mined_in.find(tx_hash);
+    if (it == m_mined_in.end() || it->second > head_locked()) {
+        return result(Json::Value());
+    }
+    Json::Value receipt;
+    receipt["transactionHash"] = tx_hash;
+    receipt["blockNumber"] = quantity(it->second);
+    receipt["blockHash"] = hash(std::to_string(it->second));
+    receipt["status"] = m_reverted.count(tx_hash) != 0 ? "0x0" : "0x1";
+    return result(receipt);
+}
+
+Json::Value GethMock::get_block(const std::string& number)
+{
+    const uint64_t head = head_locked();
+    uint64_t n = 0;
+
+    if (number == "latest" || number == "pending") {
+        n = head;
+    } else if (number != "earliest") {
+        n = stou64(number, nullptr, 16);
+    }
+    if (n > head) {
+        return result(Json::Value());
+    }
+    Json::Value block;
+    block["number"] = quantity(n);
+    block["hash"] = hash(std::to_string(n));
+    block["transactions"] = Json::Value(Json::arrayValue);
+    const auto it = m_blocks.find(n);
+    if (it != m_blocks.end()) {
+        for (const std::string& tx_hash : it->second) {
+            block["transactions"].append(tx_hash);
+        }
+    }
+    return result(block);
+}
+
+Json::Value GethMock::sign(const std::string& address, const std::string& data)
+{
+    const auto it = m_accounts.find(address);
+    if (it == m_accounts.end() || !it->second.unlocked) {
+        return error(SERVER_ERROR, "authentication needed: password or unlock");
+    }
+    // Not a valid signature: r and s are only derived from the inputs.
+    const std::string r = hash(address + data);
+    const std::string s = hash(data + address);
+    return result(r + s.substr(2) + "1b");
+}
+
+Json::Value GethMock::new_account(const std::string& passphrase)
+{
+    const std::string address =
+        hash("account:" + std::to_string(m_accounts.size()), 20);
+    m_accounts[address] = Account{passphrase, false, 0, {}};
+    return result(address);
+}
+
+Json::Value GethMock::unlock_account(
+    const std::string& address,
+    const std::string& passphrase)
+{
+    const auto it = m_accounts.find(address);
+    if (it == m_accounts.end()) {
+        return error(SERVER_ERROR, "no key for given address or file");
+    }
+    if (it->second.passphrase != passphrase) {
+        return error(
+            SERVER_ERROR, "could not decrypt key with given passphrase");
+    }
+    it->second.unlocked = true;
+    return result(true);
+}
+
+uint64_t GethMock::head_locked() const
+{
+    return static_cast<uint64_t>((Clock::now() - m_start) / m_conf.block_time);
+}
+
+bool GethMock::draw(double rate)
+{
+    return rate > 0
+           && std::uniform_real_distribution<double>(0, 1)(m_prng) < rate;
+}
+
+} // namespace dcss
@@ -0,0 +1,185 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_GETH_MOCK_H__
+#define __DCSS_GETH_MOCK_H__
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <json/json.h>
+#include <jsonrpccpp/client/iclientconnector.h>
+
+namespace dcss {
+
+/** Behavior of the geth stand-in. */
+struct GethMockConf {
+    /** Time between two blocks: a transaction is mined in the block
+     * following its submission (its confirmation delay).
+     */
+    std::chrono::milliseconds block_time = std::chrono::milliseconds(1000);
+    /** Time taken to answer each request (a batch counts once). */
+    std::chrono::milliseconds latency = std::chrono::milliseconds(0);
+    /** Probability for a call to fail (answered by an error, no effect). */
+    double failure_rate = 0;
+    /** Probability for a mined transaction to be reverted. */
+    double revert_rate = 0;
+    /** Seed of the failures and reverts. */
+    uint32_t seed = 0;
+
+    /** Parse "BLOCK_MS[,LATENCY_MS[,FAILURE_PCT[,REVERT_PCT]]]".
+     *
+     * @throw DomainError if malformed
+     */
+    static GethMockConf parse(const std::string& spec);
+};
+
+/** Calls answered by the geth stand-in. */
+struct GethMockStats {
+    /** Number of requests (a batch counts once). */
+    uint64_t n_requests;
+    /** Number of JSON-RPC calls, all methods included. */
+    uint64_t n_calls;
+    /** Number of calls failed on purpose. */
+    uint64_t n_failures;
+    /** Number of transactions accepted. */
+    uint64_t n_transactions;
+    /** Number of transactions reverted on purpose. */
+    uint64_t n_reverts;
+};
+
+/** A stand-in for geth, answering the JSON-RPC calls of
+ * `jsonrpc_spec/geth.json` without a chain, to run the Ethereum paths (and
+ * benchmark them) without a node.
+ *
+ * The blocks are mined on a fixed period, from the creation of the mock.
+ * The transactions are accepted in nonce order (one after a gap waits for
+ * the gap to be filled), they don't run any code: only the reverts
+ * injected with `revert_rate` fail. The accounts must be created and
+ * unlocked to send transactions and sign messages.
+ *
+ * It can be used in process (as the connector of a `GethClient`, or
+ * through the connections of a `GethPool`) or served over HTTP (see
+ * `bench/geth_mock_server.cpp`). It is thread-safe, the latency of
+ * concurrent requests overlaps.
+ */
+class GethMock : public jsonrpc::IClientConnector {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit GethMock(const GethMockConf& conf = GethMockConf());
+
+    ~GethMock() override = default;
+    GethMock(GethMock const&) = delete;
+    GethMock& operator=(GethMock const& x) = delete;
+    GethMock(GethMock&&) = delete;
+    GethMock& operator=(GethMock&& x) = delete;
+
+    /** Answer a JSON-RPC request (a call or a batch of calls). */
+    std::string handle(const std::string& request);
+
+    void SendRPCMessage(const std::string& message, std::string& result)
+        override;
+
+    /** Return a new connection to the mock (for a `GethPool`). */
+    std::unique_ptr<jsonrpc::IClientConnector> connect();
+
+    /** Return the number of the last block mined. */
+    uint64_t head() const;
+
+    /** Return the calls answered so far. */
+    GethMockStats stats() const;
+
+  private:
+    /** A connection, forwarding its requests to the mock. */
+    class Connection : public jsonrpc::IClientConnector {
+      public:
+        explicit Connection(GethMock& mock) : m_mock(mock) {}
+
+        void SendRPCMessage(const std::string& message, std::string& result)
+            override
+        {
+            result = m_mock.handle(message);
+        }
+
+      private:
+        GethMock& m_mock;
+    };
+
+    /** An Ethereum account. */
+    struct Account {
+        std::string passphrase;
+        bool unlocked;
+        /** Nonce of its next transaction. */
+        uint64_t next_nonce;
+        /** Transactions waiting for a nonce gap to be filled. */
+        std::map<uint64_t, std::string> queued;
+    };
+
+    /** Answer a call (`m_mutex` held). */
+    Json::Value answer_call(const Json::Value& call);
+    Json::Value send_transaction(const Json::Value& tx);
+    Json::Value get_receipt(const std::string& hash);
+    Json::Value get_block(const std::string& number);
+    Json::Value sign(const std::string& address, const std::string& data);
+    Json::Value new_account(const std::string& passphrase);
+    Json::Value unlock_account(
+        const std::string& address,
+        const std::string& passphrase);
+    /** Return the number of the last block mined (`m_mutex` held). */
+    uint64_t head_locked() const;
+    /** Return true with probability `rate`. */
+    bool draw(double rate);
+
+    const GethMockConf m_conf;
+    const Clock::time_point m_start;
+
+    mutable std::mutex m_mutex;
+    std::mt19937 m_prng;
+    std::unordered_map<std::string, Account> m_accounts;
+    /** Transactions mined, indexed by block number. */
+    std::map<uint64_t, std::vector<std::string>> m_blocks;
+    /** Block of the transactions, indexed by hash. */
+    std::unordered_map<std::string, uint64_t> m_mined_in;
+    /** Hashes of the reverted transactions. */
+    std::unordered_set<std::string> m_reverted;
+    GethMockStats m_stats;
+};
+
+} // namespace dcss
+
+#endif
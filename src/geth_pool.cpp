@@ -0,0 +1,166 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <sstream>
+
+#include <jsonrpccpp/client/connectors/httpclient.h>
+
+#include "exceptions.h"
+#include "geth_pool.h"
+#include "utils.h"
+
+namespace dcss {
+
+GethPoolConf GethPoolConf::parse(const std::string& spec)
+{
+    GethPoolConf conf;
+    std::istringstream input(spec);
+    std::string field;
+    std::vector<std::string> fields;
+
+    while (!std::getline(input, field, ',').fail()) {
+        fields.push_back(field);
+    }
+    if (fields.empty() || fields.size() > 2) {
+        throw DomainError("geth pool: bad specification " + spec);
+    }
+    conf.size = stou32(fields[0]);
+    if (fields.size() > 1) {
+        conf.timeout = std::chrono::milliseconds(stou32(fields[1]));
+    }
+    if (conf.size == 0 || conf.timeout.count() == 0) {
+        throw DomainError("geth pool: the size and timeout must not be zero");
+    }
+    return conf;
+}
+
+GethPool::GethPool(Connect connect, const GethPoolConf& conf)
+    : m_connect(std::move(connect)), m_conf(conf), m_n_open(0), m_stats()
+{
+    if (m_conf.size == 0) {
+        throw LogicError("geth pool: the size must not be zero");
+    }
+}
+
+std::unique_ptr<GethPool>
+GethPool::http(const std::string& url, const GethPoolConf& conf)
+{
+    return std::make_unique<GethPool>(
+        [url](std::chrono::milliseconds timeout)
+            -> std::unique_ptr<jsonrpc::IClientConnector> {
+            std::unique_ptr<jsonrpc::HttpClient> client =
+                std::make_unique<jsonrpc::HttpClient>(url);
+            client->SetTimeout(timeout.count());
+            return std::unique_ptr<jsonrpc::IClientConnector>(
+                std::move(client));
+        },
+        conf);
+}
+
+void GethPool::SendRPCMessage(const std::string& message, std::string& result)
+{
+    std::unique_ptr<jsonrpc::IClientConnector> connection =
+        acquire(std::chrono::steady_clock::now() + m_conf.timeout);
+
+    try {
+        connection->SendRPCMessage(message, result);
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_stats.n_errors;
+        }
+        release(nullptr);
+        throw;
+    }
+    release(std::move(connection));
+}
+
+size_t GethPool::n_open() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_n_open;
+}
+
+GethPoolStats GethPool::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+std::unique_ptr<jsonrpc::IClientConnector>
+GethPool::acquire(std::chrono::steady_clock::time_point deadline)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    ++m_stats.n_requests;
+    if (m_free.empty() && m_n_open >= m_conf.size) {
+        ++m_stats.n_waits;
+        const bool available = m_released.wait_until(lock, deadline, [this] {
+            return !m_free.empty() || m_n_open < m_conf.size;
+        });
+        if (!available) {
+            ++m_stats.n_errors;
+            throw jsonrpc::JsonRpcException(
+                jsonrpc::Errors::ERROR_CLIENT_CONNECTOR,
+                "no connection to geth released in time");
+        }
+    }
+    if (!m_free.empty()) {
+        std::unique_ptr<jsonrpc::IClientConnector> connection =
+            std::move(m_free.back());
+        m_free.pop_back();
+        return connection;
+    }
+
+    // Open a new one, without holding the lock.
+    ++m_n_open;
+    ++m_stats.n_opened;
+    lock.unlock();
+    try {
+        return m_connect(m_conf.timeout);
+    } catch (...) {
+        release(nullptr);
+        throw;
+    }
+}
+
+void GethPool::release(std::unique_ptr<jsonrpc::IClientConnector> connection)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (connection) {
+            m_free.push_back(std::move(connection));
+        } else {
+            --m_n_open;
+        }
+    }
+    m_released.notify_one();
+}
+
+} // namespace dcss
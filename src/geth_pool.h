@@ -0,0 +1,137 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_GETH_POOL_H__
+#define __DCSS_GETH_POOL_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <jsonrpccpp/client/iclientconnector.h>
+
+namespace dcss {
+
+/** Sizing of the connections to geth. */
+struct GethPoolConf {
+    /** Maximum number of connections open together. */
+    uint32_t size = 8;
+    /** Timeout of each request, and of the wait for a free connection. */
+    std::chrono::milliseconds timeout = std::chrono::seconds(30);
+
+    /** Parse "SIZE[,TIMEOUT_MS]".
+     *
+     * @throw DomainError if malformed
+     */
+    static GethPoolConf parse(const std::string& spec);
+};
+
+/** Requests sent through the pool. */
+struct GethPoolStats {
+    /** Number of requests (a batch counts once). */
+    uint64_t n_requests;
+    /** Number of connections opened (reopened after an error included). */
+    uint64_t n_opened;
+    /** Number of requests that waited for a free connection. */
+    uint64_t n_waits;
+    /** Number of requests failed (their connection is closed). */
+    uint64_t n_errors;
+};
+
+/** Persistent connections to geth, shared by concurrent callers.
+ *
+ * A request takes a free connection, or opens a new one if less than
+ * `size` are open, or else waits for one to be released. The connections
+ * are kept open between the requests (keep-alive): a `jsonrpc::HttpClient`
+ * reuses its connection as long as the server doesn't close it. A
+ * connection whose request failed is closed (it may be left mid-answer).
+ *
+ * Thread-safe: a `GethClient` on top of it can be called from any thread.
+ */
+class GethPool : public jsonrpc::IClientConnector {
+  public:
+    /** Open a connection, with the timeout of the requests. */
+    using Connect = std::function<std::unique_ptr<jsonrpc::IClientConnector>(
+        std::chrono::milliseconds timeout)>;
+
+    explicit GethPool(
+        Connect connect,
+        const GethPoolConf& conf = GethPoolConf());
+
+    ~GethPool() override = default;
+    GethPool(GethPool const&) = delete;
+    GethPool& operator=(GethPool const& x) = delete;
+    GethPool(GethPool&&) = delete;
+    GethPool& operator=(GethPool&& x) = delete;
+
+    /** Return a pool of HTTP connections to `url`. */
+    static std::unique_ptr<GethPool>
+    http(const std::string& url, const GethPoolConf& conf = GethPoolConf());
+
+    /** Send a request on a free connection.
+     *
+     * @throw jsonrpc::JsonRpcException if no connection is released in time,
+     * or if the request fails
+     */
+    void SendRPCMessage(const std::string& message, std::string& result)
+        override;
+
+    /** Return the number of connections open. */
+    size_t n_open() const;
+
+    /** Return the requests sent so far. */
+    GethPoolStats stats() const;
+
+  private:
+    /** Take a free connection (or open one), waiting until `deadline`. */
+    std::unique_ptr<jsonrpc::IClientConnector>
+    acquire(std::chrono::steady_clock::time_point deadline);
+    /** Give back a connection taken by `acquire` (null if closed). */
+    void release(std::unique_ptr<jsonrpc::IClientConnector> connection);
+
+    const Connect m_connect;
+    const GethPoolConf m_conf;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_released;
+    /** Connections open and free. */
+    std::vector<std::unique_ptr<jsonrpc::IClientConnector>> m_free;
+    /** Number of connections open, free or in use. */
+    size_t m_n_open;
+    GethPoolStats m_stats;
+};
+
+} // namespace dcss
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_KECCAK_H__
+#define __DCSS_KECCAK_H__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dcss {
+namespace keccak {
+
+/** A Keccak-256 digest. */
+struct Digest {
+    uint8_t bytes[32];
+};
+
+/** Round constants of Keccak-f[1600]. */
+constexpr uint64_t ROUND_CONSTANTS[24] = {
+    0x0000000000000001, 0x0000000000008082, 0x800000000000808a,
+    0x8000000080008000, 0x000000000000808b, 0x0000000080000001,
+    0x8000000080008081, 0x8000000000008009, 0x000000000000008a,
+    0x0000000000000088, 0x0000000080008009, 0x000000008000000a,
+    0x000000008000808b, 0x800000000000008b, 0x8000000000008089,
+    0x8000000000008003, 0x8000000000008002, 0x8000000000000080,
+    0x000000000000800a, 0x800000008000000a, 0x8000000080008081,
+    0x8000000000008080, 0x0000000080000001, 0x8000000080008008,
+};
+
+/** Rotation offsets of the lanes, in the order of `PI_LANES` (rho). */
+constexpr unsigned ROTATIONS[24] = {
+    1,  3,  6,  10, 15, 21, 28, 36, 45, 55, 2,  14,
+    27, 41, 56, 8,  25, 43, 62, 18, 39, 61, 20, 44,
+};
+
+/** Destinations of the lanes (pi). */
+constexpr unsigned PI_LANES[24] = {
+    10, 7,  11, 17, 18, 3, 5,  16, 8,  21, 24, 4,
+    15, 23, 19, 13, 12, 2, 20, 14, 22, 9,  6,  1,
+};
+
+/** Number of bytes absorbed per permutation (1088 bits for Keccak-256). */
+constexpr size_t RATE = 136;
+
+struct State {
+    uint64_t lanes[25];
+};
+
+constexpr uint64_t rotl(uint64_t x, unsigned n)
+{
+    return (x << n) | (x >> (64 - n));
+}
+
+/** Keccak-f[1600]. */
+constexpr void permute(State& state)
+{
+    uint64_t* st = state.lanes;
+
+    for (const uint64_t round_constant : ROUND_CONSTANTS) {
+        uint64_t bc[5] = {0, 0, 0, 0, 0};
+
+        // Theta.
+        for (unsigned i = 0; i < 5; ++i) {
+            bc[i] = st[i] ^ st[i + 5] ^ st[i + 10] ^ st[i + 15] ^ st[i + 20];
+        }
+        for (unsigned i = 0; i < 5; ++i) {
+            const uint64_t t = bc[(i + 4) % 5] ^ rotl(bc[(i + 1) % 5], 1);
+            for (unsigned j = 0; j < 25; j += 5) {
+                st[j + i] ^= t;
+            }
+        }
+
+        // Rho and pi.
+        uint64_t t = st[1];
+        for (unsigned i = 0; i < 24; ++i) {
+            const unsigned j = PI_LANES[i];
+            const uint64_t lane = st[j];
+            st[j] = rotl(t, ROTATIONS[i]);
+            t = lane;
+        }
+
+        // Chi.
+        for (unsigned j = 0; j < 25; j += 5) {
+            for (unsigned i = 0; i < 5; ++i) {
+                bc[i] = st[j + i];
+            }
+            for (unsigned i = 0; i < 5; ++i) {
+                st[j + i] ^= ~bc[(i + 1) % 5] & bc[(i + 2) % 5];
+            }
+        }
+
+        // Iota.
+        st[0] ^= round_constant;
+    }
+}
+
+/** Return the Keccak-256 digest of `data` (as used by Ethereum, that is
+ * with the original padding, not the SHA-3 one).
+ *
+ * It is `constexpr`: the digests of literals (e.g. the function selectors of
+ * the contract ABI) can be computed at compile time.
+ */
+constexpr Digest keccak256(const char* data, size_t size)
+{
+    State state = {{}};
+
+    // Absorb the data, then the padding: 0x01 ... 0x80.
+    const size_t padded = (size / RATE + 1) * RATE;
+    for (size_t offset = 0; offset < padded; offset += RATE) {
+        for (size_t i = 0; i < RATE; ++i) {
+            uint64_t byte = 0;
+            if (offset + i < size) {
+                byte = static_cast<uint8_t>(data[offset + i]);
+            }
+            if (offset + i == size) {
+                byte ^= 0x01;
+            }
+            if (offset + i == padded - 1) {
+                byte ^= 0x80;
+            }
+            state.lanes[i / 8] ^= byte << (8 * (i % 8));
+        }
+        permute(state);
+    }
+
+    // Squeeze (the digest fits in the first lanes).
+    Digest digest = {{}};
+    for (size_t i = 0; i < sizeof(digest.bytes); ++i) {
+        digest.bytes[i] =
+            static_cast<uint8_t>(state.lanes[i / 8] >> (8 * (i % 8)));
+    }
+    return digest;
+}
+
+/** Return the Keccak-256 digest of a null-terminated string. */
+constexpr Digest keccak256(const char* str)
+{
+    size_t size = 0;
+    while (str[size] != '\0') {
+        ++size;
+    }
+    return keccak256(str, size);
+}
+
+} // namespace keccak
+} // namespace dcss
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cmath>
+
+#include "exceptions.h"
+#include "latency_model.h"
+
+namespace dcss {
+
+LatencyModel::LatencyModel(
+    double median,
+    double sigma,
+    double slow_rate,
+    double slow_factor,
+    double loss_rate,
+    double timeout)
+    : m_slow_rate(slow_rate), m_slow_factor(slow_factor),
+      m_loss_rate(loss_rate), m_timeout(timeout),
+      m_latency(std::log(median), sigma), m_loss(loss_rate)
+{
+    if (median <= 0.0 || sigma < 0.0 || slow_factor < 1.0 || timeout <= 0.0) {
+        throw DomainError("latency model: invalid latency");
+    }
+    if (slow_rate < 0.0 || slow_rate > 1.0) {
+        throw DomainError("latency model: invalid slow rate");
+    }
+    if (loss_rate < 0.0 || loss_rate > 1.0) {
+        throw DomainError("latency model: invalid loss rate");
+    }
+}
+
+/** Tell if a node is a slow one.
+ *
+ * The choice only depends on the node ID, so a node is either always or
+ * never slow.
+ */
+bool LatencyModel::is_slow(const UInt160& node_id) const
+{
+    const size_t bucket = node_id.hash() % 10000;
+
+    return static_cast<double>(bucket) < m_slow_rate * 10000.0;
+}
+
+/** Draw the latency of a RPC sent to a node.
+ *
+ * @param node_id ID of the remote node
+ * @param prng    random number generator to use
+ * @param latency latency of the RPC (capped to the timeout)
+ * @return false if the RPC is lost (`latency` is then the timeout).
+ */
+bool LatencyModel::sample(
+    const UInt160& node_id,
+    std::mt19937& prng,
+    double& latency)
+{
+    if (m_loss(prng)) {
+        latency = m_timeout;
+        return false;
+    }
+
+    latency = m_latency(prng);
+    if (is_slow(node_id)) {
+        latency *= m_slow_factor;
+    }
+    if (latency >= m_timeout) {
+        latency = m_timeout;
+        return false;
+    }
+    return true;
+}
+
+} // namespace dcss
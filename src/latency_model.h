@@ -0,0 +1,94 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_LATENCY_MODEL_H__
+#define __DCSS_LATENCY_MODEL_H__
+
+#include <cmath>
+#include <random>
+
+#include "uint160.h"
+
+namespace dcss {
+
+/** Simulated latency/loss of the RPCs (in virtual milliseconds).
+ *
+ * The latency of a RPC follows a log-normal distribution. A fixed fraction
+ * of the nodes (chosen from their ID) are slow: their latencies are
+ * multiplied by a constant factor. Each RPC can also be lost, in which case
+ * the caller only notices it after a timeout.
+ */
+class LatencyModel {
+  public:
+    /** Create a latency model.
+     *
+     * @param median      median latency of a RPC (ms)
+     * @param sigma       shape of the log-normal distribution
+     * @param slow_rate   fraction of slow nodes, in [0; 1]
+     * @param slow_factor latency multiplier for the slow nodes
+     * @param loss_rate   probability to lose a RPC, in [0; 1]
+     * @param timeout     time after which a RPC is considered as lost (ms)
+     *
+     * @throw DomainError — invalid parameters.
+     */
+    LatencyModel(
+        double median = 20.0,
+        double sigma = 0.5,
+        double slow_rate = 0.05,
+        double slow_factor = 10.0,
+        double loss_rate = 0.01,
+        double timeout = 1000.0);
+
+    /** Return the median latency of a RPC (ms). */
+    inline double median() const
+    {
+        return std::exp(m_latency.m());
+    }
+
+    /** Return the timeout of a RPC (ms). */
+    inline double timeout() const
+    {
+        return m_timeout;
+    }
+
+    bool is_slow(const UInt160& node_id) const;
+    bool sample(const UInt160& node_id, std::mt19937& prng, double& latency);
+
+  private:
+    double m_slow_rate;
+    double m_slow_factor;
+    double m_loss_rate;
+    double m_timeout;
+    std::lognormal_distribution<double> m_latency;
+    std::bernoulli_distribution m_loss;
+};
+
+} // namespace dcss
+
+#endif
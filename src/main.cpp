@@ -28,6 +28,7 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -54,9 +55,23 @@
     std::cerr << "\t-a\tKademlia alpha parameter\n";
     std::cerr << "\t-n\tnumber of nodes\n";
     std::cerr << "\t-c\tinitial number of connections per node\n";
-    std::cerr << "\t-g\tgeth RPC server address\n";
+    std::cerr << "\t-g\tgeth RPC server address (or mock[:BLOCK_MS,...])\n";
+    std::cerr << "\t-G\tconnections to geth (size[,timeout_ms])\n";
+    std::cerr << "\t-A\tEthereum accounts cache (path)\n";
     std::cerr << "\t-B\tbootstrap list (comma-separated list of IPs)\n";
+    std::cerr << "\t-r\tsize of the k-buckets replacement cache\n";
+    std::cerr << "\t-R\trouting table (fixed, split, relaxed or full)\n";
+    std::cerr << "\t-L\tsize of the sibling list\n";
+    std::cerr << "\t-K\tnumber of keys looked up together\n";
+    std::cerr << "\t-C\tlookup cache (size,ttl[,prefix_bits])\n";
+    std::cerr << "\t-M\tvalue cache (bytes[,lru|tinylfu])\n";
+    std::cerr << "\t-H\tpopularity replication "
+                 "(threshold[,replicas[,lifetime]])\n";
+    std::cerr << "\t-T\treport the N most loaded nodes at exit\n";
     std::cerr << "\t-N\tnumber of files\n";
+    std::cerr << "\t-s\tsize of the files (in bytes)\n";
+    std::cerr << "\t-E\terasure code (n_data,n_parities)\n";
+    std::cerr << "\t-F\tpercentage of nodes offline when checking files\n";
     std::cerr << "\t-S\trandom seed\n";
     std::cerr << "\t-V\tshow version\n";
     exit(1);
@@ -121,17 +136,37 @@ int main(int argc, char** argv)
     uint32_t n_nodes = 1500;
     uint32_t n_init_conn = 100;
     uint32_t n_files = 5000;
+    uint32_t file_size = 0;
     uint32_t rand_seed = 0;
+    uint32_t n_data = 0;
+    uint32_t n_parities = 0;
+    uint32_t fail_pct = 0;
+    uint32_t load_top_n = 0;
+    std::string cache_size;
+    dcss::BucketLayout layout = dcss::BucketLayout::FIXED;
+    uint32_t n_siblings = 0;
+    uint32_t lookup_batch = 1;
+    uint32_t lookup_cache_size = 0;
+    uint32_t lookup_cache_ttl = 0;
+    uint32_t lookup_cache_prefix = 0;
+    uint64_t value_cache_size = 0;
+    dcss::CachePolicy value_cache_policy = dcss::CachePolicy::TINY_LFU;
+    uint32_t hot_threshold = 0;
+    uint32_t hot_replicas = 0;
+    uint32_t hot_lifetime = 0;
     std::string fname;
     std::string log_cfg;
     std::string geth_addr = "localhost:8545";
+    dcss::GethPoolConf geth_pool_conf;
+    std::string accounts_path;
     std::vector<std::string> bstraplist;
 
     START_EASYLOGGINGPP(argc, argv);
 
     opterr = 0;
 
-    while ((c = getopt(argc, argv, "b:k:a:n:c:g:B:S:f:l:N:V")) != -1) {
+    const char* optstring = "b:k:a:n:c:g:G:A:B:S:f:l:L:K:C:M:H:N:s:E:F:r:R:T:V";
+    while ((c = getopt(argc, argv, optstring)) != -1) {
         switch (c) {
         case 'b':
             n_bits = dcss::stou32(optarg);
@@ -154,6 +189,25 @@ int main(int argc, char** argv)
             break;
         case 'g':
             geth_addr = optarg;
+            if (geth_addr.compare(0, 5, "mock:") == 0) {
+                try {
+                    dcss::GethMockConf::parse(geth_addr.substr(5));
+                } catch (const dcss::DomainError& exn) {
+                    std::cerr << exn.what() << '\n';
+                    exit(1);
+                }
+            }
+            break;
+        case 'G':
+            try {
+                geth_pool_conf = dcss::GethPoolConf::parse(optarg);
+            } catch (const dcss::DomainError& exn) {
+                std::cerr << exn.what() << '\n';
+                exit(1);
+            }
+            break;
+        case 'A':
+            accounts_path = optarg;
             break;
         case 'B': {
             std::istringstream input(optarg);
@@ -175,6 +229,113 @@ int main(int argc, char** argv)
         case 'N':
             n_files = dcss::stou32(optarg);
             break;
+        case 's':
+            file_size = dcss::stou32(optarg);
+            break;
+        case 'E': {
+            std::istringstream input(optarg);
+            std::string n_data_str;
+            std::string n_parities_str;
+            if (std::getline(input, n_data_str, ',').fail()
+                || std::getline(input, n_parities_str).fail()) {
+                usage();
+            }
+            n_data = dcss::stou32(n_data_str);
+            n_parities = dcss::stou32(n_parities_str);
+            if (n_data == 0 || n_parities == 0) {
+                usage();
+            }
+            break;
+        }
+        case 'C': {
+            std::istringstream input(optarg);
+            std::string size_str;
+            std::string ttl_str;
+            std::string prefix_str;
+            if (std::getline(input, size_str, ',').fail()
+                || std::getline(input, ttl_str, ',').fail()) {
+                usage();
+            }
+            lookup_cache_size = dcss::stou32(size_str);
+            lookup_cache_ttl = dcss::stou32(ttl_str);
+            if (!std::getline(input, prefix_str).fail()) {
+                lookup_cache_prefix = dcss::stou32(prefix_str);
+            }
+            break;
+        }
+        case 'M': {
+            std::istringstream input(optarg);
+            std::string size_str;
+            std::string policy_str;
+            if (std::getline(input, size_str, ',').fail()) {
+                usage();
+            }
+            value_cache_size = dcss::stou64(size_str);
+            if (!std::getline(input, policy_str).fail()) {
+                if (policy_str == "lru") {
+                    value_cache_policy = dcss::CachePolicy::LRU;
+                } else if (policy_str == "tinylfu") {
+                    value_cache_policy = dcss::CachePolicy::TINY_LFU;
+                } else {
+                    usage();
+                }
+            }
+            break;
+        }
+        case 'H': {
+            std::istringstream input(optarg);
+            std::string threshold_str;
+            std::string replicas_str;
+            std::string lifetime_str;
+            if (std::getline(input, threshold_str, ',').fail()) {
+                usage();
+            }
+            hot_threshold = dcss::stou32(threshold_str);
+            if (hot_threshold == 0 || hot_threshold > 15) {
+                usage();
+            }
+            if (!std::getline(input, replicas_str, ',').fail()) {
+                hot_replicas = dcss::stou32(replicas_str);
+            }
+            if (!std::getline(input, lifetime_str).fail()) {
+                hot_lifetime = dcss::stou32(lifetime_str);
+            }
+            break;
+        }
+        case 'F':
+            fail_pct = dcss::stou32(optarg);
+            if (fail_pct > 100) {
+                usage();
+            }
+            break;
+        case 'r':
+            cache_size = optarg;
+            break;
+        case 'L':
+            n_siblings = dcss::stou32(optarg);
+            break;
+        case 'K':
+            lookup_batch = dcss::stou32(optarg);
+            if (lookup_batch == 0) {
+                usage();
+            }
+            break;
+        case 'R':
+            if (strcmp(optarg, "fixed") == 0) {
+                layout = dcss::BucketLayout::FIXED;
+            } else if (strcmp(optarg, "split") == 0) {
+                layout = dcss::BucketLayout::SPLIT;
+            } else if (strcmp(optarg, "relaxed") == 0) {
+                layout = dcss::BucketLayout::RELAXED;
+            } else if (strcmp(optarg, "full") == 0) {
+                layout = dcss::BucketLayout::FULL;
+            } else {
+                usage();
+            }
+            break;
+        case 'T':
+            load_top_n = dcss::stou32(optarg);
+            break;
         case 'V':
             show_version();
         case '?':
@@ -212,7 +373,38 @@ int main(int argc, char** argv)
         n_nodes = dcss::stou32(p);
     }
 
-    dcss::Conf conf(n_bits, k, alpha, n_nodes, geth_addr, bstraplist);
+    dcss::Conf conf(
+        n_bits, k, alpha, n_nodes, geth_addr, bstraplist, geth_pool_conf);
+    conf.n_data = n_data;
+    conf.n_parities = n_parities;
+    if (!cache_size.empty()) {
+        conf.replacement_cache_size = dcss::stou32(cache_size);
+    }
+    conf.bucket_layout = layout;
+    conf.n_siblings = n_siblings;
+    conf.lookup_batch = lookup_batch;
+    conf.lookup_cache_size = lookup_cache_size;
+    conf.lookup_cache_ttl = lookup_cache_ttl;
+    if (lookup_cache_prefix != 0) {
+        conf.lookup_cache_prefix = lookup_cache_prefix;
+    }
+    conf.value_cache_size = value_cache_size;
+    conf.value_cache_policy = value_cache_policy;
+    conf.hot_threshold = hot_threshold;
+    if (hot_replicas != 0) {
+        conf.hot_replicas = hot_replicas;
+    }
+    if (hot_lifetime != 0) {
+        conf.hot_lifetime = hot_lifetime;
+    }
+    if (!accounts_path.empty()) {
+        try {
+            conf.accounts.open(accounts_path);
+        } catch (const dcss::DomainError& exn) {
+            std::cerr << exn.what() << '\n';
+            exit(1);
+        }
+    }
     // conf.save(std::cout);
     dcss::Network network(conf);
     dcss::Shell shell;
@@ -220,13 +412,21 @@ int main(int argc, char** argv)
     dcss::prng().seed(rand_seed);
 
     network.initialize_nodes(n_init_conn, bstraplist);
-    network.initialize_files(n_files);
+    network.initialize_files(n_files, file_size);
+    network.fail_nodes(fail_pct / 100.0);
+    // Only count the load from the file checks on.
+    network.rpc_load().reset();
     network.check_files();
+    network.report_durability();
 
     shell.set_cmds(dcss::cmd_defs);
     shell.set_handle(&network);
     shell.set_prompt(std::string(PACKAGE) + "> ");
     shell.loop();
 
+    if (load_top_n != 0) {
+        network.report_load(load_top_n);
+    }
+
     return EXIT_SUCCESS;
 }
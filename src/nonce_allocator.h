@@ -0,0 +1,66 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_NONCE_ALLOCATOR_H__
+#define __DCSS_NONCE_ALLOCATOR_H__
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace dcss {
+
+/** Nonces of the accounts sending transactions, allocated locally so that
+ * the transactions of an account can be sent back to back.
+ *
+ * The next nonce of an account is synchronized with geth (its pending
+ * transaction count) before its first transaction, then after a nonce
+ * error (or a gap left by a failed transaction, if it couldn't be filled).
+ */
+class NonceAllocator {
+  public:
+    /** Return true if the next nonce of `account` is known. */
+    bool is_synced(const std::string& account) const;
+
+    /** Set the next nonce of `account`. */
+    void sync(const std::string& account, uint64_t next);
+
+    /** Return the next nonce of `account` (which must be synced). */
+    uint64_t allocate(const std::string& account);
+
+    /** Forget the next nonce of `account`, to resynchronize it. */
+    void invalidate(const std::string& account);
+
+  private:
+    std::unordered_map<std::string, uint64_t> m_next;
+};
+
+} // namespace dcss
+
+#endif
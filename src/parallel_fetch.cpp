@@ -0,0 +1,136 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+#include <queue>
+#include <utility>
+
+#include "parallel_fetch.h"
+
+namespace dcss {
+
+/** A request in flight. */
+struct Pending {
+    /** Time at which the request completes (answer or timeout). */
+    double deadline;
+    /** Time at which the request was sent. */
+    double sent_at;
+    /** Index of the target. */
+    size_t target;
+    /** False if the request is known to be lost. */
+    bool delivered;
+
+    // Earliest deadline first.
+    bool operator<(const Pending& other) const
+    {
+        return deadline > other.deadline;
+    }
+};
+
+/** Fetch `n_needed` values out of `targets`, `n_parallel` at a time.
+ *
+ * The requests are sent to the first `n_parallel` targets at once; each
+ * failure (loss, timeout, unavailable value) is replaced by a request to the
+ * next unused target. The fetch completes as soon as `n_needed` values have
+ * been received: the requests still in flight are cancelled (they are never
+ * performed).
+ *
+ * The fetch runs in virtual time: `latency` tells when a request completes,
+ * `fetch` is only called when it does.
+ *
+ * @param targets    candidate targets, by order of preference
+ * @param n_needed   number of values to fetch
+ * @param n_parallel number of requests in flight (at least `n_needed`)
+ * @param timeout    time after which an unanswered request is failed (ms)
+ * @param latency    latency model
+ * @param fetch      function used to perform a request
+ */
+FetchResult fetch_first_n(
+    const std::vector<FetchTarget>& targets,
+    uint32_t n_needed,
+    uint32_t n_parallel,
+    double timeout,
+    const LatencyFunc& latency,
+    const FetchFunc& fetch)
+{
+    FetchResult result{{}, 0.0, 0, 0, 0, false};
+    std::priority_queue<Pending> in_flight;
+    size_t next_target = 0;
+
+    const auto send = [&](double now) {
+        const FetchTarget& target = targets[next_target];
+        double delay = timeout;
+        const bool delivered = latency(target, delay);
+
+        in_flight.push(Pending{now + delay, now, next_target, delivered});
+        ++next_target;
+        ++result.n_sent;
+    };
+
+    if (n_needed == 0) {
+        result.complete = true;
+        return result;
+    }
+    n_parallel = std::max(n_parallel, n_needed);
+    while (next_target < targets.size() && next_target < n_parallel) {
+        send(0.0);
+    }
+
+    while (!in_flight.empty()) {
+        const Pending req = in_flight.top();
+        in_flight.pop();
+        result.latency = req.deadline;
+
+        Buffer value;
+        if (req.delivered && fetch(targets[req.target], value)) {
+            result.values.push_back(std::move(value));
+            if (result.values.size() == n_needed) {
+                result.complete = true;
+                result.n_cancelled = static_cast<uint32_t>(in_flight.size());
+                return result;
+            }
+            continue;
+        }
+
+        if (req.delivered && req.deadline < req.sent_at + timeout) {
+            // Unanswered request (dead node or missing value): accounted as
+            // a timeout.
+            in_flight.push(
+                Pending{req.sent_at + timeout, req.sent_at, req.target, false});
+            continue;
+        }
+        ++result.n_failed;
+        if (next_target < targets.size()) {
+            send(req.deadline);
+        }
+    }
+    return result;
+}
+
+} // namespace dcss
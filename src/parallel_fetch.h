@@ -0,0 +1,80 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_PARALLEL_FETCH_H__
+#define __DCSS_PARALLEL_FETCH_H__
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "buffer.h"
+#include "dht/dht.h"
+#include "uint160.h"
+
+namespace dcss {
+
+/** A value (replica or fragment) to fetch, and the node holding it. */
+struct FetchTarget {
+    UInt160 key;
+    dht::NodeAddress holder;
+};
+
+/** Outcome of a parallel fetch. */
+struct FetchResult {
+    /** The fetched values (at most `n_needed`). */
+    std::vector<Buffer> values;
+    /** Time to complete (or to give up), in virtual milliseconds. */
+    double latency;
+    /** Number of requests sent. */
+    uint32_t n_sent;
+    /** Number of requests lost, timed out or unanswered. */
+    uint32_t n_failed;
+    /** Number of requests cancelled (still pending on completion). */
+    uint32_t n_cancelled;
+    /** True if `n_needed` values have been fetched. */
+    bool complete;
+};
+
+/** Send a request (performed only if the request is not cancelled). */
+using FetchFunc = std::function<bool(const FetchTarget&, Buffer&)>;
+/** Draw the latency of a request, return false if the request is lost. */
+using LatencyFunc = std::function<bool(const FetchTarget&, double&)>;
+
+FetchResult fetch_first_n(
+    const std::vector<FetchTarget>& targets,
+    uint32_t n_needed,
+    uint32_t n_parallel,
+    double timeout,
+    const LatencyFunc& latency,
+    const FetchFunc& fetch);
+
+} // namespace dcss
+
+#endif
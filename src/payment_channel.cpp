@@ -0,0 +1,265 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+#include <random>
+
+#include "abi.h"
+#include "exceptions.h"
+#include "payment_channel.h"
+
+namespace dcss {
+
+// Write the 40 digits of the address `v` to `out`: packed, without the
+// padding of its ABI word.
+static void write_packed_address(char* out, const std::string& v)
+{
+    char word[64];
+
+    abi::Address::encode(word, v);
+    std::copy_n(word + 24, 40, out);
+}
+
+// Return true if `deposit` covers `put_bytes` and `get_bytes` at the given
+// prices (without overflowing).
+static bool covers(
+    uint64_t deposit,
+    uint64_t put_bytes,
+    uint64_t put_price,
+    uint64_t get_bytes,
+    uint64_t get_price)
+{
+    if (put_price != 0 && put_bytes > deposit / put_price) {
+        return false;
+    }
+    const uint64_t left = deposit - put_bytes * put_price;
+    return get_price == 0 || get_bytes <= left / get_price;
+}
+
+PaymentChannels::PaymentChannels() : m_n_issued(0), m_stats({0, 0, 0, 0})
+{
+    std::random_device device;
+    std::uniform_int_distribution<uint64_t> dis;
+
+    m_session = dis(device);
+}
+
+std::string PaymentChannels::key(
+    const std::string& buyer,
+    const std::string& seller)
+{
+    return buyer + ':' + seller;
+}
+
+PaymentChannel& PaymentChannels::open_channel(
+    const std::string& buyer,
+    const std::string& seller)
+{
+    const auto it = m_ids.find(key(buyer, seller));
+    if (it == m_ids.end()
+        || m_channels.at(it->second).state != ChannelState::OPEN) {
+        throw DomainError("no open channel from " + buyer + " to " + seller);
+    }
+    return m_channels.at(it->second);
+}
+
+std::string PaymentChannels::open(
+    const std::string& buyer,
+    const std::string& seller,
+    uint64_t deposit,
+    uint64_t put_price,
+    uint64_t get_price)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const std::string k = key(buyer, seller);
+    if (m_ids.count(k) != 0) {
+        throw DomainError("a channel from " + buyer + " to " + seller
+                          + " is already open");
+    }
+
+    // The buyer's address, then 12 bytes unique to the buyer.
+    std::string id = "0x" + std::string(64, '0');
+    write_packed_address(&id[2], buyer);
+    abi::write_hex(&id[42], m_session, 16);
+    abi::write_hex(&id[58], m_n_issued, 8);
+    ++m_n_issued;
+
+    const PaymentChannel channel{id,
+                                 buyer,
+                                 seller,
+                                 ChannelState::OPENING,
+                                 deposit,
+                                 put_price,
+                                 get_price,
+                                 0,
+                                 0,
+                                 {0, 0, ""}};
+    m_channels[channel.id] = channel;
+    m_ids[k] = channel.id;
+    return channel.id;
+}
+
+void PaymentChannels::confirm(const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto it = m_channels.find(id);
+    if (it == m_channels.end() || it->second.state != ChannelState::OPENING) {
+        return;
+    }
+    it->second.state = ChannelState::OPEN;
+    ++m_stats.n_opened;
+}
+
+PaymentChannel
+PaymentChannels::find(const std::string& buyer, const std::string& seller)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto it = m_ids.find(key(buyer, seller));
+    if (it == m_ids.end()) {
+        throw DomainError("no channel from " + buyer + " to " + seller);
+    }
+    return m_channels.at(it->second);
+}
+
+bool PaymentChannels::is_open(
+    const std::string& buyer,
+    const std::string& seller) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto it = m_ids.find(key(buyer, seller));
+    return it != m_ids.end()
+           && m_channels.at(it->second).state == ChannelState::OPEN;
+}
+
+PaymentChannel PaymentChannels::pay(
+    const std::string& buyer,
+    const std::string& seller,
+    uint64_t put_bytes,
+    uint64_t get_bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    PaymentChannel& channel = open_channel(buyer, seller);
+    // Beyond, the seller wouldn't be paid (the contract caps the payment).
+    if (!covers(
+            channel.deposit,
+            channel.put_bytes + put_bytes,
+            channel.put_price,
+            channel.get_bytes + get_bytes,
+            channel.get_price)) {
+        throw DomainError("the deposit of " + channel.id
+                          + " doesn't cover the bytes");
+    }
+    channel.put_bytes += put_bytes;
+    channel.get_bytes += get_bytes;
+    ++m_stats.n_vouchers;
+    m_stats.n_bytes += put_bytes + get_bytes;
+    return channel;
+}
+
+void PaymentChannels::deliver(const std::string& id, const Voucher& voucher)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto it = m_channels.find(id);
+    if (it == m_channels.end()) {
+        return;
+    }
+    // The vouchers are cumulative: an older one (signed concurrently) pays
+    // less than the current one.
+    Voucher& current = it->second.voucher;
+    if (voucher.put_bytes >= current.put_bytes
+        && voucher.get_bytes >= current.get_bytes) {
+        current = voucher;
+    }
+}
+
+PaymentChannel PaymentChannels::start_closing(
+    const std::string& buyer,
+    const std::string& seller)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    PaymentChannel& channel = open_channel(buyer, seller);
+    channel.state = ChannelState::CLOSING;
+    return channel;
+}
+
+void PaymentChannels::reopen(const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto it = m_channels.find(id);
+    if (it == m_channels.end() || it->second.state != ChannelState::CLOSING) {
+        return;
+    }
+    it->second.state = ChannelState::OPEN;
+}
+
+void PaymentChannels::close(const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto it = m_channels.find(id);
+    if (it == m_channels.end()) {
+        return;
+    }
+    if (it->second.state != ChannelState::OPENING) {
+        ++m_stats.n_closed;
+    }
+    m_ids.erase(key(it->second.buyer, it->second.seller));
+    m_channels.erase(it);
+}
+
+ChannelStats PaymentChannels::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+std::string voucher_message(
+    const std::string& contract,
+    const std::string& id,
+    const Voucher& voucher)
+{
+    // Packed, like the arguments of `keccak256` in the contract: the
+    // address takes 20 bytes, the others 32.
+    std::string message = "0x" + std::string(40 + 3 * 64, '0');
+    write_packed_address(&message[2], contract);
+    abi::Bytes32::encode(&message[42], id);
+    abi::Uint256::encode(&message[106], voucher.put_bytes);
+    abi::Uint256::encode(&message[170], voucher.get_bytes);
+    return message;
+}
+
+} // namespace dcss
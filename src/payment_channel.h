@@ -0,0 +1,204 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_PAYMENT_CHANNEL_H__
+#define __DCSS_PAYMENT_CHANNEL_H__
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace dcss {
+
+/** What the buyer owes the seller: the bytes put and got since the channel
+ * was opened, signed by the buyer.
+ */
+struct Voucher {
+    uint64_t put_bytes;
+    uint64_t get_bytes;
+    /** Signature of the buyer (hex-encoded r, s and v), empty if none. */
+    std::string signature;
+};
+
+/** Where a channel stands: only its transactions, once mined, move it. */
+enum class ChannelState {
+    /** `openChannel` not mined yet: nothing can be paid through it. */
+    OPENING,
+    OPEN,
+    /** `settleChannel` or `disputeChannel` not mined yet: the last voucher
+     * is being redeemed, nothing more can be paid through it.
+     */
+    CLOSING,
+};
+
+/** A unidirectional payment channel, from a buyer to a seller. */
+struct PaymentChannel {
+    /** Chosen by the buyer (32 bytes, hex-encoded). */
+    std::string id;
+    std::string buyer;
+    std::string seller;
+    ChannelState state;
+    /** Tokens escrowed by the contract. */
+    uint64_t deposit;
+    /** Storage prices of the seller (tokens per byte), frozen at opening. */
+    uint64_t put_price;
+    uint64_t get_price;
+    /** Bytes paid so far (signed or not yet). */
+    uint64_t put_bytes;
+    uint64_t get_bytes;
+    /** Last voucher handed to the seller. */
+    Voucher voucher;
+};
+
+struct ChannelStats {
+    uint64_t n_opened;
+    uint64_t n_closed;
+    /** Number of vouchers signed (one per put/get paid). */
+    uint64_t n_vouchers;
+    /** Number of bytes paid through the channels. */
+    uint64_t n_bytes;
+};
+
+/** The payment channels between the nodes' accounts.
+ *
+ * Only opening and closing a channel is a transaction: in between, the
+ * buyer pays for each put/get off-chain, by signing a voucher for the
+ * cumulative number of bytes. The seller only keeps the last one, and
+ * redeems it to close the channel.
+ *
+ * The vouchers are handed to the seller through this object: all the nodes
+ * of the simulated network share it. A channel changes state only once the
+ * transaction opening or closing it is mined (see `ChannelState`).
+ */
+class PaymentChannels {
+  public:
+    PaymentChannels();
+    ~PaymentChannels() = default;
+    PaymentChannels(PaymentChannels const&) = delete;
+    PaymentChannels& operator=(PaymentChannels const& x) = delete;
+    PaymentChannels(PaymentChannels&&) = delete;
+    PaymentChannels& operator=(PaymentChannels&& x) = delete;
+
+    /** Record a new channel from `buyer` to `seller`, opening until
+     * `confirm` is called, return its ID.
+     *
+     * @throw DomainError if there is already one, or if `buyer` is not an
+     * address
+     */
+    std::string open(
+        const std::string& buyer,
+        const std::string& seller,
+        uint64_t deposit,
+        uint64_t put_price,
+        uint64_t get_price);
+
+    /** Open the channel `id`, once `openChannel` is mined. */
+    void confirm(const std::string& id);
+
+    /** Return the channel from `buyer` to `seller`.
+     *
+     * @throw DomainError if there is none
+     */
+    PaymentChannel find(const std::string& buyer, const std::string& seller);
+
+    /** Return true if there is an open channel from `buyer` to `seller`. */
+    bool
+    is_open(const std::string& buyer, const std::string& seller) const;
+
+    /** Add the bytes to the ones paid through the channel from `buyer` to
+     * `seller`, return the updated channel (the voucher to sign).
+     *
+     * @throw DomainError if there is no such open channel, or if its deposit
+     * doesn't cover the bytes
+     */
+    PaymentChannel pay(
+        const std::string& buyer,
+        const std::string& seller,
+        uint64_t put_bytes,
+        uint64_t get_bytes);
+
+    /** Hand a voucher of the channel `id` to the seller, who keeps it if it
+     * pays more than the one it has.
+     */
+    void deliver(const std::string& id, const Voucher& voucher);
+
+    /** Stop the payments through the channel from `buyer` to `seller`,
+     * return it (the last voucher to redeem).
+     *
+     * @throw DomainError if there is no such open channel
+     */
+    PaymentChannel
+    start_closing(const std::string& buyer, const std::string& seller);
+
+    /** Open the channel `id` again, if closing it failed. */
+    void reopen(const std::string& id);
+
+    /** Forget the channel `id`, once closed (or if opening it failed). */
+    void close(const std::string& id);
+
+    ChannelStats stats() const;
+
+  private:
+    static std::string
+    key(const std::string& buyer, const std::string& seller);
+    /** Return the open channel from `buyer` to `seller` (with the mutex
+     * held).
+     *
+     * @throw DomainError if there is none
+     */
+    PaymentChannel&
+    open_channel(const std::string& buyer, const std::string& seller);
+
+    mutable std::mutex m_mutex;
+    /** Random, so that the IDs are not reused by the next runs. */
+    uint64_t m_session;
+    /** Number of IDs issued in this session. */
+    uint32_t m_n_issued;
+    /** Channels (whatever their state), indexed by ID. */
+    std::unordered_map<std::string, PaymentChannel> m_channels;
+    /** IDs of the channels, indexed by buyer and seller. */
+    std::unordered_map<std::string, std::string> m_ids;
+    ChannelStats m_stats;
+};
+
+/** Return the message signed (with `eth_sign`) by the buyer for `voucher`:
+ * the contract address, the channel ID and the cumulative bytes, as checked
+ * by `settleChannel`.
+ *
+ * @throw DomainError if `contract` is not an address or `id` not 32 bytes
+ */
+std::string voucher_message(
+    const std::string& contract,
+    const std::string& id,
+    const Voucher& voucher);
+
+} // namespace dcss
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+
+#include "repair.h"
+
+namespace dcss {
+
+TokenBucket::TokenBucket(uint64_t rate, uint64_t burst)
+    : m_rate(static_cast<int64_t>(rate)),
+      m_burst(static_cast<int64_t>(std::max(rate, burst))), m_tokens(m_burst)
+{
+}
+
+/** Add the tokens of one tick. */
+void TokenBucket::tick()
+{
+    m_tokens = std::min(m_tokens + m_rate, m_burst);
+}
+
+/** Tell if some tokens are available. */
+bool TokenBucket::has_tokens() const
+{
+    return m_tokens > 0;
+}
+
+/** Consume tokens.
+ *
+ * Consuming more than available is allowed (so that a transfer larger than
+ * the burst can go through): the debt is paid by the next ticks.
+ */
+void TokenBucket::consume(uint64_t n_tokens)
+{
+    m_tokens -= static_cast<int64_t>(n_tokens);
+}
+
+/** Queue a file for repair.
+ *
+ * @return false if the file is already queued.
+ */
+bool RepairQueue::push(const RepairTask& task)
+{
+    if (!m_queued.insert(task.file).second) {
+        return false;
+    }
+    m_tasks.push(task);
+    return true;
+}
+
+/** Dequeue the most at-risk file.
+ *
+ * @return false if the queue is empty.
+ */
+bool RepairQueue::pop(RepairTask& task)
+{
+    if (m_tasks.empty()) {
+        return false;
+    }
+    task = m_tasks.top();
+    m_tasks.pop();
+    m_queued.erase(task.file);
+    return true;
+}
+
+} // namespace dcss
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_REPAIR_H__
+#define __DCSS_REPAIR_H__
+
+#include <cstdint>
+#include <queue>
+#include <unordered_set>
+#include <vector>
+
+#include "uint160.h"
+
+namespace dcss {
+
+/** Token bucket, limiting a rate of bytes per tick. */
+class TokenBucket {
+  public:
+    /** Create a bucket (initially full).
+     *
+     * @param rate  number of tokens added at each tick
+     * @param burst maximum number of tokens
+     */
+    TokenBucket(uint64_t rate, uint64_t burst);
+
+    void tick();
+    bool has_tokens() const;
+    void consume(uint64_t n_tokens);
+
+  private:
+    int64_t m_rate;
+    int64_t m_burst;
+    /** Available tokens (can go negative after an oversized consumption). */
+    int64_t m_tokens;
+};
+
+/** A file that lost some of its redundancy. */
+struct RepairTask {
+    /** Key of the file. */
+    UInt160 file;
+    /** Number of pieces (replicas or fragments) that can still be lost. */
+    int32_t margin;
+    /** Number of pieces to regenerate. */
+    uint32_t n_missing;
+
+    // The most at-risk files first, then the most damaged ones.
+    bool operator<(const RepairTask& other) const
+    {
+        if (margin != other.margin) {
+            return margin > other.margin;
+        }
+        return n_missing < other.n_missing;
+    }
+};
+
+/** Queue of the files to repair, the most at-risk first.
+ *
+ * A file is queued at most once.
+ */
+class RepairQueue {
+  public:
+    bool push(const RepairTask& task);
+    bool pop(RepairTask& task);
+
+    /** Return the number of files waiting for a repair. */
+    inline size_t size() const
+    {
+        return m_tasks.size();
+    }
+
+    /** Tell if there is no file waiting for a repair. */
+    inline bool empty() const
+    {
+        return m_tasks.empty();
+    }
+
+  private:
+    std::priority_queue<RepairTask> m_tasks;
+    std::unordered_set<UInt160> m_queued;
+};
+
+/** Outcome of a repair (see `Network::repair`). */
+struct RepairStats {
+    /** Number of repairs (a file may take several, one per node noticing
+     * missing replicas). */
+    uint32_t n_repaired;
+    /** Number of files still missing a piece, at the end. */
+    uint32_t n_degraded;
+    /** Number of files lost (too few pieces left to regenerate them). */
+    uint32_t n_lost;
+    /** Bytes transferred by the repairs. */
+    uint64_t n_bytes;
+    /** Messages sent by the detection and the repairs. */
+    uint64_t n_messages;
+    /** Number of ticks elapsed. */
+    uint32_t n_ticks;
+    /** Tick of the last repair. */
+    uint32_t restored_at;
+    /** True if a whole round of checks found nothing left to repair. */
+    bool restored;
+    /** Number of reads performed meanwhile. */
+    uint32_t n_reads;
+    /** Number of these reads that failed. */
+    uint32_t n_failed_reads;
+};
+
+} // namespace dcss
+
+#endif
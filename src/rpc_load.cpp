@@ -0,0 +1,135 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <atomic>
+#include <numeric>
+
+#include "rpc_load.h"
+
+namespace dcss {
+
+const char* rpc_name(Rpc rpc)
+{
+    switch (rpc) {
+    case Rpc::PING:
+        return "PING";
+    case Rpc::FIND_NODE:
+        return "FIND_NODE";
+    case Rpc::FIND_VALUE:
+        return "FIND_VALUE";
+    case Rpc::STORE:
+        return "STORE";
+    case Rpc::GOSSIP:
+        return "GOSSIP";
+    case Rpc::KEY_EXCHANGE:
+        return "KEY_EXCHANGE";
+    }
+    return "UNKNOWN";
+}
+
+uint64_t RpcCounters::n_requests() const
+{
+    return std::accumulate(n_served.begin(), n_served.end(), uint64_t(0));
+}
+
+RpcCounters& RpcCounters::operator+=(const RpcCounters& other)
+{
+    for (size_t i = 0; i < N_RPCS; ++i) {
+        n_served[i] += other.n_served[i];
+    }
+    bytes_in += other.bytes_in;
+    bytes_out += other.bytes_out;
+    n_stored += other.n_stored;
+    return *this;
+}
+
+/** Never reused: a new instance can't pick the tables of a destroyed one. */
+static std::atomic<uint64_t> next_id(1);
+
+RpcLoad::RpcLoad() : m_id(next_id++) {}
+
+RpcLoad::Shard& RpcLoad::local_shard()
+{
+    thread_local std::unordered_map<uint64_t, Shard*> shards;
+
+    Shard*& shard = shards[m_id];
+    if (shard == nullptr) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_shards.push_back(std::make_unique<Shard>());
+        shard = m_shards.back().get();
+    }
+    return *shard;
+}
+
+void RpcLoad::record(
+    const UInt160& node,
+    Rpc rpc,
+    uint64_t bytes_in,
+    uint64_t bytes_out,
+    uint64_t n_stored)
+{
+    Shard& shard = local_shard();
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    // Value-initialized (zeroed) on first use.
+    RpcCounters& counters = shard.counters[node];
+
+    ++counters.n_served[static_cast<size_t>(rpc)];
+    counters.bytes_in += bytes_in;
+    counters.bytes_out += bytes_out;
+    counters.n_stored += n_stored;
+}
+
+std::unordered_map<UInt160, RpcCounters> RpcLoad::totals() const
+{
+    std::unordered_map<UInt160, RpcCounters> totals;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (const auto& shard : m_shards) {
+        std::lock_guard<std::mutex> shard_lock(shard->mutex);
+
+        for (const auto& it : shard->counters) {
+            totals[it.first] += it.second;
+        }
+    }
+    return totals;
+}
+
+void RpcLoad::reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (const auto& shard : m_shards) {
+        std::lock_guard<std::mutex> shard_lock(shard->mutex);
+
+        shard->counters.clear();
+    }
+}
+
+} // namespace dcss
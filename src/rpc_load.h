@@ -0,0 +1,133 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_RPC_LOAD_H__
+#define __DCSS_RPC_LOAD_H__
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "uint160.h"
+
+namespace dcss {
+
+/** The RPCs served by the nodes. */
+enum class Rpc {
+    PING,
+    FIND_NODE,
+    FIND_VALUE,
+    STORE,
+    GOSSIP,
+    KEY_EXCHANGE,
+};
+
+static const size_t N_RPCS = 6;
+
+/** Name of an RPC, for the reports. */
+const char* rpc_name(Rpc rpc);
+
+/** Size (in bytes) of a key on the wire. */
+static const uint64_t WIRE_KEY_SIZE = 20;
+/** Size (in bytes) of a contact on the wire (ID, IPv4 address and port). */
+static const uint64_t WIRE_CONTACT_SIZE = 26;
+
+/** Load of a node: the RPCs it served. */
+struct RpcCounters {
+    /** Number of requests served, per RPC. */
+    std::array<uint64_t, N_RPCS> n_served;
+    /** Bytes received (requests) and sent (answers). */
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    /** Number of entries stored (by STORE). */
+    uint64_t n_stored;
+
+    /** Return the number of requests served, all RPCs included. */
+    uint64_t n_requests() const;
+    RpcCounters& operator+=(const RpcCounters& other);
+};
+
+/** Per-node RPC counters.
+ *
+ * Each thread records in its own table (an uncontended lock), the tables
+ * are only summed when the counters are read.
+ */
+class RpcLoad {
+  public:
+    RpcLoad();
+
+    /** Record a request served by `node`.
+     *
+     * @param node      ID of the node serving the request
+     * @param rpc       the RPC
+     * @param bytes_in  size of the request
+     * @param bytes_out size of the answer
+     * @param n_stored  number of entries stored by the request
+     */
+    void record(
+        const UInt160& node,
+        Rpc rpc,
+        uint64_t bytes_in,
+        uint64_t bytes_out,
+        uint64_t n_stored = 0);
+
+    /** Return the counters of each node (summed over the threads). */
+    std::unordered_map<UInt160, RpcCounters> totals() const;
+
+    /** Reset every counter. */
+    void reset();
+
+    ~RpcLoad() = default;
+    RpcLoad(RpcLoad const&) = delete;
+    RpcLoad& operator=(RpcLoad const& x) = delete;
+    RpcLoad(RpcLoad&&) = delete;
+    RpcLoad& operator=(RpcLoad&& x) = delete;
+
+  private:
+    /** Counters recorded by one thread. */
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<UInt160, RpcCounters> counters;
+    };
+
+    /** Return the table of the calling thread (created on first use). */
+    Shard& local_shard();
+
+    /** Identifies this instance in the thread-local tables. */
+    const uint64_t m_id;
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+};
+
+} // namespace dcss
+
+#endif
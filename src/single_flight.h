@@ -0,0 +1,143 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_SINGLE_FLIGHT_H__
+#define __DCSS_SINGLE_FLIGHT_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace dcss {
+
+/** Coalesces the concurrent calls of an operation on the same key.
+ *
+ * The first caller of `run` for a key (the leader) runs the operation, the
+ * callers arriving while it is in flight wait for it and share its result
+ * (or its exception). Once done, the call is forgotten: the next caller for
+ * this key runs the operation again (the results are not cached).
+ *
+ * A caller gives up by `cancel`ing its flag, it then gets a CancelledError
+ * at once, the leader included: a leader that can give up runs the
+ * operation in the background. The operation keeps on running as long as
+ * another caller waits for its result, and can poll `abandoned` to stop
+ * early otherwise.
+ */
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class SingleFlight {
+  public:
+    /** Set, from any thread, by a caller to give up. */
+    using CancelFlag = std::atomic<bool>;
+    /** Return true if no caller wants the result anymore. */
+    using AbandonedFunc = std::function<bool()>;
+    /** The operation, which may stop early once abandoned. */
+    using Func = std::function<Value(const AbandonedFunc& abandoned)>;
+
+    SingleFlight();
+
+    Value
+    run(const Key& key, const Func& func, const CancelFlag* cancel = nullptr);
+
+    /** Set `flag`, giving up the calls waiting with it. */
+    void cancel(CancelFlag& flag);
+
+    /** Return the number of calls in flight. */
+    size_t in_flight() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_calls.size();
+    }
+
+    /** Return the number of calls to `run`. */
+    uint64_t n_calls() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_n_calls;
+    }
+
+    /** Return the number of calls that joined one already in flight. */
+    uint64_t n_shared() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_n_shared;
+    }
+
+    /** Wait for the operations running in the background. */
+    ~SingleFlight();
+    SingleFlight(SingleFlight const&) = delete;
+    SingleFlight& operator=(SingleFlight const& x) = delete;
+    SingleFlight(SingleFlight&&) = delete;
+    SingleFlight& operator=(SingleFlight&& x) = delete;
+
+  private:
+    /** State of a call in flight. */
+    struct Call {
+        std::shared_future<Value> result;
+        /** Number of callers waiting for the result, the leader included. */
+        uint32_t n_waiting;
+        /** The result is set. */
+        bool done;
+        /** Nobody wants the result anymore (no caller can join it). */
+        bool abandoned;
+    };
+
+    void complete(
+        const Key& key,
+        const std::shared_ptr<Call>& call,
+        std::promise<Value>& promise,
+        const Func& func);
+    Value wait(
+        std::unique_lock<std::mutex>& lock,
+        const Key& key,
+        const std::shared_ptr<Call>& call,
+        const CancelFlag* cancel);
+    void forget(const Key& key, const std::shared_ptr<Call>& call);
+
+    mutable std::mutex m_mutex;
+    /** Signaled when a call is done, cancelled or when an operation running
+     * in the background returns.
+     */
+    std::condition_variable m_cond;
+    std::unordered_map<Key, std::shared_ptr<Call>, Hash> m_calls;
+    uint64_t m_n_calls;
+    uint64_t m_n_shared;
+    /** Number of operations running in the background. */
+    uint32_t m_n_running;
+};
+
+} // namespace dcss
+
+#include "single_flight.tpp"
+
+#endif
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <exception>
+#include <thread>
+#include <utility>
+
+#include "exceptions.h"
+
+namespace dcss {
+
+template <typename Key, typename Value, typename Hash>
+SingleFlight<Key, Value, Hash>::SingleFlight()
+    : m_n_calls(0), m_n_shared(0), m_n_running(0)
+{
+}
+
+template <typename Key, typename Value, typename Hash>
+SingleFlight<Key, Value, Hash>::~SingleFlight()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond.wait(lock, [this]() { return m_n_running == 0; });
+}
+
+/** Run `func` for `key`, or join the call in flight for `key`, if any.
+ *
+ * Without `cancel`, the leader runs `func` itself. Otherwise, `func` runs
+ * in the background, so that the leader can give up at once: it must not
+ * refer to the caller's locals then.
+ *
+ * @param key    key of the operation
+ * @param func   the operation (only run if no call is in flight)
+ * @param cancel flag set by the caller to give up (see `cancel`), if any
+ * @return the result of the operation.
+ *
+ * @throw CancelledError — the caller gave up.
+ * @note the exceptions thrown by `func` are propagated to every caller.
+ */
+template <typename Key, typename Value, typename Hash>
+Value SingleFlight<Key, Value, Hash>::run(
+    const Key& key,
+    const Func& func,
+    const CancelFlag* cancel)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    ++m_n_calls;
+    const auto it = m_calls.find(key);
+    if (it != m_calls.end()) {
+        const std::shared_ptr<Call> call(it->second);
+
+        ++m_n_shared;
+        ++call->n_waiting;
+        return wait(lock, key, call, cancel);
+    }
+
+    const auto promise = std::make_shared<std::promise<Value>>();
+    const auto call = std::make_shared<Call>();
+    call->result = promise->get_future().share();
+    call->n_waiting = 1;
+    call->done = false;
+    call->abandoned = false;
+    m_calls.emplace(key, call);
+
+    if (cancel == nullptr) {
+        lock.unlock();
+        complete(key, call, *promise, func);
+        lock.lock();
+        return wait(lock, key, call, nullptr);
+    }
+    ++m_n_running;
+    std::thread([this, key, call, promise, func]() {
+        complete(key, call, *promise, func);
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        --m_n_running;
+        m_cond.notify_all();
+    }).detach();
+    return wait(lock, key, call, cancel);
+}
+
+template <typename Key, typename Value, typename Hash>
+void SingleFlight<Key, Value, Hash>::cancel(CancelFlag& flag)
+{
+    // Set under the lock, not to be missed by a caller about to wait.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    flag = true;
+    m_cond.notify_all();
+}
+
+/** Run `func` and publish its result (or its exception). */
+template <typename Key, typename Value, typename Hash>
+void SingleFlight<Key, Value, Hash>::complete(
+    const Key& key,
+    const std::shared_ptr<Call>& call,
+    std::promise<Value>& promise,
+    const Func& func)
+{
+    const AbandonedFunc abandoned = [this, &call]() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return call->abandoned;
+    };
+
+    try {
+        promise.set_value(func(abandoned));
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+    }
+    // Forgotten once done: a caller arriving from now on runs the operation
+    // again.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    forget(key, call);
+    call->done = true;
+    m_cond.notify_all();
+}
+
+/** Wait for the result of a call in flight (`lock` held). */
+template <typename Key, typename Value, typename Hash>
+Value SingleFlight<Key, Value, Hash>::wait(
+    std::unique_lock<std::mutex>& lock,
+    const Key& key,
+    const std::shared_ptr<Call>& call,
+    const CancelFlag* cancel)
+{
+    m_cond.wait(lock, [&call, cancel]() {
+        return call->done || (cancel != nullptr && cancel->load());
+    });
+    --call->n_waiting;
+    if (call->done) {
+        lock.unlock();
+        return call->result.get();
+    }
+
+    // The last caller gave up: the call is dropped, so that the next
+    // callers start a new one.
+    if (call->n_waiting == 0) {
+        call->abandoned = true;
+        forget(key, call);
+    }
+    throw CancelledError("call cancelled");
+}
+
+/** Remove `call` from the calls in flight, unless already replaced
+ * (`m_mutex` held).
+ */
+template <typename Key, typename Value, typename Hash>
+void SingleFlight<Key, Value, Hash>::forget(
+    const Key& key,
+    const std::shared_ptr<Call>& call)
+{
+    const auto it = m_calls.find(key);
+    if (it != m_calls.end() && it->second == call) {
+        m_calls.erase(it);
+    }
+}
+
+} // namespace dcss
@@ -0,0 +1,533 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <unordered_set>
+#include <utility>
+
+#include "exceptions.h"
+#include "geth_batch.h"
+#include "tx_manager.h"
+
+namespace dcss {
+
+// Number of blocks fetched together.
+static const uint64_t MAX_BLOCKS_PER_SCAN = 64;
+
+// Number of transactions sent to fill a gap in the nonces, before giving
+// up (the account is then synchronized again).
+static const uint32_t MAX_GAP_FILLS = 4;
+
+// Parse a quantity, hex-encoded according to the Ethereum JSON-RPC API (up
+// to 64 bits).
+static uint64_t parse_quantity(const std::string& hex)
+{
+    if (hex.size() < 3 || hex.size() > 2 + 16 || hex.compare(0, 2, "0x") != 0
+        || hex.find_first_not_of("0123456789abcdefABCDEF", 2)
+               != std::string::npos) {
+        throw jsonrpc::JsonRpcException(
+            jsonrpc::Errors::ERROR_CLIENT_INVALID_RESPONSE, hex);
+    }
+    return std::stoull(hex, nullptr, 16);
+}
+
+static std::string as_string(const Json::Value& value)
+{
+    if (!value.isString()) {
+        throw jsonrpc::JsonRpcException(
+            jsonrpc::Errors::ERROR_CLIENT_INVALID_RESPONSE,
+            value.toStyledString());
+    }
+    return value.asString();
+}
+
+// Return true if a transaction has been rejected because of its nonce.
+static bool is_nonce_error(const std::string& message)
+{
+    return message.find("nonce") != std::string::npos
+           || message.find("underpriced") != std::string::npos
+           || message.find("known") != std::string::npos;
+}
+
+static std::string encode_quantity(uint64_t n)
+{
+    std::ostringstream oss;
+    oss << "0x" << std::hex << n;
+    return oss.str();
+}
+
+TxManager::TxManager(
+    GethClient& geth,
+    std::chrono::milliseconds min_poll,
+    std::chrono::milliseconds max_poll,
+    std::chrono::milliseconds timeout)
+    : m_geth(geth), m_min_poll(min_poll),
+      m_max_poll(std::max(min_poll, max_poll)), m_timeout(timeout),
+      m_n_in_flight(0), m_stats(), m_stopping(false), m_last_block(0),
+      m_backoff(min_poll)
+{
+}
+
+TxManager::~TxManager()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeup.notify_one();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+std::future<TxReceipt> TxManager::submit(const Json::Value& tx)
+{
+    auto done = std::make_shared<std::promise<TxReceipt>>();
+    std::future<TxReceipt> result = done->get_future();
+
+    submit(tx, [done](const TxReceipt& receipt, std::exception_ptr error) {
+        if (error) {
+            done->set_exception(error);
+        } else {
+            done->set_value(receipt);
+        }
+    });
+    return result;
+}
+
+void TxManager::submit(const Json::Value& tx, TxCallback on_done)
+{
+    Tx entry;
+
+    entry.params = tx;
+    entry.on_done = std::move(on_done);
+    entry.local_nonce = false;
+    entry.retried = false;
+    entry.n_gap_fills = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping) {
+            throw LogicError("transaction manager stopped");
+        }
+        if (!m_thread.joinable()) {
+            m_thread = std::thread(&TxManager::run, this);
+        }
+        m_queue.push_back(std::move(entry));
+        ++m_n_in_flight;
+    }
+    m_wakeup.notify_one();
+}
+
+size_t TxManager::n_in_flight() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_n_in_flight;
+}
+
+TxStats TxManager::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void TxManager::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (!m_stopping) {
+        std::deque<Tx> queue;
+        queue.swap(m_queue);
+        lock.unlock();
+
+        if (!queue.empty() && m_pending.empty()) {
+            // Start following the chain: the transactions sent from now on
+            // can only be in the blocks to come.
+            std::exception_ptr error;
+            try {
+                m_last_block = head_block();
+            } catch (jsonrpc::JsonRpcException&) {
+                error = std::current_exception();
+            }
+            if (error) {
+                for (Tx& tx : queue) {
+                    settle(tx, TxReceipt(), error);
+                }
+                queue.clear();
+            }
+            m_backoff = m_min_poll;
+            m_next_poll = Clock::now() + m_backoff;
+        }
+        if (!queue.empty()) {
+            send(queue);
+        }
+
+        if (!m_pending.empty() && m_next_poll <= Clock::now()) {
+            follow_chain();
+        }
+        expire();
+
+        lock.lock();
+        const auto has_work = [this]() {
+            return m_stopping || !m_queue.empty();
+        };
+        if (m_pending.empty()) {
+            m_wakeup.wait(lock, has_work);
+        } else {
+            m_wakeup.wait_until(lock, m_next_poll, has_work);
+        }
+    }
+
+    // Give up the transactions in flight.
+    std::deque<Tx> queue;
+    queue.swap(m_queue);
+    lock.unlock();
+
+    const auto cancelled = std::make_exception_ptr(
+        CancelledError("transaction manager stopped"));
+    for (Tx& tx : queue) {
+        settle(tx, TxReceipt(), cancelled);
+    }
+    for (auto& pending : m_pending) {
+        settle(pending.second, TxReceipt(), cancelled);
+    }
+    m_pending.clear();
+}
+
+void TxManager::sync_nonces(const std::deque<Tx>& queue)
+{
+    GethBatch counts(m_geth);
+    std::vector<std::string> accounts;
+    std::unordered_set<std::string> seen;
+
+    for (const Tx& tx : queue) {
+        const std::string from = tx.params.get("from", "").asString();
+        if (from.empty() || tx.params.isMember("nonce")
+            || m_nonces.is_synced(from) || !seen.insert(from).second) {
+            continue;
+        }
+        Json::Value params;
+        params.append(from);
+        params.append("pending");
+        counts.add("eth_getTransactionCount", params);
+        accounts.push_back(from);
+    }
+    if (accounts.empty()) {
+        return;
+    }
+
+    // Without a nonce, geth assigns one.
+    try {
+        counts.send();
+    } catch (jsonrpc::JsonRpcException&) {
+    }
+    count_calls(counts);
+
+    for (size_t i = 0; i < accounts.size(); ++i) {
+        if (!counts.sent(i) || counts.error_code(i) != 0) {
+            continue;
+        }
+        try {
+            const uint64_t next = parse_quantity(as_string(counts.result(i)));
+            m_nonces.sync(accounts[i], next);
+        } catch (jsonrpc::JsonRpcException&) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_stats.n_nonce_syncs;
+    }
+}
+
+void TxManager::send(std::deque<Tx>& queue)
+{
+    GethBatch batch(m_geth);
+    std::exception_ptr error;
+
+    sync_nonces(queue);
+    for (Tx& tx : queue) {
+        // Not `operator[]`, which would add a null sender.
+        const std::string from = tx.params.get("from", "").asString();
+        if (!tx.params.isMember("nonce") && m_nonces.is_synced(from)) {
+            tx.params["nonce"] = encode_quantity(m_nonces.allocate(from));
+            tx.local_nonce = true;
+        }
+        Json::Value params;
+        params.append(tx.params);
+        batch.add("eth_sendTransaction", params);
+    }
+    try {
+        batch.send();
+    } catch (jsonrpc::JsonRpcException&) {
+        error = std::current_exception();
+    }
+    count_calls(batch);
+
+    const Clock::time_point deadline = Clock::now() + m_timeout;
+    for (size_t i = 0; i < queue.size(); ++i) {
+        Tx& tx = queue[i];
+        std::string hash;
+
+        if (!batch.sent(i)) {
+            give_up(tx, error, false);
+            continue;
+        }
+        try {
+            hash = as_string(batch.result(i));
+        } catch (jsonrpc::JsonRpcException& exn) {
+            give_up(
+                tx,
+                std::current_exception(),
+                is_nonce_error(exn.GetMessage()));
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_stats.n_sent;
+        }
+        tx.deadline = deadline;
+        m_pending.emplace(hash, std::move(tx));
+    }
+}
+
+void TxManager::give_up(Tx& tx, std::exception_ptr error, bool nonce_error)
+{
+    const std::string from = tx.params.get("from", "").asString();
+
+    if (nonce_error) {
+        // A nonce already used (or skipped) by another sender: retry once,
+        // with a fresh nonce.
+        if (drop_nonce(tx) && !tx.retried) {
+            tx.retried = true;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back(std::move(tx));
+            return;
+        }
+    } else if (tx.local_nonce || tx.n_gap_fills != 0) {
+        // Its nonce is a gap, holding back the transactions sent after it:
+        // taken again at once.
+        const std::string nonce = tx.params.get("nonce", "").asString();
+        if (tx.n_gap_fills < MAX_GAP_FILLS) {
+            fill_gap(from, nonce, tx.n_gap_fills + 1);
+        } else {
+            // The next transaction of the sender fills it.
+            m_nonces.invalidate(from);
+        }
+    }
+    settle(tx, TxReceipt(), error);
+}
+
+void TxManager::fill_gap(
+    const std::string& from,
+    const std::string& nonce,
+    uint32_t n_fills)
+{
+    Tx filler;
+
+    // Nothing but the nonce: an empty transfer to itself.
+    filler.params["from"] = from;
+    filler.params["to"] = from;
+    filler.params["value"] = "0x0";
+    filler.params["nonce"] = nonce;
+    filler.on_done = [](const TxReceipt&, std::exception_ptr) {};
+    filler.local_nonce = false;
+    filler.retried = true;
+    filler.n_gap_fills = n_fills;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.push_back(std::move(filler));
+    ++m_n_in_flight;
+    ++m_stats.n_fillers;
+}
+
+bool TxManager::drop_nonce(Tx& tx)
+{
+    if (!tx.local_nonce) {
+        return false;
+    }
+    m_nonces.invalidate(tx.params.get("from", "").asString());
+    tx.params.removeMember("nonce");
+    tx.local_nonce = false;
+    return true;
+}
+
+uint64_t TxManager::head_block()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_stats.n_calls;
+        ++m_stats.n_requests;
+    }
+    return parse_quantity(m_geth.eth_blockNumber());
+}
+
+void TxManager::follow_chain()
+{
+    bool new_block = false;
+
+    try {
+        const uint64_t head = head_block();
+
+        while (m_last_block < head && !m_pending.empty()) {
+            // Fetch the new blocks together, then the receipts of all the
+            // transactions they contain.
+            const uint64_t n_blocks =
+                std::min<uint64_t>(head - m_last_block, MAX_BLOCKS_PER_SCAN);
+            GethBatch blocks(m_geth);
+            for (uint64_t i = 1; i <= n_blocks; ++i) {
+                Json::Value params;
+                params.append(encode_quantity(m_last_block + i));
+                params.append(false);
+                blocks.add("eth_getBlockByNumber", params);
+            }
+            blocks.send();
+            count_calls(blocks);
+
+            std::vector<std::string> mined;
+            uint64_t n_scanned = 0;
+            for (; n_scanned < n_blocks; ++n_scanned) {
+                const Json::Value& block = blocks.result(n_scanned);
+                if (block.isNull()) {
+                    break; // Not served yet.
+                }
+                for (const Json::Value& hash : block["transactions"]) {
+                    if (m_pending.count(hash.asString()) != 0) {
+                        mined.push_back(hash.asString());
+                    }
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stats.n_blocks += n_scanned;
+            }
+            // The blocks are scanned again if a receipt is missing.
+            if (n_scanned == 0 || !settle_mined(mined).empty()) {
+                break;
+            }
+            m_last_block += n_scanned;
+            new_block = true;
+        }
+    } catch (jsonrpc::JsonRpcException&) {
+        // Retried at the next poll.
+    }
+
+    if (new_block) {
+        m_backoff = m_min_poll;
+    } else {
+        m_backoff = std::min(2 * m_backoff, m_max_poll);
+    }
+    m_next_poll = Clock::now() + m_backoff;
+}
+
+std::vector<std::string>
+TxManager::settle_mined(const std::vector<std::string>& hashes)
+{
+    GethBatch receipts(m_geth);
+    std::vector<std::string> missing;
+
+    for (const std::string& hash : hashes) {
+        Json::Value params;
+        params.append(hash);
+        receipts.add("eth_getTransactionReceipt", params);
+    }
+    receipts.send();
+    count_calls(receipts);
+
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        const std::string& hash = hashes[i];
+        // geth answers null, or an error, for a transaction not mined yet.
+        if (receipts.error_code(i) != 0 || receipts.result(i).isNull()) {
+            missing.push_back(hash);
+            continue;
+        }
+        const Json::Value& receipt = receipts.result(i);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_stats.n_mined;
+        }
+        auto it = m_pending.find(hash);
+        const bool success = receipt["status"] != "0x0";
+        settle(it->second, {hash, success, receipt}, nullptr);
+        m_pending.erase(it);
+    }
+    return missing;
+}
+
+void TxManager::expire()
+{
+    const Clock::time_point now = Clock::now();
+    std::vector<std::string> expired;
+
+    for (const auto& pending : m_pending) {
+        if (pending.second.deadline <= now) {
+            expired.push_back(pending.first);
+        }
+    }
+    if (expired.empty()) {
+        return;
+    }
+
+    // Last chance, in case their blocks have been missed.
+    try {
+        expired = settle_mined(expired);
+    } catch (jsonrpc::JsonRpcException&) {
+    }
+    for (const std::string& hash : expired) {
+        auto it = m_pending.find(hash);
+        // Its nonce may be a gap, holding back the next transactions.
+        drop_nonce(it->second);
+        settle(
+            it->second,
+            TxReceipt(),
+            std::make_exception_ptr(
+                DomainError("transaction " + hash + " not mined in time")));
+        m_pending.erase(it);
+    }
+}
+
+void TxManager::settle(
+    Tx& tx,
+    const TxReceipt& receipt,
+    std::exception_ptr error)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_n_in_flight;
+    }
+    tx.on_done(receipt, error);
+}
+
+void TxManager::count_calls(const GethBatch& batch)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.n_calls += batch.size();
+    m_stats.n_requests += batch.n_requests();
+}
+
+} // namespace dcss
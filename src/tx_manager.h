@@ -0,0 +1,225 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_TX_MANAGER_H__
+#define __DCSS_TX_MANAGER_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "geth_batch.h"
+#include "gethclient.h"
+#include "nonce_allocator.h"
+
+namespace dcss {
+
+/** A mined transaction. */
+struct TxReceipt {
+    /** Hash of the transaction. */
+    std::string hash;
+    /** False if the transaction has been reverted (status 0x0). */
+    bool success;
+    /** The receipt, as returned by `eth_getTransactionReceipt`. */
+    Json::Value receipt;
+};
+
+/** Called once the transaction is mined (`error` is null), or on failure
+ * (the receipt is then empty). It must not throw.
+ */
+using TxCallback =
+    std::function<void(const TxReceipt& receipt, std::exception_ptr error)>;
+
+/** Calls made to geth by the transaction manager. */
+struct TxStats {
+    /** Number of transactions sent. */
+    uint64_t n_sent;
+    /** Number of transactions mined (reverted ones included). */
+    uint64_t n_mined;
+    /** Number of blocks scanned. */
+    uint64_t n_blocks;
+    /** Number of JSON-RPC calls, all methods included. */
+    uint64_t n_calls;
+    /** Number of requests (round trips), several calls sent together count
+     * once.
+     */
+    uint64_t n_requests;
+    /** Number of nonces synchronized with geth. */
+    uint64_t n_nonce_syncs;
+    /** Number of transactions sent only to fill a gap in the nonces. */
+    uint64_t n_fillers;
+};
+
+/** Submit transactions to geth without blocking the caller.
+ *
+ * The transactions are sent by a background thread (started on the first
+ * submission), which then follows the chain while some are pending: the
+ * head is polled with an exponential backoff, from `min_poll` up to
+ * `max_poll` (reset by each new block), and every new block is scanned
+ * once for all the pending transactions. Only the receipts of the
+ * transactions found are fetched. A transaction not seen after `timeout`
+ * is given up (with a `DomainError`).
+ *
+ * The transactions queued together are sent in a single batch, as are the
+ * new blocks and the receipts. The nonces are allocated locally, so that
+ * the transactions of an account don't wait for each other. The nonce of a
+ * transaction that fails to be sent is taken again at once, by an empty
+ * transaction, so that the ones sent after it don't wait.
+ *
+ * `geth` is shared with the other users of the client: its connector must
+ * be thread-safe (like `GethPool`).
+ */
+class TxManager {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    TxManager(
+        GethClient& geth,
+        std::chrono::milliseconds min_poll = std::chrono::milliseconds(100),
+        std::chrono::milliseconds max_poll = std::chrono::milliseconds(4000),
+        std::chrono::milliseconds timeout = std::chrono::minutes(10));
+
+    /** Stop the background thread, the transactions still in flight fail
+     * with a `CancelledError`.
+     */
+    ~TxManager();
+    TxManager(TxManager const&) = delete;
+    TxManager& operator=(TxManager const& x) = delete;
+    TxManager(TxManager&&) = delete;
+    TxManager& operator=(TxManager&& x) = delete;
+
+    /** Submit a transaction (the parameters of `eth_sendTransaction`).
+     *
+     * @return the receipt, once the transaction is mined
+     */
+    std::future<TxReceipt> submit(const Json::Value& tx);
+
+    /** Submit a transaction, `on_done` is called from the background
+     * thread.
+     */
+    void submit(const Json::Value& tx, TxCallback on_done);
+
+    /** Return the number of transactions submitted but not mined yet. */
+    size_t n_in_flight() const;
+
+    /** Return the calls made so far. */
+    TxStats stats() const;
+
+  private:
+    /** A transaction in flight. */
+    struct Tx {
+        Json::Value params;
+        TxCallback on_done;
+        Clock::time_point deadline;
+        /** True if its nonce has been allocated by `m_nonces`. */
+        bool local_nonce;
+        /** True if sent again, after a nonce error. */
+        bool retried;
+        /** For a transaction filling a gap in the nonces, the number of
+         * the ones sent for it so far (this one included), else 0.
+         */
+        uint32_t n_gap_fills;
+    };
+
+    void run();
+    /** Synchronize the nonces of the senders of `queue`, if needed. */
+    void sync_nonces(const std::deque<Tx>& queue);
+    /** Send the transactions of `queue` (the failed ones are settled, or
+     * queued again after a nonce error).
+     */
+    void send(std::deque<Tx>& queue);
+    /** Settle `tx`, which failed to be sent (with a nonce error or not),
+     * or queue it again.
+     */
+    void give_up(Tx& tx, std::exception_ptr error, bool nonce_error);
+    /** Queue a transaction taking the `nonce` of `from` (left by a failed
+     * transaction, and holding back the ones sent after it): the
+     * `n_fills`-th one sent for it.
+     */
+    void fill_gap(
+        const std::string& from,
+        const std::string& nonce,
+        uint32_t n_fills);
+    /** Forget the nonce allocated to `tx` (its sender is synchronized
+     * again), return false if it had none.
+     */
+    bool drop_nonce(Tx& tx);
+    /** Return the number of the last block mined. */
+    uint64_t head_block();
+    /** Scan the blocks mined since the last scan, if any. */
+    void follow_chain();
+    /** Settle the transactions `hashes`, mined or reverted, return the ones
+     * whose receipt is missing.
+     */
+    std::vector<std::string>
+    settle_mined(const std::vector<std::string>& hashes);
+    /** Give up the transactions past their deadline. */
+    void expire();
+    /** Report the outcome of `tx`. */
+    void settle(Tx& tx, const TxReceipt& receipt, std::exception_ptr error);
+    /** Account for the calls of `batch`. */
+    void count_calls(const GethBatch& batch);
+
+    GethClient& m_geth;
+    const std::chrono::milliseconds m_min_poll;
+    const std::chrono::milliseconds m_max_poll;
+    const std::chrono::milliseconds m_timeout;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    /** Submitted, not sent yet. */
+    std::deque<Tx> m_queue;
+    size_t m_n_in_flight;
+    TxStats m_stats;
+    bool m_stopping;
+
+    // Owned by the background thread.
+    NonceAllocator m_nonces;
+    /** Sent, indexed by hash. */
+    std::unordered_map<std::string, Tx> m_pending;
+    /** Last block scanned. */
+    uint64_t m_last_block;
+    Clock::time_point m_next_poll;
+    std::chrono::milliseconds m_backoff;
+
+    std::thread m_thread;
+};
+
+} // namespace dcss
+
+#endif
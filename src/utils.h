@@ -31,10 +31,12 @@
 #define __DCSS_UTILS_H__
 
 #include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <limits>
 #include <random>
 #include <string>
+#include <vector>
 
 #define ELPP_STL_LOGGING
 #define ELPP_LOG_UNORDERED_SET
@@ -84,6 +86,54 @@ safe_copy_n(const SrcContainer& src, size_t n, DstContainer& dst)
     std::copy_n(src.begin(), std::min(n, src.size()), std::back_inserter(dst));
 }
 
+/** Return the `q`-quantile (`q` in [0; 1]) of `values` (reordered). */
+static inline double percentile(std::vector<double>& values, double q)
+{
+    if (values.empty()) {
+        return 0.0;
+    }
+    const auto rank = static_cast<size_t>(
+        std::ceil(q * static_cast<double>(values.size())));
+    const auto nth = values.begin() + std::max<size_t>(rank, 1) - 1;
+
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth;
+}
+
+/** Return the Gini coefficient of `values` (reordered): 0 if they're all
+ * equal, close to 1 if a single one holds almost the whole total.
+ */
+static inline double gini(std::vector<double>& values)
+{
+    double total = 0.0;
+    double weighted = 0.0;
+
+    std::sort(values.begin(), values.end());
+    for (size_t i = 0; i < values.size(); ++i) {
+        total += values[i];
+        weighted += static_cast<double>(i + 1) * values[i];
+    }
+    if (total == 0.0) {
+        return 0.0;
+    }
+    const auto n = static_cast<double>(values.size());
+    return 2.0 * weighted / (n * total) - (n + 1.0) / n;
+}
+
+/** Return a Zipf distribution over [0; n): P(i) is proportional to
+ * 1 / (i + 1)^s (the lowest indexes are the most popular).
+ */
+static inline std::discrete_distribution<size_t>
+zipf_distribution(size_t n, double s)
+{
+    std::vector<double> weights(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        weights[i] = 1.0 / std::pow(static_cast<double>(i + 1), s);
+    }
+    return std::discrete_distribution<size_t>(weights.begin(), weights.end());
+}
+
 // Logger for the simulator.
 #define SIM_LOG_ID "simulator"
 #define SIM_LOG(_level) CLOG(_level, SIM_LOG_ID)
@@ -0,0 +1,226 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+#include <iterator>
+
+#include "value_cache.h"
+
+namespace dcss {
+
+CountMinSketch::CountMinSketch(uint32_t width)
+    : m_width(1), m_n_increments(0)
+{
+    // A power of two, so that the index is a mask.
+    while (m_width < std::max(width, 1u)) {
+        m_width <<= 1u;
+    }
+    m_counters.assign(static_cast<size_t>(DEPTH) * m_width, 0);
+    m_sample_size = 10 * static_cast<uint64_t>(m_width);
+}
+
+size_t CountMinSketch::index(const UInt160& key, uint32_t row) const
+{
+    // Double hashing: the second hash is a mix (splitmix64) of the first.
+    const uint64_t h1 = key.hash();
+    uint64_t h2 = h1 + 0x9e3779b97f4a7c15u;
+    h2 = (h2 ^ (h2 >> 30u)) * 0xbf58476d1ce4e5b9u;
+    h2 = (h2 ^ (h2 >> 27u)) * 0x94d049bb133111ebu;
+    h2 ^= h2 >> 31u;
+
+    const uint64_t column = (h1 + row * (h2 | 1u)) & (m_width - 1);
+    return static_cast<size_t>(row) * m_width + column;
+}
+
+void CountMinSketch::increment(const UInt160& key)
+{
+    for (uint32_t row = 0; row < DEPTH; ++row) {
+        uint8_t& counter = m_counters[index(key, row)];
+
+        if (counter < MAX_COUNT) {
+            ++counter;
+        }
+    }
+    if (++m_n_increments >= m_sample_size) {
+        age();
+    }
+}
+
+uint32_t CountMinSketch::estimate(const UInt160& key) const
+{
+    uint32_t count = MAX_COUNT;
+
+    for (uint32_t row = 0; row < DEPTH; ++row) {
+        count = std::min<uint32_t>(count, m_counters[index(key, row)]);
+    }
+    return count;
+}
+
+/** Halve every counter: the old accesses weigh less and less. */
+void CountMinSketch::age()
+{
+    for (auto& counter : m_counters) {
+        counter = static_cast<uint8_t>(counter >> 1u);
+    }
+    m_n_increments /= 2;
+}
+
+ValueCache::ValueCache(
+    uint64_t budget,
+    CachePolicy policy,
+    uint32_t sketch_width)
+    : m_budget(budget), m_policy(policy),
+      // A disabled cache needs no sketch.
+      m_sketch(
+          policy == CachePolicy::TINY_LFU && budget > 0 ? sketch_width : 1),
+      m_probation_size(0), m_protected_size(0), m_stats{0, 0, 0, 0, 0}
+{
+}
+
+uint64_t ValueCache::charge(const Buffer& value)
+{
+    return value.size() + sizeof(UInt160);
+}
+
+/** Return the cached value of `key`, if any.
+ *
+ * @param key   the key of the value
+ * @param value the value, if cached (shared with the cache, not copied)
+ * @return true if the value is cached, false otherwise.
+ */
+bool ValueCache::get(const UInt160& key, Buffer& value)
+{
+    if (m_policy == CachePolicy::TINY_LFU) {
+        m_sketch.increment(key);
+    }
+    const auto it = m_index.find(key);
+    if (it == m_index.end()) {
+        ++m_stats.n_misses;
+        return false;
+    }
+    ++m_stats.n_hits;
+    value = it->second->value;
+    promote(it->second);
+    return true;
+}
+
+/** Offer a value (just read, see `get`) to the cache.
+ *
+ * @return true if the value has been admitted, false otherwise.
+ */
+bool ValueCache::put(const UInt160& key, const Buffer& value)
+{
+    const uint64_t size = charge(value);
+    const auto cached = m_index.find(key);
+
+    // A new version replaces the cached one.
+    if (cached != m_index.end()) {
+        remove(cached->second);
+    }
+    if (size > m_budget) {
+        ++m_stats.n_rejected;
+        return false;
+    }
+
+    // Pick the victims, least recently used first, from probation then from
+    // the protected segment. With TinyLFU, the newcomer must be more popular
+    // than each of them.
+    const uint32_t frequency = m_sketch.estimate(key);
+    std::vector<ItemList::iterator> victims;
+    uint64_t freed = 0;
+    for (ItemList* segment : {&m_probation, &m_protected}) {
+        for (auto it = segment->end();
+             used() - freed + size > m_budget && it != segment->begin();) {
+            --it;
+            if (m_policy == CachePolicy::TINY_LFU
+                && m_sketch.estimate(it->key) >= frequency) {
+                ++m_stats.n_rejected;
+                return false;
+            }
+            victims.push_back(it);
+            freed += charge(it->value);
+        }
+    }
+    for (const auto& victim : victims) {
+        remove(victim);
+        ++m_stats.n_evicted;
+    }
+
+    m_probation.push_front(Item{key, value, false});
+    m_probation_size += size;
+    m_index[key] = m_probation.begin();
+    ++m_stats.n_admitted;
+    return true;
+}
+
+/** Move a value hit to the front of its segment (or promote it, from
+ * probation to the protected segment, demoting the least recently used
+ * protected values if needed).
+ */
+void ValueCache::promote(ItemList::iterator it)
+{
+    if (m_policy == CachePolicy::LRU || it->is_protected) {
+        ItemList& segment = it->is_protected ? m_protected : m_probation;
+
+        segment.splice(segment.begin(), segment, it);
+        return;
+    }
+    const uint64_t size = charge(it->value);
+    const uint64_t protected_budget = m_budget / 10 * 8;
+
+    it->is_protected = true;
+    m_protected.splice(m_protected.begin(), m_probation, it);
+    m_probation_size -= size;
+    m_protected_size += size;
+    while (m_protected_size > protected_budget && m_protected.size() > 1) {
+        const auto last = std::prev(m_protected.end());
+        const uint64_t last_size = charge(last->value);
+
+        last->is_protected = false;
+        m_probation.splice(m_probation.begin(), m_protected, last);
+        m_protected_size -= last_size;
+        m_probation_size += last_size;
+    }
+}
+
+void ValueCache::remove(ItemList::iterator it)
+{
+    const uint64_t size = charge(it->value);
+
+    m_index.erase(it->key);
+    if (it->is_protected) {
+        m_protected_size -= size;
+        m_protected.erase(it);
+    } else {
+        m_probation_size -= size;
+        m_probation.erase(it);
+    }
+}
+
+} // namespace dcss
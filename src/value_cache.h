@@ -0,0 +1,165 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __DCSS_VALUE_CACHE_H__
+#define __DCSS_VALUE_CACHE_H__
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "buffer.h"
+#include "uint160.h"
+
+namespace dcss {
+
+/** Admission and eviction policy of a value cache. */
+enum class CachePolicy {
+    /** Admit every value, evict the least recently used ones (as the
+     * Kademlia caching along the lookup path).
+     */
+    LRU,
+    /** Admit a value only if it is more frequently used than the ones it
+     * would evict (TinyLFU), and evict with a segmented LRU.
+     */
+    TINY_LFU,
+};
+
+/** Approximate access frequencies of the keys (count-min sketch).
+ *
+ * Each key increments a counter in each row, its frequency is estimated as
+ * the minimum of its counters. The counters saturate at 15 and are halved
+ * every `10 * width` increments, so that the estimations follow the recent
+ * popularity.
+ */
+class CountMinSketch {
+  public:
+    explicit CountMinSketch(uint32_t width);
+
+    void increment(const UInt160& key);
+    uint32_t estimate(const UInt160& key) const;
+
+  private:
+    /** Index of the counter of `key` in the row `row`. */
+    size_t index(const UInt160& key, uint32_t row) const;
+    void age();
+
+    static const uint32_t DEPTH = 4;
+    static const uint8_t MAX_COUNT = 15;
+
+    uint32_t m_width;
+    std::vector<uint8_t> m_counters;
+    uint64_t m_n_increments;
+    uint64_t m_sample_size;
+};
+
+/** Counters of a value cache. */
+struct ValueCacheStats {
+    uint64_t n_hits;
+    uint64_t n_misses;
+    /** Number of values admitted/refused in the cache. */
+    uint64_t n_admitted;
+    uint64_t n_rejected;
+    /** Number of values evicted to make room. */
+    uint64_t n_evicted;
+};
+
+/** A cache of values, with a fixed memory budget.
+ *
+ * With the TinyLFU policy, the cache is split into a probation segment,
+ * where the newly admitted values go, and a protected segment (80% of the
+ * budget), where the values hit while in probation are promoted. The values
+ * demoted from the protected segment go back to probation and the victims
+ * are taken from probation first.
+ */
+class ValueCache {
+  public:
+    /** Create a value cache.
+     *
+     * @param budget       memory budget (in bytes, values and keys)
+     * @param policy       admission and eviction policy
+     * @param sketch_width number of counters per row of the frequency
+     *                     sketch (TinyLFU), about the number of keys whose
+     *                     popularity is tracked
+     */
+    ValueCache(
+        uint64_t budget,
+        CachePolicy policy,
+        uint32_t sketch_width = 4096);
+
+    bool get(const UInt160& key, Buffer& value);
+    bool put(const UInt160& key, const Buffer& value);
+
+    /** Return the memory used by the cached values (in bytes). */
+    inline uint64_t used() const
+    {
+        return m_probation_size + m_protected_size;
+    }
+
+    /** Return the counters of the cache. */
+    inline const ValueCacheStats& stats() const
+    {
+        return m_stats;
+    }
+
+    ~ValueCache() = default;
+    ValueCache(ValueCache const&) = delete;
+    ValueCache& operator=(ValueCache const& x) = delete;
+    ValueCache(ValueCache&&) = default;
+    ValueCache& operator=(ValueCache&& x) = default;
+
+  private:
+    struct Item {
+        UInt160 key;
+        Buffer value;
+        bool is_protected;
+    };
+    using ItemList = std::list<Item>;
+
+    /** Memory charged for a value. */
+    static uint64_t charge(const Buffer& value);
+    void promote(ItemList::iterator it);
+    void remove(ItemList::iterator it);
+
+    uint64_t m_budget;
+    CachePolicy m_policy;
+    CountMinSketch m_sketch;
+    /** Most recently used first. */
+    ItemList m_probation;
+    ItemList m_protected;
+    uint64_t m_probation_size;
+    uint64_t m_protected_size;
+    std::unordered_map<UInt160, ItemList::iterator> m_index;
+    ValueCacheStats m_stats;
+};
+
+} // namespace dcss
+
+#endif
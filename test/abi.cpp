@@ -0,0 +1,129 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "abi.h"
+#include "exceptions.h"
+#include "keccak.h"
+
+using dcss::abi::Address;
+using dcss::abi::Array;
+using dcss::abi::Bytes32;
+using dcss::abi::Function;
+using dcss::abi::Uint256;
+using dcss::abi::Uint8;
+
+static std::string to_hex(const dcss::keccak::Digest& digest)
+{
+    std::string hex;
+    for (const uint8_t byte : digest.bytes) {
+        char digits[3];
+        snprintf(digits, sizeof(digits), "%02x", byte);
+        hex += digits;
+    }
+    return hex;
+}
+
+static std::string word(const std::string& hex)
+{
+    return std::string(64 - hex.size(), '0') + hex;
+}
+
+TEST(AbiTest, TestKeccak256) // NOLINT
+{
+    ASSERT_EQ(
+        to_hex(dcss::keccak::keccak256("")),
+        "c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470");
+    ASSERT_EQ(
+        to_hex(dcss::keccak::keccak256("abc")),
+        "4e03657aea45a94fc7d47ba826c8d667c0d1e6e33a64a036ec44f58fa12d6c45");
+    // More than one block.
+    const std::string data(200, 'a');
+    ASSERT_EQ(
+        to_hex(dcss::keccak::keccak256(data.data(), data.size())),
+        "96ea54061def936c4be90b518992fdc6f12f535068a256229aca54267b4d084d");
+}
+
+TEST(AbiTest, TestSelector) // NOLINT
+{
+    constexpr Function<Address, Uint256> transfer("transfer(address,uint256)");
+    static_assert(transfer.selector() == 0xa9059cbb, "not a constant");
+
+    constexpr Function<Address, Address, Uint256> buy_storage(
+        "buyStorage(address,address,uint256)");
+    ASSERT_EQ(buy_storage.selector(), 0x366e4d75u);
+
+    // A compilation error, if constexpr.
+    ASSERT_THROW(
+        Function<Address>("transfer(address,uint256)"), dcss::LogicError);
+    ASSERT_THROW(Function<Address>("transfer(uint256)"), dcss::LogicError);
+    ASSERT_THROW(Function<Address>("transfer"), dcss::LogicError);
+    ASSERT_THROW(Function<Array<Address>>("f(address)"), dcss::LogicError);
+    ASSERT_NO_THROW(Function<>("f()"));
+}
+
+TEST(AbiTest, TestEncodeStatic) // NOLINT
+{
+    const Function<Address, Uint256, Uint8, Bytes32> f(
+        "f(address,uint256,uint8,bytes32)");
+    const std::string addr = "0x" + std::string(40, 'a');
+    const std::string bytes = "0x" + std::string(64, 'b');
+
+    const std::string data = f.encode(addr, 0x1234, 27, bytes);
+    ASSERT_EQ(data.size(), 2 + f.size(addr, 0x1234, 27, bytes));
+    ASSERT_EQ(
+        data,
+        "0x11a55a28" + word(std::string(40, 'a')) + word("1234") + word("1b")
+            + std::string(64, 'b'));
+
+    ASSERT_THROW(f.encode("0x1234", 0, 0, bytes), dcss::DomainError);
+    ASSERT_THROW(f.encode(addr, 0, 0, "0x12"), dcss::DomainError);
+}
+
+TEST(AbiTest, TestEncodeDynamic) // NOLINT
+{
+    const Function<Address, Array<Address>, Array<Uint256>> f(
+        "f(address,address[],uint256[])");
+    const std::string a1 = "0x" + std::string(40, '1');
+    const std::string a2 = "0x" + std::string(40, '2');
+    const std::string a3 = "0x" + std::string(40, '3');
+
+    // The head (the address, then the offsets of the arrays), then the
+    // tails (the length, then the items).
+    ASSERT_EQ(
+        f.encode(a1, {a2, a3}, {5}),
+        "0xe0bf4fed" + word(std::string(40, '1')) + word("60") + word("c0")
+            + word("2") + word(std::string(40, '2'))
+            + word(std::string(40, '3')) + word("1") + word("5"));
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "account_cache.h"
+#include "dcss_conf.h"
+#include "dcss_node.h"
+#include "dcss_node_com.h"
+#include "dht/dht.h"
+#include "exceptions.h"
+#include "uint160.h"
+
+static const char* const CACHE_PATH = "account_cache_test.txt";
+
+TEST(AccountCacheTest, TestPersist) // NOLINT
+{
+    std::remove(CACHE_PATH);
+    {
+        dcss::AccountCache cache;
+        cache.insert(1u, "0x01");
+        ASSERT_EQ(cache.find(1u), "0x01");
+
+        // Only the accounts inserted once open are persisted.
+        cache.open(CACHE_PATH);
+        cache.insert(2u, "0x02");
+        cache.insert(3u, "0x03");
+        EXPECT_EQ(cache.size(), 3u);
+    }
+    {
+        dcss::AccountCache cache;
+        cache.open(CACHE_PATH);
+        EXPECT_EQ(cache.size(), 2u);
+        EXPECT_EQ(cache.find(1u), "");
+        EXPECT_EQ(cache.find(2u), "0x02");
+        EXPECT_EQ(cache.find(3u), "0x03");
+
+        // The later records win.
+        cache.insert(2u, "0x22");
+    }
+    dcss::AccountCache cache;
+    cache.open(CACHE_PATH);
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_EQ(cache.find(2u), "0x22");
+    std::remove(CACHE_PATH);
+}
+
+TEST(AccountCacheTest, TestParseError) // NOLINT
+{
+    {
+        std::ofstream fout(CACHE_PATH);
+        fout << dcss::UInt160(1u).to_string() << " 0x01\n";
+        fout << "deadbeef 0x02\n";
+    }
+    dcss::AccountCache cache;
+    ASSERT_THROW(cache.open(CACHE_PATH), dcss::DomainError);
+
+    {
+        std::ofstream fout(CACHE_PATH);
+        fout << dcss::UInt160(1u).to_string() << '\n';
+    }
+    ASSERT_THROW(cache.open(CACHE_PATH), dcss::DomainError);
+    std::remove(CACHE_PATH);
+}
+
+TEST(AccountCacheTest, TestErase) // NOLINT
+{
+    std::remove(CACHE_PATH);
+    {
+        dcss::AccountCache cache;
+        cache.open(CACHE_PATH);
+        cache.insert(1u, "0x01");
+        cache.insert(2u, "0x02");
+        cache.erase(1u);
+        cache.erase(2u);
+        EXPECT_EQ(cache.size(), 0u);
+        EXPECT_EQ(cache.find(1u), "");
+        cache.insert(2u, "0x22");
+    }
+    // Only a new account supersedes the one in the file.
+    dcss::AccountCache cache;
+    cache.open(CACHE_PATH);
+    EXPECT_EQ(cache.find(1u), "0x01");
+    EXPECT_EQ(cache.find(2u), "0x22");
+    std::remove(CACHE_PATH);
+}
+
+TEST(AccountCacheTest, TestStaleAccount) // NOLINT
+{
+    using Node = dcss::Node<dcss::NodeLocalCom>;
+
+    const dcss::Conf conf(8, 2, 3, 2, "mock", {});
+    const dcss::NodeLocalCom com(nullptr);
+    // Cached, but unknown to geth (e.g. another chain).
+    conf.accounts.insert(2u, "0x0000000000000000000000000000000000000002");
+    Node fresh(conf, dcss::dht::NodeAddress(1u, "", 0), com);
+    Node stale(conf, dcss::dht::NodeAddress(2u, "", 0), com);
+
+    Node::provision_accounts(conf, {&fresh, &stale});
+    EXPECT_TRUE(fresh.is_account_ready());
+    ASSERT_TRUE(stale.is_account_ready());
+    EXPECT_NE(
+        stale.get_eth_account(), "0x0000000000000000000000000000000000000002");
+    EXPECT_EQ(conf.accounts.find(2u), stale.get_eth_account());
+    EXPECT_EQ(conf.accounts.size(), 2u);
+}
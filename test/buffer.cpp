@@ -0,0 +1,94 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "buffer.h"
+#include "exceptions.h"
+
+TEST(BufferTest, TestEmpty) // NOLINT
+{
+    const dcss::Buffer buf;
+
+    EXPECT_TRUE(buf.empty()) << "default buffer is empty";
+    EXPECT_EQ(buf.size(), 0u);
+    EXPECT_EQ(buf.to_string(), "");
+    EXPECT_EQ(buf, dcss::Buffer(std::string())) << "empty buffers are equal";
+}
+
+TEST(BufferTest, TestShareStorage) // NOLINT
+{
+    const std::string payload("hello, world");
+    const dcss::Buffer buf(payload);
+    const uint8_t* bytes = buf.data();
+
+    // Copies (e.g. one per replica) share the bytes.
+    std::vector<dcss::Buffer> replicas(5, buf);
+    for (const auto& replica : replicas) {
+        EXPECT_EQ(replica.data(), bytes) << "copy must not copy the bytes";
+        EXPECT_TRUE(replica.shares_storage_with(buf));
+    }
+    EXPECT_EQ(buf.use_count(), 6);
+
+    replicas.clear();
+    EXPECT_EQ(buf.use_count(), 1) << "storage is released with the copies";
+    EXPECT_EQ(buf.to_string(), payload);
+}
+
+TEST(BufferTest, TestSlice) // NOLINT
+{
+    const dcss::Buffer buf(std::string("0123456789"));
+
+    const dcss::Buffer mid = buf.slice(2, 5);
+    EXPECT_EQ(mid.to_string(), "23456");
+    EXPECT_EQ(mid.data(), buf.data() + 2) << "slicing must not copy";
+
+    const dcss::Buffer sub = mid.slice(1, 2);
+    EXPECT_EQ(sub.to_string(), "34") << "offset is relative to the slice";
+    EXPECT_TRUE(sub.shares_storage_with(buf));
+
+    EXPECT_TRUE(buf.slice(10, 0).empty()) << "empty slice at the end";
+    ASSERT_THROW(buf.slice(11, 0), dcss::DomainError) << "offset too large";
+    ASSERT_THROW(mid.slice(3, 3), dcss::DomainError) << "length too large";
+}
+
+TEST(BufferTest, TestEquality) // NOLINT
+{
+    const dcss::Buffer a(std::string("abcabc"));
+    const dcss::Buffer b(std::string("abc"));
+
+    EXPECT_EQ(a.slice(0, 3), b) << "equality compares the content";
+    EXPECT_EQ(a.slice(0, 3), a.slice(3, 3));
+    EXPECT_NE(a, b);
+    EXPECT_NE(a.slice(1, 3), b);
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "buffer.h"
+#include "erasure_code.h"
+#include "exceptions.h"
+
+static dcss::Buffer make_payload(size_t size)
+{
+    std::vector<uint8_t> bytes(size);
+
+    for (size_t i = 0; i < size; ++i) {
+        bytes[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+    return dcss::Buffer(std::move(bytes));
+}
+
+TEST(ErasureCodeTest, TestRoundTrip) // NOLINT
+{
+    dcss::ErasureCode code(4, 2);
+
+    for (const size_t size : {0, 1, 100, 4096, 10000}) {
+        const dcss::Buffer payload = make_payload(size);
+        const std::vector<dcss::Buffer> fragments = code.encode(payload);
+
+        ASSERT_EQ(fragments.size(), code.n_fragments());
+        for (uint32_t i = 0; i < fragments.size(); ++i) {
+            EXPECT_EQ(dcss::ErasureCode::fragment_index(fragments[i]), i);
+        }
+        EXPECT_EQ(code.decode(fragments), payload) << "size " << size;
+    }
+}
+
+TEST(ErasureCodeTest, TestMissingFragments) // NOLINT
+{
+    dcss::ErasureCode code(4, 2);
+    const dcss::Buffer payload = make_payload(1000);
+    const std::vector<dcss::Buffer> fragments = code.encode(payload);
+
+    // Any `n_data` fragments are enough.
+    for (uint32_t i = 0; i < code.n_fragments(); ++i) {
+        for (uint32_t j = i + 1; j < code.n_fragments(); ++j) {
+            std::vector<dcss::Buffer> available;
+            for (uint32_t idx = 0; idx < code.n_fragments(); ++idx) {
+                if (idx != i && idx != j) {
+                    available.push_back(fragments[idx]);
+                }
+            }
+            EXPECT_EQ(code.decode(available), payload)
+                << "missing " << i << " and " << j;
+        }
+    }
+}
+
+TEST(ErasureCodeTest, TestNotEnoughFragments) // NOLINT
+{
+    dcss::ErasureCode code(4, 2);
+    const std::vector<dcss::Buffer> fragments =
+        code.encode(make_payload(1000));
+
+    // Duplicates don't count.
+    const std::vector<dcss::Buffer> dups = {
+        fragments[0], fragments[0], fragments[1], fragments[2]};
+    EXPECT_THROW(code.decode(dups), dcss::DomainError);
+
+    const std::vector<dcss::Buffer> few(
+        fragments.begin(), fragments.begin() + 3);
+    EXPECT_THROW(code.decode(few), dcss::DomainError);
+
+    EXPECT_THROW(code.decode({dcss::Buffer(std::string("junk"))}),
+                 dcss::DomainError);
+}
+
+TEST(ErasureCodeTest, TestInvalidParameters) // NOLINT
+{
+    EXPECT_THROW(dcss::ErasureCode(0, 2), dcss::DomainError);
+    EXPECT_THROW(dcss::ErasureCode(4, 0), dcss::DomainError);
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "buffer.h"
+#include "dcss_file.h"
+#include "erasure_code.h"
+#include "exceptions.h"
+#include "file_pipeline.h"
+#include "uint160.h"
+
+/** An in-memory, thread-safe, key-value store. */
+class MemoryStore {
+  public:
+    bool store(const dcss::UInt160& key, const dcss::Buffer& value)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_values[key] = value;
+        return true;
+    }
+
+    bool fetch(const dcss::UInt160& key, dcss::Buffer& value)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        const auto it = m_values.find(key);
+        if (it == m_values.end()) {
+            return false;
+        }
+        value = it->second;
+        return true;
+    }
+
+    void erase(const dcss::UInt160& key)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_values.erase(key);
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        return m_values.size();
+    }
+
+  private:
+    std::mutex m_mutex;
+    std::map<dcss::UInt160, dcss::Buffer> m_values;
+};
+
+static std::string make_payload(size_t size)
+{
+    std::string payload(size, '\0');
+
+    for (size_t i = 0; i < size; ++i) {
+        payload[i] = static_cast<char>(i * 131 + i / 7);
+    }
+    return payload;
+}
+
+TEST(FilePipelineTest, TestRoundTrip) // NOLINT
+{
+    const dcss::UInt160 key(0xcafeu);
+    MemoryStore mem;
+    const auto store = [&](const dcss::UInt160& k, const dcss::Buffer& v) {
+        return mem.store(k, v);
+    };
+    const auto fetch = [&](const dcss::UInt160& k, dcss::Buffer& v) {
+        return mem.fetch(k, v);
+    };
+
+    for (const size_t size : {0, 1, 1000, 4096, 100000}) {
+        dcss::FilePipeline pipeline(4, 2, 64, 1024, 3, 2, 2);
+        const std::string payload = make_payload(size);
+        std::istringstream input(payload);
+        std::ostringstream output;
+
+        const auto file = pipeline.put(key, input, store);
+        EXPECT_EQ(file->parts().size(), (size + 1023) / 1024);
+        EXPECT_EQ(pipeline.get(*file, output, fetch), size);
+        EXPECT_EQ(output.str(), payload) << "size " << size;
+    }
+}
+
+TEST(FilePipelineTest, TestLostFragments) // NOLINT
+{
+    const dcss::UInt160 key(0xbeefu);
+    dcss::FilePipeline pipeline(4, 2, 64, 512, 2, 2, 3);
+    MemoryStore mem;
+    const std::string payload = make_payload(10000);
+    std::istringstream input(payload);
+
+    // Storing fails for the last fragment of each stripe.
+    const auto file = pipeline.put(
+        key, input, [&](const dcss::UInt160& k, const dcss::Buffer& v) {
+            return dcss::ErasureCode::fragment_index(v) != 5 && mem.store(k, v);
+        });
+    EXPECT_EQ(mem.size(), file->parts().size() * 5);
+
+    // Lose another fragment per stripe: still `n_data` fragments.
+    for (const auto& stripe_key : file->parts()) {
+        mem.erase(dcss::File::part_key(stripe_key, 0, 6, 64));
+    }
+    std::ostringstream output;
+    pipeline.get(*file, output, [&](const dcss::UInt160& k, dcss::Buffer& v) {
+        return mem.fetch(k, v);
+    });
+    EXPECT_EQ(output.str(), payload);
+
+    // One more and the file is lost.
+    mem.erase(dcss::File::part_key(file->parts().back(), 1, 6, 64));
+    std::ostringstream lost;
+    EXPECT_THROW(
+        pipeline.get(
+            *file,
+            lost,
+            [&](const dcss::UInt160& k, dcss::Buffer& v) {
+                return mem.fetch(k, v);
+            }),
+        dcss::DomainError);
+}
+
+TEST(FilePipelineTest, TestStoreFailure) // NOLINT
+{
+    dcss::FilePipeline pipeline(2, 1, 64, 256, 2, 2, 2);
+    const std::string payload = make_payload(4096);
+    std::istringstream input(payload);
+    std::atomic<uint32_t> n_calls(0);
+
+    // Every store fails: the first stripe can't be stored.
+    EXPECT_THROW(
+        pipeline.put(
+            dcss::UInt160(1u),
+            input,
+            [&](const dcss::UInt160& /*k*/, const dcss::Buffer& /*v*/) {
+                ++n_calls;
+                return false;
+            }),
+        dcss::DomainError);
+    EXPECT_LT(n_calls, 16u * 3u) << "pipeline aborts early";
+}
+
+TEST(FilePipelineTest, TestInvalidParameters) // NOLINT
+{
+    using dcss::DomainError;
+    using dcss::FilePipeline;
+
+    EXPECT_THROW(FilePipeline(0, 2, 64, 1024, 1, 1, 1), DomainError);
+    EXPECT_THROW(FilePipeline(4, 0, 64, 1024, 1, 1, 1), DomainError);
+    EXPECT_THROW(FilePipeline(4, 2, 64, 0, 1, 1, 1), DomainError);
+    EXPECT_THROW(FilePipeline(4, 2, 64, 1024, 0, 1, 1), DomainError);
+    EXPECT_THROW(FilePipeline(4, 2, 64, 1024, 1, 1, 0), DomainError);
+}
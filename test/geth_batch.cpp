@@ -0,0 +1,113 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "exceptions.h"
+#include "geth_batch.h"
+#include "gethclient.h"
+
+namespace {
+
+/** Echo the parameter of each call, in reverse order, and fail the calls
+ * to "fail".
+ */
+class EchoServer : public jsonrpc::IClientConnector {
+  public:
+    void SendRPCMessage(const std::string& message, std::string& result)
+        override
+    {
+        Json::Reader reader;
+        Json::Value calls;
+        Json::Value answers(Json::arrayValue);
+
+        reader.parse(message, calls);
+        ++n_requests;
+        for (Json::ArrayIndex i = calls.size(); i > 0; --i) {
+            const Json::Value& call = calls[i - 1];
+            Json::Value answer;
+
+            answer["jsonrpc"] = "2.0";
+            answer["id"] = call["id"];
+            if (call["method"] == "fail") {
+                answer["error"]["code"] = -32000;
+                answer["error"]["message"] = "failed";
+            } else {
+                answer["result"] = call["params"][0];
+            }
+            answers.append(answer);
+        }
+        result = Json::FastWriter().write(answers);
+    }
+
+    uint32_t n_requests = 0;
+};
+
+} // namespace
+
+TEST(GethBatchTest, TestSend) // NOLINT
+{
+    EchoServer server;
+    GethClient geth(server);
+    dcss::GethBatch batch(geth, 4);
+
+    for (int i = 0; i < 10; ++i) {
+        Json::Value params;
+        params.append(i);
+        batch.add(i == 5 ? "fail" : "echo", params);
+    }
+    ASSERT_FALSE(batch.sent(0));
+    ASSERT_THROW(batch.result(0), dcss::LogicError);
+
+    batch.send();
+    EXPECT_EQ(server.n_requests, 3u);
+    for (int i = 0; i < 10; ++i) {
+        const auto call = static_cast<size_t>(i);
+        EXPECT_TRUE(batch.sent(call));
+        if (i == 5) {
+            EXPECT_EQ(batch.error_code(call), -32000);
+            EXPECT_THROW(batch.result(call), jsonrpc::JsonRpcException);
+        } else {
+            EXPECT_EQ(batch.error_code(call), 0);
+            EXPECT_EQ(batch.result(call).asInt(), i);
+        }
+    }
+
+    // Only the new calls are sent.
+    Json::Value params;
+    params.append(10);
+    const size_t last = batch.add("echo", params);
+    batch.send();
+    EXPECT_EQ(server.n_requests, 4u);
+    EXPECT_EQ(batch.result(last).asInt(), 10);
+    EXPECT_EQ(batch.size(), 11u);
+    EXPECT_EQ(batch.n_requests(), 4u);
+}
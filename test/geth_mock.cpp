@@ -0,0 +1,196 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "exceptions.h"
+#include "geth_batch.h"
+#include "geth_mock.h"
+#include "gethclient.h"
+#include "tx_manager.h"
+
+namespace {
+
+dcss::GethMockConf make_conf(int block_ms)
+{
+    dcss::GethMockConf conf;
+
+    conf.block_time = std::chrono::milliseconds(block_ms);
+    return conf;
+}
+
+Json::Value make_tx(const std::string& from, int64_t nonce = -1)
+{
+    Json::Value tx;
+
+    tx["from"] = from;
+    tx["to"] = "0x02";
+    tx["data"] = "0x";
+    if (nonce >= 0) {
+        tx["nonce"] = "0x" + std::to_string(nonce);
+    }
+    return tx;
+}
+
+/** Return the pending transaction count of `account` (not in the stubs). */
+std::string tx_count(GethClient& geth, const std::string& account)
+{
+    Json::Value params;
+
+    params.append(account);
+    params.append("pending");
+    return geth.CallMethod("eth_getTransactionCount", params).asString();
+}
+
+void wait_block(const dcss::GethMock& mock, uint64_t number)
+{
+    while (mock.head() < number) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+} // namespace
+
+TEST(GethMockTest, TestParse) // NOLINT
+{
+    const dcss::GethMockConf conf = dcss::GethMockConf::parse("500,20,5,10");
+
+    EXPECT_EQ(conf.block_time.count(), 500);
+    EXPECT_EQ(conf.latency.count(), 20);
+    EXPECT_DOUBLE_EQ(conf.failure_rate, 0.05);
+    EXPECT_DOUBLE_EQ(conf.revert_rate, 0.1);
+    EXPECT_EQ(dcss::GethMockConf::parse("200").latency.count(), 0);
+
+    EXPECT_THROW(dcss::GethMockConf::parse(""), dcss::DomainError);
+    EXPECT_THROW(dcss::GethMockConf::parse("0"), dcss::DomainError);
+    EXPECT_THROW(dcss::GethMockConf::parse("1,2,300"), dcss::DomainError);
+    EXPECT_THROW(dcss::GethMockConf::parse("1,2,3,4,5"), dcss::DomainError);
+}
+
+TEST(GethMockTest, TestTransactions) // NOLINT
+{
+    dcss::GethMock mock(make_conf(100));
+    GethClient geth(mock);
+
+    // The accounts must be unlocked to send.
+    const std::string account = geth.personal_newAccount("secret");
+    ASSERT_EQ(account.size(), 42u);
+    EXPECT_THROW(
+        geth.eth_sendTransaction(make_tx(account)), jsonrpc::JsonRpcException);
+    EXPECT_THROW(
+        geth.personal_unlockAccount(account, "wrong", 0),
+        jsonrpc::JsonRpcException);
+    ASSERT_TRUE(geth.personal_unlockAccount(account, "secret", 0));
+    EXPECT_EQ(geth.eth_sign(account, "0xdeadbeef").size(), 132u);
+
+    // The transaction after a gap waits for the gap to be filled.
+    const std::string queued = geth.eth_sendTransaction(make_tx(account, 1));
+    EXPECT_EQ(tx_count(geth, account), "0x0");
+    const std::string first = geth.eth_sendTransaction(make_tx(account, 0));
+    EXPECT_EQ(tx_count(geth, account), "0x2");
+    EXPECT_THROW(
+        geth.eth_sendTransaction(make_tx(account, 1)),
+        jsonrpc::JsonRpcException);
+    EXPECT_TRUE(geth.eth_getTransactionReceipt(first).isNull());
+
+    // Both are mined in the next block.
+    wait_block(mock, mock.head() + 1);
+    const Json::Value receipt = geth.eth_getTransactionReceipt(first);
+    ASSERT_FALSE(receipt.isNull());
+    const Json::Value block =
+        geth.eth_getBlockByNumber(receipt["blockNumber"].asString(), false);
+    ASSERT_EQ(block["transactions"].size(), 2u);
+    EXPECT_EQ(block["transactions"][0].asString(), first);
+    EXPECT_EQ(block["transactions"][1].asString(), queued);
+    EXPECT_EQ(geth.eth_getTransactionReceipt(queued)["status"], "0x1");
+
+    const dcss::GethMockStats stats = mock.stats();
+    EXPECT_EQ(stats.n_transactions, 2u);
+    EXPECT_EQ(stats.n_failures, 0u);
+}
+
+TEST(GethMockTest, TestFailures) // NOLINT
+{
+    dcss::GethMockConf conf = make_conf(10);
+    conf.failure_rate = 1;
+    dcss::GethMock mock(conf);
+    GethClient geth(mock);
+    dcss::GethBatch batch(geth);
+
+    for (int i = 0; i < 10; ++i) {
+        batch.add("eth_blockNumber", Json::Value());
+    }
+    batch.send();
+    for (size_t i = 0; i < 10; ++i) {
+        EXPECT_NE(batch.error_code(i), 0);
+    }
+    EXPECT_THROW(geth.personal_newAccount("secret"), jsonrpc::JsonRpcException);
+
+    // No effect: the account isn't created.
+    const dcss::GethMockStats stats = mock.stats();
+    EXPECT_EQ(stats.n_requests, 2u);
+    EXPECT_EQ(stats.n_calls, 11u);
+    EXPECT_EQ(stats.n_failures, 11u);
+}
+
+TEST(GethMockTest, TestTxManager) // NOLINT
+{
+    const size_t n_txs = 20;
+    dcss::GethMockConf conf = make_conf(5);
+    conf.revert_rate = 0.5;
+    conf.latency = std::chrono::milliseconds(1);
+    dcss::GethMock mock(conf);
+    GethClient geth(mock);
+    const std::string account = geth.personal_newAccount("secret");
+    geth.personal_unlockAccount(account, "secret", 0);
+    std::vector<std::future<dcss::TxReceipt>> receipts;
+
+    {
+        dcss::TxManager txs(
+            geth,
+            std::chrono::milliseconds(1),
+            std::chrono::milliseconds(4));
+        for (size_t i = 0; i < n_txs; ++i) {
+            receipts.push_back(txs.submit(make_tx(account)));
+        }
+        uint64_t n_reverted = 0;
+        for (auto& receipt : receipts) {
+            n_reverted += receipt.get().success ? 0 : 1;
+        }
+        EXPECT_EQ(n_reverted, mock.stats().n_reverts);
+        EXPECT_EQ(txs.stats().n_mined, n_txs);
+    }
+    EXPECT_EQ(mock.stats().n_transactions, n_txs);
+}
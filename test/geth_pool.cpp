@@ -0,0 +1,208 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "exceptions.h"
+#include "geth_pool.h"
+
+namespace {
+
+/** Connections answering after `delay`, counting the requests in progress
+ * together. The requests "fail" fail.
+ */
+class Server {
+  public:
+    explicit Server(std::chrono::milliseconds delay) : m_delay(delay) {}
+
+    std::unique_ptr<jsonrpc::IClientConnector> connect()
+    {
+        ++n_connects;
+        return std::make_unique<Connection>(*this);
+    }
+
+    std::atomic<uint32_t> n_connects{0};
+    std::atomic<uint32_t> n_active{0};
+    std::atomic<uint32_t> max_active{0};
+
+  private:
+    class Connection : public jsonrpc::IClientConnector {
+      public:
+        explicit Connection(Server& server) : m_server(server) {}
+
+        void SendRPCMessage(const std::string& message, std::string& result)
+            override
+        {
+            const uint32_t active = ++m_server.n_active;
+            uint32_t max = m_server.max_active;
+            while (active > max
+                   && !m_server.max_active.compare_exchange_weak(max, active)) {
+            }
+            std::this_thread::sleep_for(m_server.m_delay);
+            --m_server.n_active;
+            if (message == "fail") {
+                throw jsonrpc::JsonRpcException(
+                    jsonrpc::Errors::ERROR_CLIENT_CONNECTOR, "reset");
+            }
+            result = message;
+        }
+
+      private:
+        Server& m_server;
+    };
+
+    const std::chrono::milliseconds m_delay;
+};
+
+std::unique_ptr<dcss::GethPool>
+make_pool(Server& server, uint32_t size, int timeout_ms = 1000)
+{
+    dcss::GethPoolConf conf;
+
+    conf.size = size;
+    conf.timeout = std::chrono::milliseconds(timeout_ms);
+    return std::make_unique<dcss::GethPool>(
+        [&server](std::chrono::milliseconds /* timeout */) {
+            return server.connect();
+        },
+        conf);
+}
+
+/** Send `n_requests` requests from each of `n_threads` threads. */
+void send_together(dcss::GethPool& pool, size_t n_threads, size_t n_requests)
+{
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < n_threads; ++i) {
+        threads.emplace_back([&pool, n_requests] {
+            for (size_t j = 0; j < n_requests; ++j) {
+                std::string result;
+                pool.SendRPCMessage("ping", result);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+} // namespace
+
+TEST(GethPoolTest, TestParse) // NOLINT
+{
+    const dcss::GethPoolConf conf = dcss::GethPoolConf::parse("16,500");
+
+    EXPECT_EQ(conf.size, 16u);
+    EXPECT_EQ(conf.timeout.count(), 500);
+    EXPECT_EQ(dcss::GethPoolConf::parse("4").size, 4u);
+
+    EXPECT_THROW(dcss::GethPoolConf::parse(""), dcss::DomainError);
+    EXPECT_THROW(dcss::GethPoolConf::parse("0"), dcss::DomainError);
+    EXPECT_THROW(dcss::GethPoolConf::parse("4,0"), dcss::DomainError);
+    EXPECT_THROW(dcss::GethPoolConf::parse("4,1,1"), dcss::DomainError);
+}
+
+TEST(GethPoolTest, TestKeepAlive) // NOLINT
+{
+    Server server(std::chrono::milliseconds(0));
+    auto pool = make_pool(server, 4);
+    std::string result;
+
+    // Requests one after the other: a single connection, kept open.
+    for (int i = 0; i < 10; ++i) {
+        pool->SendRPCMessage("ping", result);
+        EXPECT_EQ(result, "ping");
+    }
+    EXPECT_EQ(server.n_connects, 1u);
+    EXPECT_EQ(pool->n_open(), 1u);
+    EXPECT_EQ(pool->stats().n_requests, 10u);
+}
+
+TEST(GethPoolTest, TestConcurrent) // NOLINT
+{
+    Server server(std::chrono::milliseconds(2));
+    auto pool = make_pool(server, 4);
+
+    // No more than 4 connections, used together.
+    send_together(*pool, 16, 5);
+    EXPECT_LE(server.n_connects, 4u);
+    EXPECT_LE(server.max_active, 4u);
+    EXPECT_GT(server.max_active, 1u);
+
+    const dcss::GethPoolStats stats = pool->stats();
+    EXPECT_EQ(stats.n_requests, 80u);
+    EXPECT_EQ(stats.n_opened, server.n_connects);
+    EXPECT_GT(stats.n_waits, 0u);
+    EXPECT_EQ(stats.n_errors, 0u);
+}
+
+TEST(GethPoolTest, TestErrors) // NOLINT
+{
+    Server server(std::chrono::milliseconds(0));
+    auto pool = make_pool(server, 2);
+    std::string result;
+
+    // The connection of a failed request is closed, then reopened.
+    pool->SendRPCMessage("ping", result);
+    EXPECT_THROW(
+        pool->SendRPCMessage("fail", result), jsonrpc::JsonRpcException);
+    EXPECT_EQ(pool->n_open(), 0u);
+    pool->SendRPCMessage("ping", result);
+    EXPECT_EQ(server.n_connects, 2u);
+    EXPECT_EQ(pool->stats().n_errors, 1u);
+}
+
+TEST(GethPoolTest, TestTimeout) // NOLINT
+{
+    Server server(std::chrono::milliseconds(100));
+    auto pool = make_pool(server, 1, 10);
+    std::string result;
+
+    // The only connection is busy for longer than the timeout.
+    std::thread busy([&pool] {
+        std::string busy_result;
+        pool->SendRPCMessage("ping", busy_result);
+    });
+    while (server.n_active == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_THROW(
+        pool->SendRPCMessage("ping", result), jsonrpc::JsonRpcException);
+    busy.join();
+
+    pool->SendRPCMessage("ping", result);
+    EXPECT_EQ(server.n_connects, 1u);
+}
@@ -0,0 +1,533 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dcss_conf.h"
+#include "dht/dht.h"
+#include "uint160.h"
+
+namespace {
+
+using dcss::UInt160;
+using dcss::dht::NodeAddress;
+
+/** Communication layer where every node answers, except the dead ones. */
+class FakeCom : public dcss::dht::NodeComBase {
+  public:
+    /** `lonely` nodes answer, but know nobody (not even themselves). */
+    explicit FakeCom(
+        const std::unordered_set<UInt160>& dead,
+        const std::unordered_set<UInt160>* lonely = nullptr)
+        : m_dead(&dead), m_lonely(lonely)
+    {
+    }
+
+    bool ping(const NodeAddress& addr) override
+    {
+        return m_dead->count(addr.id()) == 0;
+    }
+
+    std::vector<NodeAddress> find_node(
+        const NodeAddress& addr,
+        const UInt160&,
+        uint32_t,
+        bool&) override
+    {
+        // Only knows itself.
+        if (!ping(addr) || is_lonely(addr)) {
+            return {};
+        }
+        return {addr};
+    }
+
+    bool find_nodes(
+        const NodeAddress& addr,
+        const std::vector<UInt160>& targets,
+        uint32_t,
+        std::vector<dcss::dht::FindNodeAnswer>& answers) override
+    {
+        if (!ping(addr)) {
+            return false;
+        }
+        if (is_lonely(addr)) {
+            answers.assign(targets.size(), {{}, false});
+            return true;
+        }
+        answers.assign(targets.size(), {{addr}, false});
+        return true;
+    }
+
+    bool store(const NodeAddress&, const UInt160&, const dcss::Buffer&)
+        override
+    {
+        return false;
+    }
+
+    bool find_value(const NodeAddress&, const UInt160&, dcss::Buffer&) override
+    {
+        return false;
+    }
+
+    bool find_value(
+        const NodeAddress& addr,
+        const UInt160&,
+        uint32_t,
+        dcss::dht::FindValueAnswer& answer) override
+    {
+        if (!ping(addr)) {
+            return false;
+        }
+        answer = {false, dcss::Buffer(), {addr}, false};
+        return true;
+    }
+
+    bool store_replica(
+        const NodeAddress&,
+        const UInt160&,
+        const dcss::Buffer&,
+        uint32_t) override
+    {
+        return false;
+    }
+
+    bool gossip(
+        const NodeAddress& addr,
+        const std::vector<dcss::dht::MemberEvent>&) override
+    {
+        return ping(addr);
+    }
+
+    bool exchange_keys(
+        const NodeAddress&,
+        const std::vector<UInt160>&,
+        std::vector<UInt160>&) override
+    {
+        return false;
+    }
+
+  private:
+    bool is_lonely(const NodeAddress& addr) const
+    {
+        return m_lonely != nullptr && m_lonely->count(addr.id()) != 0;
+    }
+
+    const std::unordered_set<UInt160>* m_dead;
+    const std::unordered_set<UInt160>* m_lonely;
+};
+
+class TestNode : public dcss::dht::Node<FakeCom> {
+  public:
+    TestNode(const dcss::Conf& conf, const FakeCom& com)
+        : dcss::dht::Node<FakeCom>(NodeAddress(UInt160(0u), "", 0), conf, com)
+    {
+    }
+
+    /** Return the IDs of the `bit_length`-bucket, most recent first. */
+    std::vector<UInt160> bucket(uint32_t bit_length) const
+    {
+        std::vector<UInt160> ids;
+
+        for (const auto& addr : buckets().at(bit_length)) {
+            ids.push_back(addr.id());
+        }
+        return ids;
+    }
+
+    /** Keys reported as stored. */
+    std::vector<UInt160> stored;
+    /** Keys reported as erased. */
+    std::vector<UInt160> erased;
+
+  private:
+    void on_store(const dcss::dht::Entry& entry) override
+    {
+        stored.push_back(entry.key());
+    }
+
+    void on_erase(const dcss::dht::Entry& entry) override
+    {
+        erased.push_back(entry.key());
+    }
+};
+
+NodeAddress make_addr(uint32_t id)
+{
+    return NodeAddress(UInt160(id), "", 0);
+}
+
+} // namespace
+
+TEST(KBucketTest, TestLeastRecentlySeenAlive) // NOLINT
+{
+    const dcss::Conf conf(8, 2, 1, 4, "http://localhost:8545", {});
+    const std::unordered_set<UInt160> dead;
+    TestNode node(conf, FakeCom(dead));
+
+    // 0x10 to 0x13 all fall in the 5-bucket.
+    EXPECT_TRUE(node.send_ping(make_addr(0x10u)));
+    EXPECT_TRUE(node.send_ping(make_addr(0x11u)));
+    EXPECT_TRUE(node.send_ping(make_addr(0x12u)));
+    EXPECT_EQ(node.bucket(5), std::vector<UInt160>({0x11u, 0x10u}));
+    EXPECT_EQ(node.pending_pings(), 1u) << "least recently seen scheduled";
+
+    node.flush_pings();
+    EXPECT_EQ(node.pending_pings(), 0u);
+    EXPECT_EQ(node.bucket(5), std::vector<UInt160>({0x10u, 0x11u}))
+        << "alive contact kept and moved in front";
+}
+
+TEST(KBucketTest, TestLeastRecentlySeenDead) // NOLINT
+{
+    const dcss::Conf conf(8, 2, 1, 4, "http://localhost:8545", {});
+    std::unordered_set<UInt160> dead;
+    TestNode node(conf, FakeCom(dead));
+
+    node.send_ping(make_addr(0x10u));
+    node.send_ping(make_addr(0x11u));
+    node.send_ping(make_addr(0x12u));
+    node.send_ping(make_addr(0x13u));
+    EXPECT_EQ(node.pending_pings(), 1u) << "no duplicate ping";
+
+    dead.insert(UInt160(0x10u));
+    node.flush_pings();
+    EXPECT_EQ(node.bucket(5), std::vector<UInt160>({0x13u, 0x11u}))
+        << "dead contact replaced by the most recent replacement";
+}
+
+TEST(KBucketTest, TestUnresponsiveEviction) // NOLINT
+{
+    const dcss::Conf conf(8, 2, 1, 4, "http://localhost:8545", {});
+    std::unordered_set<UInt160> dead;
+    TestNode node(conf, FakeCom(dead));
+
+    node.send_ping(make_addr(0x10u));
+    node.send_ping(make_addr(0x11u));
+    dead.insert(UInt160(0x11u));
+    EXPECT_FALSE(node.send_ping(make_addr(0x11u)));
+    EXPECT_EQ(node.bucket(5), std::vector<UInt160>({0x11u, 0x10u}))
+        << "kept when there is no replacement";
+
+    node.send_ping(make_addr(0x12u));
+    EXPECT_FALSE(node.send_ping(make_addr(0x11u)));
+    EXPECT_EQ(node.bucket(5), std::vector<UInt160>({0x12u, 0x10u}));
+}
+
+TEST(KBucketTest, TestNoReplacementCache) // NOLINT
+{
+    dcss::Conf conf(8, 2, 1, 4, "http://localhost:8545", {});
+    conf.replacement_cache_size = 0;
+    const std::unordered_set<UInt160> dead;
+    TestNode node(conf, FakeCom(dead));
+
+    node.send_ping(make_addr(0x10u));
+    node.send_ping(make_addr(0x11u));
+    node.send_ping(make_addr(0x12u));
+    EXPECT_EQ(node.pending_pings(), 0u);
+    EXPECT_EQ(node.bucket(5), std::vector<UInt160>({0x11u, 0x10u}));
+}
+
+TEST(KBucketTest, TestSplitLayout) // NOLINT
+{
+    dcss::Conf conf(8, 2, 1, 4, "http://localhost:8545", {});
+    conf.bucket_layout = dcss::BucketLayout::SPLIT;
+    const std::unordered_set<UInt160> dead;
+    TestNode node(conf, FakeCom(dead));
+
+    EXPECT_EQ(node.bucket_count(), 1u) << "one bucket to start";
+    node.send_ping(make_addr(0x80u));
+    node.send_ping(make_addr(0x01u));
+    EXPECT_EQ(node.bucket_count(), 1u);
+
+    // Full bucket containing our ID: split.
+    node.send_ping(make_addr(0x02u));
+    EXPECT_EQ(node.bucket_count(), 2u);
+    EXPECT_EQ(node.bucket(0), std::vector<UInt160>({0x80u}));
+    EXPECT_EQ(node.bucket(1), std::vector<UInt160>({0x02u, 0x01u}));
+
+    // Far bucket never split: the newcomers go to the replacement cache.
+    node.send_ping(make_addr(0x81u));
+    node.send_ping(make_addr(0x82u));
+    EXPECT_EQ(node.bucket_count(), 2u);
+    EXPECT_EQ(node.bucket(0), std::vector<UInt160>({0x81u, 0x80u}));
+    EXPECT_EQ(node.pending_pings(), 1u);
+
+    // Closer contacts: split again, until there is room.
+    node.send_ping(make_addr(0x03u));
+    EXPECT_EQ(node.bucket_count(), 8u);
+    EXPECT_EQ(node.connection_count(), 5u);
+}
+
+TEST(KBucketTest, TestRelaxedLayout) // NOLINT
+{
+    dcss::Conf conf(8, 2, 1, 4, "http://localhost:8545", {});
+    conf.bucket_layout = dcss::BucketLayout::RELAXED;
+    const std::unordered_set<UInt160> dead;
+    TestNode node(conf, FakeCom(dead));
+
+    node.send_ping(make_addr(0x80u));
+    node.send_ping(make_addr(0x40u));
+    node.send_ping(make_addr(0x41u));
+    ASSERT_EQ(node.bucket_count(), 2u);
+    EXPECT_EQ(node.bucket(0), std::vector<UInt160>({0x80u}));
+    EXPECT_EQ(node.bucket(1), std::vector<UInt160>({0x41u, 0x40u}));
+
+    // Full far bucket, but amongst our k closest contacts: kept.
+    node.send_ping(make_addr(0x81u));
+    node.send_ping(make_addr(0x82u));
+    EXPECT_EQ(node.bucket(0), std::vector<UInt160>({0x81u, 0x80u}));
+    EXPECT_EQ(node.pending_pings(), 1u) << "0x82 is not amongst the closest";
+}
+
+TEST(KBucketTest, TestSiblingList) // NOLINT
+{
+    dcss::Conf conf(8, 2, 1, 4, "http://localhost:8545", {});
+    conf.n_siblings = 3;
+    std::unordered_set<UInt160> dead;
+    TestNode node(conf, FakeCom(dead));
+
+    for (uint32_t id : {0x80u, 0x03u, 0x20u, 0x05u, 0x04u, 0x81u}) {
+        node.send_ping(make_addr(id));
+    }
+    std::vector<UInt160> siblings;
+    for (const auto& addr : node.siblings()) {
+        siblings.push_back(addr.id());
+    }
+    EXPECT_EQ(siblings, std::vector<UInt160>({0x03u, 0x04u, 0x05u}))
+        << "the 3 closest, sorted";
+
+    bool authoritative = false;
+    node.find_node(UInt160(0x02u), 2, authoritative);
+    EXPECT_FALSE(authoritative) << "not trusted before a self lookup";
+    node.node_lookup(UInt160(0u));
+
+    // In range (less than 3 bits away): authoritative answer.
+    const auto nodes = node.find_node(UInt160(0x02u), 2, authoritative);
+    EXPECT_TRUE(authoritative);
+    ASSERT_EQ(nodes.size(), 2u);
+    EXPECT_EQ(nodes[0].id(), UInt160(0x03u));
+    EXPECT_EQ(nodes[1].id(), UInt160(0u)) << "the node itself is a candidate";
+
+    node.find_node(UInt160(0x40u), 2, authoritative);
+    EXPECT_FALSE(authoritative) << "out of range";
+
+    // A dead sibling is dropped: the list is no longer complete.
+    dead.insert(UInt160(0x04u));
+    EXPECT_FALSE(node.send_ping(make_addr(0x04u)));
+    EXPECT_EQ(node.siblings().size(), 2u);
+    node.find_node(UInt160(0x02u), 2, authoritative);
+    EXPECT_FALSE(authoritative);
+}
+
+TEST(KBucketTest, TestFullMembership) // NOLINT
+{
+    dcss::Conf conf(8, 2, 1, 4, "http://localhost:8545", {});
+    conf.bucket_layout = dcss::BucketLayout::FULL;
+    std::unordered_set<UInt160> dead;
+    TestNode node(conf, FakeCom(dead));
+
+    for (uint32_t id : {0x80u, 0x03u, 0x20u, 0x05u, 0x04u, 0x81u}) {
+        node.send_ping(make_addr(id));
+    }
+    EXPECT_EQ(node.bucket_count(), 0u);
+    EXPECT_EQ(node.connection_count(), 6u);
+
+    // Resolved locally, without any round.
+    auto found = node.node_lookup(UInt160(0x84u));
+    ASSERT_EQ(found.size(), 2u);
+    EXPECT_EQ(found[0].id(), UInt160(0x80u));
+    EXPECT_EQ(found[1].id(), UInt160(0x81u));
+    EXPECT_EQ(node.lookup_stats().n_rounds, 0u);
+
+    // Membership changes.
+    node.on_gossip({{make_addr(0x85u), true}, {make_addr(0x80u), false}});
+    found = node.node_lookup(UInt160(0x84u));
+    EXPECT_EQ(found[0].id(), UInt160(0x85u));
+    EXPECT_EQ(found[1].id(), UInt160(0x81u));
+    node.on_gossip({{make_addr(0x80u), true}});
+    EXPECT_EQ(node.connection_count(), 6u) << "departed nodes don't come back";
+
+    // Events are forwarded once; unreachable members are removed.
+    dead.insert(UInt160(0x20u));
+    dead.insert(UInt160(0x03u));
+    dead.insert(UInt160(0x04u));
+    dead.insert(UInt160(0x05u));
+    node.gossip_round();
+    EXPECT_GT(node.gossip_stats().n_messages, 0u);
+    EXPECT_LT(node.connection_count(), 6u);
+}
+
+TEST(KBucketTest, TestBatchedLookup) // NOLINT
+{
+    const dcss::Conf conf(8, 2, 3, 4, "http://localhost:8545", {});
+    std::unordered_set<UInt160> dead;
+    TestNode node(conf, FakeCom(dead));
+
+    for (uint32_t id : {0x80u, 0x81u, 0x03u, 0x05u, 0x20u}) {
+        node.send_ping(make_addr(id));
+    }
+    const std::vector<UInt160> targets({0x84u, 0x85u, 0x04u});
+    std::vector<std::vector<NodeAddress>> expected;
+    for (const auto& target : targets) {
+        expected.push_back(node.node_lookup(target));
+    }
+    const uint64_t n_messages = node.lookup_stats().n_messages;
+    EXPECT_EQ(n_messages, 6u);
+
+    // Same answers, but the close targets share their messages.
+    EXPECT_EQ(node.node_lookup(targets), expected);
+    EXPECT_EQ(node.lookup_stats().n_messages - n_messages, 4u);
+    EXPECT_EQ(node.lookup_stats().n_queries, 12u);
+
+    // A dead node fails every target it was asked for, and is replaced by
+    // the nodes learned for the other targets.
+    dead.insert(UInt160(0x81u));
+    const auto found = node.node_lookup(targets);
+    ASSERT_EQ(found[0].size(), 2u);
+    EXPECT_EQ(found[0][0].id(), UInt160(0x80u));
+    EXPECT_EQ(found[0][1].id(), UInt160(0x05u));
+    EXPECT_EQ(found[1], found[0]);
+    EXPECT_EQ(node.lookup_stats().n_unresponsive, 2u);
+}
+
+TEST(KBucketTest, TestLookupCache) // NOLINT
+{
+    dcss::Conf conf(8, 2, 3, 4, "http://localhost:8545", {});
+    conf.lookup_cache_size = 4;
+    conf.lookup_cache_ttl = 2;
+    conf.lookup_cache_prefix = 6;
+    std::unordered_set<UInt160> dead;
+    std::unordered_set<UInt160> lonely;
+    TestNode node(conf, FakeCom(dead, &lonely));
+
+    for (uint32_t id : {0x80u, 0x81u, 0x03u, 0x05u}) {
+        node.send_ping(make_addr(id));
+    }
+    node.node_lookup(UInt160(0x84u));
+    EXPECT_EQ(node.lookup_stats().n_messages, 2u);
+    EXPECT_EQ(node.lookup_cache_stats().n_misses, 1u);
+
+    // Same prefix: a single FIND_NODE to validate the cached nodes.
+    const auto found = node.node_lookup(UInt160(0x85u));
+    ASSERT_EQ(found.size(), 2u);
+    EXPECT_EQ(found[0].id(), UInt160(0x81u)) << "sorted for the new target";
+    EXPECT_EQ(found[1].id(), UInt160(0x80u));
+    EXPECT_EQ(node.lookup_stats().n_messages, 3u);
+    EXPECT_EQ(node.lookup_cache_stats().n_hits, 1u);
+
+    // An empty answer is still an answer: the entry is kept.
+    lonely.insert(UInt160(0x81u));
+    EXPECT_EQ(node.node_lookup(UInt160(0x85u)), found);
+    EXPECT_EQ(node.lookup_stats().n_messages, 4u);
+    EXPECT_EQ(node.lookup_stats().n_unresponsive, 0u);
+    EXPECT_EQ(node.lookup_cache_stats().n_hits, 2u);
+    EXPECT_EQ(node.lookup_cache_stats().n_invalidated, 0u);
+    lonely.clear();
+
+    // Expired.
+    node.tick();
+    node.tick();
+    node.node_lookup(UInt160(0x84u));
+    EXPECT_EQ(node.lookup_cache_stats().n_expired, 1u);
+    EXPECT_EQ(node.lookup_stats().n_messages, 6u);
+
+    // A cached contact fails a ping: the entry is dropped.
+    dead.insert(UInt160(0x81u));
+    EXPECT_FALSE(node.send_ping(make_addr(0x81u)));
+    EXPECT_EQ(node.lookup_cache_stats().n_invalidated, 1u);
+    node.node_lookup(UInt160(0x84u));
+    EXPECT_EQ(node.lookup_cache_stats().n_hits, 2u);
+    EXPECT_EQ(node.lookup_cache_stats().n_misses, 3u);
+}
+
+TEST(KBucketTest, TestHotReplication) // NOLINT
+{
+    dcss::Conf conf(8, 2, 3, 4, "http://localhost:8545", {});
+    conf.hot_threshold = 2;
+    conf.hot_lifetime = 2;
+    std::unordered_set<UInt160> dead;
+    TestNode node(conf, FakeCom(dead));
+    dcss::dht::FindValueAnswer answer;
+    const dcss::Buffer value(std::string("value"));
+
+    node.store(std::make_unique<dcss::dht::Entry>(UInt160(0x10u), value));
+    node.store(std::make_unique<dcss::dht::Entry>(UInt160(0x10u), value));
+    EXPECT_EQ(node.stored, std::vector<UInt160>({0x10u})) << "stored once";
+    EXPECT_TRUE(node.serve_value(UInt160(0x10u), 2, answer));
+    EXPECT_FALSE(answer.hot);
+    EXPECT_TRUE(node.serve_value(UInt160(0x10u), 2, answer));
+    EXPECT_TRUE(answer.hot) << "read twice";
+    EXPECT_FALSE(node.serve_value(UInt160(0x11u), 2, answer));
+    EXPECT_EQ(node.replication_stats().n_served, 3u);
+
+    // A value stored for good is not turned into a replica.
+    node.store_replica(
+        std::make_unique<dcss::dht::Entry>(UInt160(0x10u), value), 1);
+    node.store_replica(
+        std::make_unique<dcss::dht::Entry>(UInt160(0x20u), value), 1);
+    node.store_replica(
+        std::make_unique<dcss::dht::Entry>(UInt160(0x30u), value), 1);
+    EXPECT_EQ(node.n_extra_replicas(), 2u);
+
+    // Popular: renewed (for 2 ticks).
+    node.serve_value(UInt160(0x30u), 2, answer);
+    node.serve_value(UInt160(0x30u), 2, answer);
+    node.tick();
+    EXPECT_EQ(node.n_extra_replicas(), 1u);
+    EXPECT_EQ(node.replication_stats().n_expired, 1u);
+    EXPECT_FALSE(node.serve_value(UInt160(0x20u), 2, answer));
+    EXPECT_TRUE(node.serve_value(UInt160(0x30u), 2, answer));
+    node.tick();
+    node.tick();
+    EXPECT_EQ(node.n_extra_replicas(), 0u);
+    EXPECT_FALSE(node.serve_value(UInt160(0x30u), 2, answer));
+    EXPECT_TRUE(node.serve_value(UInt160(0x10u), 2, answer));
+
+    // A replica stored for good is reported then.
+    node.store_replica(
+        std::make_unique<dcss::dht::Entry>(UInt160(0x40u), value), 1);
+    node.store(std::make_unique<dcss::dht::Entry>(UInt160(0x40u), value));
+    EXPECT_EQ(node.stored, std::vector<UInt160>({0x10u, 0x40u}));
+
+    // Only the values stored for good are reported as erased.
+    node.store_replica(
+        std::make_unique<dcss::dht::Entry>(UInt160(0x50u), value), 1);
+    EXPECT_TRUE(node.erase(UInt160(0x50u)));
+    EXPECT_EQ(node.n_extra_replicas(), 0u);
+    EXPECT_TRUE(node.erase(UInt160(0x40u)));
+    EXPECT_FALSE(node.erase(UInt160(0x40u)));
+    EXPECT_EQ(node.erased, std::vector<UInt160>({0x40u}));
+    EXPECT_FALSE(node.serve_value(UInt160(0x40u), 2, answer));
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+
+#include "exceptions.h"
+#include "nonce_allocator.h"
+
+TEST(NonceAllocatorTest, TestAllocate) // NOLINT
+{
+    dcss::NonceAllocator nonces;
+
+    ASSERT_FALSE(nonces.is_synced("0x01"));
+    ASSERT_THROW(nonces.allocate("0x01"), dcss::LogicError);
+
+    nonces.sync("0x01", 5);
+    nonces.sync("0x02", 0);
+    EXPECT_EQ(nonces.allocate("0x01"), 5u);
+    EXPECT_EQ(nonces.allocate("0x01"), 6u);
+    EXPECT_EQ(nonces.allocate("0x02"), 0u);
+
+    nonces.invalidate("0x01");
+    EXPECT_FALSE(nonces.is_synced("0x01"));
+    EXPECT_TRUE(nonces.is_synced("0x02"));
+    nonces.sync("0x01", 6);
+    EXPECT_EQ(nonces.allocate("0x01"), 6u);
+}
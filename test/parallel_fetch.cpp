@@ -0,0 +1,167 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "buffer.h"
+#include "dht/dht.h"
+#include "latency_model.h"
+#include "parallel_fetch.h"
+#include "uint160.h"
+
+static const double TIMEOUT = 1000.0;
+
+// Targets are numbered by their key, latency[i] < 0 means lost.
+static std::vector<dcss::FetchTarget> make_targets(size_t n)
+{
+    std::vector<dcss::FetchTarget> targets;
+
+    for (uint32_t i = 0; i < n; ++i) {
+        targets.push_back(dcss::FetchTarget{
+            dcss::UInt160(i), dcss::dht::NodeAddress(i, "localhost", 0)});
+    }
+    return targets;
+}
+
+class FetchTest : public ::testing::Test {
+  protected:
+    dcss::FetchResult run(uint32_t n_needed, uint32_t n_parallel)
+    {
+        return dcss::fetch_first_n(
+            make_targets(latencies.size()),
+            n_needed,
+            n_parallel,
+            TIMEOUT,
+            [this](const dcss::FetchTarget& target, double& delay) {
+                delay = latencies[index(target)];
+                if (delay < 0) {
+                    delay = TIMEOUT;
+                    return false;
+                }
+                return true;
+            },
+            [this](const dcss::FetchTarget& target, dcss::Buffer& value) {
+                const uint32_t idx = index(target);
+                fetched.insert(idx);
+                if (dead.count(idx) != 0) {
+                    return false;
+                }
+                value = dcss::Buffer(std::to_string(idx));
+                return true;
+            });
+    }
+
+    static uint32_t index(const dcss::FetchTarget& target)
+    {
+        const std::string hex = target.key.to_string();
+        return static_cast<uint32_t>(std::stoul(hex, nullptr, 16));
+    }
+
+    std::vector<double> latencies;
+    std::set<uint32_t> dead;
+    std::set<uint32_t> fetched;
+};
+
+TEST_F(FetchTest, TestFirstN) // NOLINT
+{
+    latencies = {50.0, 10.0, 30.0, 20.0};
+
+    const dcss::FetchResult result = run(2, 4);
+    EXPECT_TRUE(result.complete);
+    EXPECT_DOUBLE_EQ(result.latency, 20.0) << "2nd fastest answer";
+    EXPECT_EQ(result.n_sent, 4u);
+    EXPECT_EQ(result.n_cancelled, 2u);
+    EXPECT_EQ(fetched, std::set<uint32_t>({1, 3})) << "stragglers cancelled";
+    ASSERT_EQ(result.values.size(), 2u);
+    EXPECT_EQ(result.values[0].to_string(), "1");
+    EXPECT_EQ(result.values[1].to_string(), "3");
+}
+
+TEST_F(FetchTest, TestMinimalSet) // NOLINT
+{
+    latencies = {50.0, 10.0, 30.0, 20.0};
+
+    // Without extra requests, we wait for the slowest of the two first.
+    const dcss::FetchResult result = run(2, 2);
+    EXPECT_TRUE(result.complete);
+    EXPECT_DOUBLE_EQ(result.latency, 50.0);
+    EXPECT_EQ(result.n_sent, 2u);
+    EXPECT_EQ(result.n_cancelled, 0u);
+}
+
+TEST_F(FetchTest, TestReplaceFailures) // NOLINT
+{
+    latencies = {-1.0, 10.0, 30.0};
+    dead = {1};
+
+    // Lost at TIMEOUT, replaced by 1 (dead, noticed at 2*TIMEOUT) then 2.
+    const dcss::FetchResult result = run(1, 1);
+    EXPECT_TRUE(result.complete);
+    EXPECT_DOUBLE_EQ(result.latency, 2 * TIMEOUT + 30.0);
+    EXPECT_EQ(result.n_sent, 3u);
+    EXPECT_EQ(result.n_failed, 2u);
+}
+
+TEST_F(FetchTest, TestNotEnoughTargets) // NOLINT
+{
+    latencies = {10.0, -1.0, 20.0};
+
+    const dcss::FetchResult result = run(3, 3);
+    EXPECT_FALSE(result.complete);
+    EXPECT_EQ(result.values.size(), 2u);
+    EXPECT_DOUBLE_EQ(result.latency, TIMEOUT);
+    EXPECT_EQ(result.n_failed, 1u);
+}
+
+TEST(LatencyModelTest, TestSample) // NOLINT
+{
+    std::mt19937 prng(42);
+    dcss::LatencyModel model(20.0, 0.5, 0.0, 10.0, 0.0, 1000.0);
+    double latency;
+
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(model.sample(dcss::UInt160(1u), prng, latency));
+        EXPECT_GT(latency, 0.0);
+        EXPECT_LT(latency, 1000.0);
+    }
+
+    dcss::LatencyModel lossy(20.0, 0.5, 0.0, 10.0, 1.0, 1000.0);
+    EXPECT_FALSE(lossy.sample(dcss::UInt160(1u), prng, latency));
+    EXPECT_DOUBLE_EQ(latency, 1000.0) << "lost RPC noticed on timeout";
+
+    dcss::LatencyModel slow(20.0, 0.5, 1.0, 10.0, 0.0, 1000.0);
+    EXPECT_TRUE(slow.is_slow(dcss::UInt160(1u)));
+    EXPECT_FALSE(model.is_slow(dcss::UInt160(1u)));
+}
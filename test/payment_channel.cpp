@@ -0,0 +1,164 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdint>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "exceptions.h"
+#include "payment_channel.h"
+
+static const std::string BUYER = "0x1111111111111111111111111111111111111111";
+static const std::string SELLER = "0x2222222222222222222222222222222222222222";
+
+TEST(PaymentChannelTest, TestOpenClose) // NOLINT
+{
+    dcss::PaymentChannels channels;
+
+    ASSERT_FALSE(channels.is_open(BUYER, SELLER));
+    ASSERT_THROW(channels.find(BUYER, SELLER), dcss::DomainError);
+
+    const std::string id = channels.open(BUYER, SELLER, 1000, 1, 1);
+    ASSERT_EQ(id.size(), 2u + 64u);
+    ASSERT_EQ(id.substr(0, 42), BUYER);
+    ASSERT_THROW(channels.open(BUYER, SELLER, 1000, 1, 1), dcss::DomainError);
+    ASSERT_EQ(channels.find(BUYER, SELLER).deposit, 1000u);
+
+    // Nothing to pay through until `openChannel` is mined.
+    ASSERT_FALSE(channels.is_open(BUYER, SELLER));
+    ASSERT_THROW(channels.pay(BUYER, SELLER, 1, 0), dcss::DomainError);
+    channels.confirm(id);
+    ASSERT_TRUE(channels.is_open(BUYER, SELLER));
+    ASSERT_FALSE(channels.is_open(SELLER, BUYER));
+
+    channels.close(id);
+    ASSERT_FALSE(channels.is_open(BUYER, SELLER));
+
+    // Never the same ID twice.
+    const std::string failed = channels.open(BUYER, SELLER, 1000, 1, 1);
+    ASSERT_NE(failed, id);
+
+    // Forgotten if `openChannel` fails.
+    channels.close(failed);
+    ASSERT_THROW(channels.find(BUYER, SELLER), dcss::DomainError);
+
+    const dcss::ChannelStats stats = channels.stats();
+    ASSERT_EQ(stats.n_opened, 1u);
+    ASSERT_EQ(stats.n_closed, 1u);
+}
+
+TEST(PaymentChannelTest, TestClosing) // NOLINT
+{
+    dcss::PaymentChannels channels;
+    const std::string id = channels.open(BUYER, SELLER, 1000, 1, 1);
+
+    // Not open yet.
+    ASSERT_THROW(channels.start_closing(BUYER, SELLER), dcss::DomainError);
+    channels.confirm(id);
+    channels.pay(BUYER, SELLER, 100, 0);
+
+    // Nothing more to pay until the closing is mined.
+    ASSERT_EQ(channels.start_closing(BUYER, SELLER).put_bytes, 100u);
+    ASSERT_FALSE(channels.is_open(BUYER, SELLER));
+    ASSERT_THROW(channels.pay(BUYER, SELLER, 1, 0), dcss::DomainError);
+    ASSERT_THROW(channels.start_closing(BUYER, SELLER), dcss::DomainError);
+
+    // Open again if it fails.
+    channels.reopen(id);
+    ASSERT_TRUE(channels.is_open(BUYER, SELLER));
+    ASSERT_EQ(channels.pay(BUYER, SELLER, 1, 0).put_bytes, 101u);
+
+    channels.start_closing(BUYER, SELLER);
+    channels.close(id);
+    ASSERT_THROW(channels.find(BUYER, SELLER), dcss::DomainError);
+    ASSERT_EQ(channels.stats().n_closed, 1u);
+}
+
+TEST(PaymentChannelTest, TestVouchers) // NOLINT
+{
+    dcss::PaymentChannels channels;
+    const std::string id = channels.open(BUYER, SELLER, 1000, 1, 1);
+    channels.confirm(id);
+
+    ASSERT_THROW(channels.pay(SELLER, BUYER, 1, 0), dcss::DomainError);
+
+    const dcss::PaymentChannel first = channels.pay(BUYER, SELLER, 100, 0);
+    const dcss::PaymentChannel second = channels.pay(BUYER, SELLER, 0, 50);
+    ASSERT_EQ(second.put_bytes, 100u);
+    ASSERT_EQ(second.get_bytes, 50u);
+
+    // The seller keeps the voucher paying the most, whatever the order.
+    channels.deliver(id, {second.put_bytes, second.get_bytes, "0x02"});
+    channels.deliver(id, {first.put_bytes, first.get_bytes, "0x01"});
+    ASSERT_EQ(channels.find(BUYER, SELLER).voucher.signature, "0x02");
+
+    const dcss::ChannelStats stats = channels.stats();
+    ASSERT_EQ(stats.n_vouchers, 2u);
+    ASSERT_EQ(stats.n_bytes, 150u);
+}
+
+TEST(PaymentChannelTest, TestDeposit) // NOLINT
+{
+    dcss::PaymentChannels channels;
+    channels.confirm(channels.open(BUYER, SELLER, 1000, 2, 3));
+
+    channels.pay(BUYER, SELLER, 200, 0);
+    ASSERT_EQ(channels.pay(BUYER, SELLER, 0, 200).get_bytes, 200u);
+
+    // 2 * 200 + 3 * 200 tokens: nothing more is paid.
+    ASSERT_THROW(channels.pay(BUYER, SELLER, 1, 0), dcss::DomainError);
+    ASSERT_THROW(channels.pay(BUYER, SELLER, 0, 1), dcss::DomainError);
+    ASSERT_THROW(
+        channels.pay(BUYER, SELLER, UINT64_MAX / 2, 0), dcss::DomainError);
+
+    const dcss::PaymentChannel channel = channels.find(BUYER, SELLER);
+    ASSERT_EQ(channel.put_bytes, 200u);
+    ASSERT_EQ(channel.get_bytes, 200u);
+    ASSERT_EQ(channels.stats().n_vouchers, 2u);
+}
+
+TEST(PaymentChannelTest, TestVoucherMessage) // NOLINT
+{
+    const std::string id = "0x" + std::string(63, '0') + "7";
+    const std::string message =
+        dcss::voucher_message(SELLER, id, {0x10, 0x20, ""});
+
+    // 20 + 32 * 3 bytes, as hashed by the contract.
+    ASSERT_EQ(message.size(), 2u + 2 * 116u);
+    ASSERT_EQ(message.substr(0, 42), SELLER);
+    ASSERT_EQ(message.substr(42, 64), id.substr(2));
+    ASSERT_EQ(message.substr(106, 64), std::string(62, '0') + "10");
+    ASSERT_EQ(message.substr(170, 64), std::string(62, '0') + "20");
+
+    ASSERT_THROW(
+        dcss::voucher_message("0x22", id, {0, 0, ""}), dcss::DomainError);
+    ASSERT_THROW(
+        dcss::voucher_message(SELLER, "0x07", {0, 0, ""}), dcss::DomainError);
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "dcss_conf.h"
+#include "dcss_network.h"
+#include "repair.h"
+#include "uint160.h"
+
+TEST(RepairTest, TestTokenBucket) // NOLINT
+{
+    dcss::TokenBucket bucket(100, 200);
+
+    EXPECT_TRUE(bucket.has_tokens()) << "initially full";
+    bucket.consume(150);
+    EXPECT_TRUE(bucket.has_tokens());
+    bucket.consume(100);
+    EXPECT_FALSE(bucket.has_tokens()) << "oversized transfer makes a debt";
+    bucket.tick();
+    EXPECT_TRUE(bucket.has_tokens()) << "debt paid";
+
+    // Never more than the burst.
+    for (int i = 0; i < 10; ++i) {
+        bucket.tick();
+    }
+    bucket.consume(200);
+    EXPECT_FALSE(bucket.has_tokens());
+}
+
+TEST(RepairTest, TestQueuePriority) // NOLINT
+{
+    dcss::RepairQueue queue;
+    dcss::RepairTask task;
+
+    EXPECT_FALSE(queue.pop(task));
+
+    EXPECT_TRUE(queue.push(dcss::RepairTask{dcss::UInt160(1u), 3, 1}));
+    EXPECT_TRUE(queue.push(dcss::RepairTask{dcss::UInt160(2u), 0, 1}));
+    EXPECT_TRUE(queue.push(dcss::RepairTask{dcss::UInt160(3u), 0, 4}));
+    EXPECT_TRUE(queue.push(dcss::RepairTask{dcss::UInt160(4u), 1, 2}));
+    EXPECT_FALSE(queue.push(dcss::RepairTask{dcss::UInt160(4u), 0, 5}))
+        << "already queued";
+    EXPECT_EQ(queue.size(), 4u);
+
+    // Least margin first, then most missing pieces.
+    const uint32_t expected[] = {3, 2, 4, 1};
+    for (const uint32_t file : expected) {
+        ASSERT_TRUE(queue.pop(task));
+        EXPECT_EQ(task.file, dcss::UInt160(file));
+    }
+    EXPECT_TRUE(queue.empty());
+
+    // Once dequeued, a file can be queued again.
+    EXPECT_TRUE(queue.push(dcss::RepairTask{dcss::UInt160(4u), 0, 5}));
+}
+
+TEST(RepairTest, TestRepairReplicas) // NOLINT
+{
+    dcss::Conf conf(16, 4, 3, 32, "mock", {});
+    dcss::Network network(conf);
+
+    network.initialize_nodes(8, {});
+    network.initialize_files(20, 64);
+    network.fail_nodes(0.1);
+
+    const dcss::RepairStats stats = network.repair(1 << 20, 8, 100, 5);
+
+    EXPECT_TRUE(stats.restored);
+    EXPECT_GT(stats.n_repaired, 0u) << "failures degrade files";
+    EXPECT_EQ(stats.n_degraded, 0u);
+    EXPECT_EQ(stats.n_lost, 0u);
+    EXPECT_EQ(stats.n_reads, 5 * stats.n_ticks) << "read meanwhile";
+
+    // The reads taught the nodes closer neighbors, which may get a replica
+    // too: the files stay safe.
+    const dcss::RepairStats again = network.repair(1 << 20, 8, 100, 0);
+    EXPECT_TRUE(again.restored);
+    EXPECT_EQ(again.n_degraded, 0u);
+}
+
+TEST(RepairTest, TestRepairFragments) // NOLINT
+{
+    dcss::Conf conf(16, 4, 3, 32, "mock", {});
+    conf.n_data = 4;
+    conf.n_parities = 2;
+    dcss::Network network(conf);
+
+    network.initialize_nodes(8, {});
+    network.initialize_files(40, 64);
+    network.fail_nodes(1.0 / 32);
+
+    const dcss::RepairStats stats = network.repair(1 << 20, 8, 100, 5);
+
+    EXPECT_TRUE(stats.restored);
+    EXPECT_GT(stats.n_repaired, 0u) << "failures degrade files";
+    EXPECT_EQ(stats.n_degraded, 0u);
+    EXPECT_EQ(stats.n_lost, 0u);
+}
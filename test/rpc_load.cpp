@@ -0,0 +1,92 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rpc_load.h"
+#include "uint160.h"
+
+TEST(RpcLoadTest, TestRecord) // NOLINT
+{
+    dcss::RpcLoad load;
+
+    load.record(1u, dcss::Rpc::FIND_NODE, 20, 52);
+    load.record(1u, dcss::Rpc::STORE, 120, 0, 1);
+    load.record(2u, dcss::Rpc::PING, 20, 20);
+
+    const auto totals = load.totals();
+    ASSERT_EQ(totals.size(), 2u);
+    const dcss::RpcCounters& first = totals.at(1u);
+    EXPECT_EQ(first.n_requests(), 2u);
+    EXPECT_EQ(
+        first.n_served[static_cast<size_t>(dcss::Rpc::FIND_NODE)], 1u);
+    EXPECT_EQ(first.n_served[static_cast<size_t>(dcss::Rpc::STORE)], 1u);
+    EXPECT_EQ(first.bytes_in, 140u);
+    EXPECT_EQ(first.bytes_out, 52u);
+    EXPECT_EQ(first.n_stored, 1u);
+    EXPECT_EQ(totals.at(2u).n_requests(), 1u);
+
+    load.reset();
+    EXPECT_TRUE(load.totals().empty());
+    load.record(2u, dcss::Rpc::PING, 20, 20);
+    EXPECT_EQ(load.totals().at(2u).n_requests(), 1u);
+}
+
+TEST(RpcLoadTest, TestThreads) // NOLINT
+{
+    const uint32_t n_threads = 4;
+    const uint32_t n_records = 1000;
+    dcss::RpcLoad load;
+    std::vector<std::thread> threads;
+
+    for (uint32_t i = 0; i < n_threads; ++i) {
+        threads.emplace_back([&load, i]() {
+            for (uint32_t j = 0; j < n_records; ++j) {
+                // One node shared by every thread, one per thread.
+                load.record(0u, dcss::Rpc::FIND_VALUE, 20, 1);
+                load.record(i + 1, dcss::Rpc::FIND_VALUE, 20, 1);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    const auto totals = load.totals();
+    ASSERT_EQ(totals.size(), n_threads + 1);
+    EXPECT_EQ(totals.at(0u).n_requests(), n_threads * n_records);
+    EXPECT_EQ(totals.at(0u).bytes_out, n_threads * n_records);
+    for (uint32_t i = 1; i <= n_threads; ++i) {
+        EXPECT_EQ(totals.at(i).n_requests(), n_records);
+    }
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "exceptions.h"
+#include "single_flight.h"
+
+namespace {
+
+using Flight = dcss::SingleFlight<std::string, uint32_t>;
+
+/** Wait until `n` calls joined the one in flight. */
+void wait_shared(const Flight& flight, uint64_t n)
+{
+    while (flight.n_shared() < n) {
+        std::this_thread::yield();
+    }
+}
+
+} // namespace
+
+TEST(SingleFlightTest, TestShared) // NOLINT
+{
+    Flight flight;
+    std::promise<void> release;
+    std::shared_future<void> released(release.get_future().share());
+    std::atomic<uint32_t> n_runs(0);
+    const auto func = [&](const Flight::AbandonedFunc&) {
+        ++n_runs;
+        released.wait();
+        return 42u;
+    };
+
+    std::vector<std::future<uint32_t>> results;
+    results.push_back(
+        std::async(std::launch::async, [&] { return flight.run("a", func); }));
+    while (flight.in_flight() == 0) {
+        std::this_thread::yield();
+    }
+    for (int i = 0; i < 3; ++i) {
+        results.push_back(std::async(
+            std::launch::async, [&] { return flight.run("a", func); }));
+    }
+    wait_shared(flight, 3);
+    // Other keys are not coalesced.
+    EXPECT_EQ(flight.run("b", [](const Flight::AbandonedFunc&) { return 1u; }),
+              1u);
+    release.set_value();
+
+    for (auto& result : results) {
+        EXPECT_EQ(result.get(), 42u);
+    }
+    EXPECT_EQ(n_runs, 1u);
+    EXPECT_EQ(flight.n_calls(), 5u);
+    EXPECT_EQ(flight.in_flight(), 0u);
+
+    // Done: the next call runs the operation again.
+    flight.run("a", func);
+    EXPECT_EQ(n_runs, 2u);
+}
+
+TEST(SingleFlightTest, TestErrorPropagation) // NOLINT
+{
+    Flight flight;
+    std::promise<void> release;
+    std::shared_future<void> released(release.get_future().share());
+    const auto func = [&](const Flight::AbandonedFunc&) -> uint32_t {
+        released.wait();
+        throw dcss::DomainError("lookup failed");
+    };
+
+    auto leader =
+        std::async(std::launch::async, [&] { return flight.run("a", func); });
+    while (flight.in_flight() == 0) {
+        std::this_thread::yield();
+    }
+    auto follower =
+        std::async(std::launch::async, [&] { return flight.run("a", func); });
+    wait_shared(flight, 1);
+    release.set_value();
+
+    EXPECT_THROW(leader.get(), dcss::DomainError);
+    EXPECT_THROW(follower.get(), dcss::DomainError);
+    // Errors are not cached.
+    EXPECT_EQ(flight.run("a", [](const Flight::AbandonedFunc&) { return 7u; }),
+              7u);
+}
+
+TEST(SingleFlightTest, TestCancelFollower) // NOLINT
+{
+    Flight flight;
+    std::promise<void> release;
+    std::shared_future<void> released(release.get_future().share());
+    std::atomic<bool> abandoned(false);
+    const auto func = [&](const Flight::AbandonedFunc& is_abandoned) {
+        released.wait();
+        abandoned = is_abandoned();
+        return 42u;
+    };
+    Flight::CancelFlag cancel(false);
+
+    auto leader =
+        std::async(std::launch::async, [&] { return flight.run("a", func); });
+    while (flight.in_flight() == 0) {
+        std::this_thread::yield();
+    }
+    auto follower = std::async(
+        std::launch::async, [&] { return flight.run("a", func, &cancel); });
+    wait_shared(flight, 1);
+    flight.cancel(cancel);
+
+    EXPECT_THROW(follower.get(), dcss::CancelledError);
+    release.set_value();
+    EXPECT_EQ(leader.get(), 42u) << "the leader is not affected";
+    EXPECT_FALSE(abandoned);
+}
+
+TEST(SingleFlightTest, TestAbandoned) // NOLINT
+{
+    std::promise<void> release;
+    std::shared_future<void> released(release.get_future().share());
+    std::atomic<bool> checked(false);
+    std::atomic<bool> follower_gone(false);
+    std::atomic<bool> stopped(false);
+    const auto func = [&](const Flight::AbandonedFunc& abandoned) -> uint32_t {
+        released.wait();
+        // Still wanted by the follower.
+        EXPECT_FALSE(abandoned());
+        checked = true;
+        while (!follower_gone) {
+            std::this_thread::yield();
+        }
+        if (abandoned()) {
+            stopped = true;
+            throw dcss::CancelledError("lookup stopped");
+        }
+        return 42u;
+    };
+    Flight::CancelFlag cancel(false);
+    Flight::CancelFlag follower_cancel(false);
+    // Last, to wait for the operation before the above go away.
+    Flight flight;
+
+    auto leader = std::async(
+        std::launch::async, [&] { return flight.run("a", func, &cancel); });
+    while (flight.in_flight() == 0) {
+        std::this_thread::yield();
+    }
+    auto follower = std::async(std::launch::async, [&] {
+        return flight.run("a", func, &follower_cancel);
+    });
+    wait_shared(flight, 1);
+    flight.cancel(cancel);
+    EXPECT_THROW(leader.get(), dcss::CancelledError)
+        << "the leader doesn't wait for the operation";
+
+    release.set_value();
+    while (!checked) {
+        std::this_thread::yield();
+    }
+    flight.cancel(follower_cancel);
+    EXPECT_THROW(follower.get(), dcss::CancelledError);
+    EXPECT_EQ(flight.in_flight(), 0u);
+    follower_gone = true;
+    while (!stopped) {
+        std::this_thread::yield();
+    }
+}
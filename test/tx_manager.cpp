@@ -0,0 +1,399 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "exceptions.h"
+#include "gethclient.h"
+#include "tx_manager.h"
+
+namespace {
+
+/** A stand-in for geth: each call to `mine` mines the transactions sent
+ * since the previous one (in nonce order), their data selects the outcome.
+ */
+class FakeGeth : public jsonrpc::IClientConnector {
+  public:
+    void mine()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const std::string& hash : m_unmined) {
+            m_mined[hash] = m_blocks.size() + 1;
+        }
+        m_blocks.push_back(m_unmined);
+        m_unmined.clear();
+    }
+
+    /** Fail (once) the transaction with the given nonce. */
+    void fail_nonce(uint64_t nonce)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fail_nonces.insert(nonce);
+    }
+
+    /** Answer `eth_blockNumber` with `head` instead of the head. */
+    void set_head(const std::string& head)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_head = head;
+    }
+
+    /** Return the number of transactions sent, not mined yet. */
+    size_t n_unmined()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_unmined.size();
+    }
+
+    /** Return the number of calls to `method`. */
+    uint32_t n_calls(const std::string& method)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_n_calls[method];
+    }
+
+    /** Return the number of requests (a batch counts once). */
+    uint32_t n_requests()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_n_requests;
+    }
+
+    void SendRPCMessage(const std::string& message, std::string& result)
+        override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Json::Reader reader;
+        Json::Value request;
+        Json::Value answers;
+
+        reader.parse(message, request);
+        ++m_n_requests;
+        if (request.isArray()) {
+            answers = Json::Value(Json::arrayValue);
+            for (const Json::Value& call : request) {
+                answers.append(answer_call(call));
+            }
+        } else {
+            answers = answer_call(request);
+        }
+        result = Json::FastWriter().write(answers);
+    }
+
+  private:
+    Json::Value answer_call(const Json::Value& request)
+    {
+        Json::Value answer;
+
+        answer["jsonrpc"] = "2.0";
+        answer["id"] = request["id"];
+
+        const std::string method = request["method"].asString();
+        const Json::Value& param = request["params"][0];
+        ++m_n_calls[method];
+        if (method == "eth_sendTransaction") {
+            send(param, answer);
+        } else if (method == "eth_getTransactionCount") {
+            answer["result"] = quantity(m_next_nonce[param.asString()]);
+        } else if (method == "eth_blockNumber") {
+            answer["result"] =
+                m_head.empty() ? quantity(m_blocks.size()) : m_head;
+        } else if (method == "eth_getBlockByNumber") {
+            const size_t number = std::stoul(param.asString(), nullptr, 16);
+            if (number == 0 || number > m_blocks.size()) {
+                answer["result"] = Json::Value();
+            } else {
+                Json::Value& txs = answer["result"]["transactions"];
+                txs = Json::Value(Json::arrayValue);
+                for (const std::string& hash : m_blocks[number - 1]) {
+                    txs.append(hash);
+                }
+            }
+        } else if (method == "eth_getTransactionReceipt") {
+            const std::string hash = param.asString();
+            if (m_mined.count(hash) == 0) {
+                answer["result"] = Json::Value();
+            } else {
+                answer["result"]["transactionHash"] = hash;
+                answer["result"]["blockNumber"] = quantity(m_mined[hash]);
+                answer["result"]["status"] =
+                    m_data[hash] == "revert" ? "0x0" : "0x1";
+            }
+        }
+        return answer;
+    }
+
+    /** Accept the transactions in nonce order: a transaction after a gap
+     * waits for the gap to be filled.
+     */
+    void send(const Json::Value& tx, Json::Value& answer)
+    {
+        const std::string from = tx["from"].asString();
+        uint64_t& next = m_next_nonce[from];
+        const uint64_t nonce = tx.isMember("nonce")
+                                   ? std::stoull(tx["nonce"].asString(), 0, 16)
+                                   : next;
+
+        if (tx["data"] == "reject"
+            || (tx.isMember("from") && !tx["from"].isString())) {
+            answer["error"]["code"] = -32602;
+            answer["error"]["message"] = "invalid argument";
+            return;
+        }
+        if (m_fail_nonces.erase(nonce) != 0) {
+            answer["error"]["code"] = -32000;
+            answer["error"]["message"] = "txpool is full";
+            return;
+        }
+        if (nonce < next) {
+            answer["error"]["code"] = -32000;
+            answer["error"]["message"] = "nonce too low";
+            return;
+        }
+        const std::string hash = "0x" + std::to_string(m_data.size());
+        m_data[hash] = tx["data"].asString();
+        answer["result"] = hash;
+
+        std::map<uint64_t, std::string>& queued = m_queued[from];
+        queued[nonce] = hash;
+        for (auto it = queued.find(next); it != queued.end();
+             it = queued.find(next)) {
+            m_unmined.push_back(it->second);
+            queued.erase(it);
+            ++next;
+        }
+    }
+
+    static std::string quantity(size_t n)
+    {
+        std::ostringstream oss;
+        oss << "0x" << std::hex << n;
+        return oss.str();
+    }
+
+    std::mutex m_mutex;
+    std::map<std::string, std::string> m_data;
+    std::vector<std::string> m_unmined;
+    std::vector<std::vector<std::string>> m_blocks;
+    std::map<std::string, size_t> m_mined;
+    std::map<std::string, uint32_t> m_n_calls;
+    uint32_t m_n_requests = 0;
+    std::map<std::string, uint64_t> m_next_nonce;
+    std::map<std::string, std::map<uint64_t, std::string>> m_queued;
+    std::set<uint64_t> m_fail_nonces;
+    std::string m_head;
+};
+
+Json::Value make_tx(const std::string& data)
+{
+    Json::Value tx;
+
+    tx["from"] = "0x01";
+    tx["to"] = "0x02";
+    tx["data"] = data;
+    return tx;
+}
+
+void wait_sent(FakeGeth& fake, size_t n_txs)
+{
+    while (fake.n_unmined() < n_txs) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+} // namespace
+
+TEST(TxManagerTest, TestSubmit) // NOLINT
+{
+    const size_t n_txs = 50;
+    FakeGeth fake;
+    GethClient geth(fake);
+    dcss::TxManager txs(
+        geth,
+        std::chrono::milliseconds(1),
+        std::chrono::milliseconds(4));
+    std::vector<std::future<dcss::TxReceipt>> receipts;
+
+    // All the transactions are in flight together, mined in two blocks.
+    for (size_t i = 0; i < n_txs; ++i) {
+        receipts.push_back(txs.submit(make_tx("0x" + std::to_string(i))));
+        if (i == n_txs / 2) {
+            wait_sent(fake, i + 1);
+            fake.mine();
+        }
+    }
+    auto reverted = txs.submit(make_tx("revert"));
+    auto rejected = txs.submit(make_tx("reject"));
+    // Sent as is: geth picks the sender.
+    Json::Value no_sender = make_tx("0x");
+    no_sender.removeMember("from");
+    auto by_geth = txs.submit(no_sender);
+    // The nonce of the rejected one is taken by an empty transaction.
+    wait_sent(fake, n_txs / 2 + 2);
+    fake.mine();
+    fake.mine();
+
+    for (auto& receipt : receipts) {
+        const dcss::TxReceipt mined = receipt.get();
+        EXPECT_TRUE(mined.success);
+        EXPECT_EQ(mined.receipt["transactionHash"].asString(), mined.hash);
+    }
+    EXPECT_FALSE(reverted.get().success);
+    EXPECT_TRUE(by_geth.get().success);
+    EXPECT_THROW(rejected.get(), jsonrpc::JsonRpcException);
+    // The empty transaction is mined too (nobody waits for it).
+    while (txs.n_in_flight() != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // A single receipt fetched per transaction, each block scanned once.
+    const dcss::TxStats stats = txs.stats();
+    EXPECT_EQ(stats.n_fillers, 1u);
+    EXPECT_EQ(stats.n_sent, n_txs + 3);
+    EXPECT_EQ(stats.n_mined, n_txs + 3);
+    EXPECT_EQ(fake.n_calls("eth_getTransactionReceipt"), n_txs + 3);
+    EXPECT_EQ(fake.n_calls("eth_getBlockByNumber"), stats.n_blocks);
+    EXPECT_LE(stats.n_blocks, 3u);
+    EXPECT_EQ(stats.n_requests, fake.n_requests());
+    EXPECT_LT(stats.n_requests, stats.n_calls);
+}
+
+TEST(TxManagerTest, TestBackoff) // NOLINT
+{
+    FakeGeth fake;
+    GethClient geth(fake);
+    dcss::TxManager txs(
+        geth,
+        std::chrono::milliseconds(1),
+        std::chrono::milliseconds(8));
+
+    // Head polled after 1, 2, 4, 8, 8… ms: no busy wait.
+    auto receipt = txs.submit(make_tx("0x"));
+    wait_sent(fake, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    EXPECT_LE(fake.n_calls("eth_blockNumber"), 10u);
+
+    fake.mine();
+    EXPECT_TRUE(receipt.get().success);
+    EXPECT_EQ(fake.n_calls("eth_getTransactionReceipt"), 1u);
+}
+
+TEST(TxManagerTest, TestInvalidAnswer) // NOLINT
+{
+    FakeGeth fake;
+    GethClient geth(fake);
+    dcss::TxManager txs(geth);
+
+    // Not a 64-bit quantity: the transactions fail, the manager goes on.
+    fake.set_head("0x" + std::string(17, 'f'));
+    EXPECT_THROW(txs.submit(make_tx("0x")).get(), jsonrpc::JsonRpcException);
+    fake.set_head("0xg");
+    EXPECT_THROW(txs.submit(make_tx("0x")).get(), jsonrpc::JsonRpcException);
+    EXPECT_EQ(txs.n_in_flight(), 0u);
+}
+
+TEST(TxManagerTest, TestGiveUp) // NOLINT
+{
+    FakeGeth fake;
+    GethClient geth(fake);
+    std::promise<std::exception_ptr> cancelled;
+
+    {
+        dcss::TxManager txs(
+            geth,
+            std::chrono::milliseconds(1),
+            std::chrono::milliseconds(2),
+            std::chrono::milliseconds(20));
+
+        auto timed_out = txs.submit(make_tx("0x"));
+        EXPECT_THROW(timed_out.get(), dcss::DomainError);
+
+        txs.submit(
+            make_tx("0x"),
+            [&cancelled](const dcss::TxReceipt&, std::exception_ptr error) {
+                cancelled.set_value(error);
+            });
+    }
+    // Still in flight when the manager is destroyed.
+    const std::exception_ptr error = cancelled.get_future().get();
+    ASSERT_TRUE(error);
+    EXPECT_THROW(std::rethrow_exception(error), dcss::CancelledError);
+}
+
+TEST(TxManagerTest, TestNonces) // NOLINT
+{
+    const size_t n_txs = 10;
+    FakeGeth fake;
+    GethClient geth(fake);
+    dcss::TxManager txs(
+        geth,
+        std::chrono::milliseconds(1),
+        std::chrono::milliseconds(4));
+    std::vector<std::future<dcss::TxReceipt>> receipts;
+
+    // The 4th transaction fails: the ones sent after it wait for the gap,
+    // filled at once, without another submission.
+    fake.fail_nonce(3);
+    for (size_t i = 0; i < n_txs; ++i) {
+        receipts.push_back(txs.submit(make_tx("0x")));
+    }
+    EXPECT_THROW(receipts[3].get(), jsonrpc::JsonRpcException);
+    wait_sent(fake, n_txs);
+    fake.mine();
+    for (size_t i = 0; i < receipts.size(); ++i) {
+        if (i != 3) {
+            EXPECT_TRUE(receipts[i].get().success);
+        }
+    }
+    EXPECT_EQ(txs.stats().n_fillers, 1u);
+
+    // Its next nonce taken by another sender: synchronized again.
+    Json::Value other = make_tx("0x");
+    other["nonce"] = "0xa";
+    Json::Value params;
+    params.append(other);
+    geth.CallMethod("eth_sendTransaction", params);
+    auto last = txs.submit(make_tx("0x"));
+    wait_sent(fake, 2);
+    fake.mine();
+    EXPECT_TRUE(last.get().success);
+    EXPECT_EQ(txs.stats().n_nonce_syncs, 2u);
+    EXPECT_EQ(txs.stats().n_fillers, 1u);
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2017-2018 the DCSS authors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdint>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "buffer.h"
+#include "uint160.h"
+#include "value_cache.h"
+
+namespace {
+
+/** A value charged 100 bytes (with its key). */
+dcss::Buffer value_of(char c)
+{
+    return dcss::Buffer(std::string(100 - sizeof(dcss::UInt160), c));
+}
+
+/** Read `key` through `cache`, storing it on a miss. */
+bool read(dcss::ValueCache& cache, uint32_t key)
+{
+    dcss::Buffer value;
+
+    if (cache.get(key, value)) {
+        return true;
+    }
+    cache.put(key, value_of('a'));
+    return false;
+}
+
+bool is_cached(dcss::ValueCache& cache, uint32_t key)
+{
+    dcss::Buffer value;
+
+    return cache.get(key, value);
+}
+
+} // namespace
+
+TEST(ValueCacheTest, TestSketch) // NOLINT
+{
+    dcss::CountMinSketch sketch(64);
+
+    for (int i = 0; i < 5; ++i) {
+        sketch.increment(1u);
+    }
+    sketch.increment(2u);
+    EXPECT_EQ(sketch.estimate(1u), 5);
+    EXPECT_EQ(sketch.estimate(2u), 1);
+    EXPECT_EQ(sketch.estimate(3u), 0);
+
+    // One counter per row, aged every 10 increments.
+    dcss::CountMinSketch small(1);
+    for (int i = 0; i < 9; ++i) {
+        small.increment(1u);
+    }
+    EXPECT_EQ(small.estimate(1u), 9);
+    small.increment(1u);
+    EXPECT_EQ(small.estimate(1u), 5);
+}
+
+TEST(ValueCacheTest, TestLru) // NOLINT
+{
+    dcss::ValueCache cache(300, dcss::CachePolicy::LRU);
+
+    for (uint32_t key = 1; key <= 3; ++key) {
+        EXPECT_FALSE(read(cache, key));
+    }
+    EXPECT_EQ(cache.used(), 300);
+    EXPECT_TRUE(read(cache, 1));
+    EXPECT_FALSE(read(cache, 4));
+    EXPECT_EQ(cache.stats().n_evicted, 1);
+    EXPECT_FALSE(is_cached(cache, 2));
+    EXPECT_TRUE(is_cached(cache, 1));
+    EXPECT_TRUE(is_cached(cache, 3));
+    EXPECT_TRUE(is_cached(cache, 4));
+
+    // A new version replaces the cached one.
+    dcss::Buffer value;
+    EXPECT_TRUE(cache.put(1u, value_of('b')));
+    EXPECT_TRUE(cache.get(1u, value));
+    EXPECT_EQ(value, value_of('b'));
+    EXPECT_EQ(cache.used(), 300);
+}
+
+TEST(ValueCacheTest, TestAdmission) // NOLINT
+{
+    dcss::ValueCache cache(300, dcss::CachePolicy::TINY_LFU);
+
+    for (int i = 0; i < 3; ++i) {
+        for (uint32_t key = 1; key <= 3; ++key) {
+            read(cache, key);
+        }
+    }
+    EXPECT_EQ(cache.stats().n_hits, 6);
+
+    // A one-hit wonder does not evict the popular values...
+    EXPECT_FALSE(read(cache, 4));
+    EXPECT_EQ(cache.stats().n_rejected, 1);
+    EXPECT_EQ(cache.stats().n_evicted, 0);
+    for (uint32_t key = 1; key <= 3; ++key) {
+        EXPECT_TRUE(is_cached(cache, key));
+    }
+
+    // ...until it gets more popular than them.
+    for (int i = 0; i < 6; ++i) {
+        read(cache, 4);
+    }
+    EXPECT_TRUE(is_cached(cache, 4));
+    EXPECT_EQ(cache.stats().n_evicted, 1);
+    EXPECT_EQ(cache.used(), 300);
+}
+
+TEST(ValueCacheTest, TestProtected) // NOLINT
+{
+    dcss::ValueCache cache(300, dcss::CachePolicy::TINY_LFU);
+
+    read(cache, 1);
+    // Hit in probation: promoted to the protected segment.
+    EXPECT_TRUE(read(cache, 1));
+    read(cache, 2);
+    read(cache, 3);
+    for (int i = 0; i < 3; ++i) {
+        read(cache, 4);
+    }
+
+    // The least recently used value is protected, the victim is taken from
+    // probation.
+    EXPECT_TRUE(is_cached(cache, 1));
+    EXPECT_FALSE(is_cached(cache, 2));
+    EXPECT_TRUE(is_cached(cache, 3));
+    EXPECT_TRUE(is_cached(cache, 4));
+}
+
+TEST(ValueCacheTest, TestBudget) // NOLINT
+{
+    for (const auto policy :
+         {dcss::CachePolicy::LRU, dcss::CachePolicy::TINY_LFU}) {
+        dcss::ValueCache cache(1000, policy);
+
+        for (uint32_t i = 0; i < 1000; ++i) {
+            read(cache, (i * 7919) % 37);
+            EXPECT_LE(cache.used(), 1000);
+        }
+        EXPECT_FALSE(cache.put(1000u, dcss::Buffer(std::string(1000, 'a'))));
+
+        dcss::ValueCache disabled(0, policy);
+        EXPECT_FALSE(read(disabled, 1));
+        EXPECT_FALSE(read(disabled, 1));
+        EXPECT_EQ(disabled.used(), 0);
+    }
+}